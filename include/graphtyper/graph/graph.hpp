@@ -114,11 +114,20 @@ public:
     ) const;
 
   bool is_variant_in_graph(Variant const & var) const;
+
+  /**
+   * \brief Gets sorted and merged regions, in the 'chr:begin-end' format, which cover all variants of the graph.
+   * \details Each variant is padded by 'padding' bases on both sides. Positions are 1-based and inclusive.
+   */
+  std::vector<std::string> get_variant_regions(uint32_t const padding) const;
   uint8_t get_10log10_num_paths(TNodeIndex const v, uint32_t const MAX_DISTANCE = 60);
 
   /*************************
    * GRAPH LOCAL ALIGNMENT *
    *************************/
+  /** \brief Gets the reference position of a location. Positions on variant nodes are counted from the reach. */
+  uint32_t get_reference_position_of_location(Location const & l) const;
+
   std::unordered_set<long>
   reference_distance_between_locations(std::vector<Location> const & ll1,
                                        std::vector<Location> const & ll2
@@ -162,6 +171,23 @@ public:
   std::vector<uint32_t> ref_reach_poses;
   std::vector<uint32_t> actual_poses;
 
+  /******************
+   * POSITION INDEX *
+   ******************/
+  /**
+   * \brief Creates the index used to find the nodes of a position. It is not serialized and needs to be recreated
+   *        each time the graph is constructed or loaded.
+   */
+  void create_position_index();
+
+  std::vector<uint32_t> ref_node_orders; /** \brief Order of each reference node, used for binary search. */
+
+  /**
+   * \brief Segment tree with the maximum reach of the out variants of each reference node, used to find all
+   *        variants which overlap a position regardless of their length.
+   */
+  std::vector<uint32_t> var_reach_tree;
+
   /**
    * ERROR CHECKING
    */
@@ -74,6 +74,43 @@ count_mismatches_backward(std::vector<char> const & read,
 }
 
 
+/**
+ * \brief Adds the mismatches of the graph DNA in [dna_it, dna_end) against the read bases from 'read_it' on to
+ *        'mismatches', so a path can be aligned to a read node by node without copying its sequence.
+ * \return False if the DNA has a '<' or '>' or if there are more than 'max_mismatches' mismatches.
+ */
+template <typename TReadIt, typename TDnaIt>
+bool inline
+add_mismatches(TReadIt read_it,
+               TReadIt const read_end,
+               TDnaIt dna_it,
+               TDnaIt const dna_end,
+               uint32_t & mismatches,
+               uint32_t const max_mismatches
+               )
+{
+  while (dna_it != dna_end && read_it != read_end)
+  {
+    if (*dna_it == '>' || *dna_it == '<')
+    {
+      return false; // Do not allow paths with < or >
+    }
+    else if (*dna_it != *read_it && *read_it != 'N' && *dna_it != 'N')
+    {
+      ++mismatches;
+
+      if (mismatches > max_mismatches)
+        return false; // Stop at this point
+    }
+
+    ++read_it;
+    ++dna_it;
+  }
+
+  return true;
+}
+
+
 void inline
 add_node_dna_to_sequence(std::vector<char> & seq, gyper::Label const & label, uint32_t const from, uint32_t const to)
 {
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <bitset> // std::bitset
 #include <cstdint> // uint64_t
 #include <memory> // std::unique_ptr
 #include <vector> // std::vector
@@ -8,6 +7,7 @@
 #include <graphtyper/constants.hpp> // MAX_NUMBER_OF_HAPLOTYPES
 #include <graphtyper/graph/genotype.hpp> // gyper::Genotype
 #include <graphtyper/typer/var_stats.hpp> // gyper::MapQ
+#include <graphtyper/utilities/compact_bitset.hpp> // gyper::CompactBitset
 
 namespace gyper
 {
@@ -89,7 +89,7 @@ public:
   void clear();
 
   void add_coverage(uint32_t local_genotype_id, uint16_t c);
-  void add_explanation(uint32_t local_genotype_id, std::bitset<MAX_NUMBER_OF_HAPLOTYPES> const & e);
+  void add_explanation(uint32_t local_genotype_id, CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> const & e);
   void update_max_log_score();
 
   /*********************
@@ -101,8 +101,8 @@ public:
   std::vector<uint32_t> get_genotype_ids() const;
 
   uint32_t best_score_of_a_path(std::size_t pn_index,
-                                std::bitset<MAX_NUMBER_OF_HAPLOTYPES> const & e1,
-                                std::bitset<MAX_NUMBER_OF_HAPLOTYPES> const & e2
+                                CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> const & e1,
+                                CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> const & e2
                                 ) const;
 
   /** Update likelihood and stats */
@@ -124,7 +124,7 @@ public:
 
   void strand_to_stats(bool forward_strand, bool is_first_in_pair);
   void coverage_to_gts(std::size_t pn_index, bool is_proper_pair);
-  std::bitset<MAX_NUMBER_OF_HAPLOTYPES> explain_to_path_explain();
+  CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> explain_to_path_explain();
 
 
   uint16_t static constexpr NO_COVERAGE = 0xFFFFu;
@@ -139,10 +139,52 @@ public:
 
 private:
   std::vector<uint16_t> coverage; // per gt
-  std::vector<std::bitset<MAX_NUMBER_OF_HAPLOTYPES> > explains; // per gt
+  std::vector<CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> > explains; // per gt
 
-  std::bitset<MAX_NUMBER_OF_HAPLOTYPES> find_which_haplotypes_explain_the_read(uint32_t cnum) const;
+  CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> find_which_haplotypes_explain_the_read(uint32_t cnum) const;
   std::vector<uint16_t> find_with_how_many_errors_haplotypes_explain_the_read(uint32_t cnum) const;
 };
 
+
+/**
+ * \brief Adds 'row_scores[classes[x]]' to 'row[x]' from 'x' to 'row_size' with vector instructions, as long as a
+ *        whole vector fits.
+ * \return The index where the kernel stopped, the rest of the row is left to a narrower kernel.
+ */
+#ifdef __AVX2__
+std::size_t add_class_scores_avx2(uint16_t * row,
+                                  uint16_t const * classes,
+                                  uint16_t const * row_scores,
+                                  std::size_t x,
+                                  std::size_t row_size
+                                  );
+#endif // __AVX2__
+
+#ifdef __SSE2__
+std::size_t add_class_scores_sse2(uint16_t * row,
+                                  uint16_t const * classes,
+                                  uint16_t const * row_scores,
+                                  std::size_t x,
+                                  std::size_t row_size
+                                  );
+#endif // __SSE2__
+
+/** \brief Adds 'row_scores[classes[x]]' to 'row[x]' from 'x' to 'row_size'. */
+void add_class_scores_scalar(uint16_t * row,
+                             uint16_t const * classes,
+                             uint16_t const * row_scores,
+                             std::size_t x,
+                             std::size_t row_size
+                             );
+
+/**
+ * \brief Adds the log score of a read to each pair of haplotypes in a lower triangular log score matrix.
+ * \details The score of a haplotype pair only depends on the number of errors of each haplotype, capped at three, so
+ *          each row of the matrix is updated with vectorized lookups of a four entry score table.
+ */
+void add_read_to_log_scores(std::vector<uint16_t> & log_score,
+                            std::vector<uint16_t> const & haplotype_errors,
+                            uint16_t epsilon_exponent
+                            );
+
 } // namespace gyper
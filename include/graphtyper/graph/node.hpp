@@ -27,7 +27,7 @@ public:
   std::size_t out_degree() const;
   Label const & get_label() const;
   TNodeIndex get_var_index(unsigned const & index) const;
-  std::vector<TNodeIndex> get_vars() const;
+  std::vector<TNodeIndex> const & get_vars() const;
 
 private:
   template <class Archive>
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <mutex>
+#include <utility>
 #include <vector>
 
 #include <graphtyper/graph/graph.hpp>
@@ -13,12 +14,24 @@ namespace gyper
 class GenotypePaths;
 class VariantCandidate;
 
+/**
+ * \brief Read depth of a batch of reads on the reference.
+ * \details The depth is kept as intervals of reference indexes, each covered by one read. The intervals of a read are
+ *          merged so each index is counted at most once per read. The per-index depth is only computed with a
+ *          difference array and a prefix sum over the window the intervals cover. Once there are many intervals they
+ *          are folded into a depth window, so the intervals do not grow without bound when many reads are added.
+ */
 class ReferenceDepth
 {
 public:
+  using TInterval = std::pair<uint32_t, uint32_t>; // Half-open interval of reference indexes
+
   uint32_t reference_offset = 0;
-  std::vector<uint16_t> depth;
-  std::vector<uint32_t> local_depth; // List of indexes to increase the depth of, they might be duplicates
+  std::size_t depth_size = 0; // Number of reference positions the depth is over
+  std::vector<TInterval> intervals; // Merged intervals of the committed reads which have not been folded
+  std::vector<TInterval> local_intervals; // Intervals of the current read, they might overlap
+  std::size_t folded_begin = 0; // Reference index of the first position in 'folded_depth'
+  std::vector<uint16_t> folded_depth; // Depth of the committed reads which have been folded out of 'intervals'
 
   /****************
    * CONSTRUCTORS *
@@ -33,6 +46,16 @@ public:
   std::string print_non_zero_depth(std::size_t MIN_DEPTH = 1) const;
   uint16_t get_read_depth(VariantCandidate const & var) const;
 
+  /**
+   * \brief Gets the depth of the window [window_begin, window_end) covered by the committed intervals.
+   * \details The depth is capped at 0xFFFF. The window is empty if no read has been committed.
+   */
+  std::vector<uint16_t> get_depth_window(std::size_t & window_begin) const;
+
+  /** \brief Gets the depth of the reference indexes [begin, end), capped at 0xFFFF. */
+  std::vector<uint16_t> get_depth_range(std::size_t begin, std::size_t end) const;
+  std::vector<uint16_t> get_depth() const;
+
   /****************
    * MODIFICATION *
    ****************/
@@ -41,6 +64,7 @@ public:
   void clear();
   void increase_local_depth_by_one(std::size_t start_pos, std::size_t end_pos);
   void commit_local_depth();
+  void fold_intervals();
   void resize_depth(std::size_t ref_size = graph.reference.size());
 };
 
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint> // uint64_t
+#include <string> // std::string
+#include <vector> // std::vector
+
+#include <graphtyper/utilities/arena.hpp> // gyper::ArenaVector
+
+
+namespace gyper
+{
+
+/**
+ * \brief Index for finding the k-mers which are in Hamming distance one to a query k-mer.
+ * \details A k-mer in Hamming distance one differs in exactly one base, so it shares either the high or the low
+ *          16-mer half with the query (pigeonhole principle). The index keeps all k-mers twice, once sorted by the
+ *          high half and once by the low half (i.e. rotated by 32 bits), each with a bucket directory over the top
+ *          bits of the half. A query is a bucket lookup and a short scan in each table.
+ *
+ *          The tables are either built in memory or memory-mapped from a file written by write(), which is created
+ *          next to the memory-mapped k-mer index when the graph is indexed.
+ */
+class Hamming1Index
+{
+public:
+  Hamming1Index() = default;
+  Hamming1Index(Hamming1Index const &) = delete;
+  Hamming1Index(Hamming1Index && mv_index) noexcept;
+  ~Hamming1Index();
+
+  Hamming1Index & operator=(Hamming1Index const &) = delete;
+  Hamming1Index & operator=(Hamming1Index && mv_index) noexcept;
+
+  /** \brief Builds the index from a list of distinct k-mers. */
+  void build(std::vector<uint64_t> && keys);
+
+  /** \brief Memory-maps an index file. Returns false if the file is missing or invalid. */
+  bool open(std::string const & path);
+
+  /** \brief Writes the index to a file which can be memory-mapped with open(). */
+  void write(std::string const & path) const;
+
+  void clear();
+  bool empty() const;
+  std::size_t size() const;
+
+  /**
+   * \brief Finds k-mers in Hamming distance one to 'key'.
+   * \details The k-mers are in the same order as in to_uint64_vec_hamming_distance_1. If many k-mers share a half
+   *          with 'key', all 48 candidates of the other half are returned instead, which may not all be in the index.
+   */
+  std::vector<uint64_t> find(uint64_t const key) const;
+
+  /** \brief Same as find, but appends the k-mers to 'neighbours'. */
+  void find(uint64_t const key, ArenaVector<uint64_t> & neighbours) const;
+
+private:
+  uint32_t bucket_bits = 0;
+  std::size_t num_keys = 0;
+
+  // The tables, which point either to the vectors below or into the memory-mapped file
+  uint64_t const * high_keys = nullptr; /** \brief k-mers sorted by their high half. */
+  uint32_t const * high_directory = nullptr;
+  uint64_t const * low_keys = nullptr; /** \brief k-mers rotated by 32 bits, so they are sorted by their low half. */
+  uint32_t const * low_directory = nullptr;
+
+  std::vector<uint64_t> built_high_keys;
+  std::vector<uint32_t> built_high_directory;
+  std::vector<uint64_t> built_low_keys;
+  std::vector<uint32_t> built_low_directory;
+
+  void * mapped = nullptr;
+  std::size_t mapped_size = 0;
+
+  std::size_t directory_size() const;
+  template <typename TNeighbours>
+  void find_in_table(uint64_t const * table,
+                     uint32_t const * directory,
+                     uint64_t const rotated_key,
+                     uint32_t const rotation,
+                     TNeighbours & neighbours) const;
+};
+
+
+std::string get_hamming1_index_path(std::string const & index_path);
+
+} // namespace gyper
@@ -1,11 +1,11 @@
 #pragma once
 
+#include <string> // std::string
 #include <vector> // std::vector
-#include <unordered_map> // std::unordered_map
-
-#include <google/dense_hash_map> // google::dense_hash_map
 
+#include <graphtyper/index/hamming1_index.hpp> // gyper::Hamming1Index
 #include <graphtyper/index/kmer_label.hpp> // gyper::KmerLabel
+#include <graphtyper/index/mmap_index.hpp> // gyper::KmerTable, gyper::MmapIndex
 
 
 namespace gyper
@@ -13,19 +13,62 @@ namespace gyper
 
 class Graph;
 
+
+/**
+ * \brief Buffers of the Hamming distance 1 queries of a read. They are allocated from the arena of a batch and reused
+ *        for each read of the batch, so they only grow to the size the longest read needs.
+ */
+struct Hamming1QueryBuffers
+{
+  explicit Hamming1QueryBuffers(Arena & arena);
+
+  ArenaVector<uint64_t> keys; /** \brief Keys of the read k-mers, flattened as in KmerTable::multi_get. */
+  ArenaVector<std::size_t> key_offsets;
+  ArenaVector<uint64_t> hamming1_keys; /** \brief Keys in Hamming distance 1 to the keys of each read k-mer. */
+  ArenaVector<std::size_t> hamming1_key_offsets;
+  ArenaVector<KmerSlot const *> found_slots;
+};
+
+
 class MemIndex
 {
 public:
-  uint64_t empty_key = 0ul;
-  google::dense_hash_map<uint64_t, std::vector<KmerLabel> > hamming0;
-  std::unordered_map<uint64_t, uint64_t> hamming1;
+  KmerTable hamming0; /** \brief Table of k-mers, backed either by the memory-mapped index or 'slots' and 'labels'. */
+  Hamming1Index hamming1;
 
   MemIndex() = default;
+  MemIndex(MemIndex const &) = delete;
+  MemIndex(MemIndex &&) = default;
+  MemIndex & operator=(MemIndex const &) = delete;
+  MemIndex & operator=(MemIndex &&) = default;
+
   void load();
-  // void generate_hamming1_hash_map();
+  bool load_mmap(std::string const & mmap_index_path);
+  void generate_hamming1_index();
+
+  /**
+   * \brief Memory-maps the hamming distance 1 index written along with the memory-mapped k-mer index, or generates
+   *        it if the file is missing or was written for another k-mer table.
+   */
+  void load_hamming1_index(std::string const & hamming1_index_path);
+  bool is_hamming1_index_available() const;
   std::vector<KmerLabel> get(std::vector<uint64_t> const & keys) const;
   std::vector<std::vector<KmerLabel> > multi_get(std::vector<std::vector<uint64_t> > const & keys) const;
+  std::vector<std::vector<KmerLabel> > multi_get(ArenaVector<uint64_t> const & flat_keys,
+                                                 ArenaVector<std::size_t> const & key_offsets,
+                                                 Arena & arena) const;
   std::vector<std::vector<KmerLabel> > multi_get_hamming1(std::vector<std::vector<uint64_t> > const & keys) const;
+
+  /**
+   * \brief Same as above, with the keys of the read k-mers in 'buffers.keys' and 'buffers.key_offsets'. The keys in
+   *        Hamming distance 1 are looked up in a single batch.
+   */
+  std::vector<std::vector<KmerLabel> > multi_get_hamming1(Hamming1QueryBuffers & buffers) const;
+
+private:
+  std::vector<KmerSlot> slots;
+  std::vector<char> labels;
+  MmapIndex mmap_index;
 };
 
 
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint> // uint64_t
+#include <string> // std::string
+#include <vector> // std::vector
+
+#include <graphtyper/index/index.hpp> // gyper::Index
+#include <graphtyper/index/kmer_label.hpp> // gyper::KmerLabel
+#include <graphtyper/utilities/arena.hpp> // gyper::ArenaVector
+
+
+namespace gyper
+{
+
+class RocksDB;
+
+/** Size of a single serialized label (start_index, end_index and variant_id). */
+uint8_t const PACKED_LABEL_SIZE = 12;
+
+/**
+ * \brief A slot in the open-addressing hash table of k-mers.
+ * \details An empty slot has a label count of zero. The label offset is stored in the lower 40 bits of
+ *          'offset_count' and the label count in the upper 24 bits.
+ */
+struct KmerSlot
+{
+  uint64_t key;
+  uint64_t offset_count;
+};
+
+
+/**
+ * \brief Header of the memory-mapped index file.
+ */
+struct MmapIndexHeader
+{
+  char magic[8];
+  uint64_t version;
+  uint64_t num_slots; /** \brief Number of slots in the hash table, always a power of two. */
+  uint64_t num_keys; /** \brief Number of distinct k-mers in the index. */
+  uint64_t num_labels; /** \brief Total number of labels in the label blob. */
+  uint64_t reserved[3];
+};
+
+
+/**
+ * \brief Read-only view of an open-addressing table of k-mers and the packed labels they point to.
+ * \details The table does not own its memory, which is either memory-mapped (MmapIndex) or kept in RAM (MemIndex).
+ *          Only the serialized label fields are stored, variant num and order are derived from the graph when a
+ *          k-mer is queried.
+ */
+class KmerTable
+{
+public:
+  KmerTable() = default;
+  KmerTable(KmerSlot const * _slots, uint64_t const num_slots, char const * _labels, std::size_t const _num_keys);
+
+  bool empty() const;
+  std::size_t size() const;
+
+  /** \brief Finds the slot of a key. Returns nullptr if the key is not in the table. */
+  KmerSlot const * find(uint64_t const key) const;
+  std::vector<KmerLabel> get(std::vector<uint64_t> const & keys) const;
+
+  /**
+   * \brief Queries many read k-mers in one pass, where each read k-mer may have several keys.
+   * \details Slots and labels are prefetched a few lookups ahead, so the lookups are bound by memory-level
+   *          parallelism instead of memory latency. Each read k-mer gets the same labels as from get().
+   */
+  std::vector<std::vector<KmerLabel> > multi_get(std::vector<std::vector<uint64_t> > const & keys) const;
+
+  /**
+   * \brief Same as multi_get, with the keys flattened into one vector. The keys of read k-mer 'i' are
+   *        'flat_keys[key_offsets[i]]' to 'flat_keys[key_offsets[i + 1] - 1]'.
+   * \details The scratch space of the lookups is allocated from 'arena', which the caller is responsible for
+   *          resetting.
+   */
+  std::vector<std::vector<KmerLabel> > multi_get(ArenaVector<uint64_t> const & flat_keys,
+                                                 ArenaVector<std::size_t> const & key_offsets,
+                                                 Arena & arena) const;
+
+  /**
+   * \brief Same as above, with the scratch space of the lookups in 'found_slots'. It is resized as needed, so a caller
+   *        which queries many reads one at a time can reuse it.
+   */
+  std::vector<std::vector<KmerLabel> > multi_get(ArenaVector<uint64_t> const & flat_keys,
+                                                 ArenaVector<std::size_t> const & key_offsets,
+                                                 ArenaVector<KmerSlot const *> & found_slots) const;
+  std::vector<uint64_t> get_keys() const;
+
+private:
+  KmerSlot const * slots = nullptr;
+  uint64_t slot_mask = 0;
+  char const * labels = nullptr;
+  std::size_t num_keys = 0;
+
+  /** \brief Looks up 'key_offsets[num_kmers]' flattened keys. 'found_slots' must have room for a slot per key. */
+  std::vector<std::vector<KmerLabel> > multi_get(uint64_t const * flat_keys,
+                                                 std::size_t const * key_offsets,
+                                                 std::size_t const num_kmers,
+                                                 KmerSlot const ** found_slots) const;
+};
+
+
+/**
+ * \brief Immutable k-mer index which is queried in place from a memory-mapped file.
+ * \details The file contains a header, followed by a table of 'num_slots' KmerSlot and a blob of
+ *          'num_labels' packed labels. The file is mapped read-only and shared, so concurrent calling jobs on
+ *          the same host share the index through the page cache and no copy of the index is made on startup.
+ */
+class MmapIndex
+{
+public:
+  KmerTable table;
+
+  MmapIndex() = default;
+  MmapIndex(MmapIndex const &) = delete;
+  MmapIndex(MmapIndex && mv_index) noexcept;
+  ~MmapIndex();
+
+  MmapIndex & operator=(MmapIndex const &) = delete;
+  MmapIndex & operator=(MmapIndex && mv_index) noexcept;
+
+  bool open(std::string const & path);
+  void close();
+  bool is_open() const;
+
+private:
+  void * data = nullptr;
+  std::size_t data_size = 0;
+};
+
+
+/** Hashes a k-mer key to its home slot in a table with 'slot_mask + 1' slots. */
+uint64_t inline
+kmer_slot_hash(uint64_t const key, uint64_t const slot_mask)
+{
+  return ((key ^ (key >> 29)) * 0x9E3779B97F4A7C15ull >> 17) & slot_mask;
+}
+
+
+uint64_t inline
+kmer_slot_offset(KmerSlot const & slot)
+{
+  return slot.offset_count & 0x000000FFFFFFFFFFull;
+}
+
+
+uint32_t inline
+kmer_slot_count(KmerSlot const & slot)
+{
+  return static_cast<uint32_t>(slot.offset_count >> 40);
+}
+
+
+/** Decodes 'count' packed labels and appends them to 'labels'. Variant num/order are derived from the graph. */
+void append_packed_labels(char const * data, std::size_t const count, std::vector<KmerLabel> & labels);
+
+/**
+ * \brief Builds the slots and packed labels of a k-mer table from a RocksDB index.
+ * \details The table has a load factor of at most 2/3. RocksDB iterates keys in a fixed order and the labels are
+ *          copied in their stored order, so the same index always gives the same table.
+ * \return The number of k-mers in the table.
+ */
+std::size_t build_kmer_table(Index<RocksDB> const & rocksdb_index,
+                             std::vector<KmerSlot> & slots,
+                             std::vector<char> & labels);
+
+std::string get_mmap_index_path(std::string const & index_path);
+void write_mmap_index(Index<RocksDB> const & rocksdb_index, std::string const & path);
+
+} // namespace gyper
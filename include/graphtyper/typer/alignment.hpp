@@ -14,10 +14,36 @@
 namespace gyper
 {
 
+/** \brief Orientations in which a read or a read pair is aligned. */
+uint8_t const ALIGN_FORWARD = 1;
+uint8_t const ALIGN_REVERSE = 2;
+uint8_t const ALIGN_BOTH = ALIGN_FORWARD | ALIGN_REVERSE;
+
+/** \brief Gets the orientations in which an unpaired read is aligned, as ALIGN_FORWARD and/or ALIGN_REVERSE. */
+uint8_t get_orientations_to_align(SamRead const & record);
+
+/** \brief Gets the orientations in which a read pair is aligned, as ALIGN_FORWARD and/or ALIGN_REVERSE. */
+uint8_t get_orientations_to_align(SamRead const & record1, SamRead const & record2);
+
 void
 align_unpaired_read_pairs(TReads & reads, std::vector<GenotypePaths> & genos);
 
 
+/** \brief Gets the reference distance between two paths of a read pair which is closest to 'OPTIMAL'. */
+long get_insert_size(std::vector<Path>::const_iterator it1,
+                     std::vector<Path>::const_iterator it2,
+                     uint32_t const OPTIMAL,
+                     bool const REVERSE_COMPLEMENT);
+
+/**
+ * \brief Gets the reference distance between any paths of two reads of a pair which is closest to 'OPTIMAL'. Of
+ *        equally close distances, the first one found is returned.
+ */
+int64_t find_shortest_distance(GenotypePaths const & geno1,
+                               GenotypePaths const & geno2,
+                               uint32_t const OPTIMAL,
+                               bool const REVERSE_COMPLEMENT);
+
 GenotypePaths find_genotype_paths_of_a_single_sequence(seqan::IupacString const & read, seqan::CharString const & qual, int const mismatches = -1, gyper::Graph const & graph = gyper::graph);
 
 std::vector<std::pair<GenotypePaths, GenotypePaths> >
@@ -26,4 +52,13 @@ align_paired_reads(std::vector<TReadPair> const & records);
 std::vector<GenotypePaths>
 find_haplotype_paths(std::vector<seqan::Dna5String> const & sequences);
 
+/**
+ * \brief Gets the number of aligned sequences and how many of them had their paths copied from an identical sequence
+ *        in the same batch.
+ */
+void get_read_cache_statistics(uint64_t & num_aligned, uint64_t & num_cached);
+
+/** \brief Logs how many aligned sequences had their paths copied from an identical sequence in the same batch. */
+void log_read_cache_statistics();
+
 } // namespace gyper
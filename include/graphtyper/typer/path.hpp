@@ -1,12 +1,12 @@
 #pragma once
 
-#include <bitset> // std::bitset<Size>
 #include <cstdint> // uint16_t, uint32_t
 #include <vector> // std::vector<Type>
 
 #include <graphtyper/constants.hpp>
 #include <graphtyper/graph/haplotype.hpp>
 #include <graphtyper/index/kmer_label.hpp>
+#include <graphtyper/utilities/compact_bitset.hpp> // gyper::CompactBitset
 
 namespace gyper
 {
@@ -31,7 +31,7 @@ public:
    */
   uint16_t read_end_index = 0;
   std::vector<uint32_t> var_order;
-  std::vector<std::bitset<MAX_NUMBER_OF_HAPLOTYPES> > nums;
+  std::vector<CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> > nums;
   uint16_t mismatches;
 
   /*********************
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <condition_variable> // std::condition_variable
+#include <cstddef> // std::size_t
+#include <deque> // std::deque
+#include <exception> // std::exception_ptr
+#include <functional> // std::function
+#include <mutex> // std::mutex
+#include <thread> // std::thread
+#include <utility> // std::pair
+#include <vector> // std::vector
+
+#include <graphtyper/typer/genotype_paths.hpp> // gyper::GenotypePaths
+#include <graphtyper/utilities/sam_reader.hpp> // gyper::TReads
+
+
+namespace gyper
+{
+
+class VcfWriter;
+
+/** \brief A batch of reads of a single sample, as read from its SAM/BAM/CRAM file. */
+struct ReadBatch
+{
+  TReads reads;
+  std::size_t pn_index = 0;
+};
+
+
+/** \brief A batch of reads which have been aligned to the graph. Only one of 'genos' and 'geno_pairs' is used. */
+struct AlignedBatch
+{
+  std::vector<GenotypePaths> genos;
+  std::vector<std::pair<GenotypePaths, GenotypePaths> > geno_pairs;
+  std::size_t pn_index = 0;
+};
+
+
+/** \brief Occupancy of a bounded queue, sampled each time a batch is added to it. */
+struct QueueOccupancy
+{
+  std::size_t capacity = 0;
+  std::size_t num_batches = 0;
+  std::size_t sum_occupancy = 0; /** \brief Sum of the queue sizes seen when the batches were added. */
+  std::size_t num_full = 0; /** \brief Number of batches which found the queue full. */
+};
+
+
+/**
+ * \brief Pipeline which aligns batches of reads to the graph and adds the alignments to the genotype likelihoods.
+ * \details The pipeline has three stages. The reading stage runs on the thread which adds batches, the alignment
+ *          stage and the scoring stage (variant discovery, reference depth and haplotype scores) run on a pool of
+ *          worker threads. The stages are connected by bounded queues. A worker always takes from the queue of the
+ *          later stage first and scores its own batch if the scoring queue is full, so the pool balances uneven
+ *          batches between the stages and never blocks on a full queue.
+ *
+ *          If a stage throws, the pipeline stops: the remaining batches are dropped and the first exception is
+ *          rethrown by join().
+ */
+class ReadPipeline
+{
+public:
+  using TAlignStage = std::function<AlignedBatch(ReadBatch &&)>;
+  using TScoreStage = std::function<void(AlignedBatch &)>;
+
+  /** \brief Creates a pipeline which aligns the reads to the graph and scores the alignments with 'writer'. */
+  ReadPipeline(VcfWriter & writer, std::size_t const num_threads, std::size_t const queue_size);
+  ReadPipeline(TAlignStage _align_stage,
+               TScoreStage _score_stage,
+               std::size_t const num_threads,
+               std::size_t const queue_size);
+  ReadPipeline(ReadPipeline const &) = delete;
+  ReadPipeline & operator=(ReadPipeline const &) = delete;
+  ~ReadPipeline();
+
+  /** \brief Adds a batch of reads to the alignment queue. Blocks while the queue is full. */
+  void add(ReadBatch && batch);
+
+  /**
+   * \brief Waits until all batches have been processed and reports the occupancy of the queues.
+   * \details Rethrows the first exception thrown by a stage.
+   */
+  void join();
+
+private:
+  TAlignStage align_stage;
+  TScoreStage score_stage;
+  std::size_t const max_queue_size;
+  std::mutex queue_mutex;
+  std::condition_variable work_available;
+  std::condition_variable space_available;
+  std::deque<ReadBatch> align_queue;
+  std::deque<AlignedBatch> score_queue;
+  QueueOccupancy align_occupancy;
+  QueueOccupancy score_occupancy;
+  bool is_closed = false;
+  std::exception_ptr error; /** \brief The first exception thrown by a stage, which stops the pipeline. */
+  std::vector<std::thread> workers;
+
+  void start_workers(std::size_t const num_threads);
+  void close_and_wait();
+  void run_worker();
+  void process_batches();
+};
+
+} // namespace gyper
@@ -27,6 +27,7 @@ class VariantMap
 public:
   void set_samples(std::vector<std::string> const & new_samples);
   void add_variants(std::vector<VariantCandidate> && vars, std::size_t pn_index);
+  void merge_varmap_shards();
   void create_varmap_for_all(); // Uses the global reference depth
   void filter_varmap_for_all();
 
@@ -43,7 +44,15 @@ public:
   std::vector<std::string> samples;
   PoolVarMap pool_varmap; /** \brief A varmap for all samples */
   std::vector<VarMap> varmaps; /** \brief List of varmaps, one for each sample */
-  std::vector<std::mutex> map_mutexes;
+
+  /**
+   * \brief Number of shards of each sample's varmap while variants are added. Each shard has its own mutex, so
+   *        threads adding variants of the same sample rarely wait on each other.
+   */
+  static std::size_t constexpr NUM_SHARDS = 64;
+
+  std::vector<VarMap> varmap_shards; /** \brief Shard 's' of sample 'i' is at index 'i * NUM_SHARDS + s' */
+  std::vector<std::mutex> shard_mutexes;
 
   template <class Archive>
   void inline
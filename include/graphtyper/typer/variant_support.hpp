@@ -1,7 +1,7 @@
 #pragma once
 
 #include <cstdint> // uint32_t
-#include <set> // std::set<T>
+#include <vector> // std::vector<T>
 
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
@@ -24,11 +24,12 @@ public:
   uint16_t clipped = 0u;
   uint16_t first_in_pairs = 0u;
   uint16_t sequence_reversed = 0u;
-  std::set<uint32_t> unique_positions;
+  std::vector<uint32_t> unique_positions; /** \brief Sorted original positions of the reads supporting the variant. */
   uint32_t pn_index = 0u;
 
   VariantSupport() = default;
 
+  void add_unique_position(uint32_t original_pos);
   void set_depth(uint16_t _depth);
 
   uint32_t get_support() const;
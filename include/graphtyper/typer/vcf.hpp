@@ -5,16 +5,17 @@
 #include <unordered_map> // std::unordered_map
 #include <vector> // std::vector
 
+#include <boost/utility/string_ref.hpp> // boost::string_ref
+
 #include <graphtyper/constants.hpp>
 #include <graphtyper/graph/genotype.hpp>
 #include <graphtyper/graph/haplotype.hpp>
 #include <graphtyper/typer/segment.hpp>
 #include <graphtyper/typer/variant.hpp>
 #include <graphtyper/utilities/bgzf_stream.hpp>
+#include <graphtyper/utilities/text_buffer.hpp> // gyper::TextBuffer
 
 
-class InputFile; // Implemented in libStatGen
-
 namespace gyper
 {
 
@@ -43,11 +44,22 @@ public:
    * CLASS MODIFERS *
    ******************/
   /** I/O member functions */
-  InputFile * vcf_file = nullptr;
+  BGZF * vcf_file = nullptr;
   BGZF_stream bgzf_stream;
+  TextBuffer record_text; /** \brief Reused by write_record. */
+  std::vector<char> read_buffer; /** \brief Decompressed text of the VCF file which is being read. */
+  std::size_t read_pos = 0; /** \brief Start of the next line in read_buffer. */
+  std::size_t read_end = 0; /** \brief End of the text in read_buffer. */
+  std::vector<boost::string_ref> read_fields; /** \brief Reused by read_record for the fields of a line. */
+  std::vector<boost::string_ref> read_values; /** \brief Reused by read_record for the values of a field. */
+  std::vector<boost::string_ref> read_sample_fields; /** \brief Reused by read_record for the fields of a sample. */
   void open_vcf_file_for_reading();
   void read_samples();
   std::string read_line();
+
+  /** \brief Gets a view of the next line, which is valid until the next line is read. Returns false at the end. */
+  bool next_line(boost::string_ref & line);
+
   bool read_record(bool SITES_ONLY = false);
   void read(bool SITES_ONLY = false); /** \brief Reads the VCF file. */
   void open_for_writing();
@@ -58,6 +70,13 @@ public:
                     const bool FILTER_ZERO_QUAL = false
                     );
 
+  /** \brief Formats a record as write_record writes it. Can be called concurrently for different variants. */
+  void format_record(Variant const & var,
+                     std::string const & suffix,
+                     bool const FILTER_ZERO_QUAL,
+                     TextBuffer & text
+                     ) const;
+
   void write_segments();
   void write(std::string const & region = "."); /** \brief Writes the VCF file. */
   void write_records(uint32_t region_begin,
@@ -8,7 +8,17 @@ namespace gyper
 {
 
 void vcf_merge(std::vector<std::string> & vcfs, std::string const & output);
-void vcf_concatenate(std::vector<std::string> const & vcfs, std::string const & output, bool const SKIP_SORT, bool const SITES_ONLY, std::string const & region);
+
+/**
+ * \brief Concatenates sorted BGZF compressed VCFs by copying their compressed blocks, without parsing the records.
+ * \details Only the header of the first VCF is kept. Returns false without writing anything if the output is not
+ *          BGZF compressed or any of the VCFs is not BGZF compressed or has other contigs or samples than the first.
+ */
+bool vcf_concatenate_bgzf_blocks(std::vector<std::string> const & vcfs, std::string const & output);
+
+/** \brief Concatenates VCFs. With COPY_BLOCKS the BGZF blocks are copied if possible, see vcf_concatenate_bgzf_blocks. */
+void vcf_concatenate(std::vector<std::string> const & vcfs, std::string const & output, bool const SKIP_SORT, bool const SITES_ONLY, std::string const & region, bool const COPY_BLOCKS = false);
+
 void vcf_break_down(std::string const & vcf, std::string const & output, std::string const & region);
 void vcf_update_info(std::string const & vcf, std::string const & output);
 
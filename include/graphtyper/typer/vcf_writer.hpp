@@ -1,7 +1,6 @@
 #pragma once
 
 #include <array>
-#include <bitset>
 #include <iostream>
 #include <map>
 #include <vector>
@@ -18,6 +17,7 @@
 #include <graphtyper/graph/genotype.hpp>
 #include <graphtyper/typer/read_stats.hpp>
 #include <graphtyper/typer/segment.hpp>
+#include <graphtyper/utilities/compact_bitset.hpp> // gyper::CompactBitset
 
 
 namespace gyper
@@ -30,7 +30,7 @@ class VcfWriter
   /*******************
    * TYPE DEFINTIONS *
    *******************/
-  using ExplainMap = std::map<uint32_t, std::vector<std::bitset<MAX_NUMBER_OF_HAPLOTYPES> > >;
+  using ExplainMap = std::map<uint32_t, std::vector<CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> > >;
 
 public:
   explicit VcfWriter(std::vector<std::string> const & samples, uint32_t variant_distance = 60);
@@ -57,7 +57,7 @@ public:
   void update_haplotype_scores_from_paths(std::vector<std::pair<GenotypePaths, GenotypePaths> > & genos, std::size_t const pn_index);
 
   void find_path_explanation(GenotypePaths const & gt_path,
-                             std::vector<std::pair<uint32_t, std::bitset<MAX_NUMBER_OF_HAPLOTYPES> > > & ids_and_path_explain
+                             std::vector<std::pair<uint32_t, CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> > > & ids_and_path_explain
                              );
 
   std::vector<uint32_t>
@@ -79,12 +79,17 @@ public:
   std::vector<HaplotypeCall> get_haplotype_calls() const;
 
 private:
-  std::mutex mutable haplotype_mutex;
+  /** \brief Number of locks guarding the haplotypes. Haplotype 'i' is guarded by lock 'i % NUM_HAPLOTYPE_LOCKS'. */
+  static std::size_t constexpr NUM_HAPLOTYPE_LOCKS = 64;
+
+  std::array<std::mutex, NUM_HAPLOTYPE_LOCKS> mutable haplotype_locks;
   std::mutex mutable io_mutex;
   std::vector<std::string> pns;
   std::string pn;
   std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t> > id2hap; // first = haplotype, second = local genotype id
 
+  std::vector<std::unique_lock<std::mutex> > lock_haplotypes(std::vector<uint32_t> const & hap_ids) const;
+
 public:
   std::vector<Haplotype> haplotypes;
 
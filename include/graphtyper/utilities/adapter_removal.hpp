@@ -49,6 +49,5 @@ struct Illumina {};
 using IlluminaAdapter = AdapterRemoval<Illumina>;
 
 void remove_adapters_from_reads(TReads & reads);
-void remove_adapters(TReads & reads);
 
 }
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef> // std::size_t
+#include <memory> // std::unique_ptr
+#include <vector> // std::vector
+
+
+namespace gyper
+{
+
+/**
+ * \brief Monotonic arena for short-lived objects. Deallocation is a no-op and all memory is released by reset().
+ * \details Allocations are carved from large blocks. reset() merges the blocks into a single block which can hold
+ *          everything allocated since the last reset, so once an arena has seen its largest batch it no longer calls
+ *          malloc.
+ */
+class Arena
+{
+public:
+  explicit Arena(std::size_t const _block_size = 1048576);
+  Arena(Arena const &) = delete;
+  Arena & operator=(Arena const &) = delete;
+
+  void * allocate(std::size_t const size, std::size_t const alignment);
+
+  /** \brief Releases all allocations. Objects allocated from the arena must not be used afterwards. */
+  void reset();
+
+  /** \brief Total size of the blocks of the arena. */
+  std::size_t capacity() const;
+
+private:
+  struct Block
+  {
+    std::unique_ptr<char[]> data;
+    std::size_t size;
+  };
+
+  std::size_t const block_size;
+  std::vector<Block> blocks;
+  std::size_t used = 0; /** \brief Bytes used in the last block. */
+
+  void add_block(std::size_t const min_size);
+};
+
+
+/** \brief STL allocator which allocates from an arena. */
+template <typename T>
+class ArenaAllocator
+{
+public:
+  using value_type = T;
+
+  explicit ArenaAllocator(Arena & _arena) noexcept : arena(&_arena) {}
+
+  template <typename U>
+  ArenaAllocator(ArenaAllocator<U> const & other) noexcept : arena(other.arena) {}
+
+  T * allocate(std::size_t const n)
+  {
+    return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *, std::size_t) noexcept {}
+
+  Arena * arena;
+};
+
+
+template <typename T, typename U>
+inline bool
+operator==(ArenaAllocator<T> const & a, ArenaAllocator<U> const & b)
+{
+  return a.arena == b.arena;
+}
+
+
+template <typename T, typename U>
+inline bool
+operator!=(ArenaAllocator<T> const & a, ArenaAllocator<U> const & b)
+{
+  return a.arena != b.arena;
+}
+
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+
+/**
+ * \brief Arena of the calling thread for objects which only live while a batch of reads is aligned.
+ * \details It is reset when the thread starts aligning a new batch, so nothing allocated from it may be kept in the
+ *          results of an alignment.
+ */
+Arena & batch_arena();
+
+} // namespace gyper
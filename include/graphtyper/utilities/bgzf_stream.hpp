@@ -4,11 +4,12 @@
 #include <cstring>
 #include <iostream> // std::cout
 #include <memory>
-#include <sstream> // std::stringstream
 #include <string> // std::string
 
 #include "bgzf.h" // part of htslib
 
+#include <graphtyper/utilities/text_buffer.hpp> // gyper::TextBuffer
+
 
 namespace gyper
 {
@@ -18,18 +19,23 @@ class BGZF_stream
 {
 private:
   BGZF * fp = nullptr;
-  std::ostringstream ss;
+  TextBuffer buffer;
 
 
 public:
   BGZF_stream() = default;
-  BGZF_stream(std::string const & filename, std::string const & filemode);
+  BGZF_stream(std::string const & filename, std::string const & filemode, int const compression_threads = 1);
   ~BGZF_stream();
 
   template <class T>
   BGZF_stream & operator<<(T const & x);
+
+  /** \brief Writes text which has already been formatted, e.g. records formatted on other threads. */
+  void write(TextBuffer const & text);
   void flush();
-  void open(std::string const & filename, std::string const & filemode);
+
+  /** \brief Opens a file for writing. Blocks are compressed on 'compression_threads' threads if it is above one. */
+  void open(std::string const & filename, std::string const & filemode, int const compression_threads = 1);
   void close(); // Close BGZF file
 
   long MAX_CACHE_SIZE = 10000000ll;
@@ -37,9 +43,9 @@ public:
 
 
 inline
-BGZF_stream::BGZF_stream(std::string const & filename, std::string const & filemode)
+BGZF_stream::BGZF_stream(std::string const & filename, std::string const & filemode, int const compression_threads)
 {
-  open(filename, filemode);
+  open(filename, filemode, compression_threads);
 }
 
 
@@ -48,30 +54,40 @@ inline
 BGZF_stream &
 BGZF_stream::operator<<(T const & x)
 {
-  // Add to stringstream
-  ss << x;
+  // Add to buffer
+  buffer << x;
 
   // Check if we should flush
-  if (static_cast<long>(ss.tellp()) > this->MAX_CACHE_SIZE)
+  if (static_cast<long>(buffer.size()) > this->MAX_CACHE_SIZE)
     flush();
 
   return *this;
 }
 
 
+inline
+void
+BGZF_stream::write(TextBuffer const & text)
+{
+  buffer.str.append(text.str);
+
+  if (static_cast<long>(buffer.size()) > this->MAX_CACHE_SIZE)
+    flush();
+}
+
+
 inline
 void
 BGZF_stream::flush()
 {
-  // Write stringstream to BGZF file
+  // Write buffer to BGZF file
   if (!fp)
   {
-    std::cout << ss.str(); // Write uncompressed to stdout
+    std::cout.write(buffer.str.data(), buffer.size()); // Write uncompressed to stdout
   }
   else
   {
-    std::string const & str = ss.str();
-    int ret = bgzf_write(fp, str.data(), str.size());
+    int ret = bgzf_write(fp, buffer.str.data(), buffer.size());
 
     if (ret < 0)
     {
@@ -80,14 +96,14 @@ BGZF_stream::flush()
     }
   }
 
-  // Clear stringstream
-  ss.str("");
+  // Clear buffer
+  buffer.clear();
 }
 
 
 inline
 void
-BGZF_stream::open(std::string const & filename, std::string const & filemode)
+BGZF_stream::open(std::string const & filename, std::string const & filemode, int const compression_threads)
 {
   if (fp)
     close();
@@ -95,6 +111,10 @@ BGZF_stream::open(std::string const & filename, std::string const & filemode)
   if (filename.size() > 0 && filename != "-")
   {
     fp = bgzf_open(filename.c_str(), filemode.c_str());
+
+    // Compressed blocks are the same as when compressing on a single thread
+    if (fp && compression_threads > 1)
+      bgzf_mt(fp, compression_threads, 256);
   }
 }
 
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm> // std::max
+#include <cassert> // assert
+#include <cstddef> // std::size_t
+#include <cstdint> // uint64_t
+#include <vector> // std::vector
+
+
+namespace gyper
+{
+
+/**
+ * \brief A bitset of N bits which only stores the words up to its highest set bit.
+ * \details The first 64 bits are stored inline and higher words spill to the heap. Bitsets of variants with few
+ *          alleles never use the heap, so they are cheap to copy when paths are merged and moved around. Words
+ *          past the end of 'spill' are zero.
+ */
+template <std::size_t N>
+class CompactBitset
+{
+  static_assert(N > 0 && N % 64 == 0, "CompactBitset size must be a multiple of 64.");
+
+public:
+  CompactBitset() = default;
+  explicit CompactBitset(uint64_t const val) : first_word(val) {}
+
+  static constexpr std::size_t size() {return N;}
+
+  bool test(std::size_t const pos) const;
+  bool operator[](std::size_t const pos) const {return test(pos);}
+  bool any() const;
+  bool none() const {return !any();}
+  std::size_t count() const;
+
+  CompactBitset & set(std::size_t const pos);
+  CompactBitset & set(); /** \brief Sets all N bits, which spills to the heap. */
+  CompactBitset & set_lowest(std::size_t const num); /** \brief Sets the lowest 'num' bits. */
+  CompactBitset & reset();
+
+  CompactBitset & operator|=(CompactBitset const & other);
+  CompactBitset & operator&=(CompactBitset const & other);
+  bool operator==(CompactBitset const & other) const;
+  bool operator!=(CompactBitset const & other) const {return !(*this == other);}
+
+private:
+  uint64_t first_word = 0;
+  std::vector<uint64_t> spill; /** \brief Words 1, 2, ... of the bitset. */
+
+  uint64_t word(std::size_t const w) const
+  {
+    return w == 0 ? first_word : (w - 1 < spill.size() ? spill[w - 1] : 0ull);
+  }
+};
+
+
+template <std::size_t N>
+inline bool
+CompactBitset<N>::test(std::size_t const pos) const
+{
+  assert(pos < N);
+  return (word(pos / 64) >> (pos % 64)) & 1ull;
+}
+
+
+template <std::size_t N>
+inline bool
+CompactBitset<N>::any() const
+{
+  if (first_word != 0)
+    return true;
+
+  for (auto const w : spill)
+  {
+    if (w != 0)
+      return true;
+  }
+
+  return false;
+}
+
+
+template <std::size_t N>
+inline std::size_t
+CompactBitset<N>::count() const
+{
+  std::size_t num = __builtin_popcountll(first_word);
+
+  for (auto const w : spill)
+    num += __builtin_popcountll(w);
+
+  return num;
+}
+
+
+template <std::size_t N>
+inline CompactBitset<N> &
+CompactBitset<N>::set(std::size_t const pos)
+{
+  assert(pos < N);
+  std::size_t const w = pos / 64;
+
+  if (w == 0)
+  {
+    first_word |= 1ull << pos;
+  }
+  else
+  {
+    if (w > spill.size())
+      spill.resize(w, 0ull);
+
+    spill[w - 1] |= 1ull << (pos % 64);
+  }
+
+  return *this;
+}
+
+
+template <std::size_t N>
+inline CompactBitset<N> &
+CompactBitset<N>::set()
+{
+  first_word = ~0ull;
+  spill.assign(N / 64 - 1, ~0ull);
+  return *this;
+}
+
+
+template <std::size_t N>
+inline CompactBitset<N> &
+CompactBitset<N>::set_lowest(std::size_t const num)
+{
+  assert(num <= N);
+
+  if (num == 0)
+    return *this;
+
+  std::size_t const num_full_words = num / 64;
+  std::size_t const remaining_bits = num % 64;
+
+  if (num_full_words == 0)
+  {
+    first_word |= (1ull << remaining_bits) - 1ull;
+    return *this;
+  }
+
+  first_word = ~0ull;
+  std::size_t const num_words = num_full_words + (remaining_bits > 0);
+
+  if (num_words - 1 > spill.size())
+    spill.resize(num_words - 1, 0ull);
+
+  for (std::size_t w = 1; w < num_full_words; ++w)
+    spill[w - 1] = ~0ull;
+
+  if (remaining_bits > 0)
+    spill[num_full_words - 1] |= (1ull << remaining_bits) - 1ull;
+
+  return *this;
+}
+
+
+template <std::size_t N>
+inline CompactBitset<N> &
+CompactBitset<N>::reset()
+{
+  first_word = 0;
+  spill.clear();
+  return *this;
+}
+
+
+template <std::size_t N>
+inline CompactBitset<N> &
+CompactBitset<N>::operator|=(CompactBitset const & other)
+{
+  first_word |= other.first_word;
+
+  if (other.spill.size() > spill.size())
+    spill.resize(other.spill.size(), 0ull);
+
+  for (std::size_t w = 0; w < other.spill.size(); ++w)
+    spill[w] |= other.spill[w];
+
+  return *this;
+}
+
+
+template <std::size_t N>
+inline CompactBitset<N> &
+CompactBitset<N>::operator&=(CompactBitset const & other)
+{
+  first_word &= other.first_word;
+
+  if (other.spill.size() < spill.size())
+    spill.resize(other.spill.size());
+
+  for (std::size_t w = 0; w < spill.size(); ++w)
+    spill[w] &= other.spill[w];
+
+  return *this;
+}
+
+
+template <std::size_t N>
+inline bool
+CompactBitset<N>::operator==(CompactBitset const & other) const
+{
+  if (first_word != other.first_word)
+    return false;
+
+  std::size_t const num_words = 1 + std::max(spill.size(), other.spill.size());
+
+  for (std::size_t w = 1; w < num_words; ++w)
+  {
+    if (word(w) != other.word(w))
+      return false;
+  }
+
+  return true;
+}
+
+
+template <std::size_t N>
+inline CompactBitset<N>
+operator&(CompactBitset<N> lhs, CompactBitset<N> const & rhs)
+{
+  lhs &= rhs;
+  return lhs;
+}
+
+
+} // namespace gyper
@@ -33,9 +33,26 @@ template <typename TSeq>
 std::vector<std::vector<KmerLabel> >
 query_index(TSeq const & read, gyper::MemIndex const & mem_index = gyper::mem_index);
 
+/**
+ * \brief Queries the k-mers of many reads in a single batch, which allows the index to prefetch ahead.
+ * \details The keys are allocated from 'arena', which the caller resets once the batch is done.
+ * \return The labels of the k-mers of each read, the same as query_index returns for that read.
+ */
+template <typename TSeq>
+std::vector<TKmerLabels>
+query_index_batch(std::vector<TSeq> const & reads,
+                  Arena & arena,
+                  gyper::MemIndex const & mem_index = gyper::mem_index);
+
+/**
+ * \brief Queries the k-mers in Hamming distance 1 to the k-mers of a read.
+ * \details The keys are put in 'buffers', which are reused for each read of a batch.
+ */
 template <typename TSeq>
 std::vector<std::vector<KmerLabel> >
-query_index_hamming_distance1(TSeq const & read, gyper::MemIndex const & mem_index = gyper::mem_index);
+query_index_hamming_distance1(TSeq const & read,
+                              Hamming1QueryBuffers & buffers,
+                              gyper::MemIndex const & mem_index = gyper::mem_index);
 
 template <typename TSeq>
 std::vector<std::vector<KmerLabel> >
@@ -38,6 +38,7 @@ public:
    * INDEXING OPTIONS *
    ********************/
   uint64_t max_index_labels = 32;
+  std::size_t index_chunk_size = 10000; // Number of reference nodes indexed by each thread at a time
 
   /*******************
    * CALLING OPTIONS *
@@ -49,8 +50,10 @@ public:
   std::size_t certain_variant_support = 14;
   double certain_variant_support_ratio = 0.49;
   bool no_new_variants = false;
+  bool only_variant_windows = false; // Read only around variants of the graph, requires no_new_variants
   bool hq_reads = false;
   std::size_t read_chunk_size = 16384ul; // 2^14
+  std::size_t max_open_files = 16; // Maximum number of SAM/BAM/CRAM files which are read concurrently
   bool phased_output = false;
   std::size_t soft_cap_of_variants_in_100_bp_window = 11;
   std::size_t soft_cap_of_non_snps_in_100_bp_window = 7;
@@ -61,6 +64,7 @@ public:
   bool get_sample_names_from_filename = false;
   bool output_all_variants = false;
   bool always_query_hamming_distance_one = false;
+  bool single_orientation_alignment = false; // Align reads only in the orientation given by strand flags or seeds
   bool is_one_genotype_per_haplotype = false;
   std::string variant_suffix_id = "";
   bool is_perfect_alignments_only = false;
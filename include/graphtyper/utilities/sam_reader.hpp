@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint> // uint8_t, uint16_t, int32_t
 #include <string> // std::String
 #include <unordered_map> // std::unordered_map
 #include <utility> // std::pair
@@ -9,22 +10,69 @@
 #include <seqan/sequence.h>
 #include <seqan/hts_io.h> // seqan::HtsFileIn, seqan::BamAlignmentRecord
 
-#include <graphtyper/utilities/hash_seqan.hpp> // For std::unordered_map<seqan::String<char>, seqan::BamAlignmentRecord>
-
 
 namespace gyper
 {
 
-using TReadPair = std::pair<seqan::BamAlignmentRecord, seqan::BamAlignmentRecord>;
+/**
+ * \brief The parts of a BAM record which are used when a read is aligned to the graph.
+ * \details The CIGAR string is summarized by whether the read is clipped and how many bases are soft-clipped at its
+ *          start. The read name, read group and AS/XS scores are only kept when statistics are written.
+ */
+struct SamRead
+{
+  seqan::IupacString seq;
+  seqan::CharString qual;
+  std::string name;
+  std::string read_group = "NA";
+  int32_t begin_pos = -1; /** \brief 0-based position of the first aligned base. */
+  uint16_t flag = 0;
+  uint16_t front_soft_clip = 0; /** \brief Number of soft-clipped bases at the start of the CIGAR string. */
+  uint16_t score_diff = 0; /** \brief Difference of the AS and XS tags, or zero if they are not available. */
+  uint8_t mapq = 0;
+  bool is_clipped = true; /** \brief True if the CIGAR string is empty or either end of it is clipped. */
+
+  bool is_paired() const {return (flag & BAM_FPAIRED) != 0u;}
+  bool is_unmapped() const {return (flag & BAM_FUNMAP) != 0u;}
+  bool is_next_unmapped() const {return (flag & BAM_FMUNMAP) != 0u;}
+  bool is_reverse() const {return (flag & BAM_FREVERSE) != 0u;}
+  bool is_first() const {return (flag & BAM_FREAD1) != 0u;}
+
+  /** \brief Original 1-based position of the read, including soft-clipped bases. */
+  long get_original_position() const {return static_cast<long>(begin_pos) + 1 - front_soft_clip;}
+
+  /** \brief Discards the CIGAR summary, e.g. when bases have been trimmed from the read. */
+  void clear_cigar()
+  {
+    front_soft_clip = 0;
+    is_clipped = true;
+  }
+};
+
+
+/** \brief Moves the parts of a BAM record which are used in the alignment to a slim read. */
+SamRead make_sam_read(seqan::BamAlignmentRecord & record);
+
+
+using TReadPair = std::pair<SamRead, SamRead>;
 using TReads = std::vector<TReadPair>;
-using TReadsFirst = std::unordered_map<seqan::String<char>, seqan::BamAlignmentRecord>;
+
+/** \brief Reads waiting for their mate and whether they pass the filters of unpaired reads. */
+using TReadsFirst = std::unordered_map<std::string, std::pair<SamRead, bool> >;
 
 class SamReader
 {
 public:
-  SamReader(std::string const & hts_path, std::vector<std::string> const & _regions);
+  /**
+   * \brief Opens a SAM/BAM/CRAM file. BGZF blocks are decompressed by a pool of 'decompression_threads' threads, or
+   *        by the reading thread if it is zero.
+   */
+  SamReader(std::string const & hts_path,
+            std::vector<std::string> const & _regions,
+            unsigned const decompression_threads = 0);
+
   TReads read_N_reads(std::size_t const N);
-  void insert_reads(TReads & reads, seqan::BamAlignmentRecord && record);
+  void insert_reads(TReads & reads, seqan::BamAlignmentRecord && record, bool const is_good_unpaired);
 
   std::size_t r = 0; /* Current region index */
   std::size_t p = 0; /* Current pos in the region */
@@ -32,6 +80,7 @@ public:
 private:
   seqan::HtsFileIn hts_file;
   bool second_file = false;
+  uint32_t fetched_end = 0; /** \brief Records of the current region starting before this position have been read. */
   std::vector<std::string> regions;
   TReadsFirst reads_first;
   TReads unpaired_reads;
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <sstream> // std::ostringstream
+#include <string> // std::string
+#include <type_traits> // std::enable_if, std::is_integral, std::make_unsigned
+
+
+namespace gyper
+{
+
+/**
+ * \brief Reusable character buffer which text is formatted into with operator<<.
+ * \details Gives the same text as std::ostream with default flags. Strings, characters and integers are appended
+ *          directly, other types are formatted with a std::ostringstream.
+ */
+class TextBuffer
+{
+public:
+  std::string str;
+
+  TextBuffer & operator<<(std::string const & s);
+  TextBuffer & operator<<(char const * s);
+  TextBuffer & operator<<(char const c);
+  TextBuffer & operator<<(signed char const c);
+  TextBuffer & operator<<(unsigned char const c);
+  TextBuffer & operator<<(bool const b);
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value, TextBuffer &>::type
+  operator<<(T const x);
+
+  template <typename T>
+  typename std::enable_if<!std::is_integral<T>::value, TextBuffer &>::type
+  operator<<(T const & x);
+
+  std::size_t size() const {return str.size();}
+  void clear() {str.clear();} /** \brief Clears the text but keeps the memory for reuse. */
+};
+
+
+inline TextBuffer &
+TextBuffer::operator<<(std::string const & s)
+{
+  str.append(s);
+  return *this;
+}
+
+
+inline TextBuffer &
+TextBuffer::operator<<(char const * s)
+{
+  str.append(s);
+  return *this;
+}
+
+
+inline TextBuffer &
+TextBuffer::operator<<(char const c)
+{
+  str.push_back(c);
+  return *this;
+}
+
+
+inline TextBuffer &
+TextBuffer::operator<<(signed char const c)
+{
+  str.push_back(static_cast<char>(c));
+  return *this;
+}
+
+
+inline TextBuffer &
+TextBuffer::operator<<(unsigned char const c)
+{
+  str.push_back(static_cast<char>(c));
+  return *this;
+}
+
+
+inline TextBuffer &
+TextBuffer::operator<<(bool const b)
+{
+  str.push_back(b ? '1' : '0');
+  return *this;
+}
+
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value, TextBuffer &>::type
+TextBuffer::operator<<(T const x)
+{
+  using TUnsigned = typename std::make_unsigned<T>::type;
+  TUnsigned u = static_cast<TUnsigned>(x);
+
+  if (x < static_cast<T>(0))
+  {
+    str.push_back('-');
+    u = static_cast<TUnsigned>(0u - u);
+  }
+
+  // Write the digits backwards, 20 digits fit any 64-bit integer
+  char digits[20];
+  char * it = digits + 20;
+
+  do
+  {
+    *--it = static_cast<char>('0' + u % 10u);
+    u /= 10u;
+  } while (u != 0);
+
+  str.append(it, digits + 20);
+  return *this;
+}
+
+
+template <typename T>
+inline typename std::enable_if<!std::is_integral<T>::value, TextBuffer &>::type
+TextBuffer::operator<<(T const & x)
+{
+  std::ostringstream ss;
+  ss << x;
+  str.append(ss.str());
+  return *this;
+}
+
+
+} // namespace gyper
@@ -9,6 +9,7 @@
 #include <seqan/sequence.h>
 
 #include <graphtyper/constants.hpp>
+#include <graphtyper/utilities/arena.hpp> // gyper::ArenaVector
 
 
 namespace gyper
@@ -37,6 +38,13 @@ uint64_t to_uint64(seqan::DnaString const & s, std::size_t i);
 uint16_t to_uint16(char const c);
 uint16_t to_uint16(std::vector<char> const & s, std::size_t i);
 
+/**
+ * \brief Appends the keys of the 32-mer starting at 'i' to 'uints', one key for each combination of the bases of
+ *        ambiguous IUPAC codes. Nothing is appended if there are more than 97 combinations.
+ */
+template <typename TSeq, typename TAlloc>
+void append_uint64_vec(TSeq const & s, std::size_t i, std::vector<uint64_t, TAlloc> & uints);
+
 template <typename TSeq>
 std::vector<uint64_t> to_uint64_vec(TSeq const & s, std::size_t i);
 std::array<uint64_t, 96> to_uint64_vec_hamming_distance_1(uint64_t const key);
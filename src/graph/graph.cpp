@@ -2,6 +2,8 @@
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <sstream> // std::ostringstream
+#include <string> // std::string
 #include <unordered_set> // std::unordered_set
 
 #include <seqan/basic.h>
@@ -14,6 +16,7 @@
 #include <boost/serialization/unordered_map.hpp>
 #include <boost/log/trivial.hpp>
 
+#include <graphtyper/graph/absolute_position.hpp>
 #include <graphtyper/graph/graph.hpp>
 #include <graphtyper/graph/label.hpp>
 #include <graphtyper/graph/node.hpp>
@@ -30,6 +33,36 @@ namespace
 // count_mismatches, count_mismatches_backward, add_node_dna_to_sequence
 #include <graphtyper/graph/graph_utils.hpp>
 
+
+/**
+ * \brief Finds all leaves in [0, last] of a max segment tree which have a value of at least 'value'.
+ * \details Leaves are appended in descending order. Subtrees with a lower maximum are skipped, so the complexity is
+ *          O((k + 1) log n) where k is the number of leaves found.
+ */
+void
+find_leaves_at_least(std::vector<uint32_t> const & tree,
+                     std::size_t const node,
+                     std::size_t const node_begin,
+                     std::size_t const node_end,
+                     std::size_t const last,
+                     uint32_t const value,
+                     std::vector<std::size_t> & leaves)
+{
+  if (node_begin > last || tree[node] < value)
+    return;
+
+  if (node_end - node_begin == 1)
+  {
+    leaves.push_back(node_begin);
+    return;
+  }
+
+  std::size_t const node_mid = node_begin + (node_end - node_begin) / 2;
+  find_leaves_at_least(tree, 2 * node + 1, node_mid, node_end, last, value, leaves);
+  find_leaves_at_least(tree, 2 * node, node_begin, node_mid, last, value, leaves);
+}
+
+
 } // anon namespace
 
 
@@ -52,6 +85,8 @@ Graph::clear()
   ref_reach_to_special_pos.clear();
   ref_reach_poses.clear();
   actual_poses.clear();
+  ref_node_orders.clear();
+  var_reach_tree.clear();
 
   reference_offset = 0;
   use_absolute_positions = true;
@@ -321,6 +356,8 @@ Graph::add_genomic_region(std::vector<char> && reference_sequence,
 
     ref_nodes[r].change_label_order(offset);
   }
+
+  create_position_index();
 }
 
 
@@ -397,6 +434,38 @@ Graph::create_special_positions()
 }
 
 
+void
+Graph::create_position_index()
+{
+  ref_node_orders.clear();
+  ref_node_orders.reserve(ref_nodes.size());
+
+  for (auto const & ref_node : ref_nodes)
+    ref_node_orders.push_back(ref_node.get_label().order);
+
+  // Leaves are stored at [num_leaves, 2 * num_leaves) and the root at index 1
+  std::size_t num_leaves = 1;
+
+  while (num_leaves < ref_nodes.size())
+    num_leaves *= 2;
+
+  var_reach_tree.assign(2 * num_leaves, 0u);
+
+  for (std::size_t r = 0; r < ref_nodes.size(); ++r)
+  {
+    uint32_t max_var_reach = 0;
+
+    for (auto const v : ref_nodes[r].get_vars())
+      max_var_reach = std::max(max_var_reach, var_nodes[v].get_label().reach());
+
+    var_reach_tree[num_leaves + r] = max_var_reach;
+  }
+
+  for (std::size_t i = num_leaves - 1; i > 0; --i)
+    var_reach_tree[i] = std::max(var_reach_tree[2 * i], var_reach_tree[2 * i + 1]);
+}
+
+
 std::vector<char>
 Graph::get_generated_reference_genome(uint32_t & from, uint32_t & to) const
 {
@@ -888,6 +957,55 @@ Graph::is_variant_in_graph(Variant const & var) const
 }
 
 
+std::vector<std::string>
+Graph::get_variant_regions(uint32_t const padding) const
+{
+  std::vector<std::string> regions;
+  std::string chr;
+  uint32_t begin = 0;
+  uint32_t end = 0;
+
+  auto add_region = [&]()
+                    {
+                      if (chr.size() == 0)
+                        return;
+
+                      std::ostringstream ss;
+                      ss << chr << ":" << begin << "-" << end;
+                      regions.push_back(ss.str());
+                    };
+
+  for (auto const & ref_node : ref_nodes)
+  {
+    if (ref_node.out_degree() <= 1)
+      continue;
+
+    // The reference allele spans the variant on the reference genome
+    Label const & ref_allele_label = var_nodes[ref_node.get_var_index(0)].get_label();
+    auto const contig_begin = absolute_pos.get_contig_position(ref_allele_label.order);
+    uint32_t const contig_end = contig_begin.second + (ref_allele_label.reach() - ref_allele_label.order);
+    uint32_t const padded_begin = contig_begin.second > padding ? contig_begin.second - padding : 1;
+    uint32_t const padded_end = contig_end + padding;
+
+    if (contig_begin.first == chr && padded_begin <= end + 1)
+    {
+      // Overlaps or is next to the previous region
+      end = std::max(end, padded_end);
+    }
+    else
+    {
+      add_region();
+      chr = contig_begin.first;
+      begin = padded_begin;
+      end = padded_end;
+    }
+  }
+
+  add_region();
+  return regions;
+}
+
+
 uint8_t
 Graph::get_10log10_num_paths(TNodeIndex const v, uint32_t const MAX_DISTANCE)
 {
@@ -943,68 +1061,78 @@ Graph::get_locations_of_an_actual_position(uint32_t pos, Path const & path, bool
     return locs;
   }
 
-  for (uint32_t r = 1; r <= ref_nodes.size(); ++r)
-  {
-    if (r < ref_nodes.size() && ref_nodes[r].get_label().order <= pos)
-      continue;
+  assert(ref_node_orders.size() == ref_nodes.size());
 
-    int rr = r - 1;
+  // The last reference node which starts at or before the position
+  int rr = static_cast<int>(std::distance(ref_node_orders.begin(),
+                                          std::upper_bound(ref_node_orders.begin(), ref_node_orders.end(), pos)
+                                          )) - 1;
 
-    if (pos < (ref_nodes[rr].get_label().order + ref_nodes[rr].get_label().dna.size()))
+  if (rr < 0)
+    return locs; // The position is before the first reference node
+
+  if (pos < (ref_nodes[rr].get_label().order + ref_nodes[rr].get_label().dna.size()))
+  {
+    // Ref covers this location
+    if (!is_special)
     {
-      // Ref covers this location
-      if (!is_special)
-      {
-        locs.push_back(Location('R' /*type*/,
-                                static_cast<uint32_t>(rr) /*node_id*/,
-                                ref_nodes[rr].get_label().order /*node_order*/,
-                                pos - ref_nodes[rr].get_label().order /*offset*/
-                       )
-        );
-        break; // There is no way there are also variants at this location if the position is not special
-      }
+      locs.push_back(Location('R' /*type*/,
+                              static_cast<uint32_t>(rr) /*node_id*/,
+                              ref_nodes[rr].get_label().order /*node_order*/,
+                              pos - ref_nodes[rr].get_label().order /*offset*/
+                     )
+      );
 
-      assert (rr > 0);
-      --rr; // Variants behind the reference can only have this location
+      return locs; // There is no way there are also variants at this location if the position is not special
     }
 
-    // Check variants behind this reference
-    while (rr >= 0 && ref_nodes[rr].get_label().reach() + 5000u > pos)
+    assert (rr > 0);
+    --rr; // Variants behind the reference can only have this location
+  }
+
+  if (rr < 0)
+    return locs;
+
+  // Check variants behind this reference which reach the position
+  std::vector<std::size_t> overlapping_refs;
+  find_leaves_at_least(var_reach_tree,
+                       1 /*node*/,
+                       0 /*node_begin*/,
+                       var_reach_tree.size() / 2 /*node_end*/,
+                       rr,
+                       pos,
+                       overlapping_refs);
+
+  for (auto const r : overlapping_refs)
+  {
+    for (unsigned i = 0; i < ref_nodes[r].out_degree(); ++i)
     {
-      // Assume there is no variants larger than 5000 bp
-      for (unsigned i = 0; i < ref_nodes[rr].out_degree(); ++i)
+      uint32_t const v = static_cast<uint32_t>(ref_nodes[r].get_var_index(i));
+
+      if (pos >= var_nodes[v].get_label().order and pos <= var_nodes[v].get_label().reach())
       {
-        uint32_t const v = static_cast<uint32_t>(ref_nodes[rr].get_var_index(i));
+        // Only add this node if the path has it
+        auto find_it = std::find(path.var_order.cbegin(),
+                                 path.var_order.cend(),
+                                 var_nodes[v].get_label().order
+        );
+
+        long const j = std::distance(path.var_order.cbegin(), find_it);
+        assert(j >= 0);
+        assert(i == this->get_variant_num(v));
 
-        if (pos >= var_nodes[v].get_label().order and pos <= var_nodes[v].get_label().reach())
+        if (path.is_empty() || (j < static_cast<long>(path.nums.size()) && path.nums[j].test(i)))
         {
-          // Only add this node if the path has it
-          auto find_it = std::find(path.var_order.cbegin(),
-                                   path.var_order.cend(),
-                                   var_nodes[v].get_label().order
+          locs.push_back(
+            {'V' /*type*/,
+             v /*node_id*/,
+             var_nodes[v].get_label().order /*node_order*/,
+             pos - var_nodes[v].get_label().order  /*offset*/
+            }
           );
-
-          long const j = std::distance(path.var_order.cbegin(), find_it);
-          assert(j >= 0);
-          assert(i == this->get_variant_num(v));
-
-          if (path.is_empty() || (j < static_cast<long>(path.nums.size()) && path.nums[j].test(i)))
-          {
-            locs.push_back(
-              {'V' /*type*/,
-               v /*node_id*/,
-               var_nodes[v].get_label().order /*node_order*/,
-               pos - var_nodes[v].get_label().order  /*offset*/
-              }
-            );
-          }
         }
       }
-
-      --rr;
     }
-
-    break;
   }
 
   return locs;
@@ -1141,6 +1269,19 @@ Graph::get_all_sequences_of_length(uint32_t start,
 }
 
 
+uint32_t
+Graph::get_reference_position_of_location(Location const & l) const
+{
+  if (l.node_type == 'R')
+    return l.node_order + l.offset;
+
+  assert(l.node_type == 'V');
+  long const node_remainder = var_nodes[l.node_index].get_label().dna.size() - l.offset;
+  assert(node_remainder >= 0);
+  return var_nodes[l.node_index].get_label().reach() + 1 - node_remainder;
+}
+
+
 std::unordered_set<long>
 Graph::reference_distance_between_locations(std::vector<Location> const & ll1,
                                             std::vector<Location> const & ll2
@@ -1148,32 +1289,13 @@ Graph::reference_distance_between_locations(std::vector<Location> const & ll1,
 {
   std::unordered_set<long> distance_map;
 
-  auto get_ref_pos_lambda = [&](Location const & l)
-  {
-    uint32_t pos;
-
-    if (l.node_type == 'R')
-    {
-      pos = l.node_order + l.offset;
-    }
-    else
-    {
-      assert(l.node_type == 'V');
-      long const node_remainder = var_nodes[l.node_index].get_label().dna.size() - l.offset;
-      assert(node_remainder >= 0);
-      pos = this->var_nodes[l.node_index].get_label().reach() + 1 - node_remainder;
-    }
-
-    return pos;
-  };
-
   for (auto const & l1 : ll1)
   {
-    uint32_t const ref_pos1 = get_ref_pos_lambda(l1);
+    uint32_t const ref_pos1 = get_reference_position_of_location(l1);
 
     for (auto const & l2 : ll2)
     {
-      uint32_t const ref_pos2 = get_ref_pos_lambda(l2);
+      uint32_t const ref_pos2 = get_reference_position_of_location(l2);
       distance_map.insert(static_cast<int64_t>(ref_pos2) - static_cast<int64_t>(ref_pos1));
     }
   }
@@ -1208,27 +1330,45 @@ Graph::get_labels_forward(Location const & s,
                           ) const
 {
   std::vector<KmerLabel> labels;
+  uint32_t const read_size = read.size();
 
-  std::vector<std::vector<char> > var_and_refs(1);
+  // The path of candidate 'j' aligns its first 'lengths[j]' bases to the read with 'mismatches[j]' mismatches
+  std::vector<uint32_t> lengths(1, 0u);
+  std::vector<uint32_t> mismatches(1, 0u);
   std::vector<std::vector<uint32_t> > var_ids(1);
   std::vector<uint32_t> end_pos(1, 0u);
-  std::vector<TNodeIndex> vars;
+  std::vector<TNodeIndex> const * vars = nullptr;
+
+  // Aligns the next bases of a path to the read. The mismatches are only counted up to the end of the read.
+  auto extend =
+    [&read, read_size, max_mismatches](uint32_t & length,
+                                       uint32_t & path_mismatches,
+                                       std::vector<char>::const_iterator const dna_begin,
+                                       std::vector<char>::const_iterator const dna_end) -> bool
+    {
+      bool is_aligned = true;
+
+      if (length < read_size)
+        is_aligned = add_mismatches(read.begin() + length, read.end(), dna_begin, dna_end, path_mismatches, max_mismatches);
+
+      length += static_cast<uint32_t>(dna_end - dna_begin);
+      return is_aligned;
+    };
+
+  bool is_start_aligned = true;
 
   if (s.node_type == 'V')
   {
     assert(s.node_index < var_nodes.size());
     VarNode const & var = var_nodes[s.node_index];
     var_ids[0].push_back(s.node_index);
-    var_and_refs[0] = std::vector<char>(var.get_label().dna.begin() + s.offset,
-                                        var.get_label().dna.end()
-      );
+    is_start_aligned = extend(lengths[0], mismatches[0], var.get_label().dna.begin() + s.offset, var.get_label().dna.end());
 
     // Check if variant is enough
-    if (var_and_refs[0].size() >= read.size())
+    if (lengths[0] >= read_size)
     {
       // variant is enough
-      end_pos[0] =
-        static_cast<uint32_t>(var.get_label().reach() - (var_and_refs[0].size() - read.size()));
+      end_pos[0] = static_cast<uint32_t>(var.get_label().reach() - (lengths[0] - read_size));
 
       uint32_t const ref_reach =
         var_nodes[ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
@@ -1240,15 +1380,11 @@ Graph::get_labels_forward(Location const & s,
     {
       // We also need to add a reference
       RefNode const & ref = ref_nodes[var.get_out_ref_index()];
-      vars = ref.get_vars();
-
-      var_and_refs[0].insert(var_and_refs[0].end(),
-                             ref.get_label().dna.begin(),
-                             ref.get_label().dna.end()
-        );
+      vars = &ref.get_vars();
+      is_start_aligned = extend(lengths[0], mismatches[0], ref.get_label().dna.begin(), ref.get_label().dna.end()) &&
+                         is_start_aligned;
 
-      end_pos[0] =
-        static_cast<uint32_t>(ref.get_label().reach() - (var_and_refs[0].size() - read.size()));
+      end_pos[0] = static_cast<uint32_t>(ref.get_label().reach() - (lengths[0] - read_size));
     }
   }
   else
@@ -1256,67 +1392,68 @@ Graph::get_labels_forward(Location const & s,
     assert(s.node_type == 'R');
     assert(s.node_index < ref_nodes.size());
     RefNode const & ref = ref_nodes[s.node_index];
-    vars = ref.get_vars();
-
-    var_and_refs[0] = std::vector<char>(ref.get_label().dna.begin() + s.offset,
-                                        ref.get_label().dna.end()
-      );
-
-    end_pos[0] =
-      static_cast<uint32_t>(ref.get_label().reach() - (var_and_refs[0].size() - read.size()));
+    vars = &ref.get_vars();
+    is_start_aligned = extend(lengths[0], mismatches[0], ref.get_label().dna.begin() + s.offset, ref.get_label().dna.end());
+    end_pos[0] = static_cast<uint32_t>(ref.get_label().reach() - (lengths[0] - read_size));
   }
 
+  // Every path starts with the same bases, so none of them can be aligned
+  if (!is_start_aligned)
+    return labels;
+
   // We are starting on a variant node
-  if (vars.size() > 0 && var_and_refs[0].size() < read.size())
+  if (vars && vars->size() > 0 && lengths[0] < read_size)
   {
     // We are the the end of the graph, and the sequence is not long enough, we need to bail
-    std::vector<uint32_t> mismatch_scores(vars.size(), 0);
-    uint32_t r = var_nodes[vars[0]].get_out_ref_index();
+    uint32_t r = var_nodes[(*vars)[0]].get_out_ref_index();
     bool all_sequences_long_enough = false;
     std::size_t const MAX_VAR_AND_REFS = 128;
 
-    while (not all_sequences_long_enough && var_and_refs.size() < MAX_VAR_AND_REFS && vars.size() > 0)
+    while (not all_sequences_long_enough && lengths.size() < MAX_VAR_AND_REFS && vars->size() > 0)
     {
       all_sequences_long_enough = true;
       assert(r < ref_nodes.size());
       RefNode const & ref = ref_nodes[r];
-      std::size_t original_size = var_and_refs.size();
+      std::size_t original_size = lengths.size();
 
       for (unsigned j = 0; j < original_size; ++j)
       {
-        assert(j < var_and_refs.size());    // Should always be less than the current size
+        assert(j < lengths.size());    // Should always be less than the current size
 
-        if (var_and_refs[j].size() >= read.size())
+        if (lengths[j] >= read_size)
           continue;   // Sequence is already large enough
 
-        for (unsigned i = 0; i < vars.size() - 1; ++i)
+        for (unsigned i = 0; i < vars->size() - 1; ++i)
         {
-          assert(j < var_and_refs.size());
-          assert(vars[i] < var_nodes.size());
-          VarNode const & var = var_nodes[vars[i]];
-          std::vector<char> new_seq(var_and_refs[j].begin(), var_and_refs[j].end());
-          new_seq.insert(new_seq.end(), var.get_label().dna.begin(), var.get_label().dna.end());
-
-          bool const variant_is_enough = new_seq.size() >= read.size();
+          assert(j < lengths.size());
+          assert((*vars)[i] < var_nodes.size());
+          VarNode const & var = var_nodes[(*vars)[i]];
+          uint32_t new_length = lengths[j];
+          uint32_t new_mismatches = mismatches[j];
+          bool is_aligned = extend(new_length, new_mismatches, var.get_label().dna.begin(), var.get_label().dna.end());
+          bool const variant_is_enough = new_length >= read_size;
 
           if (not variant_is_enough)
-            new_seq.insert(new_seq.end(), ref.get_label().dna.begin(), ref.get_label().dna.end());
+          {
+            is_aligned = extend(new_length, new_mismatches, ref.get_label().dna.begin(), ref.get_label().dna.end()) &&
+                         is_aligned;
+          }
 
           // Only add it if it has less or equal than 'max_mismatches' mismatches
-          if (count_mismatches(read, 0, new_seq, 0, max_mismatches) <= max_mismatches)
+          if (is_aligned)
           {
             std::vector<uint32_t> new_var_id(var_ids[j]);
-            new_var_id.push_back(vars[i]);
+            new_var_id.push_back((*vars)[i]);
             var_ids.push_back(std::move(new_var_id));
 
             // Check if we need to continue further
-            if (new_seq.size() < read.size())
+            if (new_length < read_size)
               all_sequences_long_enough = false;
 
             // Update end positions
             if (variant_is_enough)
             {
-              end_pos.push_back(var.get_label().reach() - (new_seq.size() - read.size()));
+              end_pos.push_back(var.get_label().reach() - (new_length - read_size));
 
               // Check if the end position is further than the reference reach
               uint32_t const ref_reach = var_nodes[ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
@@ -1326,36 +1463,37 @@ Graph::get_labels_forward(Location const & s,
             }
             else
             {
-              end_pos.push_back(ref.get_label().reach() - (new_seq.size() - read.size()));
+              end_pos.push_back(ref.get_label().reach() - (new_length - read_size));
             }
 
             assert(var_nodes[var_ids.back().back()].get_label().order <= end_pos.back());
-            var_and_refs.push_back(std::move(new_seq));
+            lengths.push_back(new_length);
+            mismatches.push_back(new_mismatches);
           }
         }
 
-        // The last variant replaces the old seq
-        VarNode const & var = var_nodes[vars[vars.size() - 1]];
-        var_and_refs[j].insert(var_and_refs[j].end(), var.get_label().dna.begin(), var.get_label().dna.end());
-
-        bool const variant_is_enough = var_and_refs[j].size() >= read.size();
+        // The last variant continues the old path
+        VarNode const & var = var_nodes[vars->back()];
+        bool is_aligned = extend(lengths[j], mismatches[j], var.get_label().dna.begin(), var.get_label().dna.end());
+        bool const variant_is_enough = lengths[j] >= read_size;
 
         if (!variant_is_enough)
         {
-          var_and_refs[j].insert(var_and_refs[j].end(), ref.get_label().dna.begin(), ref.get_label().dna.end());
+          is_aligned = extend(lengths[j], mismatches[j], ref.get_label().dna.begin(), ref.get_label().dna.end()) &&
+                       is_aligned;
         }
 
-        if (count_mismatches(read, 0, var_and_refs[j], 0, max_mismatches) <= max_mismatches)
+        if (is_aligned)
         {
-          var_ids[j].push_back(vars[vars.size() - 1]);
+          var_ids[j].push_back(vars->back());
 
-          if (all_sequences_long_enough and var_and_refs[j].size() < read.size())
+          if (all_sequences_long_enough and lengths[j] < read_size)
             all_sequences_long_enough = false;
 
           // Update end positions
           if (variant_is_enough)
           {
-            end_pos[j] = var.get_label().reach() - (var_and_refs[j].size() - read.size());
+            end_pos[j] = var.get_label().reach() - (lengths[j] - read_size);
 
             // Check if the end position is further than the reference reach
             uint32_t const ref_reach = var_nodes[ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
@@ -1364,7 +1502,7 @@ Graph::get_labels_forward(Location const & s,
           }
           else
           {
-            end_pos[j] = ref.get_label().reach() - (var_and_refs[j].size() - read.size());
+            end_pos[j] = ref.get_label().reach() - (lengths[j] - read_size);
           }
 
           assert(var_nodes[var_ids[j].back()].get_label().order <= end_pos[j]);
@@ -1373,7 +1511,8 @@ Graph::get_labels_forward(Location const & s,
         else
         {
           // Delete the jth element
-          var_and_refs.erase(var_and_refs.begin() + j);
+          lengths.erase(lengths.begin() + j);
+          mismatches.erase(mismatches.begin() + j);
           var_ids.erase(var_ids.begin() + j);
           end_pos.erase(end_pos.begin() + j);
 
@@ -1386,7 +1525,7 @@ Graph::get_labels_forward(Location const & s,
       {
         // Get new reference node and variant nodes
         assert(r < ref_nodes.size());
-        vars = ref_nodes[r].get_vars();
+        vars = &ref_nodes[r].get_vars();
         ++r;
       }
       else
@@ -1400,20 +1539,18 @@ Graph::get_labels_forward(Location const & s,
   std::vector<uint32_t> best_end_pos;
 
   // Iterate all possible sequences
-  for (unsigned j = 0; j < var_and_refs.size(); ++j)
+  for (unsigned j = 0; j < lengths.size(); ++j)
   {
-    if (var_and_refs[j].size() < read.size())
+    if (lengths[j] < read_size)
       continue;
 
-    uint32_t mismatches = count_mismatches(read, 0, var_and_refs[j], 0, max_mismatches);
-
-    if (mismatches > max_mismatches)
+    if (mismatches[j] > max_mismatches)
     {
       continue;
     }
-    else if (mismatches < max_mismatches)
+    else if (mismatches[j] < max_mismatches)
     {
-      max_mismatches = mismatches; // Found alignment with fewer mismatches
+      max_mismatches = mismatches[j]; // Found alignment with fewer mismatches
       best_var_ids.clear();
       best_var_ids.push_back(var_ids[j]);
       best_end_pos.clear();
@@ -1479,23 +1616,52 @@ Graph::get_labels_backward(Location const & e,
                            ) const
 {
   std::vector<KmerLabel> labels;
+  uint32_t const read_size = read.size();
 
-  std::vector<std::vector<char> > var_and_refs(1);
+  // The path of candidate 'j' aligns its last 'lengths[j]' bases to the read with 'mismatches[j]' mismatches
+  std::vector<uint32_t> lengths(1, 0u);
+  std::vector<uint32_t> mismatches(1, 0u);
   std::vector<std::vector<uint32_t> > var_ids(1);
   std::vector<uint32_t> start_pos(1, 0u);
-  std::vector<TNodeIndex> vars;
+  std::vector<TNodeIndex> const * vars = nullptr;
+
+  // Aligns the previous bases of a path to the read, from the back. The mismatches are only counted up to the start
+  // of the read.
+  auto extend =
+    [&read, read_size, max_mismatches](uint32_t & length,
+                                       uint32_t & path_mismatches,
+                                       std::vector<char>::const_iterator const dna_begin,
+                                       std::vector<char>::const_iterator const dna_end) -> bool
+    {
+      bool is_aligned = true;
+
+      if (length < read_size)
+      {
+        is_aligned = add_mismatches(read.rbegin() + length,
+                                    read.rend(),
+                                    std::vector<char>::const_reverse_iterator(dna_end),
+                                    std::vector<char>::const_reverse_iterator(dna_begin),
+                                    path_mismatches,
+                                    max_mismatches);
+      }
+
+      length += static_cast<uint32_t>(dna_end - dna_begin);
+      return is_aligned;
+    };
+
+  bool is_start_aligned = true;
 
   if (e.node_type == 'V')
   {
     assert(e.node_index < var_nodes.size());
     VarNode const & var = var_nodes[e.node_index];
     var_ids[0].push_back(e.node_index);
-    var_and_refs[0] = std::vector<char>(var.get_label().dna.begin(), var.get_label().dna.begin() + e.offset + 1);
+    is_start_aligned = extend(lengths[0], mismatches[0], var.get_label().dna.begin(), var.get_label().dna.begin() + e.offset + 1);
 
     // Check if adding the variant was enough
-    if (var_and_refs[0].size() >= read.size())
+    if (lengths[0] >= read_size)
     {
-      start_pos[0] = var.get_label().order + (var_and_refs[0].size() - read.size());
+      start_pos[0] = var.get_label().order + (lengths[0] - read_size);
 
       // Check if we need to use a special positions
       uint32_t const ref_reach = var_nodes[ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
@@ -1506,11 +1672,12 @@ Graph::get_labels_backward(Location const & e,
     {
       uint32_t const r = var.get_out_ref_index() - 1;
       RefNode const & ref = ref_nodes[r];
-      var_and_refs[0].insert(var_and_refs[0].begin(), ref.get_label().dna.begin(), ref.get_label().dna.end());
-      start_pos[0] = ref.get_label().order + (var_and_refs[0].size() - read.size());
+      is_start_aligned = extend(lengths[0], mismatches[0], ref.get_label().dna.begin(), ref.get_label().dna.end()) &&
+                         is_start_aligned;
+      start_pos[0] = ref.get_label().order + (lengths[0] - read_size);
 
       if (r != 0)
-        vars = ref_nodes[r - 1].get_vars();
+        vars = &ref_nodes[r - 1].get_vars();
     }
   }
   else
@@ -1520,108 +1687,109 @@ Graph::get_labels_backward(Location const & e,
     RefNode const & ref = ref_nodes[e.node_index];
 
     if (e.node_index != 0)
-      vars = ref_nodes[e.node_index - 1].get_vars(); // Only if we are not on the first reference node, we can get the vars
+      vars = &ref_nodes[e.node_index - 1].get_vars(); // Only if we are not on the first reference node, we can get the vars
 
-    var_and_refs[0] = std::vector<char>(ref.get_label().dna.begin(), ref.get_label().dna.begin() + e.offset + 1);
-    start_pos[0] = ref.get_label().order + (var_and_refs[0].size() - read.size());
+    is_start_aligned = extend(lengths[0], mismatches[0], ref.get_label().dna.begin(), ref.get_label().dna.begin() + e.offset + 1);
+    start_pos[0] = ref.get_label().order + (lengths[0] - read_size);
   }
 
+  // Every path ends with the same bases, so none of them can be aligned
+  if (!is_start_aligned)
+    return labels;
+
   // We are starting on a variant node
-  if (vars.size() > 0 && var_and_refs[0].size() < read.size())
+  if (vars && vars->size() > 0 && lengths[0] < read_size)
   {
-    std::vector<uint32_t> mismatch_scores(vars.size(), 0);
-    uint32_t r = var_nodes[vars[0]].get_out_ref_index() - 1;
+    uint32_t r = var_nodes[(*vars)[0]].get_out_ref_index() - 1;
     bool all_sequences_long_enough = false;
     std::size_t const MAX_VAR_AND_REFS = 128;
 
-    while (not all_sequences_long_enough and var_and_refs.size() < MAX_VAR_AND_REFS && vars.size() > 0)
+    while (not all_sequences_long_enough and lengths.size() < MAX_VAR_AND_REFS && vars->size() > 0)
     {
       all_sequences_long_enough = true;
       assert(r < ref_nodes.size());
       RefNode const & ref = ref_nodes[r];
-      std::size_t original_size = var_and_refs.size();
+      std::size_t original_size = lengths.size();
 
       for (unsigned j = 0; j < original_size; ++j)
       {
-        assert(j < var_and_refs.size());  // Should always be less than the current size
+        assert(j < lengths.size());  // Should always be less than the current size
 
-        if (var_and_refs[j].size() >= read.size())
+        if (lengths[j] >= read_size)
           continue; // Sequence is already large enough
 
-        for (unsigned i = 0; i < vars.size() - 1; ++i)
+        for (unsigned i = 0; i < vars->size() - 1; ++i)
         {
-          assert(j < var_and_refs.size());
+          assert(j < lengths.size());
+          assert(i < vars->size());
+          assert((*vars)[i] < var_nodes.size());
+          VarNode const & var = var_nodes[(*vars)[i]];
+          uint32_t new_length = lengths[j];
+          uint32_t new_mismatches = mismatches[j];
+          bool is_aligned = extend(new_length, new_mismatches, var.get_label().dna.begin(), var.get_label().dna.end());
+          bool const variant_is_enough = new_length >= read_size;
 
-          if (var_and_refs[j].size() < read.size())
+          if (not variant_is_enough)
           {
-            assert(i < vars.size());
-            assert(vars[i] < var_nodes.size());
-            VarNode const & var = var_nodes[vars[i]];
-            std::vector<char> new_seq(var.get_label().dna.begin(), var.get_label().dna.end());
-            new_seq.insert(new_seq.end(), var_and_refs[j].begin(), var_and_refs[j].end());
+            is_aligned = extend(new_length, new_mismatches, ref.get_label().dna.begin(), ref.get_label().dna.end()) &&
+                         is_aligned;
+          }
 
-            bool const variant_is_enough = new_seq.size() >= read.size();
+          // Only add it if it has less or equal than 'max_mismatches' mismatches
+          if (is_aligned)
+          {
+            std::vector<uint32_t> new_var_id(var_ids[j]);
+            new_var_id.push_back((*vars)[i]);
+            var_ids.push_back(std::move(new_var_id));
 
-            if (not variant_is_enough)
+            // Check if we need to continue further
+            if (new_length < read_size)
             {
-              new_seq.insert(new_seq.begin(), ref.get_label().dna.begin(), ref.get_label().dna.end());
+              all_sequences_long_enough = false;
             }
 
-            // Only add it if it has less or equal than 'max_mismatches' mismatches
-            if (count_mismatches_backward(read, 0, new_seq, 0, max_mismatches) <= max_mismatches)
+            // Update end positions
+            if (variant_is_enough)
+            {
+              start_pos.push_back(var.get_label().order + (new_length - read_size));
+
+              // Check if we need to use a special positions
+              uint32_t const ref_reach = var_nodes[ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
+              if (start_pos.back() > ref_reach)
+                start_pos.back() = get_special_pos(start_pos.back(), ref_reach);
+            }
+            else
             {
-              std::vector<uint32_t> new_var_id(var_ids[j]);
-              new_var_id.push_back(vars[i]);
-              var_ids.push_back(std::move(new_var_id));
-
-              // Check if we need to continue further
-              if (new_seq.size() < read.size())
-              {
-                all_sequences_long_enough = false;
-              }
-
-              // Update end positions
-              if (variant_is_enough)
-              {
-                start_pos.push_back(var.get_label().order + (new_seq.size() - read.size()));
-
-                // Check if we need to use a special positions
-                uint32_t const ref_reach = var_nodes[ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
-                if (start_pos.back() > ref_reach)
-                  start_pos.back() = get_special_pos(start_pos.back(), ref_reach);
-              }
-              else
-              {
-                start_pos.push_back(ref.get_label().order + (new_seq.size() - read.size()));
-              }
-
-              var_and_refs.push_back(std::move(new_seq));
+              start_pos.push_back(ref.get_label().order + (new_length - read_size));
             }
+
+            lengths.push_back(new_length);
+            mismatches.push_back(new_mismatches);
           }
         }
 
-        // The last variant replaces the old seq
-        VarNode const & var = var_nodes[vars[vars.size() - 1]];
-        var_and_refs[j].insert(var_and_refs[j].begin(), var.get_label().dna.begin(), var.get_label().dna.end());
-
-        bool const variant_is_enough = var_and_refs[j].size() >= read.size();
+        // The last variant continues the old path
+        VarNode const & var = var_nodes[vars->back()];
+        bool is_aligned = extend(lengths[j], mismatches[j], var.get_label().dna.begin(), var.get_label().dna.end());
+        bool const variant_is_enough = lengths[j] >= read_size;
 
         if (!variant_is_enough)
         {
-          var_and_refs[j].insert(var_and_refs[j].begin(), ref.get_label().dna.begin(), ref.get_label().dna.end());
+          is_aligned = extend(lengths[j], mismatches[j], ref.get_label().dna.begin(), ref.get_label().dna.end()) &&
+                       is_aligned;
         }
 
-        if (count_mismatches_backward(read, 0, var_and_refs[j], 0, max_mismatches) <= max_mismatches)
+        if (is_aligned)
         {
-          var_ids[j].push_back(vars[vars.size() - 1]);
+          var_ids[j].push_back(vars->back());
 
-          if (var_and_refs[j].size() < read.size())
+          if (lengths[j] < read_size)
             all_sequences_long_enough = false;
 
           // Update end positions
           if (variant_is_enough)
           {
-            start_pos[j] = var.get_label().order + (var_and_refs[j].size() - read.size());
+            start_pos[j] = var.get_label().order + (lengths[j] - read_size);
 
             // Check if we need to use a special positions
             uint32_t const ref_reach = var_nodes[ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
@@ -1630,7 +1798,7 @@ Graph::get_labels_backward(Location const & e,
           }
           else
           {
-            start_pos[j] = ref.get_label().order + (var_and_refs[j].size() - read.size());
+            start_pos[j] = ref.get_label().order + (lengths[j] - read_size);
           }
 
           assert(var_ids.size() == start_pos.size());
@@ -1638,7 +1806,8 @@ Graph::get_labels_backward(Location const & e,
         else
         {
           // Delete the jth element
-          var_and_refs.erase(var_and_refs.begin() + j);
+          lengths.erase(lengths.begin() + j);
+          mismatches.erase(mismatches.begin() + j);
           var_ids.erase(var_ids.begin() + j);
           start_pos.erase(start_pos.begin() + j);
 
@@ -1649,19 +1818,14 @@ Graph::get_labels_backward(Location const & e,
 
       if (not all_sequences_long_enough)
       {
-        // // Get new reference node and variant nodes
-        // r = var_nodes[vars[0]].get_out_ref_index() - 1;
-        // assert(r < ref_nodes.size());
-
         if (r != 0)
         {
           --r;
-          assert(ref_nodes[r].get_vars()[0] != vars[0]);
-          vars = ref_nodes[r].get_vars();
+          assert(ref_nodes[r].get_vars()[0] != (*vars)[0]);
+          vars = &ref_nodes[r].get_vars();
         }
         else
         {
-          vars.clear();
           break;
         }
       }
@@ -1676,22 +1840,20 @@ Graph::get_labels_backward(Location const & e,
   std::vector<uint32_t> best_start_pos;
 
   // Iterate all possible sequences
-  for (unsigned j = 0; j < var_and_refs.size(); ++j)
+  for (unsigned j = 0; j < lengths.size(); ++j)
   {
-    if (var_and_refs[j].size() < read.size())
+    if (lengths[j] < read_size)
       continue;
 
-    uint32_t const mismatches = count_mismatches_backward(read, 0, var_and_refs[j], 0, max_mismatches);
-
-    if (mismatches < max_mismatches)
+    if (mismatches[j] < max_mismatches)
     {
-      max_mismatches = mismatches;
+      max_mismatches = mismatches[j];
       best_var_ids.clear();
       best_var_ids.push_back(var_ids[j]);
       best_start_pos.clear();
       best_start_pos.push_back(start_pos[j]);
     }
-    else if (mismatches == max_mismatches)
+    else if (mismatches[j] == max_mismatches)
     {
       best_var_ids.push_back(var_ids[j]);
       best_start_pos.push_back(start_pos[j]);
@@ -48,6 +48,7 @@ load_graph(std::string const & graph_path)
 
   // Create a reference genome each time the graph is loaded
   graph.generate_reference_genome();
+  graph.create_position_index();
   absolute_pos.calculate_offsets();
 }
 
@@ -70,6 +71,7 @@ load_secondary_graph(std::string const & graph_path)
 
   // Create a reference genome each time the graph is loaded
   second_graph.generate_reference_genome();
+  second_graph.create_position_index();
 
   return second_graph;
 }
@@ -1,9 +1,14 @@
+#include <bitset> // std::bitset
 #include <iostream>
 #include <vector>
 #include <cmath>
 #include <limits>
 #include <set>
 
+#ifdef __SSE2__
+#include <immintrin.h> // _mm_add_epi16, _mm256_add_epi16
+#endif // __SSE2__
+
 #include <boost/log/trivial.hpp>
 
 #include <graphtyper/graph/graph.hpp> // gyper::Graph
@@ -69,7 +74,7 @@ Haplotype::add_genotype(Genotype && gt)
 {
   var_stats.push_back(VarStats(gt.num));
   gts.push_back(std::move(gt));
-  explains.push_back(std::bitset<MAX_NUMBER_OF_HAPLOTYPES>(0));
+  explains.push_back(CompactBitset<MAX_NUMBER_OF_HAPLOTYPES>());
   coverage.push_back(gyper::Haplotype::NO_COVERAGE);
 }
 
@@ -448,30 +453,30 @@ Haplotype::coverage_to_gts(std::size_t const pn_index, bool const is_proper_pair
 }
 
 
-std::bitset<MAX_NUMBER_OF_HAPLOTYPES>
+CompactBitset<MAX_NUMBER_OF_HAPLOTYPES>
 Haplotype::explain_to_path_explain()
 {
   uint32_t const cnum = get_genotype_num();
 
   // Find gts with no explanation
-  for (auto & e : explains)
+  for (uint32_t i = 0; i < explains.size(); ++i)
   {
-    if (e.none())
-      e.set(); // Flip 'em all, cause they can all explain this read
+    if (explains[i].none())
+      explains[i].set_lowest(gts[i].num); // Set all alleles, cause they can all explain this read
   }
 
-  std::bitset<MAX_NUMBER_OF_HAPLOTYPES> path_explains = find_which_haplotypes_explain_the_read(cnum);
+  CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> path_explains = find_which_haplotypes_explain_the_read(cnum);
 
   // Clear all bitsets
   for (std::size_t i = 0; i < explains.size(); ++i)
-    explains[i] = std::bitset<MAX_NUMBER_OF_HAPLOTYPES>(0); // This is better than using reset()!
+    explains[i].reset();
 
   return path_explains;
 }
 
 
 void
-Haplotype::add_explanation(uint32_t const i, std::bitset<MAX_NUMBER_OF_HAPLOTYPES> const & e)
+Haplotype::add_explanation(uint32_t const i, CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> const & e)
 {
   // i is local genotype id
   // e is explain bitset for this local genotype id
@@ -481,10 +486,10 @@ Haplotype::add_explanation(uint32_t const i, std::bitset<MAX_NUMBER_OF_HAPLOTYPE
 }
 
 
-std::bitset<MAX_NUMBER_OF_HAPLOTYPES>
+CompactBitset<MAX_NUMBER_OF_HAPLOTYPES>
 Haplotype::find_which_haplotypes_explain_the_read(uint32_t const num) const
 {
-  std::bitset<MAX_NUMBER_OF_HAPLOTYPES> haplotype_explains(0);
+  CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> haplotype_explains;
 
   for (uint32_t c = 0; c < num; ++c)
   {
@@ -618,7 +623,7 @@ Haplotype::explain_to_score(std::size_t const pn_index,
   for (uint32_t i = 0; i < explains.size(); ++i)
   {
     if (explains[i].none())
-      explains[i].set(); // Flip 'em all, cause they can all explain this read
+      explains[i].set_lowest(gts[i].num); // Set all alleles, cause they can all explain this read
   }
 
   assert(gts.size() == explains.size());
@@ -666,37 +671,14 @@ Haplotype::explain_to_score(std::size_t const pn_index,
   if (hap_sample.max_log_score < 0xFFFFul - epsilon_exponent)
   {
     hap_sample.max_log_score += epsilon_exponent;
-    int i = 0;
-
-    for (std::size_t y = 0; y < cnum; ++y)
-    {
-      for (std::size_t x = 0; x <= y; ++x, ++i)
-      {
-        assert(to_index(x, y) < static_cast<long>(hap_sample.log_score.size()));
-        assert(i == to_index(x, y));
-
-        if (haplotype_errors[x] == 0 && haplotype_errors[y] == 0)
-          hap_sample.log_score[i] += epsilon_exponent;
-        else if (haplotype_errors[x] == 0 || haplotype_errors[y] == 0)
-          hap_sample.log_score[i] += epsilon_exponent - 1;
-        else if (haplotype_errors[x] == 1 && haplotype_errors[y] == 1)
-          hap_sample.log_score[i] += 4;
-        else if (haplotype_errors[x] == 1 || haplotype_errors[y] == 1)
-          hap_sample.log_score[i] += 3;
-        else if (haplotype_errors[x] == 2 && haplotype_errors[y] == 2)
-          hap_sample.log_score[i] += 2;
-        else if (haplotype_errors[x] == 2 || haplotype_errors[y] == 2)
-          hap_sample.log_score[i] += 1;
-        // else the log_score does not change
-      }
-    }
+    add_read_to_log_scores(hap_sample.log_score, haplotype_errors, epsilon_exponent);
   }
 
   // Clear all bitsets
   assert(gts.size() == explains.size());
 
   for (std::size_t i = 0; i < gts.size(); ++i)
-    explains[i] = std::bitset<MAX_NUMBER_OF_HAPLOTYPES>(0);
+    explains[i].reset();
 }
 
 
@@ -840,8 +822,8 @@ Haplotype::get_haplotype_calls() const
 
 uint32_t
 Haplotype::best_score_of_a_path(std::size_t const pn_index,
-                                std::bitset<MAX_NUMBER_OF_HAPLOTYPES> const & e1,
-                                std::bitset<MAX_NUMBER_OF_HAPLOTYPES> const & e2
+                                CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> const & e1,
+                                CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> const & e2
                                 ) const
 {
   assert (pn_index < hap_samples.size());
@@ -894,4 +876,135 @@ Haplotype::best_score_of_a_path(std::size_t const pn_index,
   return max_path_score;
 }
 
+
+#ifdef __AVX2__
+std::size_t
+add_class_scores_avx2(uint16_t * const row,
+                      uint16_t const * const classes,
+                      uint16_t const * const row_scores,
+                      std::size_t x,
+                      std::size_t const row_size
+                      )
+{
+  __m256i const s0 = _mm256_set1_epi16(static_cast<short>(row_scores[0]));
+  __m256i const s1 = _mm256_set1_epi16(static_cast<short>(row_scores[1]));
+  __m256i const s2 = _mm256_set1_epi16(static_cast<short>(row_scores[2]));
+  __m256i const s3 = _mm256_set1_epi16(static_cast<short>(row_scores[3]));
+  __m256i const c0 = _mm256_setzero_si256();
+  __m256i const c1 = _mm256_set1_epi16(1);
+  __m256i const c2 = _mm256_set1_epi16(2);
+
+  for (; x + 16 <= row_size; x += 16)
+  {
+    __m256i const c = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(classes + x));
+    __m256i add = _mm256_blendv_epi8(s3, s2, _mm256_cmpeq_epi16(c, c2));
+    add = _mm256_blendv_epi8(add, s1, _mm256_cmpeq_epi16(c, c1));
+    add = _mm256_blendv_epi8(add, s0, _mm256_cmpeq_epi16(c, c0));
+    __m256i * const out = reinterpret_cast<__m256i *>(row + x);
+    _mm256_storeu_si256(out, _mm256_add_epi16(_mm256_loadu_si256(out), add));
+  }
+
+  return x;
+}
+
+
+#endif // __AVX2__
+
+#ifdef __SSE2__
+std::size_t
+add_class_scores_sse2(uint16_t * const row,
+                      uint16_t const * const classes,
+                      uint16_t const * const row_scores,
+                      std::size_t x,
+                      std::size_t const row_size
+                      )
+{
+  __m128i const s0 = _mm_set1_epi16(static_cast<short>(row_scores[0]));
+  __m128i const s1 = _mm_set1_epi16(static_cast<short>(row_scores[1]));
+  __m128i const s2 = _mm_set1_epi16(static_cast<short>(row_scores[2]));
+  __m128i const s3 = _mm_set1_epi16(static_cast<short>(row_scores[3]));
+  __m128i const c0 = _mm_setzero_si128();
+  __m128i const c1 = _mm_set1_epi16(1);
+  __m128i const c2 = _mm_set1_epi16(2);
+  __m128i const c3 = _mm_set1_epi16(3);
+
+  for (; x + 8 <= row_size; x += 8)
+  {
+    __m128i const c = _mm_loadu_si128(reinterpret_cast<__m128i const *>(classes + x));
+    __m128i add = _mm_and_si128(_mm_cmpeq_epi16(c, c0), s0);
+    add = _mm_or_si128(add, _mm_and_si128(_mm_cmpeq_epi16(c, c1), s1));
+    add = _mm_or_si128(add, _mm_and_si128(_mm_cmpeq_epi16(c, c2), s2));
+    add = _mm_or_si128(add, _mm_and_si128(_mm_cmpeq_epi16(c, c3), s3));
+    __m128i * const out = reinterpret_cast<__m128i *>(row + x);
+    _mm_storeu_si128(out, _mm_add_epi16(_mm_loadu_si128(out), add));
+  }
+
+  return x;
+}
+
+
+#endif // __SSE2__
+
+void
+add_class_scores_scalar(uint16_t * const row,
+                        uint16_t const * const classes,
+                        uint16_t const * const row_scores,
+                        std::size_t x,
+                        std::size_t const row_size
+                        )
+{
+  for (; x < row_size; ++x)
+    row[x] = static_cast<uint16_t>(row[x] + row_scores[classes[x]]);
+}
+
+
+void
+add_read_to_log_scores(std::vector<uint16_t> & log_score,
+                       std::vector<uint16_t> const & haplotype_errors,
+                       uint16_t const epsilon_exponent
+                       )
+{
+  std::size_t const cnum = haplotype_errors.size();
+  assert(log_score.size() >= cnum * (cnum + 1) / 2);
+
+  // Having more than three errors gives the same score as having three
+  std::vector<uint16_t> error_class(cnum);
+
+  for (std::size_t c = 0; c < cnum; ++c)
+    error_class[c] = std::min(haplotype_errors[c], static_cast<uint16_t>(3));
+
+  // Score of a haplotype pair given the error class of each haplotype
+  uint16_t const eps = epsilon_exponent;
+  uint16_t const eps_m1 = static_cast<uint16_t>(epsilon_exponent - 1);
+  uint16_t const scores[4][4] = {
+    {eps, eps_m1, eps_m1, eps_m1},
+    {eps_m1, 4, 3, 3},
+    {eps_m1, 3, 2, 1},
+    {eps_m1, 3, 1, 0}
+  };
+
+  uint16_t * row = log_score.data();
+  uint16_t const * const classes = error_class.data();
+
+  for (std::size_t y = 0; y < cnum; ++y)
+  {
+    uint16_t const * const row_scores = scores[classes[y]];
+    std::size_t const row_size = y + 1;
+    std::size_t x = 0;
+
+    // The widest kernel updates as much of the row as it can and the narrower ones update the rest
+#ifdef __AVX2__
+    x = add_class_scores_avx2(row, classes, row_scores, x, row_size);
+#endif // __AVX2__
+
+#ifdef __SSE2__
+    x = add_class_scores_sse2(row, classes, row_scores, x, row_size);
+#endif // __SSE2__
+
+    add_class_scores_scalar(row, classes, row_scores, x, row_size);
+    row += row_size;
+  }
+}
+
+
 } // namespace gyper
@@ -35,7 +35,7 @@ RefNode::get_var_index(unsigned const & index) const
 }
 
 
-std::vector<TNodeIndex>
+std::vector<TNodeIndex> const &
 RefNode::get_vars() const
 {
   return out_var_ids;
@@ -1,6 +1,7 @@
-#include <algorithm> // std::sort
+#include <algorithm> // std::sort, std::min, std::max
 #include <string> // std::string
 #include <sstream> // std::stringstream
+#include <utility> // std::move
 #include <vector> // std::vector
 
 #include <graphtyper/graph/graph.hpp>
@@ -9,6 +10,15 @@
 #include <graphtyper/typer/variant_candidate.hpp>
 
 
+namespace
+{
+
+/** Maximum number of committed intervals before they are folded into the depth window. */
+std::size_t const MAX_UNFOLDED_INTERVALS = 65536;
+
+} // anon namespace
+
+
 namespace gyper
 {
 
@@ -22,12 +32,14 @@ std::string
 ReferenceDepth::print_non_zero_depth(std::size_t const MIN_DEPTH) const
 {
   std::stringstream ss;
+  std::size_t window_begin;
+  std::vector<uint16_t> const window = get_depth_window(window_begin);
 
-  for (std::size_t i = 0; i < depth.size(); ++i)
+  for (std::size_t i = 0; i < window.size(); ++i)
   {
-    if (depth[i] >= MIN_DEPTH)
+    if (window[i] >= MIN_DEPTH)
     {
-      ss << (i + reference_offset) << "\t" << depth[i] << "\n";
+      ss << (window_begin + i + reference_offset) << "\t" << window[i] << "\n";
     }
   }
 
@@ -38,7 +50,7 @@ ReferenceDepth::print_non_zero_depth(std::size_t const MIN_DEPTH) const
 uint16_t
 ReferenceDepth::get_read_depth(VariantCandidate const & var) const
 {
-  assert(depth.size() > 0);
+  assert(depth_size > 0);
   assert(var.seqs.size() > 0);
   uint32_t start_pos = var.abs_pos;
   uint32_t end_pos = start_pos + var.seqs[0].size() - 1;
@@ -50,19 +62,98 @@ ReferenceDepth::get_read_depth(VariantCandidate const & var) const
   std::size_t const start_index = start_pos_to_index(start_pos);
   std::size_t const end_index = end_pos_to_index(end_pos);
 
-  auto max_depth_it = std::max_element(depth.begin() + start_index, depth.begin() + end_index);
-  assert(max_depth_it != depth.begin() + end_index);
+  // Only the depth of the variant's positions is computed
+  std::vector<uint16_t> const depth = get_depth_range(start_index, end_index);
+  auto max_depth_it = std::max_element(depth.begin(), depth.end());
+  assert(max_depth_it != depth.end());
   return *max_depth_it;
 }
 
 
+std::vector<uint16_t>
+ReferenceDepth::get_depth_window(std::size_t & window_begin) const
+{
+  if (intervals.size() == 0 && folded_depth.size() == 0)
+  {
+    window_begin = 0;
+    return std::vector<uint16_t>(0);
+  }
+
+  std::size_t window_end = 0;
+  window_begin = depth_size;
+
+  if (folded_depth.size() > 0)
+  {
+    window_begin = folded_begin;
+    window_end = folded_begin + folded_depth.size();
+  }
+
+  for (auto const & interval : intervals)
+  {
+    window_begin = std::min(window_begin, static_cast<std::size_t>(interval.first));
+    window_end = std::max(window_end, static_cast<std::size_t>(interval.second));
+  }
+
+  assert(window_begin < window_end);
+  return get_depth_range(window_begin, window_end);
+}
+
+
+std::vector<uint16_t>
+ReferenceDepth::get_depth_range(std::size_t const begin, std::size_t const end) const
+{
+  assert(begin <= end);
+  std::vector<int32_t> depth_diff(end - begin + 1, 0);
+
+  for (auto const & interval : intervals)
+  {
+    std::size_t const first = std::max(begin, static_cast<std::size_t>(interval.first));
+    std::size_t const second = std::min(end, static_cast<std::size_t>(interval.second));
+
+    if (first < second)
+    {
+      ++depth_diff[first - begin];
+      --depth_diff[second - begin];
+    }
+  }
+
+  std::vector<uint16_t> depth(end - begin);
+  int32_t d = 0;
+
+  for (std::size_t i = 0; i < depth.size(); ++i)
+  {
+    d += depth_diff[i];
+    int32_t total = d;
+    std::size_t const index = begin + i;
+
+    if (index >= folded_begin && index < folded_begin + folded_depth.size())
+      total += folded_depth[index - folded_begin];
+
+    depth[i] = static_cast<uint16_t>(std::min(total, static_cast<int32_t>(0xFFFF)));
+  }
+
+  return depth;
+}
+
+
+std::vector<uint16_t>
+ReferenceDepth::get_depth() const
+{
+  std::vector<uint16_t> depth(depth_size, 0u);
+  std::size_t window_begin;
+  std::vector<uint16_t> const window = get_depth_window(window_begin);
+  std::copy(window.begin(), window.end(), depth.begin() + window_begin);
+  return depth;
+}
+
+
 void
 ReferenceDepth::add_genotype_paths(GenotypePaths const & geno)
 {
   if (geno.paths.size() == 0 || geno.paths[0].size() < 63)
     return;
 
-  assert(local_depth.size() == 0);
+  assert(local_intervals.size() == 0);
 
   for (auto const & path : geno.paths)
   {
@@ -90,10 +181,14 @@ ReferenceDepth::add_depth(std::size_t const begin, std::size_t const end)
 void
 ReferenceDepth::clear()
 {
-  depth.clear();
-  depth.shrink_to_fit();
-  local_depth.clear();
-  local_depth.shrink_to_fit();
+  depth_size = 0;
+  intervals.clear();
+  intervals.shrink_to_fit();
+  local_intervals.clear();
+  local_intervals.shrink_to_fit();
+  folded_begin = 0;
+  folded_depth.clear();
+  folded_depth.shrink_to_fit();
 }
 
 
@@ -107,7 +202,7 @@ ReferenceDepth::start_pos_to_index(uint32_t const start_pos) const
 std::size_t
 ReferenceDepth::end_pos_to_index(uint32_t const end_pos) const
 {
-  return (end_pos > reference_offset + depth.size()) ? depth.size() : end_pos + 1 - reference_offset;
+  return (end_pos > reference_offset + depth_size) ? depth_size : end_pos + 1 - reference_offset;
 }
 
 
@@ -121,45 +216,64 @@ ReferenceDepth::increase_local_depth_by_one(std::size_t const start_pos, std::si
     return;
 
   assert(end_pos >= reference_offset);
-  assert(depth.size() > 0);
+  assert(depth_size > 0);
   std::size_t const start_index = start_pos_to_index(start_pos);
-  auto const end = depth.begin() + end_pos_to_index(end_pos);
+  std::size_t const end_index = std::min(end_pos_to_index(end_pos), depth_size);
 
   // TODO: Super rarely this fails, find out why.
   // Must likely it is related to SV breakpoint indel calling
-  // assert(start_index < depth.size());
-  if (start_index < depth.size())
-  {
-    for (auto it = depth.begin() + start_index; it != end && it != depth.end(); ++it)
-      local_depth.push_back(std::distance(depth.begin(), it)); // Increase the depth by one
-  }
+  // assert(start_index < depth_size);
+  if (start_index < end_index)
+    local_intervals.emplace_back(static_cast<uint32_t>(start_index), static_cast<uint32_t>(end_index));
 }
 
 
 void
 ReferenceDepth::commit_local_depth()
 {
-  std::sort(local_depth.begin(), local_depth.end());
-  auto last = std::unique(local_depth.begin(), local_depth.end());
+  if (local_intervals.size() == 0)
+    return;
 
-  for (auto it = local_depth.begin(); it != last; ++it)
-  {
-    assert(*it < depth.size());
-    auto & d = depth[*it];
+  // Merge the overlapping intervals of the read, so the depth is increased at most once at each position
+  std::sort(local_intervals.begin(), local_intervals.end());
+  TInterval merged = local_intervals[0];
 
-    // Make sure we will not overflow
-    if (d < 0xFFFFul)
-      ++d;
+  for (auto it = local_intervals.begin() + 1; it != local_intervals.end(); ++it)
+  {
+    if (it->first <= merged.second)
+    {
+      merged.second = std::max(merged.second, it->second);
+    }
+    else
+    {
+      intervals.push_back(merged);
+      merged = *it;
+    }
   }
 
-  local_depth.clear();
+  intervals.push_back(merged);
+  local_intervals.clear();
+
+  if (intervals.size() >= MAX_UNFOLDED_INTERVALS)
+    fold_intervals();
+}
+
+
+void
+ReferenceDepth::fold_intervals()
+{
+  std::size_t window_begin;
+  std::vector<uint16_t> window = get_depth_window(window_begin);
+  folded_begin = window_begin;
+  folded_depth = std::move(window);
+  intervals.clear();
 }
 
 
 void
 ReferenceDepth::resize_depth(std::size_t const ref_size)
 {
-  depth.resize(ref_size, 0u);
+  depth_size = ref_size;
   reference_offset = graph.ref_nodes.size() > 0 ? graph.ref_nodes[0].get_label().order : 0;
 }
 
@@ -175,30 +289,37 @@ GlobalReferenceDepth::set_pn_count(std::size_t const pn_count)
 void
 GlobalReferenceDepth::add_reference_depths_from(ReferenceDepth const & ref_depth, std::size_t const pn_index)
 {
-  if (ref_depth.depth.size() == 0)
+  if (ref_depth.depth_size == 0)
     return;
 
   if (reference_offset == 0)
     reference_offset = ref_depth.reference_offset;
 
   assert(reference_offset == ref_depth.reference_offset);
+
+  // Only the window covered by the reads of the batch is merged
+  std::size_t window_begin;
+  std::vector<uint16_t> const window = ref_depth.get_depth_window(window_begin);
+
   assert(pn_index < reference_depth_mutexes.size());
   std::lock_guard<std::mutex> lock(reference_depth_mutexes[pn_index]);
 
   assert(pn_index < this->depths.size());
 
   if (depths[pn_index].size() == 0)
-    depths[pn_index].resize(ref_depth.depth.size());
+    depths[pn_index].resize(ref_depth.depth_size);
 
-  assert(ref_depth.depth.size() == depths[pn_index].size());
+  assert(ref_depth.depth_size == depths[pn_index].size());
+  assert(window_begin + window.size() <= depths[pn_index].size());
+  auto depth_it = depths[pn_index].begin() + window_begin;
 
-  for (std::size_t i = 0; i < depths[pn_index].size(); ++i)
+  for (auto it = window.cbegin(); it != window.cend(); ++it, ++depth_it)
   {
     // Check for overflow
-    if (static_cast<uint32_t>(depths[pn_index][i]) + static_cast<int32_t>(ref_depth.depth[i]) < 0xFFFFul)
-      depths[pn_index][i] += ref_depth.depth[i];
+    if (static_cast<uint32_t>(*depth_it) + static_cast<uint32_t>(*it) < 0xFFFFul)
+      *depth_it += *it;
     else
-      depths[pn_index][i] = 0xFFFFul;
+      *depth_it = 0xFFFFul;
   }
 }
 
@@ -0,0 +1,377 @@
+#include <algorithm> // std::sort, std::lower_bound, std::upper_bound
+#include <cassert> // assert
+#include <cstdint> // uint64_t
+#include <cstdio> // std::FILE
+#include <cstdlib> // std::exit
+#include <cstring> // memcpy, memcmp, memset
+#include <iterator> // std::distance
+#include <string> // std::string
+#include <utility> // std::move
+#include <vector> // std::vector
+
+#include <fcntl.h> // ::open
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // ::close
+
+#include <boost/log/trivial.hpp>
+
+#include <graphtyper/index/hamming1_index.hpp>
+
+
+namespace
+{
+
+uint32_t const MAX_BUCKET_BITS = 24;
+char const HAMMING1_INDEX_MAGIC[8] = {'G', 'T', 'H', 'A', 'M', 'M', '1', 'X'};
+uint64_t const HAMMING1_INDEX_VERSION = 1;
+
+
+/**
+ * \brief Header of a Hamming distance 1 index file.
+ * \details It is followed by the high and low key tables of 'num_keys' k-mers each and then the high and low
+ *          directories of '2^bucket_bits + 1' entries each.
+ */
+struct Hamming1IndexHeader
+{
+  char magic[8];
+  uint64_t version;
+  uint64_t bucket_bits;
+  uint64_t num_keys;
+};
+
+/** If more k-mers than this share a half with the query, the candidates of the other half are returned instead. */
+std::size_t const MAX_SCAN_LENGTH = 48;
+
+
+uint64_t inline
+rotate_key(uint64_t const key, uint32_t const rotation)
+{
+  return rotation == 0 ? key : (key << rotation) | (key >> (64 - rotation));
+}
+
+
+/** Checks if 'x', the XOR of two 2-bit packed k-mers, has exactly one differing base. */
+bool inline
+is_one_base_difference(uint64_t const x)
+{
+  return __builtin_popcountll((x | (x >> 1)) & 0x5555555555555555ull) == 1;
+}
+
+
+std::vector<uint32_t>
+make_directory(std::vector<uint64_t> const & sorted_keys, uint32_t const bucket_bits)
+{
+  std::vector<uint32_t> directory((1ull << bucket_bits) + 1, 0u);
+
+  for (auto const key : sorted_keys)
+    ++directory[(key >> (64 - bucket_bits)) + 1];
+
+  for (std::size_t b = 1; b < directory.size(); ++b)
+    directory[b] += directory[b - 1];
+
+  assert(directory.back() == sorted_keys.size());
+  return directory;
+}
+
+
+} // anon namespace
+
+
+namespace gyper
+{
+
+Hamming1Index::Hamming1Index(Hamming1Index && mv_index) noexcept
+{
+  *this = std::move(mv_index);
+}
+
+
+Hamming1Index::~Hamming1Index()
+{
+  clear();
+}
+
+
+Hamming1Index &
+Hamming1Index::operator=(Hamming1Index && mv_index) noexcept
+{
+  if (this != &mv_index)
+  {
+    clear();
+    bucket_bits = mv_index.bucket_bits;
+    num_keys = mv_index.num_keys;
+    high_keys = mv_index.high_keys;
+    high_directory = mv_index.high_directory;
+    low_keys = mv_index.low_keys;
+    low_directory = mv_index.low_directory;
+
+    // Moving the vectors keeps their buffers, so the table pointers stay valid
+    built_high_keys = std::move(mv_index.built_high_keys);
+    built_high_directory = std::move(mv_index.built_high_directory);
+    built_low_keys = std::move(mv_index.built_low_keys);
+    built_low_directory = std::move(mv_index.built_low_directory);
+    mapped = mv_index.mapped;
+    mapped_size = mv_index.mapped_size;
+
+    mv_index.mapped = nullptr;
+    mv_index.clear();
+  }
+
+  return *this;
+}
+
+
+void
+Hamming1Index::build(std::vector<uint64_t> && keys)
+{
+  clear();
+
+  if (keys.size() == 0)
+    return;
+
+  assert(keys.size() < 0xFFFFFFFFull);
+  bucket_bits = 1;
+
+  while (bucket_bits < MAX_BUCKET_BITS && (1ull << bucket_bits) < keys.size())
+    ++bucket_bits;
+
+  built_low_keys.reserve(keys.size());
+
+  for (auto const key : keys)
+    built_low_keys.push_back(rotate_key(key, 32));
+
+  built_high_keys = std::move(keys);
+  std::sort(built_high_keys.begin(), built_high_keys.end());
+  std::sort(built_low_keys.begin(), built_low_keys.end());
+  built_high_directory = make_directory(built_high_keys, bucket_bits);
+  built_low_directory = make_directory(built_low_keys, bucket_bits);
+
+  num_keys = built_high_keys.size();
+  high_keys = built_high_keys.data();
+  high_directory = built_high_directory.data();
+  low_keys = built_low_keys.data();
+  low_directory = built_low_directory.data();
+}
+
+
+bool
+Hamming1Index::open(std::string const & path)
+{
+  clear();
+  int const fd = ::open(path.c_str(), O_RDONLY);
+
+  if (fd < 0)
+    return false;
+
+  struct stat sb;
+
+  if (fstat(fd, &sb) != 0 || static_cast<std::size_t>(sb.st_size) < sizeof(Hamming1IndexHeader))
+  {
+    BOOST_LOG_TRIVIAL(warning) << "[graphtyper::hamming1_index] Index file '" << path << "' is too small.";
+    ::close(fd);
+    return false;
+  }
+
+  void * const data = mmap(nullptr, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd); // The mapping stays valid after the file descriptor is closed
+
+  if (data == MAP_FAILED)
+  {
+    BOOST_LOG_TRIVIAL(warning) << "[graphtyper::hamming1_index] Could not memory-map index file '" << path << "'.";
+    return false;
+  }
+
+  madvise(data, sb.st_size, MADV_RANDOM);
+
+  Hamming1IndexHeader header;
+  memcpy(&header, data, sizeof(Hamming1IndexHeader));
+  std::size_t const num_directory_entries = header.bucket_bits <= MAX_BUCKET_BITS ?
+                                            (1ull << header.bucket_bits) + 1 :
+                                            0;
+  std::size_t const expected_size = sizeof(Hamming1IndexHeader) +
+                                    2 * header.num_keys * sizeof(uint64_t) +
+                                    2 * num_directory_entries * sizeof(uint32_t);
+
+  if (memcmp(header.magic, HAMMING1_INDEX_MAGIC, sizeof(HAMMING1_INDEX_MAGIC)) != 0 ||
+      header.version != HAMMING1_INDEX_VERSION ||
+      header.num_keys == 0 ||
+      num_directory_entries == 0 ||
+      expected_size != static_cast<std::size_t>(sb.st_size)
+      )
+  {
+    BOOST_LOG_TRIVIAL(warning) << "[graphtyper::hamming1_index] Index file '" << path << "' is not a valid "
+                               << "graphtyper hamming distance 1 index (version " << HAMMING1_INDEX_VERSION << ").";
+    munmap(data, sb.st_size);
+    return false;
+  }
+
+  mapped = data;
+  mapped_size = sb.st_size;
+  bucket_bits = static_cast<uint32_t>(header.bucket_bits);
+  num_keys = header.num_keys;
+  high_keys = reinterpret_cast<uint64_t const *>(static_cast<char const *>(mapped) + sizeof(Hamming1IndexHeader));
+  low_keys = high_keys + num_keys;
+  high_directory = reinterpret_cast<uint32_t const *>(low_keys + num_keys);
+  low_directory = high_directory + num_directory_entries;
+  return true;
+}
+
+
+void
+Hamming1Index::write(std::string const & path) const
+{
+  Hamming1IndexHeader header;
+  memset(&header, 0, sizeof(Hamming1IndexHeader));
+  memcpy(header.magic, HAMMING1_INDEX_MAGIC, sizeof(HAMMING1_INDEX_MAGIC));
+  header.version = HAMMING1_INDEX_VERSION;
+  header.bucket_bits = bucket_bits;
+  header.num_keys = num_keys;
+
+  std::FILE * out = std::fopen(path.c_str(), "wb");
+
+  if (!out)
+  {
+    BOOST_LOG_TRIVIAL(error) << "[graphtyper::hamming1_index] Could not open '" << path << "' for writing.";
+    std::exit(1);
+  }
+
+  std::size_t const num_directory_entries = empty() ? 0 : directory_size();
+  bool const ok = std::fwrite(&header, sizeof(Hamming1IndexHeader), 1, out) == 1 &&
+                  std::fwrite(high_keys, sizeof(uint64_t), num_keys, out) == num_keys &&
+                  std::fwrite(low_keys, sizeof(uint64_t), num_keys, out) == num_keys &&
+                  std::fwrite(high_directory, sizeof(uint32_t), num_directory_entries, out) == num_directory_entries &&
+                  std::fwrite(low_directory, sizeof(uint32_t), num_directory_entries, out) == num_directory_entries;
+
+  if (std::fclose(out) != 0 || !ok)
+  {
+    BOOST_LOG_TRIVIAL(error) << "[graphtyper::hamming1_index] Failed writing index to '" << path << "'.";
+    std::exit(1);
+  }
+}
+
+
+void
+Hamming1Index::clear()
+{
+  if (mapped)
+  {
+    munmap(mapped, mapped_size);
+    mapped = nullptr;
+    mapped_size = 0;
+  }
+
+  bucket_bits = 0;
+  num_keys = 0;
+  high_keys = nullptr;
+  high_directory = nullptr;
+  low_keys = nullptr;
+  low_directory = nullptr;
+  built_high_keys = std::vector<uint64_t>();
+  built_high_directory = std::vector<uint32_t>();
+  built_low_keys = std::vector<uint64_t>();
+  built_low_directory = std::vector<uint32_t>();
+}
+
+
+bool
+Hamming1Index::empty() const
+{
+  return num_keys == 0;
+}
+
+
+std::size_t
+Hamming1Index::size() const
+{
+  return num_keys;
+}
+
+
+std::vector<uint64_t>
+Hamming1Index::find(uint64_t const key) const
+{
+  std::vector<uint64_t> neighbours;
+
+  if (empty())
+    return neighbours;
+
+  // Neighbours with the same high half differ in bases 0-15 and are found first, which keeps the order of
+  // to_uint64_vec_hamming_distance_1
+  find_in_table(high_keys, high_directory, key, 0, neighbours);
+  find_in_table(low_keys, low_directory, rotate_key(key, 32), 32, neighbours);
+  return neighbours;
+}
+
+
+void
+Hamming1Index::find(uint64_t const key, ArenaVector<uint64_t> & neighbours) const
+{
+  if (empty())
+    return;
+
+  find_in_table(high_keys, high_directory, key, 0, neighbours);
+  find_in_table(low_keys, low_directory, rotate_key(key, 32), 32, neighbours);
+}
+
+
+std::size_t
+Hamming1Index::directory_size() const
+{
+  return (1ull << bucket_bits) + 1;
+}
+
+
+template <typename TNeighbours>
+void
+Hamming1Index::find_in_table(uint64_t const * table,
+                             uint32_t const * directory,
+                             uint64_t const rotated_key,
+                             uint32_t const rotation,
+                             TNeighbours & neighbours) const
+{
+  uint64_t const bucket = rotated_key >> (64 - bucket_bits);
+  uint64_t const half = rotated_key & 0xFFFFFFFF00000000ull;
+  uint64_t const * begin_it = std::lower_bound(table + directory[bucket], table + directory[bucket + 1], half);
+  uint64_t const * end_it = std::upper_bound(begin_it, table + directory[bucket + 1], half | 0x00000000FFFFFFFFull);
+
+  if (static_cast<std::size_t>(std::distance(begin_it, end_it)) > MAX_SCAN_LENGTH)
+  {
+    // Too many k-mers share this half, all candidates of the other half are cheaper to look up
+    for (uint64_t bb = 0; bb < 16; ++bb)
+    {
+      for (uint64_t flip = 1; flip <= 3; ++flip)
+        neighbours.push_back(rotate_key(rotated_key ^ (flip << (bb * 2)), rotation));
+    }
+
+    return;
+  }
+
+  std::size_t const old_size = neighbours.size();
+
+  for (uint64_t const * it = begin_it; it != end_it; ++it)
+  {
+    if (is_one_base_difference(*it ^ rotated_key))
+      neighbours.push_back(rotate_key(*it, rotation));
+  }
+
+  // Order by the changed base and then by the flipped bits, which is the numerical order of the XOR with the key
+  uint64_t const key = rotate_key(rotated_key, rotation);
+
+  std::sort(neighbours.begin() + old_size,
+            neighbours.end(),
+            [key](uint64_t const a, uint64_t const b)
+            {
+              return (a ^ key) < (b ^ key);
+            });
+}
+
+
+std::string
+get_hamming1_index_path(std::string const & index_path)
+{
+  return index_path + "/graphtyper_kmers_hamming1.gtm";
+}
+
+
+} // namespace gyper
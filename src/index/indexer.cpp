@@ -1,12 +1,21 @@
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <paw/station.hpp>
 
 #include <boost/log/trivial.hpp>
 
 #include <graphtyper/graph/graph.hpp>
 #include <graphtyper/graph/graph_serialization.hpp>
+#include <graphtyper/index/hamming1_index.hpp> // gyper::Hamming1Index
 #include <graphtyper/index/indexer.hpp>
+#include <graphtyper/index/mmap_index.hpp>
+#include <graphtyper/utilities/options.hpp>
 
 #include <seqan/stream.h>
 
@@ -30,8 +39,9 @@ namespace gyper
 {
 
 
+template <typename TIndex>
 void
-index_reference_label(Index<RocksDB> & new_index, TEntryList & mers, Label const & label)
+index_reference_label(TIndex & new_index, TEntryList & mers, Label const & label)
 {
   for (unsigned d = 0; d < seqan::length(label.dna); ++d)
   {
@@ -86,8 +96,9 @@ index_reference_label(Index<RocksDB> & new_index, TEntryList & mers, Label const
 }
 
 
+template <typename TIndex>
 void
-insert_variant_label(Index<RocksDB> & new_index,
+insert_variant_label(TIndex & new_index,
                      TEntryList & mers,
                      Label const & label,
                      TNodeIndex const v,
@@ -181,8 +192,9 @@ remove_large_variants_from_list(TEntryList & list, unsigned const var_count)
 }
 
 
+template <typename TIndex>
 void
-index_variant(Index<RocksDB> & new_index,
+index_variant(TIndex & new_index,
               std::vector<VarNode> const & var_nodes,
               TEntryList & mers,
               unsigned var_count,
@@ -217,6 +229,114 @@ index_variant(Index<RocksDB> & new_index,
 }
 
 
+template <typename TIndex>
+void
+index_reference_node(TIndex & new_index, TEntryList & mers, TNodeIndex const r)
+{
+  index_reference_label(new_index, mers, graph.ref_nodes[r].get_label());
+
+  if (graph.ref_nodes[r].out_degree() > 0)
+  {
+    index_variant(new_index,
+                  graph.var_nodes,
+                  mers,
+                  static_cast<int>(graph.ref_nodes[r].out_degree()),
+                  graph.ref_nodes[r].get_var_index(0)
+                  );
+  }
+}
+
+
+namespace
+{
+
+/**
+ * \brief Buffer with the same put() interface as Index<RocksDB>, which records k-mers in the order they are put.
+ */
+struct IndexChunkBuffer
+{
+  bool is_recording = false;
+  std::vector<std::pair<uint64_t, std::vector<KmerLabel> > > entries;
+
+  void
+  put(uint64_t const key, KmerLabel && label)
+  {
+    if (is_recording)
+      entries.emplace_back(key, std::vector<KmerLabel>(1, std::move(label)));
+  }
+
+  void
+  put(uint64_t const key, std::vector<KmerLabel> && labels)
+  {
+    if (is_recording)
+      entries.emplace_back(key, std::move(labels));
+  }
+};
+
+
+/**
+ * \brief A range of reference nodes which is indexed on its own thread.
+ * \details Indexing starts at 'warmup_begin' so that all k-mers which overlap the range are complete, but only
+ *          k-mers finished at or after reference node 'r_begin' are recorded.
+ */
+struct IndexChunk
+{
+  TNodeIndex warmup_begin = 0;
+  TNodeIndex r_begin = 0;
+  TNodeIndex r_end = 0;
+  IndexChunkBuffer buffer;
+};
+
+
+/**
+ * \brief Finds the reference node where indexing must start such that every path to reference node 'r' has at
+ *        least K - 1 bases, i.e. the k-mer list is the same when 'r' is reached as in a serial run.
+ */
+TNodeIndex
+get_warmup_reference_node(TNodeIndex r)
+{
+  std::size_t shortest_path = 0;
+
+  while (r > 0 && shortest_path < K - 1)
+  {
+    --r;
+    RefNode const & ref = graph.ref_nodes[r];
+    std::size_t shortest_var = 0;
+
+    if (ref.out_degree() > 0)
+    {
+      shortest_var = std::numeric_limits<std::size_t>::max();
+
+      for (unsigned i = 0; i < ref.out_degree(); ++i)
+      {
+        shortest_var = std::min(shortest_var,
+                                static_cast<std::size_t>(graph.var_nodes[ref.get_var_index(i)].get_label().dna.size()));
+      }
+    }
+
+    shortest_path += ref.get_label().dna.size() + shortest_var;
+  }
+
+  return r;
+}
+
+
+void
+index_chunk(std::shared_ptr<IndexChunk> chunk)
+{
+  TEntryList mers;
+
+  for (TNodeIndex r = chunk->warmup_begin; r < chunk->r_end; ++r)
+  {
+    chunk->buffer.is_recording = r >= chunk->r_begin;
+    index_reference_node(chunk->buffer, mers, r);
+  }
+}
+
+
+} // anon namespace
+
+
 void
 index_graph(std::string const & graph_path, std::string const & index_path)
 {
@@ -232,48 +352,98 @@ index_graph(std::string const & graph_path, std::string const & index_path)
   }
 
   assert(graph.ref_nodes.back().out_degree() == 0);
-  uint32_t const start_order = graph.ref_nodes.front().get_label().order;
-  uint32_t const end_order = static_cast<uint32_t>(graph.ref_nodes.back().get_label().order +
-      graph.ref_nodes.back().get_label().dna.size());
-  uint32_t goal_order = start_order;
-  uint32_t goal = 0;
-
-  TNodeIndex r = 0; // Reference node index
-  // TNodeIndex v = 0; // Variant node index
-  TEntryList mers;
   BOOST_LOG_TRIVIAL(info) << "[graphtyper::indexer] The number of reference nodes are " << graph.ref_nodes.size();
 
-  while (r < graph.ref_nodes.size() - 1)
+  if (Options::instance()->threads > 1)
   {
-    if (graph.ref_nodes[r].get_label().order >= goal_order)
+    // Each thread indexes its own chunk of reference nodes into a buffer. The buffers are then put into the index
+    // in the order of the chunks, so the index is exactly the same as when it is built serially.
+    std::size_t const num_ref_nodes = graph.ref_nodes.size();
+    std::size_t const INDEX_CHUNK_SIZE = std::max(static_cast<std::size_t>(1), Options::instance()->index_chunk_size);
+    std::size_t const wave_size = INDEX_CHUNK_SIZE * Options::instance()->threads;
+    BOOST_LOG_TRIVIAL(info) << "[graphtyper::indexer] Indexing with " << Options::instance()->threads << " threads.";
+
+    for (std::size_t wave_begin = 0; wave_begin < num_ref_nodes; wave_begin += wave_size)
     {
-      BOOST_LOG_TRIVIAL(info) << "[graphtyper::indexer] Indexing progress: " << goal << '%';
-      goal_order += (end_order - start_order) / 5;
-      goal += 20;
+      std::size_t const wave_end = std::min(wave_begin + wave_size, num_ref_nodes);
+      std::vector<std::shared_ptr<IndexChunk> > chunks;
+
+      {
+        paw::Station index_station(Options::instance()->threads);
+
+        for (std::size_t r_begin = wave_begin; r_begin < wave_end; r_begin += INDEX_CHUNK_SIZE)
+        {
+          std::shared_ptr<IndexChunk> chunk = std::make_shared<IndexChunk>();
+          chunk->warmup_begin = get_warmup_reference_node(r_begin);
+          chunk->r_begin = r_begin;
+          chunk->r_end = std::min(r_begin + INDEX_CHUNK_SIZE, wave_end);
+          chunks.push_back(chunk);
+          index_station.add(index_chunk, chunk);
+        }
+
+        index_station.join();
+      }
+
+      for (auto & chunk : chunks)
+      {
+        for (auto & entry : chunk->buffer.entries)
+          new_index.put(entry.first, std::move(entry.second));
+      }
+
+      BOOST_LOG_TRIVIAL(info) << "[graphtyper::indexer] Indexing progress: " << (100 * wave_end / num_ref_nodes) << '%';
     }
+  }
+  else
+  {
+    uint32_t const start_order = graph.ref_nodes.front().get_label().order;
+    uint32_t const end_order = static_cast<uint32_t>(graph.ref_nodes.back().get_label().order +
+        graph.ref_nodes.back().get_label().dna.size());
+    uint32_t goal_order = start_order;
+    uint32_t goal = 0;
 
-    index_reference_label(new_index, mers, graph.ref_nodes[r].get_label());
+    TNodeIndex r = 0; // Reference node index
+    TEntryList mers;
 
-    if (graph.ref_nodes[r].out_degree() > 0)
+    while (r < graph.ref_nodes.size() - 1)
     {
-      index_variant(new_index,
-                    graph.var_nodes,
-                    mers,
-                    static_cast<int>(graph.ref_nodes[r].out_degree()),
-                    graph.ref_nodes[r].get_var_index(0)
-                    );
+      if (graph.ref_nodes[r].get_label().order >= goal_order)
+      {
+        BOOST_LOG_TRIVIAL(info) << "[graphtyper::indexer] Indexing progress: " << goal << '%';
+        goal_order += (end_order - start_order) / 5;
+        goal += 20;
+      }
+
+      index_reference_node(new_index, mers, r);
+      ++r;
     }
 
-    ++r;
+    index_reference_label(new_index, mers, graph.ref_nodes.back().get_label());
+    BOOST_LOG_TRIVIAL(info) << "[graphtyper::indexer] Indexing progress: 100" << '%';
   }
 
-  index_reference_label(new_index, mers, graph.ref_nodes.back().get_label());
-  BOOST_LOG_TRIVIAL(info) << "[graphtyper::indexer] Indexing progress: 100" << '%';
-  mers.clear();
-
   // Commit the rest of the buffer before closing
   BOOST_LOG_TRIVIAL(info) << "[graphtyper::indexer] Writing index to disk...";
   new_index.commit();
+
+  // Write an immutable copy of the index which can be memory-mapped when calling
+  BOOST_LOG_TRIVIAL(info) << "[graphtyper::indexer] Writing memory-mapped index...";
+  write_mmap_index(new_index, get_mmap_index_path(index_path));
+
+  // Write the index for querying k-mers with hamming distance 1, so it does not need to be built when calling
+  {
+    MmapIndex written_index;
+
+    if (!written_index.open(get_mmap_index_path(index_path)))
+    {
+      BOOST_LOG_TRIVIAL(error) << "[graphtyper::indexer] Could not read back the memory-mapped index.";
+      std::exit(1);
+    }
+
+    Hamming1Index hamming1;
+    hamming1.build(written_index.table.get_keys());
+    hamming1.write(get_hamming1_index_path(index_path));
+  }
+
   BOOST_LOG_TRIVIAL(info) << "[graphtyper::indexer] Done.";
 }
 
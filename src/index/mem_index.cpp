@@ -1,7 +1,9 @@
-#include <array> // std::array
+#include <cassert> // assert
+#include <string> // std::string
+#include <utility> // std::pair, std::swap
 #include <vector> // std::vector
-#include <unordered_map> // std::unordered_map
-#include <utility>
+
+#include <boost/log/trivial.hpp> // BOOST_LOG_TRIVIAL
 
 #include <graphtyper/graph/graph.hpp> // gyper::Graph
 #include <graphtyper/index/indexer.hpp>
@@ -12,180 +14,184 @@
 namespace gyper
 {
 
+Hamming1QueryBuffers::Hamming1QueryBuffers(Arena & arena)
+  : keys(ArenaAllocator<uint64_t>(arena))
+  , key_offsets(ArenaAllocator<std::size_t>(arena))
+  , hamming1_keys(ArenaAllocator<uint64_t>(arena))
+  , hamming1_key_offsets(ArenaAllocator<std::size_t>(arena))
+  , found_slots(ArenaAllocator<KmerSlot const *>(arena))
+{}
+
+
 void
 MemIndex::load()
 {
   assert(index.hamming0.db); // Index is open
   assert(index.opened);
-  this->hamming0 = google::dense_hash_map<uint64_t, std::vector<KmerLabel> >();
+  mmap_index.close();
+  std::size_t const num_keys = build_kmer_table(index, slots, labels);
+  this->hamming0 = KmerTable(slots.data(), slots.size(), labels.data(), num_keys);
 
-  for (uint64_t key = 0; key < 0xFFFFFFFFFFFFFFFFull; ++key)
+  if (num_keys > 0)
   {
-    if (!index.exists(key))
-    {
-      empty_key = key; // Empty key is a class member
-      break;
-    }
+    // Compare to a hash map of label vectors, which has buckets at a load factor of at most 1/2 and a heap
+    // allocation of unpacked labels for each k-mer
+    std::size_t num_buckets = 32;
+
+    while (num_buckets < 2 * num_keys)
+      num_buckets *= 2;
+
+    std::size_t const MALLOC_OVERHEAD = 16;
+    std::size_t const hash_map_bytes = num_buckets * sizeof(std::pair<uint64_t, std::vector<KmerLabel> >) +
+                                       (labels.size() / PACKED_LABEL_SIZE) * sizeof(KmerLabel) +
+                                       num_keys * MALLOC_OVERHEAD;
+    std::size_t const table_bytes = slots.size() * sizeof(KmerSlot) + labels.size();
+
+    BOOST_LOG_TRIVIAL(info) << "[graphtyper::mem_index] Loaded " << num_keys << " k-mers using "
+                            << static_cast<double>(table_bytes) / num_keys << " bytes per k-mer (a hash map of "
+                            << "label vectors would use about " << static_cast<double>(hash_map_bytes) / num_keys
+                            << " bytes per k-mer).";
   }
+}
 
-  this->hamming0.set_empty_key(empty_key);
-  rocksdb::Iterator* it = index.hamming0.db->NewIterator(rocksdb::ReadOptions());
-  assert (it);
 
-  for (it->SeekToFirst(); it->Valid(); it->Next())
-  {
-    uint64_t const key = key_to_uint64_t(it->key().ToString());
-    this->hamming0[key] = value_to_labels(it->value().ToString());
-  }
-
-  assert(it->status().ok()); // Check for any errors
-  delete it;
+bool
+MemIndex::load_mmap(std::string const & mmap_index_path)
+{
+  if (!mmap_index.open(mmap_index_path))
+    return false;
+
+  // Nothing is kept in memory when the memory-mapped index is used
+  slots = std::vector<KmerSlot>();
+  labels = std::vector<char>();
+  this->hamming0 = mmap_index.table;
+  return true;
 }
 
-/*
+
 void
-MemIndex::generate_hamming1_hash_map()
+MemIndex::generate_hamming1_index()
 {
-  hamming1.clear();
-  std::vector<uint64_t> duplicate_keys;
+  hamming1.build(hamming0.get_keys());
+}
 
-  for (auto it = hamming0.begin(); it != hamming0.end(); ++it)
-  {
-    std::array<uint64_t, 96> hamming1_keys = to_uint64_vec_hamming_distance_1(it->first);
 
-    for (auto const & hamming1_key : hamming1_keys)
+void
+MemIndex::load_hamming1_index(std::string const & hamming1_index_path)
+{
+  if (hamming1.open(hamming1_index_path))
+  {
+    if (hamming1.size() == hamming0.size())
     {
-      auto find_it = hamming1.find(hamming1_key);
-
-      if (find_it == hamming1.end())
-        hamming1[hamming1_key] = it->first;
-      else
-        duplicate_keys.push_back(hamming1_key);
+      BOOST_LOG_TRIVIAL(info) << "[graphtyper::mem_index] Mapped hamming distance 1 index '"
+                              << hamming1_index_path << "'.";
+      return;
     }
+
+    BOOST_LOG_TRIVIAL(warning) << "[graphtyper::mem_index] The hamming distance 1 index '" << hamming1_index_path
+                               << "' has " << hamming1.size() << " k-mers but the k-mer index has "
+                               << hamming0.size() << ".";
   }
 
-  // Delete all duplicated keys
-  for (auto const & d_key : duplicate_keys)
-    hamming1.erase(d_key);
+  generate_hamming1_index();
 }
-*/
 
 
-std::vector<KmerLabel>
-MemIndex::get(std::vector<uint64_t> const & keys) const
+bool
+MemIndex::is_hamming1_index_available() const
 {
-  std::vector<KmerLabel> labels;
-  std::vector<google::dense_hash_map<uint64_t, std::vector<KmerLabel> >::const_iterator> results;
-
-  std::size_t num_results = 0;
+  return !hamming1.empty();
+}
 
-  for (std::size_t j = 0; j < keys.size(); ++j)
-  {
-    if (keys[j] != empty_key)
-    {
-      auto find_it = hamming0.find(keys[j]);
 
-      if (find_it != hamming0.end())
-      {
-        num_results += find_it->second.size();
+std::vector<KmerLabel>
+MemIndex::get(std::vector<uint64_t> const & keys) const
+{
+  return hamming0.get(keys);
+}
 
-        if (num_results > Options::instance()->max_index_labels)
-        {
-          // Too many results, give up on this kmer
-          results.clear();
-          break;
-        }
 
-        results.push_back(find_it);
-      }
-    }
-  }
+std::vector<std::vector<KmerLabel> >
+MemIndex::multi_get(std::vector<std::vector<uint64_t> > const & keys) const
+{
+  return hamming0.multi_get(keys);
+}
 
-  for (auto const res : results)
-    std::copy(res->second.begin(), res->second.end(), std::back_inserter(labels));
 
-  return labels;
+std::vector<std::vector<KmerLabel> >
+MemIndex::multi_get(ArenaVector<uint64_t> const & flat_keys,
+                    ArenaVector<std::size_t> const & key_offsets,
+                    Arena & arena) const
+{
+  return hamming0.multi_get(flat_keys, key_offsets, arena);
 }
 
 
 std::vector<std::vector<KmerLabel> >
-MemIndex::multi_get(std::vector<std::vector<uint64_t> > const & keys) const
+MemIndex::multi_get_hamming1(std::vector<std::vector<uint64_t> > const & keys) const
 {
   std::vector<std::vector<KmerLabel> > labels(keys.size());
-  std::vector<std::vector<google::dense_hash_map<uint64_t, std::vector<KmerLabel> >::const_iterator> > results(keys.size());
 
   for (std::size_t i = 0; i < keys.size(); ++i)
   {
-    std::size_t num_results = 0;
-
-    for (std::size_t j = 0; j < keys[i].size(); ++j)
-    {
-      if (keys[i][j] != empty_key)
-      {
-        auto find_it = hamming0.find(keys[i][j]);
-
-        if (find_it != hamming0.end())
-        {
-          num_results += find_it->second.size();
-
-          if (num_results > Options::instance()->max_index_labels)
-          {
-            // Too many results, give up on this kmer
-            results[i].clear();
-            break;
-          }
-
-          results[i].push_back(find_it);
-        }
-      }
-    }
-  }
-
-  // If there are not too many results, add them to labels and return them
-  for (std::size_t i = 0; i < results.size(); ++i)
-  {
-    for (auto const res : results[i])
-      std::copy(res->second.begin(), res->second.end(), std::back_inserter(labels[i]));
+    // If the key is not unique, the keys themselves are queried as there are no keys with hamming distance 1
+    if (keys[i].size() != 1)
+      labels[i] = get(keys[i]);
+    else
+      labels[i] = get(hamming1.find(keys[i][0]));
   }
 
+  assert(keys.size() == labels.size());
   return labels;
 }
 
 
 std::vector<std::vector<KmerLabel> >
-MemIndex::multi_get_hamming1(std::vector<std::vector<uint64_t> > const & keys) const
+MemIndex::multi_get_hamming1(Hamming1QueryBuffers & buffers) const
 {
-  std::vector<std::vector<KmerLabel> > labels(keys.size());
+  assert(buffers.key_offsets.size() > 0);
+  std::size_t const num_kmers = buffers.key_offsets.size() - 1;
+  buffers.hamming1_keys.clear();
+  buffers.hamming1_key_offsets.clear();
 
-  for (std::size_t i = 0; i < keys.size(); ++i)
+  for (std::size_t i = 0; i < num_kmers; ++i)
   {
-    for (std::size_t j = 0; j < keys[i].size(); ++j)
+    std::size_t const begin = buffers.key_offsets[i];
+    std::size_t const end = buffers.key_offsets[i + 1];
+    buffers.hamming1_key_offsets.push_back(buffers.hamming1_keys.size());
+
+    // If the key is not unique, the keys themselves are queried as there are no keys with hamming distance 1
+    if (end - begin != 1)
     {
-      auto find_it = hamming1.find(keys[i][j]);
-
-      if (find_it != hamming1.end())
-      {
-        auto hamming0_find_it = hamming0.find(find_it->second);
-        assert(hamming0_find_it != hamming0.end());
-        std::copy(hamming0_find_it->second.begin(), hamming0_find_it->second.end(), std::back_inserter(labels[i]));
-      }
+      buffers.hamming1_keys.insert(buffers.hamming1_keys.end(),
+                                   buffers.keys.begin() + begin,
+                                   buffers.keys.begin() + end);
     }
+    else
+      hamming1.find(buffers.keys[begin], buffers.hamming1_keys);
   }
 
-  assert(keys.size() == labels.size());
-  return labels;
+  buffers.hamming1_key_offsets.push_back(buffers.hamming1_keys.size());
+  return hamming0.multi_get(buffers.hamming1_keys, buffers.hamming1_key_offsets, buffers.found_slots);
 }
 
 
 MemIndex
 load_secondary_mem_index(std::string const & secondary_index_path, Graph & secondary_graph)
 {
+  MemIndex secondary_mem_index;
+
+  if (secondary_mem_index.load_mmap(get_mmap_index_path(secondary_index_path)))
+  {
+    secondary_mem_index.load_hamming1_index(get_hamming1_index_path(secondary_index_path));
+    return secondary_mem_index;
+  }
+
   // Swap graphs
   std::swap(graph, secondary_graph);
 
   Index<RocksDB> secondary_index = load_secondary_index(secondary_index_path);
   std::swap(index, secondary_index);
-  MemIndex secondary_mem_index;
   secondary_mem_index.load();
   std::swap(index, secondary_index);
   secondary_index.close();
@@ -193,6 +199,7 @@ load_secondary_mem_index(std::string const & secondary_index_path, Graph & secon
   // Swap graphs back to the way they were
   std::swap(graph, secondary_graph);
 
+  secondary_mem_index.generate_hamming1_index();
   return secondary_mem_index;
 }
 
@@ -0,0 +1,500 @@
+#include <cassert> // assert
+#include <cstdio> // std::FILE
+#include <cstdlib> // std::exit
+#include <cstring> // memcpy
+#include <string> // std::string
+#include <utility> // std::move
+#include <vector> // std::vector
+
+#include <fcntl.h> // ::open
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // ::close
+
+#include <boost/log/trivial.hpp>
+
+#include <graphtyper/graph/graph.hpp> // gyper::graph
+#include <graphtyper/index/mmap_index.hpp>
+#include <graphtyper/index/rocksdb.hpp> // gyper::RocksDB
+#include <graphtyper/utilities/options.hpp> // gyper::Options
+
+
+namespace
+{
+
+char const MMAP_INDEX_MAGIC[8] = {'G', 'T', 'K', 'M', 'E', 'R', 'I', 'X'};
+uint64_t const MMAP_INDEX_VERSION = 1;
+uint64_t const MAX_LABEL_COUNT = 0x0000000000FFFFFFull;
+
+/** How many lookups ahead slots and labels are prefetched in batch queries. */
+std::size_t const PREFETCH_DISTANCE = 16;
+
+} // anon namespace
+
+
+namespace gyper
+{
+
+MmapIndex::MmapIndex(MmapIndex && mv_index) noexcept
+{
+  *this = std::move(mv_index);
+}
+
+
+MmapIndex::~MmapIndex()
+{
+  close();
+}
+
+
+MmapIndex &
+MmapIndex::operator=(MmapIndex && mv_index) noexcept
+{
+  if (this != &mv_index)
+  {
+    close();
+    data = mv_index.data;
+    data_size = mv_index.data_size;
+    table = mv_index.table;
+
+    mv_index.data = nullptr;
+    mv_index.data_size = 0;
+    mv_index.table = KmerTable();
+  }
+
+  return *this;
+}
+
+
+bool
+MmapIndex::open(std::string const & path)
+{
+  close();
+  int const fd = ::open(path.c_str(), O_RDONLY);
+
+  if (fd < 0)
+    return false;
+
+  struct stat sb;
+
+  if (fstat(fd, &sb) != 0 || static_cast<std::size_t>(sb.st_size) < sizeof(MmapIndexHeader))
+  {
+    BOOST_LOG_TRIVIAL(error) << "[graphtyper::mmap_index] Index file '" << path << "' is too small.";
+    ::close(fd);
+    return false;
+  }
+
+  void * mapped = mmap(nullptr, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd); // The mapping stays valid after the file descriptor is closed
+
+  if (mapped == MAP_FAILED)
+  {
+    BOOST_LOG_TRIVIAL(error) << "[graphtyper::mmap_index] Could not memory-map index file '" << path << "'.";
+    return false;
+  }
+
+  // Lookups are random, read-ahead would only pollute the page cache
+  madvise(mapped, sb.st_size, MADV_RANDOM);
+
+  MmapIndexHeader header;
+  memcpy(&header, mapped, sizeof(MmapIndexHeader));
+
+  std::size_t const expected_size = sizeof(MmapIndexHeader) +
+                                    header.num_slots * sizeof(KmerSlot) +
+                                    header.num_labels * PACKED_LABEL_SIZE;
+
+  if (memcmp(header.magic, MMAP_INDEX_MAGIC, sizeof(MMAP_INDEX_MAGIC)) != 0 ||
+      header.version != MMAP_INDEX_VERSION ||
+      header.num_slots == 0 ||
+      (header.num_slots & (header.num_slots - 1)) != 0 ||
+      expected_size != static_cast<std::size_t>(sb.st_size)
+      )
+  {
+    BOOST_LOG_TRIVIAL(error) << "[graphtyper::mmap_index] Index file '" << path << "' is not a valid "
+                             << "graphtyper index file (version " << MMAP_INDEX_VERSION << ").";
+    munmap(mapped, sb.st_size);
+    return false;
+  }
+
+  data = mapped;
+  data_size = sb.st_size;
+  KmerSlot const * slots =
+    reinterpret_cast<KmerSlot const *>(static_cast<char const *>(data) + sizeof(MmapIndexHeader));
+  char const * labels = reinterpret_cast<char const *>(slots + header.num_slots);
+  table = KmerTable(slots, header.num_slots, labels, header.num_keys);
+
+  BOOST_LOG_TRIVIAL(info) << "[graphtyper::mmap_index] Mapped index '" << path << "' with " << header.num_keys
+                          << " k-mers and " << header.num_labels << " labels.";
+  return true;
+}
+
+
+void
+MmapIndex::close()
+{
+  if (data)
+  {
+    munmap(data, data_size);
+    data = nullptr;
+    data_size = 0;
+    table = KmerTable();
+  }
+}
+
+
+bool
+MmapIndex::is_open() const
+{
+  return data != nullptr;
+}
+
+
+KmerTable::KmerTable(KmerSlot const * _slots,
+                     uint64_t const num_slots,
+                     char const * _labels,
+                     std::size_t const _num_keys)
+  : slots(_slots)
+  , slot_mask(num_slots - 1)
+  , labels(_labels)
+  , num_keys(_num_keys)
+{
+  assert(num_slots > 0 && (num_slots & (num_slots - 1)) == 0);
+}
+
+
+bool
+KmerTable::empty() const
+{
+  return slots == nullptr;
+}
+
+
+std::size_t
+KmerTable::size() const
+{
+  return num_keys;
+}
+
+
+KmerSlot const *
+KmerTable::find(uint64_t const key) const
+{
+  if (empty())
+    return nullptr;
+
+  uint64_t s = kmer_slot_hash(key, slot_mask);
+
+  while (kmer_slot_count(slots[s]) != 0)
+  {
+    if (slots[s].key == key)
+      return &slots[s];
+
+    s = (s + 1) & slot_mask;
+  }
+
+  return nullptr;
+}
+
+
+std::vector<KmerLabel>
+KmerTable::get(std::vector<uint64_t> const & keys) const
+{
+  std::vector<KmerLabel> results;
+  std::vector<KmerSlot const *> found_slots;
+  std::size_t num_results = 0;
+
+  for (std::size_t j = 0; j < keys.size(); ++j)
+  {
+    KmerSlot const * slot = find(keys[j]);
+
+    if (slot)
+    {
+      num_results += kmer_slot_count(*slot);
+
+      if (num_results > Options::instance()->max_index_labels)
+        return results; // Too many results, give up on this kmer
+
+      found_slots.push_back(slot);
+    }
+  }
+
+  results.reserve(num_results);
+
+  for (auto const slot : found_slots)
+    append_packed_labels(labels + kmer_slot_offset(*slot) * PACKED_LABEL_SIZE, kmer_slot_count(*slot), results);
+
+  return results;
+}
+
+
+std::vector<std::vector<KmerLabel> >
+KmerTable::multi_get(std::vector<std::vector<uint64_t> > const & keys) const
+{
+  // Flatten the keys so we can prefetch across read k-mers
+  std::vector<uint64_t> flat_keys;
+  std::vector<std::size_t> key_offsets;
+  std::size_t num_keys = 0;
+
+  for (auto const & read_keys : keys)
+    num_keys += read_keys.size();
+
+  flat_keys.reserve(num_keys);
+  key_offsets.reserve(keys.size() + 1);
+
+  for (auto const & read_keys : keys)
+  {
+    key_offsets.push_back(flat_keys.size());
+    flat_keys.insert(flat_keys.end(), read_keys.begin(), read_keys.end());
+  }
+
+  key_offsets.push_back(flat_keys.size());
+  std::vector<KmerSlot const *> found_slots(flat_keys.size(), nullptr);
+  return multi_get(flat_keys.data(), key_offsets.data(), keys.size(), found_slots.data());
+}
+
+
+std::vector<std::vector<KmerLabel> >
+KmerTable::multi_get(ArenaVector<uint64_t> const & flat_keys,
+                     ArenaVector<std::size_t> const & key_offsets,
+                     Arena & arena) const
+{
+  assert(key_offsets.size() > 0);
+  ArenaVector<KmerSlot const *> found_slots{ArenaAllocator<KmerSlot const *>(arena)};
+  return multi_get(flat_keys, key_offsets, found_slots);
+}
+
+
+std::vector<std::vector<KmerLabel> >
+KmerTable::multi_get(ArenaVector<uint64_t> const & flat_keys,
+                     ArenaVector<std::size_t> const & key_offsets,
+                     ArenaVector<KmerSlot const *> & found_slots) const
+{
+  assert(key_offsets.size() > 0);
+  found_slots.resize(flat_keys.size()); // Every slot is assigned by the lookups
+  return multi_get(flat_keys.data(), key_offsets.data(), key_offsets.size() - 1, found_slots.data());
+}
+
+
+std::vector<std::vector<KmerLabel> >
+KmerTable::multi_get(uint64_t const * flat_keys,
+                     std::size_t const * key_offsets,
+                     std::size_t const num_kmers,
+                     KmerSlot const ** found_slots) const
+{
+  std::vector<std::vector<KmerLabel> > results(num_kmers);
+
+  if (empty())
+    return results;
+
+  // Find the slots of all keys
+  std::size_t const num_keys = key_offsets[num_kmers];
+
+  for (std::size_t i = 0; i < num_keys; ++i)
+  {
+    if (i + PREFETCH_DISTANCE < num_keys)
+      __builtin_prefetch(&slots[kmer_slot_hash(flat_keys[i + PREFETCH_DISTANCE], slot_mask)]);
+
+    found_slots[i] = find(flat_keys[i]);
+  }
+
+  // Decode the labels of each read k-mer, giving up on read k-mers which have too many labels
+  for (std::size_t i = 0; i < num_kmers; ++i)
+  {
+    if (i + PREFETCH_DISTANCE < num_kmers)
+    {
+      for (std::size_t j = key_offsets[i + PREFETCH_DISTANCE]; j < key_offsets[i + PREFETCH_DISTANCE + 1]; ++j)
+      {
+        if (found_slots[j])
+          __builtin_prefetch(labels + kmer_slot_offset(*found_slots[j]) * PACKED_LABEL_SIZE);
+      }
+    }
+
+    std::size_t num_results = 0;
+
+    for (std::size_t j = key_offsets[i]; j < key_offsets[i + 1]; ++j)
+    {
+      if (found_slots[j])
+        num_results += kmer_slot_count(*found_slots[j]);
+    }
+
+    if (num_results == 0 || num_results > Options::instance()->max_index_labels)
+      continue;
+
+    results[i].reserve(num_results);
+
+    for (std::size_t j = key_offsets[i]; j < key_offsets[i + 1]; ++j)
+    {
+      if (found_slots[j])
+      {
+        append_packed_labels(labels + kmer_slot_offset(*found_slots[j]) * PACKED_LABEL_SIZE,
+                             kmer_slot_count(*found_slots[j]),
+                             results[i]);
+      }
+    }
+  }
+
+  return results;
+}
+
+
+std::vector<uint64_t>
+KmerTable::get_keys() const
+{
+  std::vector<uint64_t> keys;
+  keys.reserve(num_keys);
+
+  for (uint64_t s = 0; !empty() && s <= slot_mask; ++s)
+  {
+    if (kmer_slot_count(slots[s]) != 0)
+      keys.push_back(slots[s].key);
+  }
+
+  return keys;
+}
+
+
+void
+append_packed_labels(char const * data, std::size_t const count, std::vector<KmerLabel> & labels)
+{
+  for (std::size_t i = 0; i < count; ++i, data += PACKED_LABEL_SIZE)
+  {
+    KmerLabel label;
+    memcpy(&label.start_index, data, sizeof(uint32_t));
+    memcpy(&label.end_index, data + sizeof(uint32_t), sizeof(uint32_t));
+    memcpy(&label.variant_id, data + sizeof(uint32_t) + sizeof(uint32_t), sizeof(uint32_t));
+
+    if (label.variant_id != INVALID_ID)
+    {
+      label.variant_num = graph.get_variant_num(label.variant_id);
+      label.variant_order = graph.var_nodes[label.variant_id].get_label().order;
+    }
+
+    labels.push_back(label);
+  }
+}
+
+
+std::size_t
+build_kmer_table(Index<RocksDB> const & rocksdb_index, std::vector<KmerSlot> & slots, std::vector<char> & labels)
+{
+  assert(rocksdb_index.hamming0.db);
+  std::size_t num_keys = 0;
+  std::size_t num_labels = 0;
+
+  // First pass counts the k-mers and labels, so the table and label blob can be allocated once
+  {
+    rocksdb::Iterator * it = rocksdb_index.hamming0.db->NewIterator(rocksdb::ReadOptions());
+    assert(it);
+
+    for (it->SeekToFirst(); it->Valid(); it->Next())
+    {
+      assert(it->value().size() % PACKED_LABEL_SIZE == 0);
+      std::size_t const count = it->value().size() / PACKED_LABEL_SIZE;
+
+      if (count == 0)
+        continue;
+
+      if (count > MAX_LABEL_COUNT)
+      {
+        BOOST_LOG_TRIVIAL(error) << "[graphtyper::mmap_index] A k-mer has " << count << " labels, which is more "
+                                 << "than the maximum of " << MAX_LABEL_COUNT << " in a k-mer table.";
+        std::exit(1);
+      }
+
+      ++num_keys;
+      num_labels += count;
+    }
+
+    assert(it->status().ok());
+    delete it;
+  }
+
+  // Use a load factor of at most 2/3
+  uint64_t num_slots = 16;
+
+  while (num_slots * 2 < num_keys * 3)
+    num_slots *= 2;
+
+  uint64_t const slot_mask = num_slots - 1;
+  slots.assign(num_slots, KmerSlot{0ull, 0ull});
+  labels.clear();
+  labels.reserve(num_labels * PACKED_LABEL_SIZE);
+
+  // Second pass inserts the k-mers and copies their labels in the order they are stored
+  {
+    rocksdb::Iterator * it = rocksdb_index.hamming0.db->NewIterator(rocksdb::ReadOptions());
+    assert(it);
+
+    for (it->SeekToFirst(); it->Valid(); it->Next())
+    {
+      uint64_t const count = it->value().size() / PACKED_LABEL_SIZE;
+
+      if (count == 0)
+        continue;
+
+      uint64_t const key = key_to_uint64_t(it->key().ToString());
+      uint64_t s = kmer_slot_hash(key, slot_mask);
+
+      while (kmer_slot_count(slots[s]) != 0)
+        s = (s + 1) & slot_mask;
+
+      slots[s].key = key;
+      slots[s].offset_count = (count << 40) | (labels.size() / PACKED_LABEL_SIZE);
+      labels.insert(labels.end(), it->value().data(), it->value().data() + it->value().size());
+    }
+
+    assert(it->status().ok());
+    delete it;
+  }
+
+  assert(labels.size() == num_labels * PACKED_LABEL_SIZE);
+  return num_keys;
+}
+
+
+std::string
+get_mmap_index_path(std::string const & index_path)
+{
+  return index_path + "/graphtyper_kmers.gtm";
+}
+
+
+void
+write_mmap_index(Index<RocksDB> const & rocksdb_index, std::string const & path)
+{
+  std::vector<KmerSlot> slots;
+  std::vector<char> labels;
+  std::size_t const num_keys = build_kmer_table(rocksdb_index, slots, labels);
+
+  MmapIndexHeader header;
+  memset(&header, 0, sizeof(MmapIndexHeader));
+  memcpy(header.magic, MMAP_INDEX_MAGIC, sizeof(MMAP_INDEX_MAGIC));
+  header.version = MMAP_INDEX_VERSION;
+  header.num_slots = slots.size();
+  header.num_keys = num_keys;
+  header.num_labels = labels.size() / PACKED_LABEL_SIZE;
+
+  std::FILE * out = std::fopen(path.c_str(), "wb");
+
+  if (!out)
+  {
+    BOOST_LOG_TRIVIAL(error) << "[graphtyper::mmap_index] Could not open '" << path << "' for writing.";
+    std::exit(1);
+  }
+
+  bool const ok = std::fwrite(&header, sizeof(MmapIndexHeader), 1, out) == 1 &&
+                  std::fwrite(slots.data(), sizeof(KmerSlot), slots.size(), out) == slots.size() &&
+                  std::fwrite(labels.data(), 1, labels.size(), out) == labels.size();
+
+  if (std::fclose(out) != 0 || !ok)
+  {
+    BOOST_LOG_TRIVIAL(error) << "[graphtyper::mmap_index] Failed writing index to '" << path << "'.";
+    std::exit(1);
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "[graphtyper::mmap_index] Wrote " << header.num_keys << " k-mers and "
+                          << header.num_labels << " labels to '" << path << "'.";
+}
+
+
+} // namespace gyper
@@ -472,6 +472,14 @@ parse_output_all_variants(args::Flag & arg)
 }
 
 
+/** Copy the BGZF blocks of VCFs when concatenating */
+std::unique_ptr<args::Flag>
+add_arg_copy_blocks(args::ArgumentParser & parser)
+{
+  return std::unique_ptr<args::Flag>(new args::Flag(parser, "COPY_BLOCKS", "Set to concatenate sorted BGZF compressed VCFs with the same contigs and samples by copying their compressed blocks. Only the header of the first VCF is kept and the records are not reparsed.", {"copy_blocks"}));
+}
+
+
 /** Skip VCF sorting */
 std::unique_ptr<args::Flag>
 add_arg_no_sort(args::ArgumentParser & parser)
@@ -666,6 +674,40 @@ parse_read_chunk_size(TChunkSize & read_chunk_size_arg)
 }
 
 
+/** Only variant windows argument */
+std::unique_ptr<args::Flag>
+add_arg_only_variant_windows(args::ArgumentParser & parser)
+{
+  return std::unique_ptr<args::Flag>(new args::Flag(parser, "ONLY_VARIANT_WINDOWS", "Set to only read alignments near the variants of the graph. Only used with --no_new_variants.", {"only_variant_windows"}));
+}
+
+
+void
+parse_only_variant_windows(args::Flag & arg)
+{
+  if (arg)
+    gyper::Options::instance()->only_variant_windows = true;
+}
+
+
+/** Max open files argument */
+using TMaxOpenFiles = args::ValueFlag<unsigned long>;
+
+std::unique_ptr<TMaxOpenFiles>
+add_arg_max_open_files(args::ArgumentParser & parser)
+{
+  return std::unique_ptr<TMaxOpenFiles>(new TMaxOpenFiles(parser, "N", "Maximum number of SAM/BAM/CRAM files which are read concurrently.", {"max_open_files"}));
+}
+
+
+void
+parse_max_open_files(TMaxOpenFiles & max_open_files_arg)
+{
+  if (max_open_files_arg)
+    gyper::Options::instance()->max_open_files = args::get(max_open_files_arg);
+}
+
+
 /** Filelist argument */
 using TFileList = args::ValueFlag<std::string>;
 
@@ -762,6 +804,22 @@ parse_always_query_hamming_distance_one(args::Flag & arg)
 }
 
 
+/** single_orientation argument */
+std::unique_ptr<args::Flag>
+add_arg_single_orientation(args::ArgumentParser & parser)
+{
+  return std::unique_ptr<args::Flag>(new args::Flag(parser, "SINGLE_ORIENTATION", "Set to align reads only in the orientation given by their strand flags, or by their seeds if the strand is unknown.", {"single_orientation"}));
+}
+
+
+void
+parse_single_orientation(args::Flag & arg)
+{
+  if (arg)
+    gyper::Options::instance()->single_orientation_alignment = true;
+}
+
+
 /** Max extracted haplotypes argument */
 using TMaxExtractH = args::ValueFlag<unsigned long>;
 
@@ -938,10 +996,12 @@ main(int argc, char ** argv)
     auto graph_arg = add_arg_graph(index_parser);
     auto index_arg = add_arg_index(index_parser);
     auto log_arg = add_arg_log(index_parser);
+    auto threads_arg = add_arg_threads(index_parser);
 
     parse_command_line(index_parser, argc, argv);
 
     parse_log(*log_arg);
+    parse_threads(*threads_arg);
 
     bool SUCCESS = true;
     SUCCESS &= check_required_argument(command_arg, "command");
@@ -989,16 +1049,19 @@ main(int argc, char ** argv)
     //auto maximum_homozygous_allele_balance_arg = add_arg_maximum_homozygous_allele_balance(call_parser);
     auto epsilon_0_exponent_arg = add_arg_epsilon_0_exponent(call_parser);
     auto no_new_variants_arg = add_arg_no_new_variants(call_parser);
+    auto only_variant_windows_arg = add_arg_only_variant_windows(call_parser);
     auto hq_reads_arg = add_arg_hq_reads(call_parser);
     auto is_perfect_alignments_only_arg = add_arg_is_perfect_alignments_only(call_parser);
     auto output_all_variants_arg = add_arg_output_all_variants(call_parser);
     auto read_chunk_size_arg = add_arg_read_chunk_size(call_parser);
+    auto max_open_files_arg = add_arg_max_open_files(call_parser);
     auto output_arg = add_arg_output_dir(call_parser);
     auto threads_arg = add_arg_threads(call_parser);
     auto get_sample_names_from_filename_arg = add_arg_get_sample_names_from_filename(call_parser);
     auto phased_arg = add_arg_phased(call_parser);
 //    auto ref_vs_all_arg = add_arg_ref_vs_all(call_parser);
     auto always_query_hamming_distance_one_arg = add_arg_always_query_hamming_distance_one(call_parser);
+    auto single_orientation_arg = add_arg_single_orientation(call_parser);
     auto one_genotype_per_haplotype_arg = add_arg_one_genotype_per_haplotype(call_parser);
     // auto use_read_cache_arg = add_arg_use_read_cache(call_parser);
     auto suffix_id_arg = add_arg_suffix_id(call_parser);
@@ -1008,6 +1071,7 @@ main(int argc, char ** argv)
     parse_log(*log_arg);
     parse_threads(*threads_arg);
     parse_read_chunk_size(*read_chunk_size_arg);
+    parse_max_open_files(*max_open_files_arg);
     // parse_use_read_cache(*use_read_cache_arg);
     parse_minimum_variant_support(*minimum_variant_support_arg);
     parse_minimum_variant_support_ratio(*minimum_variant_support_ratio_arg);
@@ -1023,12 +1087,14 @@ main(int argc, char ** argv)
     parse_get_sample_names_from_filename(*get_sample_names_from_filename_arg);
     // parse_gather_unmapped(*gather_unmapped_arg);
     parse_no_new_variants(*no_new_variants_arg);
+    parse_only_variant_windows(*only_variant_windows_arg);
     parse_hq_reads(*hq_reads_arg);
     parse_is_perfect_alignments_only(*is_perfect_alignments_only_arg);
     parse_output_all_variants(*output_all_variants_arg);
     parse_phased(*phased_arg);
 //    parse_ref_vs_all(*ref_vs_all_arg);
     parse_always_query_hamming_distance_one(*always_query_hamming_distance_one_arg);
+    parse_single_orientation(*single_orientation_arg);
     parse_one_genotype_per_haplotype(*one_genotype_per_haplotype_arg);
     parse_suffix_id(*suffix_id_arg);
 
@@ -1350,6 +1416,7 @@ main(int argc, char ** argv)
     auto no_sort_arg = add_arg_no_sort(vcf_concatenate_parser);
     auto region_arg = add_arg_region_val(vcf_concatenate_parser);
     auto sites_only_arg = add_arg_sites_only(vcf_concatenate_parser);
+    auto copy_blocks_arg = add_arg_copy_blocks(vcf_concatenate_parser);
 
     parse_command_line(vcf_concatenate_parser, argc, argv);
 
@@ -1375,7 +1442,7 @@ main(int argc, char ** argv)
     if (*region_arg)
       region = args::get(*region_arg);
 
-    gyper::vcf_concatenate(args::get(*vcfs_arg), output, *no_sort_arg, *sites_only_arg, region);
+    gyper::vcf_concatenate(args::get(*vcfs_arg), output, *no_sort_arg, *sites_only_arg, region, *copy_blocks_arg);
   }
   else if (std::string(argv[1]) == std::string("vcf_break_down"))
   {
@@ -1,7 +1,11 @@
 #include <array>
+#include <atomic> // std::atomic
 #include <chrono>
 #include <ctime>
 #include <mutex>
+#include <string> // std::string
+#include <unordered_map> // std::unordered_map
+#include <unordered_set> // std::unordered_set
 
 #include <boost/log/trivial.hpp>
 
@@ -13,6 +17,7 @@
 
 #include <graphtyper/graph/graph_serialization.hpp>
 #include <graphtyper/typer/alignment.hpp>
+#include <graphtyper/utilities/arena.hpp>
 #include <graphtyper/utilities/kmer_help_functions.hpp>
 #include <graphtyper/utilities/io.hpp>
 #include <graphtyper/utilities/options.hpp>
@@ -22,29 +27,6 @@
 namespace
 {
 
-bool
-is_clipped(seqan::String<seqan::CigarElement<> > const & cigar)
-{
-  return seqan::length(cigar) == 0 ||
-    cigar[0].operation == 'S' ||
-    cigar[0].operation == 'H' ||
-    cigar[seqan::length(cigar) - 1].operation == 'S' ||
-    cigar[seqan::length(cigar) - 1].operation == 'H';
-}
-
-
-long
-get_original_position(seqan::BamAlignmentRecord const & record)
-{
-  long pos = record.beginPos + 1;
-
-  if (seqan::length(record.cigar) > 0 && record.cigar[0].operation == 'S')
-    pos -= record.cigar[0].count;
-
-  return pos;
-}
-
-
 void
 merge_index_queries(seqan::IupacString const & read,
                     gyper::GenotypePaths & geno,
@@ -139,6 +121,8 @@ merge_index_queries(seqan::IupacString const & read,
 void
 find_genotype_paths_of_one_of_the_sequences(seqan::IupacString const & read,
                                             gyper::GenotypePaths & geno,
+                                            gyper::TKmerLabels const & r_hamming0,
+                                            gyper::Hamming1QueryBuffers & hamming1_buffers,
                                             bool const hamming_distance1_index_available,
                                             gyper::Graph const & graph = gyper::graph,
                                             gyper::MemIndex const & mem_index = gyper::mem_index
@@ -146,13 +130,12 @@ find_genotype_paths_of_one_of_the_sequences(seqan::IupacString const & read,
 {
   using namespace gyper;
 
-  TKmerLabels r_hamming0 = query_index(read, mem_index);
   TKmerLabels r_hamming1;
 
   /*if (true || Options::instance()->always_query_hamming_distance_one)*/
   {
     if (hamming_distance1_index_available)
-      r_hamming1 = query_index_hamming_distance1(read);
+      r_hamming1 = query_index_hamming_distance1(read, hamming1_buffers, mem_index);
     else
       r_hamming1 = query_index_hamming_distance1_without_index(read, mem_index);
 
@@ -167,7 +150,7 @@ find_genotype_paths_of_one_of_the_sequences(seqan::IupacString const & read,
     if (geno.longest_path_size() < ((3 * K) - 2))
     {
       if (hamming_distance1_index_available)
-        r_hamming1 = query_index_hamming_distance1(read);
+        r_hamming1 = query_index_hamming_distance1(read, hamming1_buffers, mem_index);
       else
         r_hamming1 = query_index_hamming_distance1_without_index(read, mem_index);
 
@@ -178,38 +161,231 @@ find_genotype_paths_of_one_of_the_sequences(seqan::IupacString const & read,
 }
 
 
-std::string
-get_read_group(seqan::BamTagsDict const & tags_dict)
+/** Checks if the first or the last k-mer of a sequence is in the index. */
+bool
+has_seed(seqan::IupacString const & seq)
 {
-  unsigned tagIdx = 0;
-  std::string read_group("NA");
+  using namespace gyper;
+
+  if (seqan::length(seq) < K)
+    return false;
+
+  return query_index_for_first_kmer(seq).size() > 0 || query_index_for_last_kmer(seq).size() > 0;
+}
+
+
+/** Probes the first and last k-mers of the sequences in both orientations to find which orientations seed. */
+uint8_t
+get_seeded_orientations(seqan::IupacString const & seq1, seqan::IupacString const & seq2)
+{
+  using namespace gyper;
+
+  uint8_t orientations = 0;
 
-  if (seqan::findTagKey(tagIdx, tags_dict, "RG"))
+  if (has_seed(seq1) || has_seed(seq2))
+    orientations |= ALIGN_FORWARD;
+
+  seqan::IupacString rc_seq1(seq1);
+  seqan::IupacString rc_seq2(seq2);
+  seqan::reverseComplement(rc_seq1);
+  seqan::reverseComplement(rc_seq2);
+
+  if (has_seed(rc_seq1) || has_seed(rc_seq2))
+    orientations |= ALIGN_REVERSE;
+
+  // Align both orientations if neither or both seed
+  return orientations == 0 ? ALIGN_BOTH : orientations;
+}
+
+
+/** Creates genotype paths of a read pair which is not aligned in some orientation. */
+std::pair<gyper::GenotypePaths, gyper::GenotypePaths>
+get_unaligned_pair(gyper::SamRead const & record1, gyper::SamRead const & record2)
+{
+  return std::make_pair(
+    gyper::GenotypePaths(record1.seq, record1.qual, record1.mapq),
+    gyper::GenotypePaths(record2.seq, record2.qual, record2.mapq)
+    );
+}
+
+
+/**
+ * \brief Gets the reference positions of the start or the end of each path of a read.
+ * \details The positions of path 'i' are 'ref_positions[offsets[i]]' to 'ref_positions[offsets[i + 1] - 1]'.
+ */
+void
+get_reference_positions_of_paths(gyper::GenotypePaths const & geno,
+                                 bool const is_start,
+                                 std::vector<uint32_t> & ref_positions,
+                                 std::vector<std::size_t> & offsets
+  )
+{
+  offsets.reserve(geno.paths.size() + 1);
+
+  for (auto const & path : geno.paths)
   {
-    seqan::CharString read_group_raw;
+    offsets.push_back(ref_positions.size());
+    std::vector<gyper::Location> const locs =
+      gyper::graph.get_locations_of_a_position(is_start ? path.start : path.end, path);
 
-    if (seqan::extractTagValue(read_group_raw, tags_dict, tagIdx))
-      read_group = std::string(seqan::toCString(read_group_raw));
+    for (auto const & loc : locs)
+      ref_positions.push_back(gyper::graph.get_reference_position_of_location(loc));
   }
 
-  return read_group;
+  offsets.push_back(ref_positions.size());
 }
 
 
-uint16_t
-get_alignment_score_difference(seqan::BamTagsDict const & tags_dict)
+/** Number of sequences aligned and the number of them whose paths were copied from an identical sequence. */
+std::atomic<uint64_t> num_aligned_sequences(0);
+std::atomic<uint64_t> num_cached_sequences(0);
+
+
+/** Paths of a distinct sequence in a batch. */
+struct CachedPaths
 {
-  unsigned tagIdx = 0;
-  int alignment_score = 0;
-  int secondary_score = 0;
+  std::vector<gyper::Path> paths;
+  uint32_t longest_path_length = 0;
+  bool is_aligned = false;
+};
+
 
-  if (seqan::findTagKey(tagIdx, tags_dict, "AS"))
-    seqan::extractTagValue(alignment_score, tags_dict, tagIdx);
+/** Hashes the sequence at an index of a vector of sequences, so sequences can be looked up without copying them. */
+struct SequenceHash
+{
+  std::vector<seqan::IupacString> const * sequences;
+
+  std::size_t
+  operator()(std::size_t const i) const
+  {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+
+    for (auto it = seqan::begin((*sequences)[i]); it != seqan::end((*sequences)[i]); ++it)
+      h = (h ^ seqan::ordValue(*it)) * 1099511628211ull;
+
+    return static_cast<std::size_t>(h);
+  }
+};
+
+
+struct SequenceEqual
+{
+  std::vector<seqan::IupacString> const * sequences;
+
+  bool
+  operator()(std::size_t const i, std::size_t const j) const
+  {
+    return (*sequences)[i] == (*sequences)[j];
+  }
+};
+
+
+/**
+ * \brief The distinct sequences of a batch of reads, in the orientations they are aligned in.
+ * \details Identical sequences, e.g. duplicates in amplicon or high coverage data, are seeded once. The paths of the
+ *          first of them are copied to the others, which skips the index queries and the DFS in the graph.
+ */
+class BatchSequences
+{
+public:
+  explicit BatchSequences(gyper::Arena & arena);
+
+  /** \brief Adds the next sequence to be aligned. */
+  void add(seqan::IupacString && seq);
+
+  /** \brief Queries the k-mers of all distinct sequences. */
+  void query_index();
+
+  /** \brief Finds the genotype paths of the 'b'-th added sequence, 'read'. */
+  void find_genotype_paths(std::size_t const b, seqan::IupacString const & read, gyper::GenotypePaths & geno);
+
+  void add_to_statistics() const;
+
+private:
+  gyper::Arena & arena;
+  gyper::ArenaVector<std::size_t> indexes; /** \brief Index of the distinct sequence of each added sequence. */
+  std::vector<seqan::IupacString> sequences;
+  gyper::ArenaVector<uint32_t> counts;
+  std::unordered_set<std::size_t, SequenceHash, SequenceEqual> distinct_indexes; /** \brief Indexes of 'sequences'. */
+  std::vector<gyper::TKmerLabels> labels;
+  gyper::Hamming1QueryBuffers hamming1_buffers;
+  std::vector<CachedPaths> cache;
+  uint64_t num_hits = 0;
+};
+
+
+BatchSequences::BatchSequences(gyper::Arena & _arena)
+  : arena(_arena)
+  , indexes(gyper::ArenaAllocator<std::size_t>(arena))
+  , counts(gyper::ArenaAllocator<uint32_t>(arena))
+  , distinct_indexes(0, SequenceHash{&sequences}, SequenceEqual{&sequences})
+  , hamming1_buffers(arena)
+{}
+
+
+void
+BatchSequences::add(seqan::IupacString && seq)
+{
+  // The sequence is looked up by its index, so it is added first and removed again if it is a duplicate
+  sequences.push_back(std::move(seq));
+  auto insert_it = distinct_indexes.insert(sequences.size() - 1);
+
+  if (insert_it.second)
+    counts.push_back(0);
+  else
+    sequences.pop_back();
+
+  indexes.push_back(*insert_it.first);
+  ++counts[indexes.back()];
+}
+
+
+void
+BatchSequences::query_index()
+{
+  labels = gyper::query_index_batch(sequences, arena);
+  cache.resize(sequences.size());
+  distinct_indexes.clear();
+}
+
+
+void
+BatchSequences::find_genotype_paths(std::size_t const b, seqan::IupacString const & read, gyper::GenotypePaths & geno)
+{
+  assert(b < indexes.size());
+  std::size_t const i = indexes[b];
+  CachedPaths & cached = cache[i];
+
+  if (cached.is_aligned)
+  {
+    ++num_hits;
+    geno.paths = cached.paths;
+    geno.longest_path_length = cached.longest_path_length;
+    return;
+  }
+
+  find_genotype_paths_of_one_of_the_sequences(read,
+                                              geno,
+                                              labels[i],
+                                              hamming1_buffers,
+                                              gyper::mem_index.is_hamming1_index_available());
+
+  // Only sequences which are seen again are kept
+  if (counts[i] > 1)
+  {
+    cached.paths = geno.paths;
+    cached.longest_path_length = geno.longest_path_length;
+    cached.is_aligned = true;
+  }
+}
 
-  if (seqan::findTagKey(tagIdx, tags_dict, "XS"))
-    seqan::extractTagValue(secondary_score, tags_dict, tagIdx);
 
-  return std::max(static_cast<int>(0), alignment_score - secondary_score);
+void
+BatchSequences::add_to_statistics() const
+{
+  num_aligned_sequences += indexes.size();
+  num_cached_sequences += num_hits;
 }
 
 
@@ -219,47 +395,120 @@ get_alignment_score_difference(seqan::BamTagsDict const & tags_dict)
 namespace gyper
 {
 
+/**
+ * \brief Gets the orientations in which an unpaired read is aligned.
+ * \details The sequence of the read is in its sequenced orientation, so a read which was mapped to the reverse
+ *          strand matches the graph when it is reverse complemented.
+ */
+uint8_t
+get_orientations_to_align(SamRead const & record)
+{
+  if (!Options::instance()->single_orientation_alignment)
+    return ALIGN_BOTH;
+
+  if (!record.is_unmapped())
+    return record.is_reverse() ? ALIGN_REVERSE : ALIGN_FORWARD;
+
+  return get_seeded_orientations(record.seq, seqan::IupacString());
+}
+
+
+/**
+ * \brief Gets the orientations in which a read pair is aligned.
+ * \details The second read has been reverse complemented to the strand of the first read, so the pair is reverse
+ *          complemented if the first read was mapped to the reverse strand or the second read to the forward strand.
+ *          Seeds are probed if neither read is mapped or the reads were mapped to the same strand.
+ */
+uint8_t
+get_orientations_to_align(SamRead const & record1, SamRead const & record2)
+{
+  if (!Options::instance()->single_orientation_alignment)
+    return ALIGN_BOTH;
+
+  uint8_t strand_orientations = 0;
+
+  if (!record1.is_unmapped())
+    strand_orientations |= record1.is_reverse() ? ALIGN_REVERSE : ALIGN_FORWARD;
+
+  if (!record2.is_unmapped())
+    strand_orientations |= record2.is_reverse() ? ALIGN_FORWARD : ALIGN_REVERSE;
+
+  if (strand_orientations == ALIGN_FORWARD || strand_orientations == ALIGN_REVERSE)
+    return strand_orientations;
+
+  return get_seeded_orientations(record1.seq, record2.seq);
+}
+
+
 void
 align_unpaired_read_pairs(TReads & reads, std::vector<GenotypePaths> & genos)
 {
-  for (auto read_it = reads.begin(); read_it != reads.end(); ++read_it)
+  // Nothing from the previous batch is used anymore
+  Arena & arena = batch_arena();
+  arena.reset();
+
+  // Query the k-mers of all reads, in the orientations they are aligned in, in a single batch
+  ArenaVector<uint8_t> orientations{ArenaAllocator<uint8_t>(arena)};
+  BatchSequences sequences(arena);
+  orientations.reserve(reads.size());
+
+  for (auto read_it = reads.cbegin(); read_it != reads.cend(); ++read_it)
   {
-    GenotypePaths geno1(read_it->first.seq, read_it->first.qual, read_it->first.mapQ);
+    orientations.push_back(get_orientations_to_align(read_it->first));
 
-    find_genotype_paths_of_one_of_the_sequences(
-      read_it->first.seq,
-      geno1,
-      false /*No hamming1 distance index*/
-    );
+    if ((orientations.back() & ALIGN_FORWARD) != 0)
+      sequences.add(seqan::IupacString(read_it->first.seq));
+
+    if ((orientations.back() & ALIGN_REVERSE) != 0)
+    {
+      seqan::IupacString rc_seq(read_it->first.seq);
+      seqan::reverseComplement(rc_seq);
+      sequences.add(std::move(rc_seq));
+    }
+  }
+
+  sequences.query_index();
+
+  std::size_t b = 0;
+  auto orientation_it = orientations.cbegin();
+
+  for (auto read_it = reads.begin(); read_it != reads.end(); ++read_it, ++orientation_it)
+  {
+    // Reads which are not aligned in an orientation keep an empty genotype path in that orientation
+    GenotypePaths geno1(read_it->first.seq, read_it->first.qual, read_it->first.mapq);
+
+    if ((*orientation_it & ALIGN_FORWARD) != 0)
+    {
+      sequences.find_genotype_paths(b, read_it->first.seq, geno1);
+      ++b;
+    }
 
     seqan::reverseComplement(read_it->first.seq);
     seqan::reverse(read_it->first.qual);
-    GenotypePaths geno2(read_it->first.seq, read_it->first.qual, read_it->first.mapQ);
+    GenotypePaths geno2(read_it->first.seq, read_it->first.qual, read_it->first.mapq);
 
-    find_genotype_paths_of_one_of_the_sequences(
-      read_it->first.seq,
-      geno2,
-      false /*No hamming1 distance index*/
-      );
+    if ((*orientation_it & ALIGN_REVERSE) != 0)
+    {
+      sequences.find_genotype_paths(b, read_it->first.seq, geno2);
+      ++b;
+    }
 
     switch (compare_pair_of_genotype_paths(geno1, geno2))
     {
     case 1:
       // geno1.forward_strand is true by default
-      geno1.is_first_in_pair = seqan::hasFlagFirst(read_it->first);
-      geno1.is_originally_unaligned = seqan::hasFlagUnmapped(read_it->first);
-      geno1.original_pos = get_original_position(read_it->first);
+      geno1.is_first_in_pair = read_it->first.is_first();
+      geno1.is_originally_unaligned = read_it->first.is_unmapped();
+      geno1.original_pos = read_it->first.get_original_position();
 
-      geno1.is_originally_clipped = seqan::hasFlagUnmapped(read_it->first) ||
-        is_clipped(read_it->first.cigar);
+      geno1.is_originally_clipped = read_it->first.is_unmapped() ||
+        read_it->first.is_clipped;
 
       if (Options::instance()->stats.size() > 0)
       {
-        geno1.details->query_name = seqan::toCString(read_it->first.qName);
-        seqan::CharString tags_cp(read_it->first.tags);
-        seqan::BamTagsDict tags_dict(tags_cp);
-        geno1.details->read_group = ::get_read_group(tags_dict);
-        geno1.details->score_diff = ::get_alignment_score_difference(tags_dict);
+        geno1.details->query_name = read_it->first.name;
+        geno1.details->read_group = read_it->first.read_group;
+        geno1.details->score_diff = read_it->first.score_diff;
       }
 
       genos.push_back(std::move(geno1));
@@ -267,26 +516,26 @@ align_unpaired_read_pairs(TReads & reads, std::vector<GenotypePaths> & genos)
 
     case 2:
       geno2.forward_strand = false;
-      geno2.is_first_in_pair = seqan::hasFlagFirst(read_it->first);
-      geno2.is_originally_unaligned = seqan::hasFlagUnmapped(read_it->first);
-      geno2.original_pos = get_original_position(read_it->first); // Change to 1-based system
+      geno2.is_first_in_pair = read_it->first.is_first();
+      geno2.is_originally_unaligned = read_it->first.is_unmapped();
+      geno2.original_pos = read_it->first.get_original_position(); // Change to 1-based system
 
-      geno2.is_originally_clipped = seqan::hasFlagUnmapped(read_it->first) ||
-        is_clipped(read_it->first.cigar);
+      geno2.is_originally_clipped = read_it->first.is_unmapped() ||
+        read_it->first.is_clipped;
 
       if (Options::instance()->stats.size() > 0)
       {
-        geno2.details->query_name = seqan::toCString(read_it->first.qName);
-        seqan::CharString tags_cp(read_it->first.tags);
-        seqan::BamTagsDict tags_dict(tags_cp);
-        geno2.details->read_group = ::get_read_group(tags_dict);
-        geno2.details->score_diff = ::get_alignment_score_difference(tags_dict);
+        geno2.details->query_name = read_it->first.name;
+        geno2.details->read_group = read_it->first.read_group;
+        geno2.details->score_diff = read_it->first.score_diff;
       }
 
       genos.push_back(std::move(geno2));
       break;
     }
   }
+
+  sequences.add_to_statistics();
 }
 
 
@@ -332,20 +581,42 @@ find_shortest_distance(GenotypePaths const & geno1,
                        bool const REVERSE_COMPLEMENT
   )
 {
+  // The locations of each path do not depend on the paths of the other read, so they are only found once
+  std::vector<uint32_t> ref_positions1;
+  std::vector<std::size_t> offsets1;
+  std::vector<uint32_t> ref_positions2;
+  std::vector<std::size_t> offsets2;
+  ::get_reference_positions_of_paths(geno1, !REVERSE_COMPLEMENT /*is_start*/, ref_positions1, offsets1);
+  ::get_reference_positions_of_paths(geno2, REVERSE_COMPLEMENT /*is_start*/, ref_positions2, offsets2);
+
+  int64_t const OPTIMAL_DISTANCE = OPTIMAL;
   int64_t shortest_distance_diff = 0x00000000FFFFFFFFll;
   int64_t shortest_distance = 0x00000000FFFFFFFFll;
 
-  for (auto it1 = geno1.paths.cbegin(); it1 != geno1.paths.cend(); ++it1)
+  for (std::size_t p1 = 0; p1 < geno1.paths.size(); ++p1)
   {
-    for (auto it2 = geno2.paths.cbegin(); it2 != geno2.paths.cend(); ++it2)
+    for (std::size_t p2 = 0; p2 < geno2.paths.size(); ++p2)
     {
-      long const distance = get_insert_size(it1, it2, OPTIMAL, REVERSE_COMPLEMENT);
-      long const distance_diff = std::llabs(distance - static_cast<long>(OPTIMAL));
-
-      if (distance_diff < shortest_distance_diff)
+      for (std::size_t i = offsets1[p1]; i < offsets1[p1 + 1]; ++i)
       {
-        shortest_distance_diff = distance_diff;
-        shortest_distance = distance;
+        for (std::size_t j = offsets2[p2]; j < offsets2[p2 + 1]; ++j)
+        {
+          int64_t const distance = REVERSE_COMPLEMENT ?
+                                   static_cast<int64_t>(ref_positions1[i]) - static_cast<int64_t>(ref_positions2[j]) :
+                                   static_cast<int64_t>(ref_positions2[j]) - static_cast<int64_t>(ref_positions1[i]);
+
+          int64_t const distance_diff = std::llabs(distance - OPTIMAL_DISTANCE);
+
+          if (distance_diff < shortest_distance_diff)
+          {
+            // No other distance can be closer to the optimal insert size
+            if (distance_diff == 0)
+              return distance;
+
+            shortest_distance_diff = distance_diff;
+            shortest_distance = distance;
+          }
+        }
       }
     }
   }
@@ -501,7 +772,7 @@ bool
 support_same_path(std::pair<GenotypePaths, GenotypePaths> const & genos)
 {
   // Variant order to explain
-  using ReadExplain = std::unordered_map<uint32_t, std::bitset<MAX_NUMBER_OF_HAPLOTYPES> >;
+  using ReadExplain = std::unordered_map<uint32_t, CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> >;
   ReadExplain read_explain1;
   ReadExplain read_explain2;
 
@@ -533,48 +804,35 @@ support_same_path(std::pair<GenotypePaths, GenotypePaths> const & genos)
 
 
 std::pair<GenotypePaths, GenotypePaths>
-find_genotype_paths_of_a_sequence_pair(seqan::BamAlignmentRecord const & record1,
-                                       seqan::BamAlignmentRecord const & record2,
+find_genotype_paths_of_a_sequence_pair(SamRead const & record1,
+                                       SamRead const & record2,
+                                       BatchSequences & sequences,
+                                       std::size_t const b,
                                        bool const REVERSE_COMPLEMENT
                                        )
 {
   // Create two empty paths, one for each read
   std::pair<GenotypePaths, GenotypePaths> genos =
-    std::make_pair(GenotypePaths(record1.seq, record1.qual, static_cast<uint8_t>(record1.mapQ)),
-                   GenotypePaths(record2.seq, record2.qual, static_cast<uint8_t>(record2.mapQ))
+    std::make_pair(GenotypePaths(record1.seq, record1.qual, record1.mapq),
+                   GenotypePaths(record2.seq, record2.qual, record2.mapq)
                    );
 
   // Add read group and read name if statistics should be in the output
   if (Options::instance()->stats.size() > 0)
   {
     // First read
-    //genos.first.query_name = seqan::toCString(record1.qName);
-    genos.first.details->query_name = seqan::toCString(record1.qName);
-    seqan::CharString tags_cp(record1.tags);
-    seqan::BamTagsDict tags_dict(tags_cp);
-    genos.first.details->read_group = ::get_read_group(tags_dict);
-    genos.first.details->score_diff = ::get_alignment_score_difference(tags_dict);
+    genos.first.details->query_name = record1.name;
+    genos.first.details->read_group = record1.read_group;
+    genos.first.details->score_diff = record1.score_diff;
 
     // Second read
-    //genos.second.query_name = seqan::toCString(record2.qName);
-    genos.second.details->query_name = seqan::toCString(record2.qName);
-    tags_cp = record2.tags;
-    tags_dict = seqan::BamTagsDict(tags_cp);
-    genos.second.details->read_group = ::get_read_group(tags_dict);
-    genos.second.details->score_diff = ::get_alignment_score_difference(tags_dict);
+    genos.second.details->query_name = record2.name;
+    genos.second.details->read_group = record2.read_group;
+    genos.second.details->score_diff = record2.score_diff;
   }
 
-  find_genotype_paths_of_one_of_the_sequences(
-    record1.seq,
-    genos.first,
-    false /*true when hamming distance 1 index is available*/
-    );
-
-  find_genotype_paths_of_one_of_the_sequences(
-    record2.seq,
-    genos.second,
-    false /*true when hamming distance 1 index is available*/
-    );
+  sequences.find_genotype_paths(b, record1.seq, genos.first);
+  sequences.find_genotype_paths(b + 1, record2.seq, genos.second);
 
   // Remove distant paths (from optimal insert size)
   if (genos.first.paths.size() > 0 && genos.second.paths.size() > 0) // Both reads aligned
@@ -659,65 +917,150 @@ align_paired_reads(std::vector<TReadPair> const & records)
 {
   std::vector<std::pair<GenotypePaths, GenotypePaths> > genos;
 
+  // Nothing from the previous batch is used anymore
+  Arena & arena = batch_arena();
+  arena.reset();
+
+  // Query the k-mers of all reads, in the orientations they are aligned in, in a single batch
+  ArenaVector<uint8_t> orientations{ArenaAllocator<uint8_t>(arena)};
+  BatchSequences sequences(arena);
+  orientations.reserve(records.size());
+
   for (auto record_it = records.cbegin(); record_it != records.cend(); ++record_it)
   {
-    std::pair<GenotypePaths, GenotypePaths> genos1 =
-      find_genotype_paths_of_a_sequence_pair(record_it->first,
-                                             record_it->second,
-                                             false /*REVERSE_COMPLEMENT*/
+    orientations.push_back(get_orientations_to_align(record_it->first, record_it->second));
+
+    if ((orientations.back() & ALIGN_FORWARD) != 0)
+    {
+      sequences.add(seqan::IupacString(record_it->first.seq));
+      sequences.add(seqan::IupacString(record_it->second.seq));
+    }
+
+    if ((orientations.back() & ALIGN_REVERSE) != 0)
+    {
+      seqan::IupacString rc_seq1(record_it->first.seq);
+      seqan::reverseComplement(rc_seq1);
+      sequences.add(std::move(rc_seq1));
+      seqan::IupacString rc_seq2(record_it->second.seq);
+      seqan::reverseComplement(rc_seq2);
+      sequences.add(std::move(rc_seq2));
+    }
+  }
+
+  sequences.query_index();
+
+  std::size_t b = 0;
+  auto orientation_it = orientations.cbegin();
+
+  for (auto record_it = records.cbegin(); record_it != records.cend(); ++record_it, ++orientation_it)
+  {
+    // Pairs which are not aligned in an orientation keep empty genotype paths in that orientation
+    std::pair<GenotypePaths, GenotypePaths> genos1;
+
+    if ((*orientation_it & ALIGN_FORWARD) != 0)
+    {
+      genos1 = find_genotype_paths_of_a_sequence_pair(record_it->first,
+                                                      record_it->second,
+                                                      sequences,
+                                                      b,
+                                                      false /*REVERSE_COMPLEMENT*/
+        );
+
+      b += 2;
+    }
+    else
+    {
+      genos1 = ::get_unaligned_pair(record_it->first, record_it->second);
+    }
+
+    std::pair<GenotypePaths, GenotypePaths> genos2;
+
+    if ((*orientation_it & ALIGN_REVERSE) != 0)
+    {
+      SamRead rec_first(record_it->first);
+      SamRead rec_second(record_it->second);
+      seqan::reverseComplement(rec_first.seq);
+      seqan::reverse(rec_first.qual);
+      seqan::reverseComplement(rec_second.seq);
+      seqan::reverse(rec_second.qual);
+      genos2 = find_genotype_paths_of_a_sequence_pair(rec_first,
+                                                      rec_second,
+                                                      sequences,
+                                                      b,
+                                                      true /*REVERSE_COMPLEMENT*/
         );
 
-    seqan::BamAlignmentRecord rec_first(record_it->first);
-    seqan::BamAlignmentRecord rec_second(record_it->second);
-    seqan::reverseComplement(rec_first.seq);
-    seqan::reverse(rec_first.qual);
-    seqan::reverseComplement(rec_second.seq);
-    seqan::reverse(rec_second.qual);
-    std::pair<GenotypePaths, GenotypePaths> genos2 =
-      find_genotype_paths_of_a_sequence_pair(rec_first, rec_second, true /*REVERSE_COMPLEMENT*/);
+      b += 2;
+    }
+    else
+    {
+      genos2 = ::get_unaligned_pair(record_it->first, record_it->second);
+    }
 
     switch (compare_pair_of_genotype_paths(genos1, genos2))
     {
     case 1:
       // The second read in pair has been reverse complemented
       genos1.second.forward_strand = false;
-      genos1.first.is_originally_unaligned = seqan::hasFlagUnmapped(record_it->first);
-      genos1.second.is_originally_unaligned = seqan::hasFlagUnmapped(record_it->second);
+      genos1.first.is_originally_unaligned = record_it->first.is_unmapped();
+      genos1.second.is_originally_unaligned = record_it->second.is_unmapped();
 
-      genos1.first.is_originally_clipped = seqan::hasFlagUnmapped(record_it->first) ||
-        is_clipped(record_it->first.cigar);
+      genos1.first.is_originally_clipped = record_it->first.is_unmapped() ||
+        record_it->first.is_clipped;
 
-      genos1.second.is_originally_clipped = seqan::hasFlagUnmapped(record_it->second) ||
-        is_clipped(record_it->second.cigar);
+      genos1.second.is_originally_clipped = record_it->second.is_unmapped() ||
+        record_it->second.is_clipped;
 
       genos1.second.is_first_in_pair = false;
-      genos1.first.original_pos = get_original_position(record_it->first);
-      genos1.second.original_pos = get_original_position(record_it->second);
+      genos1.first.original_pos = record_it->first.get_original_position();
+      genos1.second.original_pos = record_it->second.get_original_position();
       genos.push_back(std::move(genos1));
       break;
 
     case 2:
       // The first read in pair has been reverse complemented
       genos2.first.forward_strand = false;
-      genos2.first.is_originally_unaligned = seqan::hasFlagUnmapped(record_it->first);
-      genos2.second.is_originally_unaligned = seqan::hasFlagUnmapped(record_it->second);
+      genos2.first.is_originally_unaligned = record_it->first.is_unmapped();
+      genos2.second.is_originally_unaligned = record_it->second.is_unmapped();
 
-      genos2.first.is_originally_clipped = seqan::hasFlagUnmapped(record_it->first) ||
-        is_clipped(record_it->first.cigar);
+      genos2.first.is_originally_clipped = record_it->first.is_unmapped() ||
+        record_it->first.is_clipped;
 
-      genos2.second.is_originally_clipped = seqan::hasFlagUnmapped(record_it->second) ||
-        is_clipped(record_it->second.cigar);
+      genos2.second.is_originally_clipped = record_it->second.is_unmapped() ||
+        record_it->second.is_clipped;
 
       genos2.second.is_first_in_pair = false;
-      genos2.first.original_pos = get_original_position(record_it->first);
-      genos2.second.original_pos = get_original_position(record_it->second);
+      genos2.first.original_pos = record_it->first.get_original_position();
+      genos2.second.original_pos = record_it->second.get_original_position();
       genos.push_back(std::move(genos2));
       break;
     }
   }
 
+  sequences.add_to_statistics();
   return genos;
 }
 
 
+void
+get_read_cache_statistics(uint64_t & num_aligned, uint64_t & num_cached)
+{
+  num_aligned = num_aligned_sequences;
+  num_cached = num_cached_sequences;
+}
+
+
+void
+log_read_cache_statistics()
+{
+  uint64_t num_aligned;
+  uint64_t num_cached;
+  get_read_cache_statistics(num_aligned, num_cached);
+
+  BOOST_LOG_TRIVIAL(info) << "[graphtyper::alignment] Paths of " << num_cached << " out of " << num_aligned
+                          << " aligned sequences were copied from an identical sequence ("
+                          << (num_aligned > 0 ? 100.0 * num_cached / num_aligned : 0.0) << "%).";
+}
+
+
 } // namespace gyper
@@ -1,13 +1,14 @@
+#include <algorithm> // std::max, std::min
+#include <atomic> // std::atomic
 #include <cassert> // assert
-#include <list> // std::list
+#include <functional> // std::cref, std::ref
 #include <memory> // std::shared_ptr
 #include <sstream> // std::ostringstream
 #include <string> // std::string
+#include <thread> // std::thread
 #include <unordered_map> // std::unordered_map
 #include <vector> // std::vector
 
-#include <paw/station.hpp>
-
 #include <seqan/basic.h>
 #include <seqan/sequence.h>
 #include <seqan/seq_io.h>
@@ -29,6 +30,7 @@
 #include <graphtyper/typer/discovery.hpp>
 #include <graphtyper/typer/graph_swapper.hpp>
 #include <graphtyper/typer/genotype_paths.hpp> // gyper::GenotypePaths
+#include <graphtyper/typer/read_pipeline.hpp> // gyper::ReadPipeline
 #include <graphtyper/typer/segment_calling.hpp>
 #include <graphtyper/typer/variant_support.hpp>
 #include <graphtyper/typer/vcf.hpp>
@@ -38,85 +40,55 @@
 #include <graphtyper/utilities/options.hpp> // gyper::Options
 
 
-// gyper::TReads is defined in sam_reader.hpp
-
-namespace gyper
+namespace
 {
 
+/**
+ * \brief Reads SAM/BAM/CRAM files in batches and adds them to the pipeline.
+ * \details Files are taken from 'hts_paths' until none are left, so several threads can share the files. Each batch
+ *          is tagged with the index of its file, which is the index of its sample.
+ */
 void
-caller(std::shared_ptr<TReads> reads,
-       std::shared_ptr<VcfWriter> writer,
-       std::shared_ptr<std::size_t const> pn_index
-       )
+read_hts_files(std::vector<std::string> const & hts_paths,
+               std::vector<std::string> const & regions,
+               unsigned const decompression_threads,
+               std::atomic<std::size_t> & next_file,
+               gyper::ReadPipeline & pipeline)
 {
-  assert(reads->size() > 0);
-
-  // Check if the reads are paired
-  if (seqan::length((*reads)[0].second.seq) == 0)
-  {
-    // Do not process unpaired reads when calling segments
-    if (!Options::instance()->is_segment_calling &&
-        !Options::instance()->hq_reads
-        )
-    {
-      // The reads are unpaired
-      std::vector<GenotypePaths> genos;
-      align_unpaired_read_pairs(*reads, genos);
-
-      if (!Options::instance()->no_new_variants)
-      {
-        std::vector<VariantCandidate> variants = discover_variants(genos);
-        global_varmap.add_variants(std::move(variants), *pn_index);
-      }
-
-      if (!Options::instance()->no_new_variants || graph.is_sv_graph)
-      {
-        // Add reference depth
-        ReferenceDepth reference_depth;
-
-        for (auto const & geno : genos)
-          reference_depth.add_genotype_paths(geno);
+  using namespace gyper;
 
-        global_reference_depth.add_reference_depths_from(reference_depth, *pn_index);
-      }
+  std::size_t const READ_BATCH_SIZE = Options::instance()->read_chunk_size;
 
-      writer->update_haplotype_scores_from_paths(genos, *pn_index);
-    }
-  }
-  else
+  for (std::size_t i = next_file++; i < hts_paths.size(); i = next_file++)
   {
-    std::vector<std::pair<GenotypePaths, GenotypePaths> > geno_pairs =
-      align_paired_reads(*reads);
+    SamReader sam_reader(hts_paths[i], regions, decompression_threads);
 
-    if (!Options::instance()->no_new_variants)
-    {
-      std::vector<VariantCandidate> variants = discover_variants(geno_pairs);
-      global_varmap.add_variants(std::move(variants), *pn_index);
-    }
+    // Flush logs
+    if (Options::instance()->sink)
+      Options::instance()->sink->flush();
 
-    if (!Options::instance()->no_new_variants || graph.is_sv_graph)
+    while (true)
     {
-      // Add reference depth
-      ReferenceDepth reference_depth;
+      ReadBatch batch;
+      batch.reads = sam_reader.read_N_reads(READ_BATCH_SIZE);
+      batch.pn_index = i;
 
-      for (auto const & geno : geno_pairs)
-      {
-        reference_depth.add_genotype_paths(geno.first);
-        reference_depth.add_genotype_paths(geno.second);
-      }
+      // A batch with no reads means all reads of this file have been read
+      if (batch.reads.size() == 0)
+        break;
 
-      global_reference_depth.add_reference_depths_from(reference_depth, *pn_index);
+      pipeline.add(std::move(batch));
     }
-
-    writer->update_haplotype_scores_from_paths(geno_pairs, *pn_index);
   }
-
-  // The reads are no longer needed, let the memory free
-  reads->clear();
-  reads->shrink_to_fit();
 }
 
 
+} // anon namespace
+
+
+namespace gyper
+{
+
 void
 read_samples(std::unordered_map<std::string, std::string> & rg2sample,
              std::vector<std::string> & samples,
@@ -188,10 +160,21 @@ call(std::vector<std::string> const & hts_paths,
   }
 
   load_graph(graph_path); // Loads the graph into the global variable 'graph'
-  load_index(index_path); // Loads the index into the global variable 'index'
-  mem_index.load(); // Loads the in-memory index
-  //mem_index.generate_hamming1_hash_map(); // Generate a hashmap with edit distance 1
-  index.close(); // Close the RocksDB index, we will use the in-memory index for querying reads
+
+  // Prefer the memory-mapped index, it needs no loading and is shared between processes on the same host
+  if (!mem_index.load_mmap(get_mmap_index_path(index_path)))
+  {
+    BOOST_LOG_TRIVIAL(info) << "[graphtyper::caller] No memory-mapped index found, loading the RocksDB index.";
+    load_index(index_path); // Loads the index into the global variable 'index'
+    mem_index.load(); // Loads the in-memory index
+    index.close(); // Close the RocksDB index, we will use the in-memory index for querying reads
+    mem_index.generate_hamming1_index(); // Generate an index for querying k-mers with hamming distance 1
+  }
+  else
+  {
+    // The index for querying k-mers with hamming distance 1 is written along with the memory-mapped index
+    mem_index.load_hamming1_index(get_hamming1_index_path(index_path));
+  }
 
   // Increasing variant distance can increase computational time and file sizes of *.hap files.
   std::shared_ptr<VcfWriter> writer;
@@ -219,9 +202,6 @@ call(std::vector<std::string> const & hts_paths,
   }
 
   {
-    std::size_t const READ_BATCH_SIZE = Options::instance()->read_chunk_size;
-    std::list<std::shared_ptr<TReads> > reads;
-
     if (!Options::instance()->no_new_variants)
     {
       // Only use varmap when discovering new variants
@@ -231,40 +211,61 @@ call(std::vector<std::string> const & hts_paths,
     if (!Options::instance()->no_new_variants || graph.is_sv_graph)
       global_reference_depth.set_pn_count(samples.size());
 
-    std::vector<std::shared_ptr<std::size_t> > pn_indexes;
+    std::vector<std::string> read_regions = regions;
 
+    // Without variant discovery, only reads near variants can change the calls
+    if (Options::instance()->no_new_variants &&
+        Options::instance()->only_variant_windows &&
+        !(regions.size() == 1 && regions[0] == std::string(".")))
     {
-      paw::Station caller_station(Options::instance()->threads, 3 /*queue size*/);
-      caller_station.options.verbosity = 2; // Print messages
+      read_regions = graph.get_variant_regions(MAX_READ_LENGTH + Options::instance()->max_insert_size);
+      BOOST_LOG_TRIVIAL(info) << "[graphtyper::caller] Reading alignments in " << read_regions.size()
+                              << " windows around variants.";
+    }
 
-      for (long i = 0; i < static_cast<long>(hts_paths.size()); ++i)
+    if (read_regions.size() > 0)
+    {
+      // Alignment is the bottleneck, so the pipeline's workers get every thread the readers do not need. There is a
+      // reader for each input file, up to half of --threads. This thread is the first reader, like it was the only
+      // reader before, so only the other readers and the small BGZF decompression pools are taken from --threads.
+      unsigned const THREADS = Options::instance()->threads;
+      unsigned const MAX_DECOMPRESSION_THREADS = 2; // Per reader
+      std::size_t const NUM_READERS = std::max(static_cast<std::size_t>(1),
+                                               std::min({Options::instance()->max_open_files,
+                                                         hts_paths.size(),
+                                                         static_cast<std::size_t>(THREADS / 2)}));
+
+      unsigned const DECOMPRESSION_THREADS =
+        std::min(MAX_DECOMPRESSION_THREADS, THREADS / (8u * static_cast<unsigned>(NUM_READERS))); // 1 per 8 threads
+
+      unsigned const READ_THREADS = static_cast<unsigned>(NUM_READERS - 1) +
+                                    static_cast<unsigned>(NUM_READERS) * DECOMPRESSION_THREADS;
+
+      std::size_t const NUM_WORKERS = std::max(1u, THREADS - READ_THREADS);
+
+      // Batches are read by the reader threads, aligned and scored by the pipeline's workers
+      ReadPipeline pipeline(*writer, NUM_WORKERS, NUM_WORKERS + 1 /*queue size*/);
+      std::atomic<std::size_t> next_file(0);
+      std::vector<std::thread> readers;
+
+      for (std::size_t r = 1; r < NUM_READERS; ++r)
       {
-        SamReader sam_reader(hts_paths[i], regions);
-
-        // Flush logs
-        if (Options::instance()->sink)
-          Options::instance()->sink->flush();
-
-        while (true)
-        {
-          pn_indexes.push_back(std::make_shared<std::size_t>(i));
-          reads.push_back(std::make_shared<TReads>(sam_reader.read_N_reads(READ_BATCH_SIZE)));
-
-          if (reads.back()->size() > 0)
-          {
-            caller_station.add(caller, reads.back(), writer, pn_indexes.back());
-          }
-          else
-          {
-            // Remove the batch with no reads
-            reads.pop_back();
-            pn_indexes.pop_back();
-            break;
-          }
-        }
+        readers.emplace_back(read_hts_files,
+                             std::cref(hts_paths),
+                             std::cref(read_regions),
+                             DECOMPRESSION_THREADS,
+                             std::ref(next_file),
+                             std::ref(pipeline));
       }
 
-      caller_station.join();
+      // This thread is a reader as well
+      read_hts_files(hts_paths, read_regions, DECOMPRESSION_THREADS, next_file, pipeline);
+
+      for (auto & reader : readers)
+        reader.join();
+
+      pipeline.join();
+      log_read_cache_statistics();
     }
   }
 
@@ -506,7 +507,7 @@ discover_directly_from_bam(std::string const & graph_path,
     seqan::HtsFile hts(sam.c_str(), "r");
     seqan::BamAlignmentRecord record;
     gyper::ReferenceDepth ref_depth;
-    ref_depth.depth.resize(REGION_SIZE);
+    ref_depth.depth_size = REGION_SIZE; // Unlike resize_depth(), the reference offset is kept at 0
 
     while (seqan::readRecord(record, hts))
     {
@@ -455,7 +455,7 @@ GenotypePaths::extend_paths_at_sv_breakpoints(seqan::IupacString const & seqan_r
 
           // Set bitset
           {
-            std::bitset<MAX_NUMBER_OF_HAPLOTYPES> num;
+            CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> num;
 
             for (long i = 1; i < static_cast<long>(ref_node.out_degree()); ++i)
               num.set(i);
@@ -1,4 +1,3 @@
-#include <bitset> // std::bitset<Size>
 #include <vector> // std::vector<Type>
 
 #include <graphtyper/typer/path.hpp>
@@ -20,9 +19,8 @@ Path::Path(KmerLabel const & l, uint16_t const _read_start_index, uint16_t const
   if (l.variant_id != INVALID_ID)
   {
     var_order.push_back(l.variant_order);
-    std::bitset<MAX_NUMBER_OF_HAPLOTYPES> new_bitset(1);
-    new_bitset <<= l.variant_num;
-    nums.push_back(new_bitset);
+    nums.push_back(CompactBitset<MAX_NUMBER_OF_HAPLOTYPES>());
+    nums.back().set(l.variant_num);
   }
 }
 
@@ -89,17 +87,14 @@ Path::merge_with_current(KmerLabel const & l)
   {
     if (var_order[i] == l.variant_order)
     {
-      std::bitset<MAX_NUMBER_OF_HAPLOTYPES> new_bitset(1);
-      new_bitset <<= l.variant_num;
-      nums[i] |= new_bitset;
+      nums[i].set(l.variant_num);
       return;
     }
   }
 
   var_order.push_back(l.variant_order);
-  std::bitset<MAX_NUMBER_OF_HAPLOTYPES> new_bitset(1);
-  new_bitset <<= l.variant_num;
-  nums.push_back(std::move(new_bitset));
+  nums.push_back(CompactBitset<MAX_NUMBER_OF_HAPLOTYPES>());
+  nums.back().set(l.variant_num);
 }
 
 
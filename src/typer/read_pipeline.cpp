@@ -0,0 +1,320 @@
+#include <cassert> // assert
+#include <exception> // std::current_exception, std::rethrow_exception
+#include <mutex> // std::mutex, std::unique_lock
+#include <thread> // std::thread
+#include <utility> // std::move
+#include <vector> // std::vector
+
+#include <boost/log/trivial.hpp> // BOOST_LOG_TRIVIAL
+
+#include <graphtyper/graph/graph.hpp> // gyper::graph
+#include <graphtyper/graph/reference_depth.hpp> // gyper::ReferenceDepth, gyper::global_reference_depth
+#include <graphtyper/typer/alignment.hpp>
+#include <graphtyper/typer/discovery.hpp>
+#include <graphtyper/typer/genotype_paths.hpp> // gyper::GenotypePaths
+#include <graphtyper/typer/read_pipeline.hpp>
+#include <graphtyper/typer/variant_candidate.hpp> // gyper::VariantCandidate
+#include <graphtyper/typer/variant_map.hpp> // gyper::global_varmap
+#include <graphtyper/typer/vcf_writer.hpp> // gyper::VcfWriter
+#include <graphtyper/utilities/options.hpp> // gyper::Options
+
+
+namespace
+{
+
+/** Aligns a batch of reads to the graph. The reads are no longer needed afterwards and are freed. */
+gyper::AlignedBatch
+align_batch(gyper::ReadBatch && batch)
+{
+  using namespace gyper;
+
+  assert(batch.reads.size() > 0);
+  AlignedBatch aligned;
+  aligned.pn_index = batch.pn_index;
+
+  // Check if the reads are paired
+  if (seqan::length(batch.reads[0].second.seq) == 0)
+  {
+    // Do not process unpaired reads when calling segments
+    if (!Options::instance()->is_segment_calling && !Options::instance()->hq_reads)
+      align_unpaired_read_pairs(batch.reads, aligned.genos);
+  }
+  else
+  {
+    aligned.geno_pairs = align_paired_reads(batch.reads);
+  }
+
+  // The reads are no longer needed, let the memory free
+  batch.reads = TReads();
+  return aligned;
+}
+
+
+/** Discovers variants, adds reference depth and updates the haplotype scores of a batch of aligned reads. */
+void
+score_batch(gyper::AlignedBatch & aligned, gyper::VcfWriter & writer)
+{
+  using namespace gyper;
+
+  bool const IS_DISCOVERING = !Options::instance()->no_new_variants;
+  bool const IS_ADDING_DEPTH = !Options::instance()->no_new_variants || graph.is_sv_graph;
+
+  if (aligned.geno_pairs.size() > 0)
+  {
+    if (IS_DISCOVERING)
+    {
+      std::vector<VariantCandidate> variants = discover_variants(aligned.geno_pairs);
+      global_varmap.add_variants(std::move(variants), aligned.pn_index);
+    }
+
+    if (IS_ADDING_DEPTH)
+    {
+      // Add reference depth
+      ReferenceDepth reference_depth;
+
+      for (auto const & geno : aligned.geno_pairs)
+      {
+        reference_depth.add_genotype_paths(geno.first);
+        reference_depth.add_genotype_paths(geno.second);
+      }
+
+      global_reference_depth.add_reference_depths_from(reference_depth, aligned.pn_index);
+    }
+
+    writer.update_haplotype_scores_from_paths(aligned.geno_pairs, aligned.pn_index);
+  }
+  else if (aligned.genos.size() > 0)
+  {
+    if (IS_DISCOVERING)
+    {
+      std::vector<VariantCandidate> variants = discover_variants(aligned.genos);
+      global_varmap.add_variants(std::move(variants), aligned.pn_index);
+    }
+
+    if (IS_ADDING_DEPTH)
+    {
+      // Add reference depth
+      ReferenceDepth reference_depth;
+
+      for (auto const & geno : aligned.genos)
+        reference_depth.add_genotype_paths(geno);
+
+      global_reference_depth.add_reference_depths_from(reference_depth, aligned.pn_index);
+    }
+
+    writer.update_haplotype_scores_from_paths(aligned.genos, aligned.pn_index);
+  }
+}
+
+
+void
+add_occupancy(gyper::QueueOccupancy & occupancy, std::size_t const queue_size)
+{
+  ++occupancy.num_batches;
+  occupancy.sum_occupancy += queue_size;
+
+  if (queue_size >= occupancy.capacity)
+    ++occupancy.num_full;
+}
+
+
+void
+log_occupancy(char const * stage, gyper::QueueOccupancy const & occupancy)
+{
+  double const mean = occupancy.num_batches > 0 ?
+                      static_cast<double>(occupancy.sum_occupancy) / static_cast<double>(occupancy.num_batches) :
+                      0.0;
+
+  BOOST_LOG_TRIVIAL(info) << "[graphtyper::read_pipeline] " << stage << " queue: "
+                          << occupancy.num_batches << " batches, mean occupancy "
+                          << mean << "/" << occupancy.capacity << ", full for "
+                          << occupancy.num_full << " batches.";
+}
+
+
+} // anon namespace
+
+
+namespace gyper
+{
+
+ReadPipeline::ReadPipeline(VcfWriter & writer, std::size_t const num_threads, std::size_t const queue_size)
+  : align_stage(align_batch)
+  , score_stage([&writer](AlignedBatch & aligned){score_batch(aligned, writer);})
+  , max_queue_size(queue_size > 0 ? queue_size : 1)
+{
+  start_workers(num_threads);
+}
+
+
+ReadPipeline::ReadPipeline(TAlignStage _align_stage,
+                           TScoreStage _score_stage,
+                           std::size_t const num_threads,
+                           std::size_t const queue_size)
+  : align_stage(std::move(_align_stage))
+  , score_stage(std::move(_score_stage))
+  , max_queue_size(queue_size > 0 ? queue_size : 1)
+{
+  start_workers(num_threads);
+}
+
+
+ReadPipeline::~ReadPipeline()
+{
+  if (!is_closed)
+    close_and_wait();
+}
+
+
+void
+ReadPipeline::add(ReadBatch && batch)
+{
+  std::unique_lock<std::mutex> lock(queue_mutex);
+  add_occupancy(align_occupancy, align_queue.size());
+
+  space_available.wait(lock, [this]{
+      return error || align_queue.size() < max_queue_size;
+    });
+
+  // The batch is dropped if the pipeline has stopped, join() reports the error
+  if (error)
+    return;
+
+  align_queue.push_back(std::move(batch));
+  lock.unlock();
+  work_available.notify_one();
+}
+
+
+void
+ReadPipeline::join()
+{
+  close_and_wait();
+
+  // A full alignment queue means the alignment limits the throughput, a full scoring queue means the scoring does
+  log_occupancy("Alignment", align_occupancy);
+  log_occupancy("Scoring", score_occupancy);
+
+  if (error)
+    std::rethrow_exception(error);
+}
+
+
+void
+ReadPipeline::start_workers(std::size_t const num_threads)
+{
+  align_occupancy.capacity = max_queue_size;
+  score_occupancy.capacity = max_queue_size;
+  std::size_t const NUM_WORKERS = num_threads > 0 ? num_threads : 1;
+  workers.reserve(NUM_WORKERS);
+
+  for (std::size_t t = 0; t < NUM_WORKERS; ++t)
+    workers.emplace_back(&ReadPipeline::run_worker, this);
+}
+
+
+void
+ReadPipeline::close_and_wait()
+{
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    is_closed = true;
+  }
+
+  work_available.notify_all();
+
+  for (auto & worker : workers)
+    worker.join();
+
+  workers.clear();
+}
+
+
+void
+ReadPipeline::run_worker()
+{
+  try
+  {
+    process_batches();
+  }
+  catch (...)
+  {
+    // Stop the pipeline, so neither the other workers nor the threads adding batches wait for this worker
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+
+      if (!error)
+        error = std::current_exception();
+
+      align_queue.clear();
+      score_queue.clear();
+    }
+
+    work_available.notify_all();
+    space_available.notify_all();
+  }
+}
+
+
+void
+ReadPipeline::process_batches()
+{
+  std::unique_lock<std::mutex> lock(queue_mutex);
+
+  while (true)
+  {
+    work_available.wait(lock, [this]{
+        return is_closed || error || align_queue.size() > 0 || score_queue.size() > 0;
+      });
+
+    if (error)
+    {
+      // Another worker failed
+      break;
+    }
+    else if (score_queue.size() > 0)
+    {
+      // Prefer finishing batches over starting new ones
+      AlignedBatch aligned = std::move(score_queue.front());
+      score_queue.pop_front();
+      lock.unlock();
+      score_stage(aligned);
+      lock.lock();
+    }
+    else if (align_queue.size() > 0)
+    {
+      ReadBatch batch = std::move(align_queue.front());
+      align_queue.pop_front();
+      lock.unlock();
+      space_available.notify_one();
+
+      AlignedBatch aligned = align_stage(std::move(batch));
+      lock.lock();
+      add_occupancy(score_occupancy, score_queue.size());
+
+      if (score_queue.size() < max_queue_size)
+      {
+        score_queue.push_back(std::move(aligned));
+        lock.unlock();
+        work_available.notify_one();
+      }
+      else
+      {
+        // Score the batch directly instead of waiting for space in the queue
+        lock.unlock();
+        score_stage(aligned);
+      }
+
+      lock.lock();
+    }
+    else
+    {
+      // The pipeline is closed and all batches have been processed
+      assert(is_closed);
+      break;
+    }
+  }
+}
+
+
+} // namespace gyper
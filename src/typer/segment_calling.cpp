@@ -1,4 +1,3 @@
-#include <bitset> // std::bitset
 #include <cassert> // assert
 #include <iostream> // std::cout
 #include <map> // std::map<T,U>
@@ -27,7 +26,7 @@ namespace
 
 void
 print_explain_map(std::vector<std::string> const & hap_ids,
-                  std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > const & explain_map,
+                  std::map<uint32_t, std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > const & explain_map,
                   int32_t index = -1,
                   int32_t test_index = -1
                  )
@@ -37,7 +36,7 @@ print_explain_map(std::vector<std::string> const & hap_ids,
   {
     for (auto it = explain_map.begin(); it != explain_map.end(); ++it)
     {
-      // Type of it->second is std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
+      // Type of it->second is std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
       std::cout.width(5);
       std::cout << it->first << ": ";
 
@@ -63,7 +62,7 @@ print_explain_map(std::vector<std::string> const & hap_ids,
 
     for (auto it = explain_map.begin(); it != explain_map.end(); ++it)
     {
-      // Type of it->second is std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
+      // Type of it->second is std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
       std::cout << it->second[index].any() << " ";
     }
 
@@ -90,7 +89,7 @@ print_explain_map(std::vector<std::string> const & hap_ids,
         std::cout << std::endl;
         break;
       }
-      // Type of it->second is std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
+      // Type of it->second is std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
       // std::cout << it->second[index].any() << " ";
     }
 
@@ -100,8 +99,8 @@ print_explain_map(std::vector<std::string> const & hap_ids,
 
 
 void
-insert_into_explain_map(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & explain_map,
-                        std::pair<uint32_t, std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > const & var_explanation,
+insert_into_explain_map(std::map<uint32_t, std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & explain_map,
+                        std::pair<uint32_t, gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > const & var_explanation,
                         unsigned i,
                         std::size_t var_num
                         )
@@ -112,7 +111,7 @@ insert_into_explain_map(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NU
   {
     // Not found
     // std::cout << "[caller] INFO: Inserting new variant " << var_explanation.first << std::endl;
-    std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > new_vec(var_num);
+    std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > new_vec(var_num);
     new_vec[i] = var_explanation.second;
     explain_map[var_explanation.first] = std::move(new_vec);
   }
@@ -125,13 +124,13 @@ insert_into_explain_map(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NU
 
 
 void
-add_start_on_explain_map(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & explain_map)
+add_start_on_explain_map(std::map<uint32_t, std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & explain_map)
 {
   std::vector<uint8_t> has_started(explain_map.begin()->second.size(), 0);
 
   for (auto it = explain_map.begin(); it != explain_map.end(); ++it)
   {
-    // Type of it->second is std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
+    // Type of it->second is std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
     for (unsigned i = 0; i < it->second.size(); ++i)
     {
       assert(it->second.size() == explain_map.begin()->second.size());
@@ -155,11 +154,11 @@ add_start_on_explain_map(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_N
 
 
 void
-remove_insignificant_variants(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & explain_map)
+remove_insignificant_variants(std::map<uint32_t, std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & explain_map)
 {
   for (auto it = explain_map.cbegin(); it != explain_map.cend(); )
   {
-    // Type of it->second is std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
+    // Type of it->second is std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
     unsigned coverage = 0;
 
     for (auto explain_bitset : it->second)
@@ -186,8 +185,8 @@ remove_insignificant_variants(std::map<uint32_t, std::vector<std::bitset<gyper::
 
 
 void
-remove_out_of_order_variants(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & exon_explain_map,
-                             std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & intron_explain_map
+remove_out_of_order_variants(std::map<uint32_t, std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & exon_explain_map,
+                             std::map<uint32_t, std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & intron_explain_map
                              )
 {
   if (exon_explain_map.size() == 0)
@@ -257,7 +256,7 @@ remove_out_of_order_variants(std::map<uint32_t, std::vector<std::bitset<gyper::M
 
   for (auto it = exon_explain_map.cbegin(); it != exon_explain_map.cend(); )
   {
-    // Type of it->second is std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
+    // Type of it->second is std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
     if (std::find(longest_uniq_variants.begin(), longest_uniq_variants.end(), it->first) == longest_uniq_variants.end())
     {
       // Remove the variant if it is not found in the longest unique variants vector
@@ -272,7 +271,7 @@ remove_out_of_order_variants(std::map<uint32_t, std::vector<std::bitset<gyper::M
 
   for (auto it = intron_explain_map.cbegin(); it != intron_explain_map.cend(); )
   {
-    // Type of it->second is std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
+    // Type of it->second is std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
     if (std::find(longest_uniq_variants.begin(), longest_uniq_variants.end(), it->first) == longest_uniq_variants.end())
     {
       // Remove the variant if it is not found in the longest unique variants vector
@@ -288,13 +287,13 @@ remove_out_of_order_variants(std::map<uint32_t, std::vector<std::bitset<gyper::M
 
 
 void
-add_end_on_explain_map(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & explain_map)
+add_end_on_explain_map(std::map<uint32_t, std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & explain_map)
 {
   std::vector<uint8_t> has_ended(explain_map.begin()->second.size(), 0);
 
   for (auto it = explain_map.rbegin(); it != explain_map.rend(); ++it)
   {
-    // Type of it->second is std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
+    // Type of it->second is std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
     assert(it->second.size() == explain_map.begin()->second.size());
 
     for (unsigned i = 0; i < it->second.size(); ++i)
@@ -318,8 +317,8 @@ add_end_on_explain_map(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NUM
 
 
 std::size_t
-determine_reference_index(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > const & exon_explain_map,
-                          std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > const & intron_explain_map
+determine_reference_index(std::map<uint32_t, std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > const & exon_explain_map,
+                          std::map<uint32_t, std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > const & intron_explain_map
                           )
 {
   BOOST_LOG_TRIVIAL(info) << "[graphtyper::segment_calling] Determining reference index from explain maps.";
@@ -327,7 +326,7 @@ determine_reference_index(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_
 
   for (auto it = exon_explain_map.cbegin(); it != exon_explain_map.cend(); ++it)
   {
-    // Type of it->second is std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
+    // Type of it->second is std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
     for (unsigned i = 0; i < it->second.size(); ++i)
     {
       if (it->second[i].test(0))
@@ -340,7 +339,7 @@ determine_reference_index(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_
 
   for (auto it = intron_explain_map.cbegin(); it != intron_explain_map.cend(); ++it)
   {
-    // Type of it->second is std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
+    // Type of it->second is std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> >
     for (unsigned i = 0; i < it->second.size(); ++i)
     {
       if (it->second[i].test(0))
@@ -374,7 +373,7 @@ determine_reference_index(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_
 
 
 void
-put_reference_in_front(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & explain_map,
+put_reference_in_front(std::map<uint32_t, std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > > & explain_map,
                        std::vector<std::string> & hap_ids,
                        std::size_t const ref_index,
                        bool const change_hap_ids
@@ -397,8 +396,8 @@ put_reference_in_front(std::map<uint32_t, std::vector<std::bitset<gyper::MAX_NUM
 
   for (auto map_it = explain_map.begin(); map_it != explain_map.end(); ++map_it)
   {
-    std::vector<std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > explain_vec(map_it->second);
-    std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> ref_bitset(explain_vec[ref_index]);
+    std::vector<gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> > explain_vec(map_it->second);
+    gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES> ref_bitset(explain_vec[ref_index]);
     explain_vec.erase(explain_vec.begin() + ref_index);
     explain_vec.insert(explain_vec.begin(), ref_bitset);
     map_it->second = std::move(explain_vec);
@@ -481,7 +480,7 @@ segment_calling(std::vector<std::string> const & segment_fasta_files,
   {
     // Type of haplotype_paths_it is std::map<std::string, THapPaths>::iterator
     std::vector<std::string> hap_ids;
-    using TExplainMap = std::map<uint32_t, std::vector<std::bitset<MAX_NUMBER_OF_HAPLOTYPES> > >;
+    using TExplainMap = std::map<uint32_t, std::vector<CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> > >;
     TExplainMap exon_explain_map;
     TExplainMap intron_explain_map;
 
@@ -500,7 +499,7 @@ segment_calling(std::vector<std::string> const & segment_fasta_files,
 
         std::size_t const k = std::distance(all_haplotype_paths.cbegin(), haplotype_paths_it);
         // Previous path explanation
-        std::vector<std::vector<std::pair<uint32_t, std::bitset<MAX_NUMBER_OF_HAPLOTYPES> > > > path_explanations;
+        std::vector<std::vector<std::pair<uint32_t, CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> > > > path_explanations;
 
         for (unsigned j = 0; j < it->second.size(); ++j)
         {
@@ -537,7 +536,7 @@ segment_calling(std::vector<std::string> const & segment_fasta_files,
             }
           }
 
-          std::vector<std::pair<uint32_t, std::bitset<MAX_NUMBER_OF_HAPLOTYPES> > > path_explanation;
+          std::vector<std::pair<uint32_t, CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> > > path_explanation;
           writer.find_path_explanation(path, path_explanation);
           path_explanations.push_back(std::move(path_explanation));
         }
@@ -551,7 +550,7 @@ segment_calling(std::vector<std::string> const & segment_fasta_files,
           {
             auto & var_explanation = path_explanations[j][p];
 
-            // Type of var_explanation is std::pair<uint32_t, std::bitset<MAX_NUMBER_OF_HAPLOTYPES> >
+            // Type of var_explanation is std::pair<uint32_t, CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> >
             assert(k < has_long_exon.size());
             assert(j < has_long_exon[k].size());
             // std::cout << "[graphtyper::segment_calling] Var explain " << var_explanation.first << " ";
@@ -27,12 +27,15 @@
 namespace gyper
 {
 
+std::size_t constexpr VariantMap::NUM_SHARDS;
+
 
 void
 VariantMap::set_pn_count(std::size_t const pn_count)
 {
-  map_mutexes = std::vector<std::mutex>(pn_count);
   varmaps.resize(pn_count);
+  varmap_shards.resize(pn_count * NUM_SHARDS);
+  shard_mutexes = std::vector<std::mutex>(pn_count * NUM_SHARDS);
 }
 
 
@@ -40,13 +43,14 @@ void
 VariantMap::add_variants(std::vector<VariantCandidate> && vars, std::size_t const pn_index)
 {
   assert(pn_index < varmaps.size());
-  assert(pn_index < map_mutexes.size());
-
-  std::lock_guard<std::mutex> lock(map_mutexes[pn_index]);
-  auto & varmap = varmaps[pn_index];
+  assert((pn_index + 1) * NUM_SHARDS <= varmap_shards.size());
 
   for (auto && var : vars)
   {
+    std::size_t const shard = pn_index * NUM_SHARDS + VariantCandidateHash()(var) % NUM_SHARDS;
+    std::lock_guard<std::mutex> lock(shard_mutexes[shard]);
+    auto & varmap = varmap_shards[shard];
+
     assert(var.seqs.size() >= 2);
     assert(var.is_normalized());
     assert(var.seqs[0].size() > 0);
@@ -91,7 +95,36 @@ VariantMap::add_variants(std::vector<VariantCandidate> && vars, std::size_t cons
     if (IS_SEQ_REVERSED)
       ++it->second.sequence_reversed;
 
-    it->second.unique_positions.insert(ORIGINAL_POS);
+    it->second.add_unique_position(ORIGINAL_POS);
+  }
+}
+
+
+void
+VariantMap::merge_varmap_shards()
+{
+  assert(varmap_shards.size() == varmaps.size() * NUM_SHARDS);
+
+  for (std::size_t i = 0; i < varmaps.size(); ++i)
+  {
+    auto & varmap = varmaps[i];
+    auto const shards_begin = varmap_shards.begin() + i * NUM_SHARDS;
+    auto const shards_end = shards_begin + NUM_SHARDS;
+    std::size_t num_variants = varmap.size();
+
+    for (auto shard_it = shards_begin; shard_it != shards_end; ++shard_it)
+      num_variants += shard_it->size();
+
+    varmap.reserve(num_variants);
+
+    // A variant is always added to the same shard, so the shards have no common variants
+    for (auto shard_it = shards_begin; shard_it != shards_end; ++shard_it)
+    {
+      for (auto & item : *shard_it)
+        varmap.insert(std::move(item));
+
+      *shard_it = VarMap();
+    }
   }
 }
 
@@ -99,6 +132,7 @@ VariantMap::add_variants(std::vector<VariantCandidate> && vars, std::size_t cons
 void
 VariantMap::create_varmap_for_all()
 {
+  merge_varmap_shards();
   assert(varmaps.size() == global_reference_depth.depths.size());
   long const NUM_SAMPLES = static_cast<long>(varmaps.size());
 
@@ -1,3 +1,4 @@
+#include <algorithm> // std::lower_bound
 #include <cstdint>
 
 #include <graphtyper/utilities/options.hpp>
@@ -8,6 +9,23 @@ namespace gyper
 {
 
 
+void
+VariantSupport::add_unique_position(uint32_t const original_pos)
+{
+  // Reads are mostly added in order of their position, so the position is usually appended
+  if (unique_positions.size() == 0 || unique_positions.back() < original_pos)
+  {
+    unique_positions.push_back(original_pos);
+    return;
+  }
+
+  auto it = std::lower_bound(unique_positions.begin(), unique_positions.end(), original_pos);
+
+  if (*it != original_pos)
+    unique_positions.insert(it, original_pos);
+}
+
+
 void
 VariantSupport::set_depth(uint16_t const _depth)
 {
@@ -1,10 +1,14 @@
+#include <algorithm> // std::max, std::min
 #include <cassert>
+#include <cstring> // memchr, memmove
 #include <fstream>
 #include <iostream>
+#include <map> // std::map
 #include <sstream>
+#include <thread> // std::thread
 #include <unordered_map>
-
-#include "InputFile.h" // Included in the StatGen library
+#include <unordered_set> // std::unordered_set
+#include <utility> // std::move
 
 #include <boost/algorithm/string/predicate.hpp> // boost::algorithm::ends_with
 #include <boost/log/trivial.hpp>
@@ -163,6 +167,126 @@ get_genotype_phred(gyper::HapSample const & sample,
 }
 
 
+/** \brief Key which variants are sorted by when they are written. */
+struct VariantSortKey
+{
+  uint32_t abs_pos = 0;
+  uint32_t type_id = 0; /** \brief Rank of the variant type among the types of the VCF. */
+  uint32_t index = 0; /** \brief Index of the variant in the VCF. */
+};
+
+
+/** \brief Sorts chunks of 'values' on 'num_threads' threads and merges the sorted chunks pairwise in parallel. */
+template <typename T, typename TCompare>
+void
+parallel_sort(std::vector<T> & values, TCompare compare, std::size_t const num_threads)
+{
+  std::size_t const MIN_CHUNK_SIZE = 4096;
+  std::size_t const num_chunks = std::max(1ul, std::min(num_threads, values.size() / MIN_CHUNK_SIZE));
+
+  if (num_chunks == 1)
+  {
+    std::sort(values.begin(), values.end(), compare);
+    return;
+  }
+
+  std::vector<std::size_t> bounds;
+
+  for (std::size_t c = 0; c <= num_chunks; ++c)
+    bounds.push_back(values.size() * c / num_chunks);
+
+  std::vector<std::thread> threads;
+
+  for (std::size_t c = 1; c < num_chunks; ++c)
+  {
+    threads.emplace_back([&values, &bounds, &compare, c]{
+        std::sort(values.begin() + bounds[c], values.begin() + bounds[c + 1], compare);
+      });
+  }
+
+  std::sort(values.begin(), values.begin() + bounds[1], compare);
+
+  for (auto & thread : threads)
+    thread.join();
+
+  // Merge neighbouring chunks until everything is one chunk
+  while (bounds.size() > 2)
+  {
+    std::vector<std::size_t> merged_bounds;
+    threads.clear();
+
+    for (std::size_t c = 0; c + 2 < bounds.size(); c += 2)
+    {
+      threads.emplace_back([&values, &compare](std::size_t const begin, std::size_t const mid, std::size_t const end){
+          std::inplace_merge(values.begin() + begin, values.begin() + mid, values.begin() + end, compare);
+        }, bounds[c], bounds[c + 1], bounds[c + 2]);
+
+      merged_bounds.push_back(bounds[c]);
+    }
+
+    // An odd chunk at the end is merged in the next round
+    if (bounds.size() % 2 == 0)
+      merged_bounds.push_back(bounds[bounds.size() - 2]);
+
+    merged_bounds.push_back(bounds.back());
+
+    for (auto & thread : threads)
+      thread.join();
+
+    bounds = std::move(merged_bounds);
+  }
+}
+
+
+/**
+ * \brief Initial size of the buffer VCF files are read into. It grows only if a line does not fit, so it is kept
+ *        small as many VCFs can be open at once when merging.
+ */
+std::size_t const READ_BUFFER_SIZE = 65536;
+
+
+/** \brief Splits 'text' at each 'delim' into views of 'text'. */
+void
+split_view(boost::string_ref const text, char const delim, std::vector<boost::string_ref> & fields)
+{
+  fields.clear();
+  char const * it = text.data();
+  char const * const end = text.data() + text.size();
+
+  while (true)
+  {
+    char const * const next = static_cast<char const *>(std::memchr(it, delim, end - it));
+
+    if (next == nullptr)
+    {
+      fields.emplace_back(it, end - it);
+      return;
+    }
+
+    fields.emplace_back(it, next - it);
+    it = next + 1;
+  }
+}
+
+
+/** \brief Parses the digits at the start of 'text' as a non-negative integer. */
+unsigned long
+view_to_ulong(boost::string_ref const text)
+{
+  unsigned long x = 0;
+
+  for (char const c : text)
+  {
+    if (c < '0' || c > '9')
+      break;
+
+    x = 10 * x + static_cast<unsigned long>(c - '0');
+  }
+
+  return x;
+}
+
+
 } // anon namespace
 
 
@@ -217,11 +341,8 @@ Vcf::open_vcf_file_for_reading()
   switch (filemode)
   {
   case READ_UNCOMPRESSED_MODE:
-    vcf_file = ifopen(filename.c_str(), "r", InputFile::UNCOMPRESSED);
-    break;
-
   case READ_BGZF_MODE:
-    vcf_file = ifopen(filename.c_str(), "rb", InputFile::BGZF);
+    vcf_file = bgzf_open(filename.c_str(), "r"); // htslib reads both uncompressed and BGZF compressed files
     break;
 
   default:
@@ -234,39 +355,100 @@ Vcf::open_vcf_file_for_reading()
     BOOST_LOG_TRIVIAL(error) << "[graphtyper::vcf] Could not open " << filename << ".";
     std::exit(1);
   }
+
+  read_pos = 0;
+  read_end = 0;
+}
+
+
+bool
+Vcf::next_line(boost::string_ref & line)
+{
+  if (!vcf_file)
+    return false;
+
+  while (true)
+  {
+    char const * const begin = read_buffer.data() + read_pos;
+    std::size_t const num_unread = read_end - read_pos;
+    char const * const newline = num_unread > 0 ?
+                                 static_cast<char const *>(std::memchr(begin, '\n', num_unread)) :
+                                 nullptr;
+
+    if (newline != nullptr)
+    {
+      line = boost::string_ref(begin, newline - begin);
+      read_pos += line.size() + 1;
+      return true;
+    }
+
+    // Move the incomplete line to the front of the buffer and read more after it
+    if (read_pos > 0)
+    {
+      std::memmove(read_buffer.data(), begin, num_unread);
+      read_pos = 0;
+      read_end = num_unread;
+    }
+
+    if (read_end == read_buffer.size())
+      read_buffer.resize(std::max(READ_BUFFER_SIZE, 2 * read_buffer.size()));
+
+    ssize_t const num_read = bgzf_read(vcf_file, read_buffer.data() + read_end, read_buffer.size() - read_end);
+
+    if (num_read < 0)
+    {
+      BOOST_LOG_TRIVIAL(error) << "[graphtyper::vcf] Failed reading " << filename << ".";
+      std::exit(1);
+    }
+    else if (num_read == 0)
+    {
+      // End of file, the last line may not end with a newline
+      if (read_end == 0)
+        return false;
+
+      line = boost::string_ref(read_buffer.data(), read_end);
+      read_pos = read_end;
+      return true;
+    }
+
+    read_end += num_read;
+  }
 }
 
 
 std::string
 Vcf::read_line()
 {
-  std::string line;
-  vcf_file >> line;
-  return line;
+  boost::string_ref line;
+
+  if (!next_line(line))
+    return std::string();
+
+  return std::string(line.begin(), line.end());
 }
 
 
 bool
 Vcf::read_record(bool const SITES_ONLY)
 {
-  std::string const line = read_line();
+  boost::string_ref line;
 
-  if (line.size() == 0)
+  if (!next_line(line) || line.size() == 0)
     return false;
 
-  // Get all positions of TABs in the line
-  std::vector<std::size_t> const tabs = get_all_pos(line, '\t');
-  // We ignore the following fields: qual (5), filter (6), info (7)
+  // The fields are views of the line, values are only copied out of it when they are stored
+  std::vector<boost::string_ref> & fields = read_fields;
+  std::vector<boost::string_ref> & values = read_values;
+  split_view(line, '\t', fields);
+  assert(fields.size() >= 8);
+  // We ignore the following fields: qual (5), filter (6)
 
-  std::string const chrom = get_string_at_tab_index(line, tabs, 0);
-  uint32_t const pos = static_cast<uint32_t>(std::stoul(get_string_at_tab_index(line, tabs, 1)));
-  std::string const id = get_string_at_tab_index(line, tabs, 2);
-  std::string const ref = get_string_at_tab_index(line, tabs, 3);
-  std::string const alts = get_string_at_tab_index(line, tabs, 4);
-  std::vector<std::size_t> const alt_commas = get_all_pos(alts, ',');
+  boost::string_ref const id = fields[2];
+  boost::string_ref const ref = fields[3];
 
   Variant new_var; // Create a new variant for this position
-  new_var.abs_pos = absolute_pos.get_absolute_position(chrom, pos); // Parse positions
+  new_var.abs_pos = absolute_pos.get_absolute_position(std::string(fields[0].begin(), fields[0].end()),
+                                                       static_cast<uint32_t>(view_to_ulong(fields[1])));
 
   // Check for graphtyper variant ID suffix
   {
@@ -284,22 +466,20 @@ Vcf::read_record(bool const SITES_ONLY)
   }
 
   // Parse sequences
-  new_var.seqs.push_back(gyper::to_vec(std::string(ref)));
-  assert(alt_commas.size() >= 2);
+  new_var.seqs.push_back(std::vector<char>(ref.begin(), ref.end()));
+  split_view(fields[4], ',', values);
 
-  for (int a = 0; a < static_cast<int>(alt_commas.size()) - 1; ++a)
-    new_var.seqs.push_back(gyper::to_vec(get_string_at_tab_index(alts, alt_commas, a)));
+  for (auto const & alt : values)
+    new_var.seqs.push_back(std::vector<char>(alt.begin(), alt.end()));
 
   // Parse infos
   {
-    std::string const info = get_string_at_tab_index(line, tabs, 7);
+    boost::string_ref const info = fields[7];
 
     // Don't parse anything if the INFO field is empty
     if (info.size() > 0)
     {
-      std::vector<std::size_t> const info_semicolons = get_all_pos(info, ';');
-
-      std::unordered_set<std::string> const keys_to_parse(
+      static std::unordered_set<std::string> const keys_to_parse(
         {
           "AC",
           "CR", "CRAligner",
@@ -320,18 +500,19 @@ Vcf::read_record(bool const SITES_ONLY)
         }
       );
 
-      for (int s = 0; s < static_cast<int>(info_semicolons.size()) - 1; ++s)
+      split_view(info, ';', values);
+
+      for (auto const & info_key_value : values)
       {
-        std::string const info_key_value = get_string_at_tab_index(info, info_semicolons, s);
         auto eq_it = std::find(info_key_value.begin(), info_key_value.end(), '=');
 
         if (eq_it == info_key_value.end())
           continue;
 
-        std::string const key(info_key_value.begin(), eq_it);
+        std::string key(info_key_value.begin(), eq_it);
 
         if (keys_to_parse.count(key) == 1)
-          new_var.infos[key] = std::string(eq_it + 1, info_key_value.end());
+          new_var.infos[std::move(key)] = std::string(eq_it + 1, info_key_value.end());
       }
     }
   }
@@ -339,8 +520,8 @@ Vcf::read_record(bool const SITES_ONLY)
   // Parse samples, if any
   if (!SITES_ONLY && sample_names.size() > 0)
   {
-    std::string const format = get_string_at_tab_index(line, tabs, 8);
-    std::vector<std::size_t> all_format_colon = get_all_pos(format, ':');
+    assert(fields.size() >= 9);
+    split_view(fields[8], ':', values);
     int ad_field = -1;
     int gt_field = -1;
     int pl_field = -1;
@@ -349,9 +530,9 @@ Vcf::read_record(bool const SITES_ONLY)
     int pp_field = -1;
     int ft_field = -1;
 
-    for (int32_t f = 0; f < static_cast<int>(all_format_colon.size() - 1); ++f)
+    for (int32_t f = 0; f < static_cast<int>(values.size()); ++f)
     {
-      std::string const field = get_string_at_tab_index(format, all_format_colon, f);
+      boost::string_ref const field = values[f];
 
       if (field == "AD")
         ad_field = f;
@@ -372,19 +553,22 @@ Vcf::read_record(bool const SITES_ONLY)
     assert(ad_field != -1);
     assert(gt_field != -1);
     assert(pl_field != -1);
-    int const FIELD_OFFSET = 9;
+    std::size_t const FIELD_OFFSET = 9;
+    assert(fields.size() >= sample_names.size() + FIELD_OFFSET);
+    std::vector<boost::string_ref> & sample_fields = read_sample_fields;
 
-    for (int i = FIELD_OFFSET; i < static_cast<int>(sample_names.size()) + FIELD_OFFSET; ++i)
+    for (std::size_t i = FIELD_OFFSET; i < sample_names.size() + FIELD_OFFSET; ++i)
     {
       // Create a new sample call
       SampleCall new_call;
 
-      // Parse string of sample i
-      std::string sample_string = get_string_at_tab_index(line, tabs, i);
-      std::vector<std::size_t> sample_string_colon = get_all_pos(sample_string, ':');
+      // Split the string of sample i
+      split_view(fields[i], ':', sample_fields);
+      assert(std::max({ad_field, gt_field, pl_field, md_field, ra_field, pp_field, ft_field}) <
+             static_cast<int>(sample_fields.size()));
 
       // Parse GT (for phase)
-      std::string const gt_str = get_string_at_tab_index(sample_string, sample_string_colon, gt_field);
+      boost::string_ref const gt_str = sample_fields[gt_field];
 
       // Check if the genotypes are phased
       if (std::find(gt_str.begin(), gt_str.end(), '|') != gt_str.end())
@@ -396,10 +580,10 @@ Vcf::read_record(bool const SITES_ONLY)
         }
         else
         {
-          std::vector<std::size_t> gt_str_pos = get_all_pos(gt_str, '|');
-          assert(gt_str_pos.size() == 3);
-          uint8_t call1 = static_cast<uint8_t>(std::stoul(get_string_at_tab_index(gt_str, gt_str_pos, 0)));
-          uint8_t call2 = static_cast<uint8_t>(std::stoul(get_string_at_tab_index(gt_str, gt_str_pos, 1)));
+          split_view(gt_str, '|', values);
+          assert(values.size() == 2);
+          uint8_t call1 = static_cast<uint8_t>(view_to_ulong(values[0]));
+          uint8_t call2 = static_cast<uint8_t>(view_to_ulong(values[1]));
 
           if (call1 <= call2)
             new_var.phase.push_back(0);
@@ -409,17 +593,15 @@ Vcf::read_record(bool const SITES_ONLY)
       }
 
       // Parse AD
-      std::string const ad_str = get_string_at_tab_index(sample_string, sample_string_colon, ad_field);
-      std::vector<std::size_t> ad_str_comma = get_all_pos(ad_str, ',');
+      split_view(sample_fields[ad_field], ',', values);
 
-      for (int j = 0; j < static_cast<int>(ad_str_comma.size()) - 1; ++j)
-        new_call.coverage.push_back(static_cast<uint16_t>(std::stoul(get_string_at_tab_index(ad_str, ad_str_comma, j))));
+      for (auto const & ad : values)
+        new_call.coverage.push_back(static_cast<uint16_t>(view_to_ulong(ad)));
 
       // Parse MD
       if (md_field != -1)
       {
-        std::string const md_str = get_string_at_tab_index(sample_string, sample_string_colon, md_field);
-        unsigned long const md = std::stoul(md_str);
+        unsigned long const md = view_to_ulong(sample_fields[md_field]);
         assert(md <= 0xFFu);
         new_call.ambiguous_depth = static_cast<uint8_t>(md);
       }
@@ -427,25 +609,20 @@ Vcf::read_record(bool const SITES_ONLY)
       // Parse RA
       if (ra_field != -1)
       {
-        std::string const ra_str = get_string_at_tab_index(sample_string, sample_string_colon, ra_field);
-        std::vector<std::size_t> ra_str_comma = get_all_pos(ra_str, ',');
-
-        assert (ra_str_comma.size() == 3);
-        new_call.ref_total_depth = static_cast<uint16_t>(std::stoul(get_string_at_tab_index(ra_str, ra_str_comma, 0)));
-        new_call.alt_total_depth = static_cast<uint16_t>(std::stoul(get_string_at_tab_index(ra_str, ra_str_comma, 1)));
+        split_view(sample_fields[ra_field], ',', values);
+        assert(values.size() == 2);
+        new_call.ref_total_depth = static_cast<uint16_t>(view_to_ulong(values[0]));
+        new_call.alt_total_depth = static_cast<uint16_t>(view_to_ulong(values[1]));
       }
 
       // Parse PP
       if (pp_field != -1)
-      {
-        std::string const pp_str = get_string_at_tab_index(sample_string, sample_string_colon, pp_field);
-        new_call.alt_proper_pair_depth = static_cast<uint8_t>(std::stoul(std::move(pp_str)));
-      }
+        new_call.alt_proper_pair_depth = static_cast<uint8_t>(view_to_ulong(sample_fields[pp_field]));
 
       // Parse FT
       if (ft_field != -1)
       {
-        std::string const ft_str = get_string_at_tab_index(sample_string, sample_string_colon, ft_field);
+        boost::string_ref const ft_str = sample_fields[ft_field];
 
         if (ft_str == "PASS")
         {
@@ -453,16 +630,16 @@ Vcf::read_record(bool const SITES_ONLY)
         }
         else
         {
-          new_call.filter = static_cast<int8_t>(std::atoi(ft_str.substr(4).c_str()));
+          assert(ft_str.size() > 4);
+          new_call.filter = static_cast<int8_t>(view_to_ulong(ft_str.substr(4)));
         }
       }
 
       // Parse PL
-      std::string const pl_str = get_string_at_tab_index(sample_string, sample_string_colon, pl_field);
-      std::vector<std::size_t> pl_str_comma = get_all_pos(pl_str, ',');
+      split_view(sample_fields[pl_field], ',', values);
 
-      for (int j = 0; j < static_cast<int>(pl_str_comma.size()) - 1; ++j)
-        new_call.phred.push_back(static_cast<uint8_t>(std::stoul(get_string_at_tab_index(pl_str, pl_str_comma, j))));
+      for (auto const & pl : values)
+        new_call.phred.push_back(static_cast<uint8_t>(view_to_ulong(pl)));
 
       assert(new_call.coverage.size() * (new_call.coverage.size() + 1) / 2 == new_call.phred.size());
       new_var.calls.push_back(std::move(new_call));
@@ -484,8 +661,7 @@ Vcf::read_samples()
 
   while (true)
   {
-    std::string line;
-    vcf_file >> line;
+    std::string const line = read_line();
 
     if (line.size() == 0)
     {
@@ -559,7 +735,7 @@ Vcf::open_for_writing()
     break;
 
   case WRITE_BGZF_MODE:
-    bgzf_stream.open(filename, "wb");
+    bgzf_stream.open(filename, "wb", static_cast<int>(Options::instance()->threads));
     break;
 
   default:
@@ -760,6 +936,19 @@ Vcf::write_header()
 
 void
 Vcf::write_record(Variant const & var, std::string const & suffix, bool const FILTER_ZERO_QUAL)
+{
+  record_text.clear();
+  format_record(var, suffix, FILTER_ZERO_QUAL, record_text);
+  bgzf_stream.write(record_text);
+}
+
+
+void
+Vcf::format_record(Variant const & var,
+                   std::string const & suffix,
+                   bool const FILTER_ZERO_QUAL,
+                   TextBuffer & text
+                   ) const
 {
   // Parse the position
   auto contig_pos = absolute_pos.get_contig_position(var.abs_pos);
@@ -801,35 +990,40 @@ Vcf::write_record(Variant const & var, std::string const & suffix, bool const FI
     return;
   }
 
-  bgzf_stream << contig_pos.first << '\t';
-  bgzf_stream << contig_pos.second << '\t';
+  text << contig_pos.first << '\t';
+  text << contig_pos.second << '\t';
 
   // Write the ID field
-  bgzf_stream << contig_pos.first; // Keep the 'chr'
+  text << contig_pos.first; // Keep the 'chr'
 
-  bgzf_stream << ':' << contig_pos.second << ':' << var.determine_variant_type();
+  text << ':' << contig_pos.second << ':' << var.determine_variant_type();
 
   if (var.suffix_id.size() > 0)
-    bgzf_stream << "[" << var.suffix_id << "]";
+    text << "[" << var.suffix_id << "]";
 
-  bgzf_stream << suffix;
+  text << suffix;
 
   // Parse the sequences
   assert(var.seqs.size() >= 2);
-  bgzf_stream << '\t' << std::string(var.seqs[0].begin(), var.seqs[0].end()) << '\t'
-              << std::string(var.seqs[1].begin(), var.seqs[1].end());
+  text << '\t';
+  text.str.append(var.seqs[0].begin(), var.seqs[0].end());
+  text << '\t';
+  text.str.append(var.seqs[1].begin(), var.seqs[1].end());
 
   // Print other allele sequences if it is multi-allelic marker
   for (std::size_t a = 2; a < var.seqs.size(); ++a)
-    bgzf_stream << ',' << std::string(var.seqs[a].begin(), var.seqs[a].end());
+  {
+    text << ',';
+    text.str.append(var.seqs[a].begin(), var.seqs[a].end());
+  }
 
   // Parse qual
-  bgzf_stream << "\t" << std::to_string(variant_qual) << "\t";
+  text << "\t" << variant_qual << "\t";
 
   // Parse filter
   if (sample_names.size() == 0)
   {
-    bgzf_stream << ".\t";
+    text << ".\t";
   }
   else
   {
@@ -838,27 +1032,27 @@ Vcf::write_record(Variant const & var, std::string const & suffix, bool const FI
     if (var.infos.count("ABHet") == 1 && var.infos.at("ABHet") != std::string("-1") && std::stod(var.infos.at("ABHet")) < 0.20)
     {
       if (!is_pass)
-        bgzf_stream << ";";
+        text << ";";
 
-      bgzf_stream << "ABHet";
+      text << "ABHet";
       is_pass = false;
     }
 
     if (var.infos.count("QD") == 1 && std::stod(var.infos.at("QD")) < 4.0)
     {
       if (!is_pass)
-        bgzf_stream << ";";
+        text << ";";
 
-      bgzf_stream << "QD";
+      text << "QD";
       is_pass = false;
     }
 
     if (variant_qual < 20)
     {
       if (!is_pass)
-        bgzf_stream << ";";
+        text << ";";
 
-      bgzf_stream << "QUAL";
+      text << "QUAL";
       is_pass = false;
     }
 
@@ -868,39 +1062,39 @@ Vcf::write_record(Variant const & var, std::string const & suffix, bool const FI
         )
     {
       if (!is_pass)
-        bgzf_stream << ";";
+        text << ";";
 
-      bgzf_stream << "Pratio";
+      text << "Pratio";
       is_pass = false;
     }
 
     if (is_pass)
-      bgzf_stream << "PASS";
+      text << "PASS";
 
-    bgzf_stream << "\t";
+    text << "\t";
   }
 
 
   // Parse info
   if (var.infos.empty())
   {
-    bgzf_stream << ".";
+    text << ".";
   }
   else
   {
     auto write_info = [&](std::map<std::string, std::string>::const_iterator it)
     {
-      bgzf_stream << it->first;
+      text << it->first;
 
       if (it->second.size() > 0)
-         bgzf_stream << '=' << it->second;
+         text << '=' << it->second;
     };
 
     write_info(var.infos.cbegin());
 
     for (auto map_it = std::next(var.infos.cbegin(), 1); map_it != var.infos.cend(); ++map_it)
     {
-      bgzf_stream << ';';
+      text << ';';
       write_info(map_it);
     }
 
@@ -910,7 +1104,7 @@ Vcf::write_record(Variant const & var, std::string const & suffix, bool const FI
 
   // Parse FORMAT
   if (sample_names.size() > 0)
-    bgzf_stream << "\tGT:FT:AD:MD:DP:RA:PP:GQ:PL";
+    text << "\tGT:FT:AD:MD:DP:RA:PP:GQ:PL";
 
   for (std::size_t i = 0; i < var.calls.size(); ++i)
   {
@@ -926,9 +1120,9 @@ Vcf::write_record(Variant const & var, std::string const & suffix, bool const FI
     {
       // If all PHRED scores are zero, print ./. (or .|.)
       if (var.phase.size() > 0)
-        bgzf_stream << "\t.|.";
+        text << "\t.|.";
       else
-        bgzf_stream << "\t./.";
+        text << "\t./.";
     }
     else
     {
@@ -939,13 +1133,13 @@ Vcf::write_record(Variant const & var, std::string const & suffix, bool const FI
         assert(i < var.phase.size());
 
         if (var.phase[i] == 0)
-          bgzf_stream << "\t" << gt_call.first << "|" << gt_call.second;
+          text << "\t" << gt_call.first << "|" << gt_call.second;
         else
-          bgzf_stream << "\t" << gt_call.second << "|" << gt_call.first;
+          text << "\t" << gt_call.second << "|" << gt_call.first;
       }
       else
       {
-        bgzf_stream << "\t" << gt_call.first << "/" << gt_call.second;
+        text << "\t" << gt_call.first << "/" << gt_call.second;
       }
     }
 
@@ -953,52 +1147,52 @@ Vcf::write_record(Variant const & var, std::string const & suffix, bool const FI
     long const gq = call.get_gq();
 
     {
-      bgzf_stream << ":";
+      text << ":";
       int8_t filter = call.check_filter(gq);
 
       if (filter == 0)
       {
-        bgzf_stream << "PASS";
+        text << "PASS";
       }
       else
       {
         assert(filter > 0);
-        bgzf_stream << "FAIL" << static_cast<long>(filter);
+        text << "FAIL" << static_cast<long>(filter);
       }
     }
 
     // Write AD
     assert(call.coverage.size() > 0);
-    bgzf_stream << ":" << call.coverage[0];
+    text << ":" << call.coverage[0];
 
     for (auto ad_it = call.coverage.begin() + 1; ad_it != call.coverage.end(); ++ad_it)
-      bgzf_stream << "," << *ad_it;
+      text << "," << *ad_it;
 
     // Write MD (Multi-depth)
-    bgzf_stream << ":" << static_cast<uint64_t>(call.ambiguous_depth);
+    text << ":" << static_cast<uint64_t>(call.ambiguous_depth);
 
     // Write DP
-    bgzf_stream << ":" << call.get_depth();
+    text << ":" << call.get_depth();
 
     // Write RA
-    bgzf_stream << ":" << call.ref_total_depth << "," << call.alt_total_depth;
+    text << ":" << call.ref_total_depth << "," << call.alt_total_depth;
 
     // Write PP
-    bgzf_stream << ":" << static_cast<std::size_t>(call.alt_proper_pair_depth);
+    text << ":" << static_cast<std::size_t>(call.alt_proper_pair_depth);
 
     // Write GQ
-    bgzf_stream << ":" << gq;
+    text << ":" << gq;
 
     // Write PL
-    bgzf_stream << ":" << static_cast<uint16_t>(call.phred[0]);
+    text << ":" << static_cast<uint16_t>(call.phred[0]);
     // This cast to uint16_t is needed! Otherwise uint8_t is represented as a char
 
     for (std::size_t p = 1; p < call.phred.size(); ++p)
-      bgzf_stream << "," << static_cast<uint16_t>(call.phred[p]);
+      text << "," << static_cast<uint16_t>(call.phred[p]);
   }
 
   // Fin.
-  bgzf_stream << "\n";
+  text << "\n";
 }
 
 
@@ -1021,67 +1215,125 @@ Vcf::write_records(uint32_t const region_begin,
   if (variants.size() == 0)
     return;
 
-  // Sort the variants
-  auto compare_variants = [&](std::size_t const i, std::size_t const j) -> bool
+  // Determine the type of each variant once and rank the types, so variants are compared without building strings
+  std::vector<std::string> types;
+  std::map<std::string, uint32_t> type_ids;
+  types.reserve(variants.size());
+
+  for (auto const & var : variants)
   {
-    assert(i < variants.size());
-    assert(j < variants.size());
-    gyper::Variant const & a = variants[i];
-    gyper::Variant const & b = variants[j];
-    assert(a.seqs.size() >= 2);
-    assert(b.seqs.size() >= 2);
-    return a.abs_pos < b.abs_pos ||
-           (a.abs_pos == b.abs_pos &&
-            a.determine_variant_type() < b.determine_variant_type()
-           ) ||
-           (a.abs_pos == b.abs_pos &&
-             a.determine_variant_type() == b.determine_variant_type() &&
-             a.seqs < b.seqs
-           );
-  };
+    types.push_back(var.determine_variant_type());
+    type_ids[types.back()] = 0;
+  }
 
-  auto same_variant_id = [](Variant const & a, Variant const & b) -> bool
   {
-    return a.abs_pos == b.abs_pos && a.determine_variant_type() == b.determine_variant_type();
-  };
+    uint32_t rank = 0;
+
+    for (auto & type_id : type_ids)
+      type_id.second = rank++;
+  }
 
-  std::vector<std::size_t> indexes;
+  std::vector<VariantSortKey> keys(variants.size());
 
   for (std::size_t i = 0; i < variants.size(); ++i)
-    indexes.push_back(i);
+  {
+    assert(variants[i].seqs.size() >= 2);
+    keys[i].abs_pos = variants[i].abs_pos;
+    keys[i].type_id = type_ids[types[i]];
+    keys[i].index = static_cast<uint32_t>(i);
+  }
+
+  types.clear();
+
+  // Sort the variants by position, type and alleles. The index breaks ties so the order is deterministic
+  auto compare_variants = [&](VariantSortKey const & a, VariantSortKey const & b) -> bool
+  {
+    if (a.abs_pos != b.abs_pos)
+      return a.abs_pos < b.abs_pos;
+
+    if (a.type_id != b.type_id)
+      return a.type_id < b.type_id;
 
-  std::sort(indexes.begin(), indexes.end(), compare_variants);
-  assert(indexes.size() > 0);
+    if (variants[a.index].seqs != variants[b.index].seqs)
+      return variants[a.index].seqs < variants[b.index].seqs;
+
+    return a.index < b.index;
+  };
+
+  parallel_sort(keys, compare_variants, std::max(1u, Options::instance()->threads));
+
+  auto same_variant_id = [](VariantSortKey const & a, VariantSortKey const & b) -> bool
+  {
+    return a.abs_pos == b.abs_pos && a.type_id == b.type_id;
+  };
 
   auto inside_region = [&](uint32_t const pos) -> bool
   {
     return pos >= region_begin && pos <= region_end;
   };
 
-  long dup = -1; // -1 means no duplication
-
-  if (inside_region(variants[indexes[0]].abs_pos))
-    write_record(variants[indexes[0]], "" /*suffix*/, FILTER_ZERO_QUAL);
+  // Find the variants to write and the ID suffixes of variants with the same ID as the previous one
+  std::vector<std::size_t> written_indexes;
+  std::vector<long> dups; // -1 means no duplication
+  long dup = -1;
 
-  // Write the variants in the correct order
-  for (long i = 1; i < static_cast<long>(indexes.size()); ++i)
+  for (std::size_t i = 0; i < keys.size(); ++i)
   {
     // Make sure the variant is unique
-    if (inside_region(variants[indexes[i]].abs_pos))
+    if (inside_region(keys[i].abs_pos))
     {
-      if (!same_variant_id(variants[indexes[i]], variants[indexes[i - 1]]))
+      if (i == 0 || !same_variant_id(keys[i], keys[i - 1]))
       {
-        write_record(variants[indexes[i]], "" /*suffix*/, FILTER_ZERO_QUAL);
         dup = -1;
       }
       else
       {
         ++dup;
         assert(dup >= 0);
-        write_record(variants[indexes[i]], std::string(".") + std::to_string(dup), FILTER_ZERO_QUAL);
       }
+
+      written_indexes.push_back(keys[i].index);
+      dups.push_back(dup);
     }
   }
+
+  // Records are formatted in parallel in blocks of about a megabyte and written in order
+  std::size_t const NUM_THREADS = std::max(1u, Options::instance()->threads);
+  std::size_t const RECORDS_PER_BLOCK = std::max(1ul, 1048576ul / (256ul + 32ul * sample_names.size()));
+  std::vector<TextBuffer> blocks(NUM_THREADS);
+
+  auto format_block = [&](std::size_t const b, std::size_t const begin, std::size_t const end)
+  {
+    blocks[b].clear();
+
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      std::string const suffix = dups[i] == -1 ? std::string() : std::string(".") + std::to_string(dups[i]);
+      format_record(variants[written_indexes[i]], suffix, FILTER_ZERO_QUAL, blocks[b]);
+    }
+  };
+
+  for (std::size_t begin = 0; begin < written_indexes.size(); begin += NUM_THREADS * RECORDS_PER_BLOCK)
+  {
+    std::vector<std::thread> threads;
+
+    for (std::size_t b = 1; b < NUM_THREADS; ++b)
+    {
+      std::size_t const block_begin = std::min(written_indexes.size(), begin + b * RECORDS_PER_BLOCK);
+      std::size_t const block_end = std::min(written_indexes.size(), block_begin + RECORDS_PER_BLOCK);
+
+      if (block_begin < block_end)
+        threads.emplace_back(format_block, b, block_begin, block_end);
+    }
+
+    format_block(0, begin, std::min(written_indexes.size(), begin + RECORDS_PER_BLOCK));
+
+    for (auto & thread : threads)
+      thread.join();
+
+    for (std::size_t b = 0; b <= threads.size(); ++b)
+      bgzf_stream.write(blocks[b]);
+  }
 }
 
 
@@ -1174,10 +1426,12 @@ Vcf::close_vcf_file()
 
   if (vcf_file)
   {
-    ifclose(vcf_file);
-    delete vcf_file;
+    bgzf_close(vcf_file);
     vcf_file = nullptr;
   }
+
+  read_pos = 0;
+  read_end = 0;
 }
 
 
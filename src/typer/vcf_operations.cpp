@@ -1,17 +1,172 @@
+#include <algorithm> // std::max, std::min
 #include <cmath> // sqrt
+#include <cstdlib> // free
+#include <cstring> // memcmp, memmove
 #include <iostream> // std::cout, std::endl
 #include <string> // std::string
 #include <sstream> // std::ostringstream
+#include <thread> // std::thread
 #include <vector> // std::vector
 
+#include <boost/algorithm/string/predicate.hpp> // boost::algorithm::ends_with, boost::algorithm::starts_with
 #include <boost/log/trivial.hpp> // BOOST_LOG_TRIVIAL
 
+#include "bgzf.h" // part of htslib
+#include "hfile.h" // part of htslib
+#include "kstring.h" // part of htslib
+
 #include <graphtyper/graph/absolute_position.hpp>
 #include <graphtyper/graph/genomic_region.hpp>
 #include <graphtyper/typer/vcf_operations.hpp>
 #include <graphtyper/typer/vcf.hpp> // gyper::Vcf
 #include <graphtyper/typer/var_stats.hpp> // gyper::join_strand_bias, gyper::split_bias_to_strings
+#include <graphtyper/utilities/options.hpp> // gyper::Options
+
+
+namespace
+{
+
+/** \brief Number of records read from each VCF at a time when merging. */
+std::size_t const MERGE_BATCH_SIZE = 64;
+
+
+/** \brief Reads up to 'max_records' records from each VCF. The VCFs are split between 'num_threads' threads. */
+void
+read_record_batches(std::vector<gyper::Vcf> & vcfs, std::size_t const max_records, std::size_t const num_threads)
+{
+  auto read_vcfs = [&](std::size_t const t)
+  {
+    for (std::size_t i = t; i < vcfs.size(); i += num_threads)
+    {
+      for (std::size_t r = 0; r < max_records && vcfs[i].read_record(); ++r)
+      {}
+    }
+  };
+
+  std::vector<std::thread> threads;
+
+  for (std::size_t t = 1; t < std::min(num_threads, vcfs.size()); ++t)
+    threads.emplace_back(read_vcfs, t);
+
+  read_vcfs(0);
+
+  for (auto & thread : threads)
+    thread.join();
+}
+
+
+/** \brief The empty BGZF block which marks the end of a BGZF file. */
+char const BGZF_EOF_MARKER[28] = {
+  '\037', '\213', '\010', '\4', '\0', '\0', '\0', '\0', '\0', '\377', '\6', '\0', '\102', '\103',
+  '\2', '\0', '\033', '\0', '\3', '\0', '\0', '\0', '\0', '\0', '\0', '\0', '\0', '\0'
+};
+
+
+/**
+ * \brief Reads the header of a BGZF compressed VCF, up to and including the line with the sample names.
+ * \details 'header' gets the whole header and 'layout' the lines which must be the same in VCFs which are
+ *          concatenated, i.e. the contigs and the sample names. Returns false if there is no line with sample names.
+ */
+bool
+read_bgzf_vcf_header(BGZF * fp, std::string & header, std::string & layout)
+{
+  kstring_t line = {0, 0, nullptr};
+  bool has_samples = false;
+
+  while (bgzf_getline(fp, '\n', &line) >= 0)
+  {
+    std::string const header_line(line.s, line.l);
+
+    if (header_line.size() == 0 || header_line[0] != '#')
+      break; // A record before the line with sample names
 
+    header.append(header_line);
+    header.push_back('\n');
+
+    if (boost::algorithm::starts_with(header_line, "##contig="))
+    {
+      layout.append(header_line);
+      layout.push_back('\n');
+    }
+    else if (header_line.size() == 1 || header_line[1] != '#')
+    {
+      layout.append(header_line);
+      has_samples = true;
+      break;
+    }
+  }
+
+  free(line.s);
+  return has_samples;
+}
+
+
+/**
+ * \brief Copies the rest of a BGZF file after its header to 'out'.
+ * \details Records which are in the same block as the end of the header are recompressed and the block is flushed,
+ *          after that the compressed blocks are copied verbatim. The end-of-file marker of the input is not copied.
+ *
+ *          This depends on the layout of htslib's BGZF struct without a thread pool: 'uncompressed_block' holds the
+ *          last decompressed block, of which 'block_offset' out of 'block_length' bytes have been read, and 'fp' is
+ *          the hFILE positioned right after that block. With a thread pool ('mt' is set) blocks are read ahead and
+ *          written behind, so false is returned for such files.
+ */
+bool
+copy_bgzf_blocks(BGZF * fp, BGZF * out)
+{
+  if (fp->mt != nullptr || out->mt != nullptr)
+  {
+    BOOST_LOG_TRIVIAL(warning) << "[graphtyper::vcf_operations] BGZF blocks cannot be copied with a thread pool.";
+    return false;
+  }
+
+  // Write the records which were decompressed along with the end of the header
+  if (fp->block_offset < fp->block_length)
+  {
+    char const * records = static_cast<char const *>(fp->uncompressed_block) + fp->block_offset;
+
+    if (bgzf_write(out, records, fp->block_length - fp->block_offset) < 0)
+      return false;
+  }
+
+  if (bgzf_flush(out) < 0)
+    return false;
+
+  // Hold back the last bytes read, in case they are the end-of-file marker
+  std::size_t const COPY_SIZE = 1048576;
+  std::size_t const EOF_SIZE = sizeof(BGZF_EOF_MARKER);
+  std::vector<char> buffer(COPY_SIZE + EOF_SIZE);
+  std::size_t held = 0;
+
+  while (true)
+  {
+    ssize_t const num_read = hread(fp->fp, buffer.data() + held, COPY_SIZE);
+
+    if (num_read < 0)
+      return false;
+    else if (num_read == 0)
+      break;
+
+    held += num_read;
+
+    if (held > EOF_SIZE)
+    {
+      if (hwrite(out->fp, buffer.data(), held - EOF_SIZE) != static_cast<ssize_t>(held - EOF_SIZE))
+        return false;
+
+      std::memmove(buffer.data(), buffer.data() + held - EOF_SIZE, EOF_SIZE);
+      held = EOF_SIZE;
+    }
+  }
+
+  if (held == EOF_SIZE && std::memcmp(buffer.data(), BGZF_EOF_MARKER, EOF_SIZE) == 0)
+    return true;
+
+  return held == 0 || hwrite(out->fp, buffer.data(), held) == static_cast<ssize_t>(held);
+}
+
+
+} // anon namespace
 
 
 namespace gyper
@@ -21,48 +176,47 @@ void
 vcf_merge(std::vector<std::string> & vcfs, std::string const & output)
 {
   // Skip if the filename contains '*'
-  vcfs.erase(std::remove_if(vcfs.begin(), vcfs.end(), [](std::string const & vcf){
-      return std::count(vcf.begin(), vcf.end(), '*') > 0;
-    }), vcfs.end());
+  std::vector<std::string> kept_vcfs;
 
-  if (vcfs.size() == 0)
+  for (auto const & vcf_filename : vcfs)
+  {
+    if (std::count(vcf_filename.begin(), vcf_filename.end(), '*') > 0)
+      continue;
+
+    kept_vcfs.push_back(vcf_filename);
+  }
+
+  if (kept_vcfs.size() == 0)
     return;
 
+  // The VCFs have the same records in the same order. The records are read in batches from all VCFs and merged,
+  // so only a batch of records of each VCF is in memory at a time
+  std::vector<gyper::Vcf> in_vcfs(kept_vcfs.size());
   gyper::Vcf vcf;
-  vcf.open(READ_MODE, vcfs.at(0));
-  vcf.read(); // Read the entire file
-  vcf.open(WRITE_MODE, output); // Change to write mode
+  vcf.open(WRITE_MODE, output);
   vcf.open_for_writing();
 
-  std::vector<gyper::Vcf> next_vcfs(vcfs.size() - 1);
-
   // For checking if we have duplicated IDs
   long dup = -1l;
   uint32_t old_abs_pos = static_cast<uint32_t>(-1);
   std::string old_variant_type = "";
 
   // Open all VCFs and add sample names
-  for (std::size_t i = 1; i < vcfs.size(); ++i)
+  for (std::size_t i = 0; i < kept_vcfs.size(); ++i)
   {
-    if (std::count(vcfs[i].begin(), vcfs[i].end(), '*') > 0)
-      continue;
-
-    gyper::Vcf & next_vcf = next_vcfs[i - 1];
-    next_vcf.open(READ_MODE, vcfs[i]);
+    gyper::Vcf & in_vcf = in_vcfs[i];
+    in_vcf.open(READ_MODE, kept_vcfs[i]);
 
     // Open the VCF file
-    next_vcf.open_vcf_file_for_reading();
+    in_vcf.open_vcf_file_for_reading();
 
-    if (next_vcf.vcf_file)
-    {
-      // Read the sample names and add them
-      next_vcf.read_samples();
+    // Read the sample names and add them
+    in_vcf.read_samples();
 
-      // Add samples names (we chose to copy them for assertions when reading the records)
-      vcf.sample_names.insert(vcf.sample_names.end(),
-                              next_vcf.sample_names.begin(),
-                              next_vcf.sample_names.end());
-    }
+    // Add samples names (we chose to copy them for assertions when reading the records)
+    vcf.sample_names.insert(vcf.sample_names.end(),
+                            in_vcf.sample_names.begin(),
+                            in_vcf.sample_names.end());
   }
 
   BOOST_LOG_TRIVIAL(info) << "[graphtyper::vcf_operations::vcf_merge] "
@@ -70,310 +224,406 @@ vcf_merge(std::vector<std::string> & vcfs, std::string const & output)
                           << vcf.sample_names.size();
 
   vcf.write_header(); // Now that we know all the sample names we can write the header
+  std::size_t const NUM_THREADS = std::max(1u, Options::instance()->threads);
 
-  // For each variant in the first VCF, add the calls from the other VCFs
-  for (auto & var : vcf.variants)
+  while (true)
   {
-    // CR
-    uint32_t number_of_clipped_reads = 0;
+    read_record_batches(in_vcfs, MERGE_BATCH_SIZE, NUM_THREADS);
+    std::size_t const num_records = in_vcfs[0].variants.size();
 
-    {
-      auto find_it = var.infos.find("CR");
+    if (num_records == 0)
+      break; // All records of the first VCF have been merged
 
-      if (find_it != var.infos.end())
-        number_of_clipped_reads = std::strtoull(find_it->second.c_str(), NULL, 10);
+    for (auto const & in_vcf : in_vcfs)
+    {
+      if (in_vcf.variants.size() < num_records)
+      {
+        BOOST_LOG_TRIVIAL(error) << "[graphtyper::vcf_operations::vcf_merge] "
+                                 << "There was a problem reading "
+                                 << in_vcf.filename << ".";
+        std::exit(1);
+      }
     }
 
-    // Unaligned
-    uint32_t number_of_unaligned_reads = 0;
-
+    // For each variant in the first VCF, add the calls from the other VCFs
+    for (std::size_t r = 0; r < num_records; ++r)
     {
-      auto find_it = var.infos.find("Unaligned");
+      Variant & var = in_vcfs[0].variants[r];
 
-      if (find_it != var.infos.end())
-        number_of_unaligned_reads = std::strtoull(find_it->second.c_str(), NULL, 10);
-    }
+      // CR
+      uint32_t number_of_clipped_reads = 0;
 
-    // MQ. Keep track of the total mapping quality rooted/squared
-    uint64_t total_mapq_root = var.get_rooted_mapq();
+      {
+        auto find_it = var.infos.find("CR");
 
-    // MQ0
-    uint32_t mapq_zero_count = 0;
+        if (find_it != var.infos.end())
+          number_of_clipped_reads = std::strtoull(find_it->second.c_str(), NULL, 10);
+      }
 
-    {
-      auto find_it = var.infos.find("MQ0");
-      if (find_it != var.infos.end())
-        mapq_zero_count = std::strtoull(find_it->second.c_str(), NULL, 10);
-    }
+      // Unaligned
+      uint32_t number_of_unaligned_reads = 0;
 
-    // MQperAllele
-    std::vector<uint64_t> total_mapq_per_allele = var.get_rooted_mapq_per_allele();
+      {
+        auto find_it = var.infos.find("Unaligned");
 
-    // SBF and SBR
-    std::vector<uint32_t> strand_forward;
-    std::vector<uint32_t> strand_reverse;
+        if (find_it != var.infos.end())
+          number_of_unaligned_reads = std::strtoull(find_it->second.c_str(), NULL, 10);
+      }
 
-    std::vector<uint32_t> r1_strand_forward;
-    std::vector<uint32_t> r1_strand_reverse;
-    std::vector<uint32_t> r2_strand_forward;
-    std::vector<uint32_t> r2_strand_reverse;
+      // MQ. Keep track of the total mapping quality rooted/squared
+      uint64_t total_mapq_root = var.get_rooted_mapq();
 
-    std::vector<uint32_t> realignment_distance;
-    std::vector<uint32_t> realignment_count;
+      // MQ0
+      uint32_t mapq_zero_count = 0;
 
-    {
-      auto find_it = var.infos.find("SBF");
+      {
+        auto find_it = var.infos.find("MQ0");
+        if (find_it != var.infos.end())
+          mapq_zero_count = std::strtoull(find_it->second.c_str(), NULL, 10);
+      }
 
-      if (find_it != var.infos.end())
-        strand_forward = split_bias_to_numbers(find_it->second);
+      // MQperAllele
+      std::vector<uint64_t> total_mapq_per_allele = var.get_rooted_mapq_per_allele();
 
-      find_it = var.infos.find("SBR");
+      // SBF and SBR
+      std::vector<uint32_t> strand_forward;
+      std::vector<uint32_t> strand_reverse;
 
-      if (find_it != var.infos.end())
-        strand_reverse = split_bias_to_numbers(find_it->second);
+      std::vector<uint32_t> r1_strand_forward;
+      std::vector<uint32_t> r1_strand_reverse;
+      std::vector<uint32_t> r2_strand_forward;
+      std::vector<uint32_t> r2_strand_reverse;
 
-      // Read specific strand bias
-      find_it = var.infos.find("SBF1");
+      std::vector<uint32_t> realignment_distance;
+      std::vector<uint32_t> realignment_count;
 
-      if (find_it != var.infos.end())
-        r1_strand_forward = split_bias_to_numbers(find_it->second);
+      {
+        auto find_it = var.infos.find("SBF");
 
-      find_it = var.infos.find("SBF2");
+        if (find_it != var.infos.end())
+          strand_forward = split_bias_to_numbers(find_it->second);
 
-      if (find_it != var.infos.end())
-        r2_strand_forward = split_bias_to_numbers(find_it->second);
+        find_it = var.infos.find("SBR");
 
-      find_it = var.infos.find("SBR1");
+        if (find_it != var.infos.end())
+          strand_reverse = split_bias_to_numbers(find_it->second);
 
-      if (find_it != var.infos.end())
-        r1_strand_reverse = split_bias_to_numbers(find_it->second);
+        // Read specific strand bias
+        find_it = var.infos.find("SBF1");
 
-      find_it = var.infos.find("SBR2");
+        if (find_it != var.infos.end())
+          r1_strand_forward = split_bias_to_numbers(find_it->second);
 
-      if (find_it != var.infos.end())
-        r2_strand_reverse = split_bias_to_numbers(find_it->second);
+        find_it = var.infos.find("SBF2");
 
-      // Realignment count and distance
-      find_it = var.infos.find("RACount");
+        if (find_it != var.infos.end())
+          r2_strand_forward = split_bias_to_numbers(find_it->second);
 
-      if (find_it != var.infos.end())
-        realignment_count = split_bias_to_numbers(find_it->second);
+        find_it = var.infos.find("SBR1");
 
-      find_it = var.infos.find("RADist");
+        if (find_it != var.infos.end())
+          r1_strand_reverse = split_bias_to_numbers(find_it->second);
 
-      if (find_it != var.infos.end())
-        realignment_distance = split_bias_to_numbers(find_it->second);
-    }
+        find_it = var.infos.find("SBR2");
 
-    for (auto & next_vcf : next_vcfs)
-    {
-      if (!next_vcf.vcf_file)
-        continue;
+        if (find_it != var.infos.end())
+          r2_strand_reverse = split_bias_to_numbers(find_it->second);
 
-      assert(next_vcf.variants.size() == 0);
-      bool const SUCCESS = next_vcf.read_record();
+        // Realignment count and distance
+        find_it = var.infos.find("RACount");
 
-      if (!SUCCESS)
-      {
-        BOOST_LOG_TRIVIAL(error) << "[graphtyper::vcf_operations::vcf_merge] "
-                                 << "There was a problem reading "
-                                 << next_vcf.filename << ".";
-        std::exit(1);
-      }
+        if (find_it != var.infos.end())
+          realignment_count = split_bias_to_numbers(find_it->second);
 
-      assert(next_vcf.variants.size() == 1);
+        find_it = var.infos.find("RADist");
+
+        if (find_it != var.infos.end())
+          realignment_distance = split_bias_to_numbers(find_it->second);
+      }
 
-      // Get CR
+      for (std::size_t i = 1; i < in_vcfs.size(); ++i)
       {
-        auto find_it = next_vcf.variants[0].infos.find("CR");
+        Variant & next_var = in_vcfs[i].variants[r];
 
-        if (find_it != next_vcf.variants[0].infos.end())
-          number_of_clipped_reads += std::strtoull(find_it->second.c_str(), NULL, 10);
-      }
+        // Get CR
+        {
+          auto find_it = next_var.infos.find("CR");
 
-      // Get MQ
-      total_mapq_root += next_vcf.variants[0].get_rooted_mapq();
+          if (find_it != next_var.infos.end())
+            number_of_clipped_reads += std::strtoull(find_it->second.c_str(), NULL, 10);
+        }
 
-      // Get MQ0
-      {
-        auto find_it = next_vcf.variants[0].infos.find("MQ0");
+        // Get MQ
+        total_mapq_root += next_var.get_rooted_mapq();
 
-        if (find_it != next_vcf.variants[0].infos.end())
-          mapq_zero_count += std::strtoull(find_it->second.c_str(), NULL, 10);
-      }
+        // Get MQ0
+        {
+          auto find_it = next_var.infos.find("MQ0");
 
-      // Get MQperAllele
-      {
-        std::vector<uint64_t> new_mapq_per_allele =
-          next_vcf.variants[0].get_rooted_mapq_per_allele();
+          if (find_it != next_var.infos.end())
+            mapq_zero_count += std::strtoull(find_it->second.c_str(), NULL, 10);
+        }
 
-        assert(new_mapq_per_allele.size() == total_mapq_per_allele.size());
+        // Get MQperAllele
+        {
+          std::vector<uint64_t> new_mapq_per_allele =
+            next_var.get_rooted_mapq_per_allele();
 
-        for (std::size_t m = 0; m < new_mapq_per_allele.size(); ++m)
-          total_mapq_per_allele[m] += new_mapq_per_allele[m];
-      }
+          assert(new_mapq_per_allele.size() == total_mapq_per_allele.size());
 
-      // Get SBF and SBR
-      {
-        auto add_to_bias_lambda = [&](std::string id, std::vector<uint32_t> & bias)
-                                  {
-                                    auto find_it = next_vcf.variants[0].infos.find(id);
+          for (std::size_t m = 0; m < new_mapq_per_allele.size(); ++m)
+            total_mapq_per_allele[m] += new_mapq_per_allele[m];
+        }
 
-                                    if (find_it != next_vcf.variants[0].infos.end())
+        // Get SBF and SBR
+        {
+          auto add_to_bias_lambda = [&](std::string id, std::vector<uint32_t> & bias)
                                     {
-                                      std::vector<uint32_t> split_nums =
-                                        split_bias_to_numbers(find_it->second);
+                                      auto find_it = next_var.infos.find(id);
 
-                                      for (std::size_t i = 0; i < split_nums.size(); ++i)
+                                      if (find_it != next_var.infos.end())
                                       {
-                                        if (i < strand_forward.size())
-                                          bias[i] += split_nums[i];
-                                        else
-                                          bias.push_back(split_nums[i]);
+                                        std::vector<uint32_t> split_nums =
+                                          split_bias_to_numbers(find_it->second);
+
+                                        for (std::size_t i = 0; i < split_nums.size(); ++i)
+                                        {
+                                          if (i < strand_forward.size())
+                                            bias[i] += split_nums[i];
+                                          else
+                                            bias.push_back(split_nums[i]);
+                                        }
                                       }
-                                    }
-                                  };
-
-        add_to_bias_lambda("SBF", strand_forward);
-        add_to_bias_lambda("SBR", strand_reverse);
-        add_to_bias_lambda("SBF1", r1_strand_forward);
-        add_to_bias_lambda("SBF2", r2_strand_forward);
-        add_to_bias_lambda("SBR1", r1_strand_reverse);
-        add_to_bias_lambda("SBR2", r2_strand_reverse);
-        add_to_bias_lambda("RACount", realignment_count);
-        add_to_bias_lambda("RADist", realignment_distance);
-      }
-
-      std::move(next_vcf.variants[0].calls.begin(),
-                next_vcf.variants[0].calls.end(),
-                std::back_inserter(var.calls));
+                                    };
+
+          add_to_bias_lambda("SBF", strand_forward);
+          add_to_bias_lambda("SBR", strand_reverse);
+          add_to_bias_lambda("SBF1", r1_strand_forward);
+          add_to_bias_lambda("SBF2", r2_strand_forward);
+          add_to_bias_lambda("SBR1", r1_strand_reverse);
+          add_to_bias_lambda("SBR2", r2_strand_reverse);
+          add_to_bias_lambda("RACount", realignment_count);
+          add_to_bias_lambda("RADist", realignment_distance);
+        }
 
-      std::move(next_vcf.variants[0].phase.begin(),
-                next_vcf.variants[0].phase.end(),
-                std::back_inserter(var.phase));
+        std::move(next_var.calls.begin(),
+                  next_var.calls.end(),
+                  std::back_inserter(var.calls));
 
-      next_vcf.variants.clear();
-    }
+        std::move(next_var.phase.begin(),
+                  next_var.phase.end(),
+                  std::back_inserter(var.phase));
 
-    // Add strand bias, this must happend before the INFO is generated
-    var.infos["SBF"] = join_strand_bias(strand_forward);
-    var.infos["SBR"] = join_strand_bias(strand_reverse);
+        next_var = Variant(); // Free memory
+      }
 
-    var.infos["SBF1"] = join_strand_bias(r1_strand_forward);
-    var.infos["SBF2"] = join_strand_bias(r2_strand_forward);
-    var.infos["SBR1"] = join_strand_bias(r1_strand_reverse);
-    var.infos["SBR2"] = join_strand_bias(r2_strand_reverse);
+      // Add strand bias, this must happend before the INFO is generated
+      var.infos["SBF"] = join_strand_bias(strand_forward);
+      var.infos["SBR"] = join_strand_bias(strand_reverse);
 
-    var.infos["RACount"] = join_strand_bias(realignment_count);
-    var.infos["RADist"] = join_strand_bias(realignment_distance);
+      var.infos["SBF1"] = join_strand_bias(r1_strand_forward);
+      var.infos["SBF2"] = join_strand_bias(r2_strand_forward);
+      var.infos["SBR1"] = join_strand_bias(r1_strand_reverse);
+      var.infos["SBR2"] = join_strand_bias(r2_strand_reverse);
 
-    // MQ requires the generated INFOs
-    var.generate_infos();
+      var.infos["RACount"] = join_strand_bias(realignment_count);
+      var.infos["RADist"] = join_strand_bias(realignment_distance);
 
-    // Add MQ
-    {
-      uint64_t const seq_depth = var.get_seq_depth();
+      // MQ requires the generated INFOs
+      var.generate_infos();
 
-      if (seq_depth > 0)
+      // Add MQ
       {
-        var.infos["MQ"] = std::to_string(
-          static_cast<uint16_t>(sqrt(static_cast<double>(total_mapq_root) /
-                                     static_cast<double>(seq_depth)))
-          );
+        uint64_t const seq_depth = var.get_seq_depth();
+
+        if (seq_depth > 0)
+        {
+          var.infos["MQ"] = std::to_string(
+            static_cast<uint16_t>(sqrt(static_cast<double>(total_mapq_root) /
+                                       static_cast<double>(seq_depth)))
+            );
+        }
+        else
+        {
+          var.infos["MQ"] = "255";
+        }
       }
-      else
+
+      // MQperAllele
+      if (total_mapq_per_allele.size() > 0)
       {
-        var.infos["MQ"] = "255";
-      }
-    }
+        std::ostringstream ss;
+        std::size_t m = 0;
+        uint64_t seq_depth = var.get_seq_depth_of_allele(0);
 
-    // MQperAllele
-    if (total_mapq_per_allele.size() > 0)
-    {
-      std::ostringstream ss;
-      std::size_t m = 0;
-      uint64_t seq_depth = var.get_seq_depth_of_allele(0);
+        if (seq_depth > 0)
+        {
+          ss <<
+            static_cast<uint16_t>(sqrt(static_cast<double>(total_mapq_per_allele[m]) /
+                                       static_cast<double>(seq_depth)));
+        }
+        else
+        {
+          ss << 255u;
+        }
 
-      if (seq_depth > 0)
-      {
-        ss <<
-          static_cast<uint16_t>(sqrt(static_cast<double>(total_mapq_per_allele[m]) /
-                                     static_cast<double>(seq_depth)));
+        for (m = 1; m < total_mapq_per_allele.size(); ++m)
+        {
+          seq_depth = var.get_seq_depth_of_allele(m);
+
+          if (seq_depth > 0)
+          {
+            ss << ',' <<
+              static_cast<uint16_t>(sqrt(static_cast<double>(total_mapq_per_allele[m]) /
+                                         static_cast<double>(seq_depth)));
+          }
+          else
+          {
+            ss << ',' << 255u;
+          }
+        }
+
+        var.infos["MQperAllele"] = ss.str();
       }
-      else
+
+      // Add MQ0
+      var.infos["MQ0"] = std::to_string(mapq_zero_count);
+
+      // Add CR
+      var.infos["CR"] = std::to_string(number_of_clipped_reads);
+
+      // Add number of unaligned reads
+      var.infos["Unaligned"] = std::to_string(number_of_unaligned_reads);
+
+      // Do not remove uncalled alleles as it will mess up cases when multiple vcf_merges are run.
+      //var.remove_uncalled_alleles();
+
+      if (var.calls.size() != vcf.sample_names.size())
       {
-        ss << 255u;
+        BOOST_LOG_TRIVIAL(error) << "[graphtyper::vcf_operations::vcf_merge] Number of calls "
+                                 << "a variant had did not matches the number of samples "
+                                 << var.calls.size() << " vs. " << vcf.sample_names.size();
+        std::exit(1);
       }
 
-      for (m = 1; m < total_mapq_per_allele.size(); ++m)
+      // Only write variants if they have any alternative alleles
+      if (var.seqs.size() >= 2)
       {
-        seq_depth = var.get_seq_depth_of_allele(m);
+        std::string const & new_variant_type = var.determine_variant_type();
 
-        if (seq_depth > 0)
+        // Check if this is duplicated ID, and if so make them unique by adding a suffix to the ID
+        if (old_abs_pos != var.abs_pos || old_variant_type != new_variant_type)
         {
-          ss << ',' <<
-            static_cast<uint16_t>(sqrt(static_cast<double>(total_mapq_per_allele[m]) /
-                                       static_cast<double>(seq_depth)));
+          vcf.write_record(var, "" /*suffix*/);
+          dup = -1;
         }
         else
         {
-          ss << ',' << 255u;
+          ++dup;
+          assert(dup >= 0l);
+          vcf.write_record(var, std::string(".") + std::to_string(dup) /*suffix*/);
         }
+
+        old_abs_pos = var.abs_pos;
+        old_variant_type = new_variant_type;
       }
 
-      var.infos["MQperAllele"] = ss.str();
+      var = Variant(); // Free memory
     }
 
-    // Add MQ0
-    var.infos["MQ0"] = std::to_string(mapq_zero_count);
+    for (auto & in_vcf : in_vcfs)
+      in_vcf.variants.clear();
+  }
+
+  // Close all the files
+  for (auto & in_vcf : in_vcfs)
+    in_vcf.close_vcf_file();
 
-    // Add CR
-    var.infos["CR"] = std::to_string(number_of_clipped_reads);
+  vcf.close_vcf_file();
+}
 
-    // Add number of unaligned reads
-    var.infos["Unaligned"] = std::to_string(number_of_unaligned_reads);
 
-    // Do not remove uncalled alleles as it will mess up cases when multiple vcf_merges are run.
-    //var.remove_uncalled_alleles();
+bool
+vcf_concatenate_bgzf_blocks(std::vector<std::string> const & vcfs, std::string const & output)
+{
+  if (!boost::algorithm::ends_with(output, ".vcf.gz"))
+    return false;
 
-    if (var.calls.size() != vcf.sample_names.size())
+  std::vector<std::string> in_vcfs;
+
+  // Skip if the filename contains '*'
+  for (auto const & vcf : vcfs)
+  {
+    if (std::count(vcf.begin(), vcf.end(), '*') == 0)
+      in_vcfs.push_back(vcf);
+  }
+
+  if (in_vcfs.size() == 0)
+    return false;
+
+  // Check that all VCFs are BGZF compressed and have the same contigs and samples before anything is written
+  std::string first_header;
+  std::string first_layout;
+
+  for (std::size_t i = 0; i < in_vcfs.size(); ++i)
+  {
+    BGZF * fp = bgzf_open(in_vcfs[i].c_str(), "r");
+    std::string header;
+    std::string layout;
+    bool const is_compatible = fp && bgzf_compression(fp) == 2 && read_bgzf_vcf_header(fp, header, layout) &&
+                               (i == 0 || layout == first_layout);
+
+    if (fp)
+      bgzf_close(fp);
+
+    if (!is_compatible)
     {
-      BOOST_LOG_TRIVIAL(error) << "[graphtyper::vcf_operations::vcf_merge] Number of calls "
-                               << "a variant had did not matches the number of samples "
-                               << var.calls.size() << " vs. " << vcf.sample_names.size();
-      std::exit(1);
+      BOOST_LOG_TRIVIAL(warning) << "[graphtyper::vcf_operations] Cannot copy the BGZF blocks of " << in_vcfs[i]
+                                 << ", it is either not BGZF compressed or its contigs or samples differ from "
+                                 << in_vcfs[0] << ".";
+      return false;
     }
 
-    // Only write variants if they have any alternative alleles
-    if (var.seqs.size() >= 2)
+    if (i == 0)
     {
-      std::string const & new_variant_type = var.determine_variant_type();
+      first_header = std::move(header);
+      first_layout = std::move(layout);
+    }
+  }
 
-      // Check if this is duplicated ID, and if so make them unique by adding a suffix to the ID
-      if (old_abs_pos != var.abs_pos || old_variant_type != new_variant_type)
-      {
-        vcf.write_record(var, "" /*suffix*/);
-        dup = -1;
-      }
-      else
-      {
-        ++dup;
-        assert(dup >= 0l);
-        vcf.write_record(var, std::string(".") + std::to_string(dup) /*suffix*/);
-      }
+  BGZF * out = bgzf_open(output.c_str(), "w");
+
+  if (!out || bgzf_write(out, first_header.data(), first_header.size()) < 0)
+  {
+    BOOST_LOG_TRIVIAL(error) << "[graphtyper::vcf_operations] Could not write to " << output << ".";
+    std::exit(1);
+  }
+
+  for (auto const & vcf : in_vcfs)
+  {
+    BGZF * fp = bgzf_open(vcf.c_str(), "r");
+    std::string header;
+    std::string layout;
 
-      old_abs_pos = var.abs_pos;
-      old_variant_type = new_variant_type;
+    if (!fp || !read_bgzf_vcf_header(fp, header, layout) || !copy_bgzf_blocks(fp, out))
+    {
+      BOOST_LOG_TRIVIAL(error) << "[graphtyper::vcf_operations] Failed copying the records of " << vcf << " to "
+                               << output << ".";
+      std::exit(1);
     }
 
-    var = Variant(); // Free memory
+    bgzf_close(fp);
   }
 
-  // Close all the files
-  for (auto & next_vcf : next_vcfs)
-    next_vcf.close_vcf_file();
+  if (bgzf_close(out) < 0)
+  {
+    BOOST_LOG_TRIVIAL(error) << "[graphtyper::vcf_operations] Could not close " << output << ".";
+    std::exit(1);
+  }
 
-  vcf.close_vcf_file();
+  BOOST_LOG_TRIVIAL(info) << "[graphtyper::vcf_operations] Concatenated the BGZF blocks of " << in_vcfs.size()
+                          << " VCFs.";
+  return true;
 }
 
 
@@ -382,8 +632,24 @@ vcf_concatenate(std::vector<std::string> const & vcfs,
                 std::string const & output,
                 bool const SKIP_SORT,
                 bool const SITES_ONLY,
-                std::string const & region)
+                std::string const & region,
+                bool const COPY_BLOCKS)
 {
+  if (COPY_BLOCKS)
+  {
+    if (SITES_ONLY || region != ".")
+    {
+      BOOST_LOG_TRIVIAL(warning) << "[graphtyper::vcf_operations] The BGZF blocks cannot be copied when only "
+                                 << "sites or a region are written.";
+    }
+    else if (vcf_concatenate_bgzf_blocks(vcfs, output))
+    {
+      return;
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "[graphtyper::vcf_operations] Concatenating by reading every record.";
+  }
+
   gyper::Vcf vcf;
 
   if (vcfs.size() == 0)
@@ -78,6 +78,9 @@ are_genotype_paths_good(gyper::GenotypePaths const & geno)
 namespace gyper
 {
 
+std::size_t constexpr VcfWriter::NUM_HAPLOTYPE_LOCKS;
+
+
 VcfWriter::VcfWriter(std::vector<std::string> const & samples, uint32_t variant_distance)
   : pns(samples)
   , pn(samples[0])
@@ -112,8 +115,6 @@ VcfWriter::update_haplotype_scores_from_paths(std::vector<GenotypePaths> & genos
   if (Options::instance()->is_perfect_alignments_only)
   {
     // Perfect alignments
-    std::lock_guard<std::mutex> lock(haplotype_mutex);
-
     for (auto & geno : genos)
     {
       if (are_genotype_paths_perfect(geno))
@@ -123,8 +124,6 @@ VcfWriter::update_haplotype_scores_from_paths(std::vector<GenotypePaths> & genos
   else
   {
     // Good alignments (default)
-    std::lock_guard<std::mutex> lock(haplotype_mutex);
-
     for (auto & geno : genos)
     {
       if (are_genotype_paths_good(geno))
@@ -145,8 +144,6 @@ VcfWriter::update_haplotype_scores_from_paths(
 {
   if (Options::instance()->is_perfect_alignments_only)
   {
-    std::lock_guard<std::mutex> lock(haplotype_mutex);
-
     for (auto & geno : genos)
     {
       bool const READ1_IS_GOOD = are_genotype_paths_good(geno.first);
@@ -165,8 +162,6 @@ VcfWriter::update_haplotype_scores_from_paths(
   }
   else
   {
-    std::lock_guard<std::mutex> lock(haplotype_mutex);
-
     for (auto & geno : genos)
     {
       bool const READ1_IS_GOOD = are_genotype_paths_good(geno.first);
@@ -452,6 +447,21 @@ VcfWriter::update_haplotype_scores_from_path(GenotypePaths & geno,
   std::size_t const mismatches = geno.paths[0].mismatches;
   std::vector<uint32_t> recent_ids;
 
+  for (auto const & path : geno.paths)
+  {
+    for (auto const var_order : path.var_order)
+    {
+      assert(id2hap.count(var_order) == 1);
+      recent_ids.push_back(id2hap.at(var_order).first);
+    }
+  }
+
+  std::sort(recent_ids.begin(), recent_ids.end());
+  recent_ids.erase(std::unique(recent_ids.begin(), recent_ids.end()), recent_ids.end());
+
+  // Only the haplotypes of this read are locked, so reads of other haplotypes can be scored concurrently
+  std::vector<std::unique_lock<std::mutex> > const locks = lock_haplotypes(recent_ids);
+
   for (auto p_it = geno.paths.begin(); p_it != geno.paths.end(); ++p_it)
   {
     assert(p_it->var_order.size() == p_it->nums.size());
@@ -465,7 +475,6 @@ VcfWriter::update_haplotype_scores_from_path(GenotypePaths & geno,
       assert(p_it->nums[i].any());
 
       haplotypes[type_ids.first].add_explanation(type_ids.second, p_it->nums[i]);
-      recent_ids.push_back(type_ids.first);
 
       // Add coverage if the explanation is unique
       if (p_it->nums[i].count() == 1)
@@ -490,11 +499,8 @@ VcfWriter::update_haplotype_scores_from_path(GenotypePaths & geno,
     }
   }
 
-  std::sort(recent_ids.begin(), recent_ids.end());
-  auto last = std::unique(recent_ids.begin(), recent_ids.end());
-
   // After each read, move the "explain" to the score vector.
-  for (auto it = recent_ids.begin(); it != last; ++it)
+  for (auto it = recent_ids.begin(); it != recent_ids.end(); ++it)
   {
     assert(*it < haplotypes.size());
     assert(pn_index < haplotypes[*it].hap_samples.size());
@@ -521,6 +527,29 @@ VcfWriter::update_haplotype_scores_from_path(GenotypePaths & geno,
 }
 
 
+std::vector<std::unique_lock<std::mutex> >
+VcfWriter::lock_haplotypes(std::vector<uint32_t> const & hap_ids) const
+{
+  std::vector<std::size_t> lock_ids;
+  lock_ids.reserve(hap_ids.size());
+
+  for (auto const hap_id : hap_ids)
+    lock_ids.push_back(hap_id % NUM_HAPLOTYPE_LOCKS);
+
+  // Locks are always taken in ascending order, so two threads cannot deadlock
+  std::sort(lock_ids.begin(), lock_ids.end());
+  lock_ids.erase(std::unique(lock_ids.begin(), lock_ids.end()), lock_ids.end());
+
+  std::vector<std::unique_lock<std::mutex> > locks;
+  locks.reserve(lock_ids.size());
+
+  for (auto const lock_id : lock_ids)
+    locks.emplace_back(haplotype_locks[lock_id]);
+
+  return locks;
+}
+
+
 std::vector<HaplotypeCall>
 VcfWriter::get_haplotype_calls() const
 {
@@ -620,7 +649,7 @@ VcfWriter::explain_map_specific_indexes_to_haplotype_scores(
 
 void
 VcfWriter::find_path_explanation(GenotypePaths const & gt_path,
-                                 std::vector<std::pair<uint32_t, std::bitset<MAX_NUMBER_OF_HAPLOTYPES> > > & ids_and_path_explain
+                                 std::vector<std::pair<uint32_t, CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> > > & ids_and_path_explain
                                  )
 {
   // ids_and_path_explain is a vector of haplotype_id and haplotype_explain pairs
@@ -646,7 +675,7 @@ VcfWriter::find_path_explanation(GenotypePaths const & gt_path,
   for (auto it = recent_ids.begin(); it != last_it; ++it)
   {
     assert (*it < haplotypes.size());
-    std::bitset<MAX_NUMBER_OF_HAPLOTYPES> path_explain = haplotypes[*it].explain_to_path_explain();
+    CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> path_explain = haplotypes[*it].explain_to_path_explain();
     ids_and_path_explain.push_back(std::make_pair(*it, path_explain));
     assert (ids_and_path_explain.back().second.any());
   }
@@ -479,10 +479,10 @@ remove_adapters_from_reads(TReads & reads)
     ar.remove(bases_to_erase, read_it->first.qual, read_it->second.qual);
 
     if (seqan::length(read_it->first.seq) != SIZE_BEFORE_1)
-      seqan::clear(read_it->first.cigar);
+      read_it->first.clear_cigar();
 
     if (seqan::length(read_it->second.seq) != SIZE_BEFORE_2)
-      seqan::clear(read_it->second.cigar);
+      read_it->second.clear_cigar();
   }
 
   // Delete all short read pairs
@@ -499,87 +499,4 @@ remove_adapters_from_reads(TReads & reads)
 }
 
 
-// Remove adapters from Bam records
-void
-remove_adapters(TReads & reads)
-{
-  gyper::AdapterRemoval<gyper::Illumina> ar;
-  unsigned i = 0;
-
-  for (auto read_it = reads.begin(); read_it != reads.end(); ++read_it, ++i)
-  {
-    seqan::BamTagsDict tags1(read_it->first.tags);
-
-    // Check if adapter information is already known
-    {
-      unsigned tagIdx = 0;
-
-      if (seqan::findTagKey(tagIdx, tags1, ADAPTER_TAG))
-      {
-        // The read pair has been checked for adapters. Leave it as it is.
-        continue;
-      }
-    }
-
-    auto bases_to_erase = ar.remove_adapters_from_read_read2_complemented(read_it->first.seq, read_it->second.seq);
-    // BOOST_LOG_TRIVIAL(debug) << "Case 4: " << std::get<0>(bases_to_erase) << "-" << std::get<1>(bases_to_erase) << " "
-    //                                        << std::get<2>(bases_to_erase) << "-" << std::get<3>(bases_to_erase);
-
-    // lambda function which adds the the adapter removal tag to the
-    auto set_tags = [](seqan::BamTagsDict & tags, uint16_t start, uint16_t end)
-                    {
-                      if (start == 0)
-                      {
-                        setTagValue(tags, ADAPTER_TAG, static_cast<short>(end));
-                        // BOOST_LOG_TRIVIAL(debug) << "AD = " << start << " " << end;
-                      }
-                      else
-                      {
-                        setTagValue(tags, ADAPTER_TAG, static_cast<short>(start) - static_cast<short>(end));
-                      }
-                    };
-
-    seqan::BamTagsDict tags2(read_it->second.tags);
-
-    set_tags(tags1, std::get<0>(bases_to_erase), std::get<1>(bases_to_erase));
-    set_tags(tags2, std::get<2>(bases_to_erase), std::get<3>(bases_to_erase));
-
-    // if (std::get<1>(bases_to_erase) > std::get<0>(bases_to_erase))
-    // {
-    //   // Adapter at front
-    //   assert (std::get<0>(bases_to_erase) == 0);
-    //   setTagValue(tags1, ADAPTER_TAG, static_cast<short>(std::get<1>(bases_to_erase)));
-    // }
-    // else
-    // {
-    //   // Adapter at back (or no adapter if std::get<1>(bases_to_erase) == std::get<0>(bases_to_erase))
-    //   setTagValue(tags1, ADAPTER_TAG, static_cast<short>(std::get<1>(bases_to_erase)) - static_cast<short>(std::get<0>(bases_to_erase)));
-    // }
-    //
-    //
-    //
-    // if (std::get<3>(bases_to_erase) > std::get<2>(bases_to_erase))
-    // {
-    //   // Adapter at front
-    //   assert (std::get<2>(bases_to_erase) == 0);
-    //   setTagValue(tags2, ADAPTER_TAG, static_cast<short>(std::get<3>(bases_to_erase)));
-    // }
-    // else
-    // {
-    //   // Adapter at back (or no adapter if std::get<3>(bases_to_erase) == std::get<2>(bases_to_erase))
-    //   setTagValue(tags2, ADAPTER_TAG, static_cast<short>(std::get<3>(bases_to_erase)) - static_cast<short>(std::get<2>(bases_to_erase)));
-    // }
-
-    // ar.remove(bases_to_erase, read_it->first.seq, read_it->second.seq);
-    // ar.remove(bases_to_erase, read_it->first.qual, read_it->second.qual);
-    // if (std::get<1>(bases_to_erase) - std::get<0>(bases_to_erase) == 0)
-    // {
-    //   BOOST_LOG_TRIVIAL(debug) << seqan::length(read_it->first.seq);
-    // }
-  }
-
-  BOOST_LOG_TRIVIAL(info) << "[adapter_removal] I have checked " << reads.size() << " read pairs.";
-}
-
-
 } // namespace gyper
@@ -0,0 +1,87 @@
+#include <algorithm> // std::max
+#include <cassert> // assert
+#include <cstdint> // uintptr_t
+#include <utility> // std::move
+
+#include <graphtyper/utilities/arena.hpp>
+
+
+namespace gyper
+{
+
+Arena::Arena(std::size_t const _block_size)
+  : block_size(_block_size)
+{}
+
+
+void *
+Arena::allocate(std::size_t const size, std::size_t const alignment)
+{
+  assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+  if (blocks.size() > 0)
+  {
+    Block & block = blocks.back();
+    uintptr_t const address = reinterpret_cast<uintptr_t>(block.data.get()) + used;
+    std::size_t const padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+
+    if (used + padding + size <= block.size)
+    {
+      used += padding + size;
+      return block.data.get() + used - size;
+    }
+  }
+
+  // The last block is full, all blocks are aligned for any type so no padding is needed in a new one
+  add_block(size);
+  used = size;
+  return blocks.back().data.get();
+}
+
+
+void
+Arena::reset()
+{
+  if (blocks.size() > 1)
+  {
+    // Replace the blocks with a single block large enough for all of them
+    std::size_t const total_size = capacity();
+    blocks.clear();
+    add_block(total_size);
+  }
+
+  used = 0;
+}
+
+
+std::size_t
+Arena::capacity() const
+{
+  std::size_t total_size = 0;
+
+  for (auto const & block : blocks)
+    total_size += block.size;
+
+  return total_size;
+}
+
+
+void
+Arena::add_block(std::size_t const min_size)
+{
+  Block block;
+  block.size = std::max(block_size, min_size);
+  block.data.reset(new char[block.size]);
+  blocks.push_back(std::move(block));
+}
+
+
+Arena &
+batch_arena()
+{
+  thread_local Arena arena;
+  return arena;
+}
+
+
+} // namespace gyper
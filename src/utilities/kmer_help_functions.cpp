@@ -1,8 +1,10 @@
 #include <iostream>
+#include <iterator>
 #include <vector>
 
 #include <graphtyper/index/rocksdb.hpp>
 #include <graphtyper/index/mem_index.hpp>
+#include <graphtyper/utilities/arena.hpp>
 #include <graphtyper/utilities/kmer_help_functions.hpp>
 #include <graphtyper/utilities/type_conversions.hpp>
 
@@ -73,32 +75,89 @@ query_index(TSeq const & read, MemIndex const & _mem_index)
 }
 
 
+template <typename TSeq>
+std::vector<TKmerLabels>
+query_index_batch(std::vector<TSeq> const & reads, Arena & arena, MemIndex const & _mem_index)
+{
+  // The keys are only needed while the index is queried, so they are allocated from the arena of the batch
+  ArenaVector<uint64_t> flat_keys{ArenaAllocator<uint64_t>(arena)};
+  ArenaVector<std::size_t> key_offsets{ArenaAllocator<std::size_t>(arena)};
+  ArenaVector<std::size_t> read_offsets{ArenaAllocator<std::size_t>(arena)};
+  std::size_t num_kmers = 0;
+
+  for (auto const & read : reads)
+    num_kmers += get_num_kmers(read);
+
+  // Most k-mers have a single key, reads with ambiguous bases have more
+  flat_keys.reserve(2 * num_kmers);
+  key_offsets.reserve(num_kmers + 1);
+  read_offsets.reserve(reads.size() + 1);
+
+  for (auto const & read : reads)
+  {
+    read_offsets.push_back(key_offsets.size());
+    std::size_t const num_keys = get_num_kmers(read);
+
+    for (unsigned i = 0; i < num_keys; ++i)
+    {
+      key_offsets.push_back(flat_keys.size());
+      append_uint64_vec(read, (K - 1) * i, flat_keys);
+    }
+  }
+
+  read_offsets.push_back(key_offsets.size());
+  key_offsets.push_back(flat_keys.size());
+  TKmerLabels batch_labels = _mem_index.multi_get(flat_keys, key_offsets, arena);
+  std::vector<TKmerLabels> labels(reads.size());
+
+  for (std::size_t r = 0; r < reads.size(); ++r)
+  {
+    labels[r].assign(std::make_move_iterator(batch_labels.begin() + read_offsets[r]),
+                     std::make_move_iterator(batch_labels.begin() + read_offsets[r + 1]));
+  }
+
+  return labels;
+}
+
+
 // Explicit instantation
 template std::vector<KmerLabel> query_index_for_first_kmer(seqan::IupacString const & read, MemIndex const & _mem_index);
 template std::vector<KmerLabel> query_index_for_last_kmer(seqan::IupacString const & read, MemIndex const & _mem_index);
 template std::vector<std::vector<KmerLabel> > query_index<seqan::Dna5String>(seqan::Dna5String const &, MemIndex const & mem_index);
 template std::vector<std::vector<KmerLabel> > query_index<seqan::IupacString>(seqan::IupacString const &, MemIndex const & mem_index);
+template std::vector<TKmerLabels> query_index_batch<seqan::IupacString>(std::vector<seqan::IupacString> const &,
+                                                                                 Arena &,
+                                                                                 MemIndex const & mem_index);
 
 
 template <typename TSeq>
 std::vector<std::vector<KmerLabel> >
-query_index_hamming_distance1(TSeq const & read, gyper::MemIndex const & _mem_index)
+query_index_hamming_distance1(TSeq const & read, Hamming1QueryBuffers & buffers, gyper::MemIndex const & _mem_index)
 {
-  std::vector<std::vector<uint64_t> > multi_keys;
   std::size_t const num_keys = get_num_kmers(read);
+  buffers.keys.clear();
+  buffers.key_offsets.clear();
 
   for (unsigned i = 0; i < num_keys; ++i)
-    multi_keys.push_back(to_uint64_vec(read, (K - 1) * i));
+  {
+    buffers.key_offsets.push_back(buffers.keys.size());
+    append_uint64_vec(read, (K - 1) * i, buffers.keys);
+  }
 
-  return _mem_index.multi_get_hamming1(multi_keys);
+  buffers.key_offsets.push_back(buffers.keys.size());
+  return _mem_index.multi_get_hamming1(buffers);
 }
 
 
 // Explicit instantation
 template std::vector<std::vector<KmerLabel> >
-query_index_hamming_distance1<seqan::Dna5String>(seqan::Dna5String const &, gyper::MemIndex const &);
+query_index_hamming_distance1<seqan::Dna5String>(seqan::Dna5String const &,
+                                                 Hamming1QueryBuffers &,
+                                                 gyper::MemIndex const &);
 template std::vector<std::vector<KmerLabel> >
-query_index_hamming_distance1<seqan::IupacString>(seqan::IupacString const &, gyper::MemIndex const &);
+query_index_hamming_distance1<seqan::IupacString>(seqan::IupacString const &,
+                                                  Hamming1QueryBuffers &,
+                                                  gyper::MemIndex const &);
 
 
 template <typename TSeq>
@@ -1,4 +1,6 @@
+#include <algorithm> // std::max
 #include <string> // std::string
+#include <utility> // std::move, std::pair
 #include <vector> // std::vector
 
 #include <seqan/hts_io.h>
@@ -6,6 +8,7 @@
 #include <boost/log/trivial.hpp>
 
 #include <graphtyper/constants.hpp>
+#include <graphtyper/graph/genomic_region.hpp> // gyper::GenomicRegion
 #include <graphtyper/utilities/options.hpp>
 #include <graphtyper/utilities/sam_reader.hpp>
 
@@ -123,6 +126,42 @@ is_good_read(seqan::BamAlignmentRecord & record)
   return true;
 }
 
+
+std::string
+get_read_group(seqan::BamTagsDict const & tags_dict)
+{
+  unsigned tagIdx = 0;
+  std::string read_group("NA");
+
+  if (seqan::findTagKey(tagIdx, tags_dict, "RG"))
+  {
+    seqan::CharString read_group_raw;
+
+    if (seqan::extractTagValue(read_group_raw, tags_dict, tagIdx))
+      read_group = std::string(seqan::toCString(read_group_raw));
+  }
+
+  return read_group;
+}
+
+
+uint16_t
+get_alignment_score_difference(seqan::BamTagsDict const & tags_dict)
+{
+  unsigned tagIdx = 0;
+  int alignment_score = 0;
+  int secondary_score = 0;
+
+  if (seqan::findTagKey(tagIdx, tags_dict, "AS"))
+    seqan::extractTagValue(alignment_score, tags_dict, tagIdx);
+
+  if (seqan::findTagKey(tagIdx, tags_dict, "XS"))
+    seqan::extractTagValue(secondary_score, tags_dict, tagIdx);
+
+  return std::max(static_cast<int>(0), alignment_score - secondary_score);
+}
+
+
 } // namespace anon
 
 
@@ -130,10 +169,50 @@ is_good_read(seqan::BamAlignmentRecord & record)
 namespace gyper
 {
 
-SamReader::SamReader(std::string const & hts_path, std::vector<std::string> const & _regions)
+SamRead
+make_sam_read(seqan::BamAlignmentRecord & record)
+{
+  SamRead read;
+  read.seq = std::move(record.seq);
+  read.qual = std::move(record.qual);
+  read.begin_pos = record.beginPos;
+  read.flag = record.flag;
+  read.mapq = static_cast<uint8_t>(record.mapQ);
+
+  std::size_t const CIGAR_SIZE = seqan::length(record.cigar);
+
+  if (CIGAR_SIZE > 0)
+  {
+    char const first_op = record.cigar[0].operation;
+    char const last_op = record.cigar[CIGAR_SIZE - 1].operation;
+    read.is_clipped = first_op == 'S' || first_op == 'H' || last_op == 'S' || last_op == 'H';
+
+    if (first_op == 'S')
+      read.front_soft_clip = static_cast<uint16_t>(record.cigar[0].count);
+  }
+
+  if (Options::instance()->stats.size() > 0)
+  {
+    read.name = std::string(seqan::toCString(record.qName));
+    seqan::BamTagsDict tags_dict(record.tags);
+    read.read_group = get_read_group(tags_dict);
+    read.score_diff = get_alignment_score_difference(tags_dict);
+  }
+
+  return read;
+}
+
+
+SamReader::SamReader(std::string const & hts_path,
+                     std::vector<std::string> const & _regions,
+                     unsigned const decompression_threads)
   : hts_file(hts_path.c_str())
   , regions(_regions)
 {
+  // Decompress BGZF blocks in htslib's thread pool, so reading does not starve the worker threads
+  if (decompression_threads > 0)
+    hts_set_threads(hts_file.fp, static_cast<int>(decompression_threads));
+
   if (!(regions.size() == 1 && regions[0] == std::string(".")) && !seqan::loadIndex(hts_file))
   {
     // Try to build it if we cannot open it
@@ -156,6 +235,9 @@ SamReader::read_N_reads(std::size_t const N)
   {
     if (seqan::readRegion(record, hts_file))
     {
+      if (record.beginPos >= 0 && static_cast<uint32_t>(record.beginPos) < fetched_end)
+        continue;
+
       // Filter bad unpaired reads. Unpaired reads that have many errors or heavily clipped are
       // almost always noise
       if ((!seqan::hasFlagMultiple(record) || seqan::hasFlagNextUnmapped(record)) && !is_good_read(record))
@@ -195,7 +277,13 @@ SamReader::read_N_reads(std::size_t const N)
         continue;
 
       assert(seqan::length(record.seq) == seqan::length(record.qual));
-      insert_reads(reads, std::move(record));
+
+      // Paired reads whose mate is unmapped may end up unpaired, filter them now while the tags are available
+      bool const IS_GOOD_UNPAIRED = !seqan::hasFlagMultiple(record) ||
+                                    !seqan::hasFlagNextUnmapped(record) ||
+                                    is_good_read(record);
+
+      insert_reads(reads, std::move(record), IS_GOOD_UNPAIRED);
 
       if (reads.size() >= N)
       {
@@ -206,6 +294,12 @@ SamReader::read_N_reads(std::size_t const N)
     {
       ++r;
       seqan::setRegion(hts_file, regions[r].c_str());
+
+      // If the regions are sorted and disjoint, records which start before the end of the previous region overlap
+      // it as well and have already been read
+      GenomicRegion const prev_region(regions[r - 1]);
+      GenomicRegion const region(regions[r]);
+      fetched_end = prev_region.chr == region.chr && prev_region.end <= region.begin ? prev_region.end : 0;
     }
     else
     {
@@ -220,11 +314,10 @@ SamReader::read_N_reads(std::size_t const N)
 
     for (auto it = reads_first.begin(); it != reads_first.end(); ++it)
     {
-      if ((!seqan::hasFlagMultiple(it->second) || seqan::hasFlagNextUnmapped(it->second)) && !is_good_read(it->second))
+      if (!it->second.second)
         continue;
 
-      seqan::BamAlignmentRecord empty_record;
-      reads.push_back({it->second, empty_record});
+      reads.push_back({std::move(it->second.first), SamRead()});
     }
 
     reads_first.clear();
@@ -236,56 +329,55 @@ SamReader::read_N_reads(std::size_t const N)
 
 
 void
-SamReader::insert_reads(TReads & reads, seqan::BamAlignmentRecord && record)
+SamReader::insert_reads(TReads & reads, seqan::BamAlignmentRecord && record, bool const is_good_unpaired)
 {
   if ((hts_file.hts_record->core.flag & (BAM_FSECONDARY | BAM_FQCFAIL | BAM_FSUPPLEMENTARY | BAM_FDUP)) != 0u)
     return;
 
-  if (!seqan::hasFlagMultiple(record))
+  SamRead read = make_sam_read(record);
+
+  if (!read.is_paired())
   {
     // Read is not paired
-    seqan::BamAlignmentRecord empty_record;
-
-    // Make it the first read, if it isn't it already
-    //if (!seqan::hasFlagFirst(record))
-    //  seqan::toggleFlagFirst(record);
-
     // This read is read 1
-    if (seqan::hasFlagRC(record))
+    if (read.is_reverse())
     {
       // Read 1 is reversed
-      seqan::reverseComplement(record.seq);
-      seqan::reverse(record.qual);
+      seqan::reverseComplement(read.seq);
+      seqan::reverse(read.qual);
     }
 
-    unpaired_reads.push_back({record, empty_record});
+    unpaired_reads.push_back({std::move(read), SamRead()});
     return;
   }
 
-  if (seqan::hasFlagFirst(record))
+  if (read.is_first())
   {
     // This read is read 1
-    if (seqan::hasFlagRC(record))
+    if (read.is_reverse())
     {
       // Read 1 is reversed
-      seqan::reverseComplement(record.seq);
-      seqan::reverse(record.qual);
+      seqan::reverseComplement(read.seq);
+      seqan::reverse(read.qual);
     }
   }
-  else if (!seqan::hasFlagRC(record))
+  else if (!read.is_reverse())
   {
     // Read 2 is not reversed
-    seqan::reverseComplement(record.seq);
-    seqan::reverse(record.qual);
+    seqan::reverseComplement(read.seq);
+    seqan::reverse(read.qual);
   }
 
-  auto results_it = reads_first.find(record.qName);
+  std::string read_name(seqan::toCString(record.qName));
+  auto results_it = reads_first.find(read_name);
 
   if (results_it != reads_first.end())
   {
-    if (seqan::hasFlagFirst(record))
+    SamRead & mate = results_it->second.first;
+
+    if (read.is_first())
     {
-      if (seqan::hasFlagFirst(results_it->second))
+      if (mate.is_first())
       {
         BOOST_LOG_TRIVIAL(warning) << "[graphtyper::sam_reader] "
                                    << "Two first-in-pair reads with identical read name found. "
@@ -293,12 +385,12 @@ SamReader::insert_reads(TReads & reads, seqan::BamAlignmentRecord && record)
       }
       else
       {
-        reads.push_back({record, results_it->second});
+        reads.push_back({std::move(read), std::move(mate)});
       }
     }
     else
     {
-      if (!seqan::hasFlagFirst(results_it->second))
+      if (!mate.is_first())
       {
         BOOST_LOG_TRIVIAL(warning) << "[graphtyper::sam_reader] "
                                    << "Two second-in-pair reads with identical read name found. "
@@ -306,7 +398,7 @@ SamReader::insert_reads(TReads & reads, seqan::BamAlignmentRecord && record)
       }
       else
       {
-        reads.push_back({results_it->second, record});
+        reads.push_back({std::move(mate), std::move(read)});
       }
     }
 
@@ -314,7 +406,7 @@ SamReader::insert_reads(TReads & reads, seqan::BamAlignmentRecord && record)
   }
   else
   {
-    reads_first[record.qName] = std::move(record);
+    reads_first[std::move(read_name)] = std::make_pair(std::move(read), is_good_unpaired);
   }
 }
 
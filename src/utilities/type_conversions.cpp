@@ -99,21 +99,25 @@ to_uint16(std::vector<char> const & s, std::size_t i)
 }
 
 
-template <typename TSeq>
-std::vector<uint64_t>
-to_uint64_vec(TSeq const & s, std::size_t i)
+template <typename TSeq, typename TAlloc>
+void
+append_uint64_vec(TSeq const & s, std::size_t i, std::vector<uint64_t, TAlloc> & uints)
 {
   assert(seqan::length(s) >= 32 + i);  // Cannot read 32 bases from read!"
-  std::vector<uint64_t> uints(1, 0u);
+  std::size_t const first = uints.size();
+  uints.push_back(0u);
 
   for (unsigned const j = i + 32; i < j; ++i)
   {
     std::size_t const origin_size = uints.size();
 
-    if (origin_size > 97)
-      return std::vector<uint64_t>();
+    if (origin_size - first > 97)
+    {
+      uints.resize(first);
+      return;
+    }
 
-    for (std::size_t u = 0; u < origin_size; ++u)
+    for (std::size_t u = first; u < origin_size; ++u)
     {
       std::bitset<4> const iupac(seqan::ordValue(s[i]));
 
@@ -157,12 +161,23 @@ to_uint64_vec(TSeq const & s, std::size_t i)
       }
     }
   }
+}
+
 
+template <typename TSeq>
+std::vector<uint64_t>
+to_uint64_vec(TSeq const & s, std::size_t i)
+{
+  std::vector<uint64_t> uints;
+  append_uint64_vec(s, i, uints);
   return uints;
 }
 
 
 // Explicit instantation
+template void append_uint64_vec(seqan::IupacString const & s, std::size_t i, std::vector<uint64_t> & uints);
+template void append_uint64_vec(seqan::IupacString const & s, std::size_t i, ArenaVector<uint64_t> & uints);
+template void append_uint64_vec(seqan::Dna5String const & s, std::size_t i, ArenaVector<uint64_t> & uints);
 template std::vector<uint64_t> to_uint64_vec<seqan::Dna5String>(seqan::Dna5String const & s, std::size_t i);
 template std::vector<uint64_t> to_uint64_vec<seqan::IupacString>(seqan::IupacString const & s, std::size_t i);
 
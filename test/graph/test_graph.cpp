@@ -7,6 +7,7 @@
 #include <iostream>
 #include <fstream>
 
+#include <graphtyper/graph/absolute_position.hpp>
 #include <graphtyper/graph/graph.hpp>
 #include <graphtyper/graph/label.hpp>
 #include <graphtyper/graph/var_record.hpp>
@@ -1688,3 +1689,125 @@ TEST_CASE("Two overlapping indels")
     REQUIRE(var_nodes[2].get_label().dna == gyper::to_vec("ATATATATAT"));
   }
 }
+
+
+TEST_CASE("Locations of a position are found in variants longer than 5000 bp")
+{
+  using namespace gyper;
+  std::vector<char> reference_sequence = gyper::to_vec("AC");
+  reference_sequence.insert(reference_sequence.end(), 6000, 'G');
+  reference_sequence.push_back('T');
+  std::vector<gyper::VarRecord> records;
+
+  {
+    gyper::VarRecord record;
+    record.pos = 1;
+    record.ref = std::vector<char>(reference_sequence.begin() + 1, reference_sequence.begin() + 6002);
+    record.alts = {{'C'}};
+
+    records.push_back(record);
+  }
+
+  graph = gyper::Graph(false /*use_absolute_positions*/);
+  graph.add_genomic_region(std::move(reference_sequence), std::move(records), gyper::GenomicRegion());
+  REQUIRE(graph.ref_nodes.size() == 2);
+  REQUIRE(graph.var_nodes.size() == 2);
+
+  SECTION("A position on a reference node has a single location")
+  {
+    std::vector<gyper::Location> locs = graph.get_locations_of_an_actual_position(0);
+    REQUIRE(locs.size() == 1);
+    REQUIRE(locs[0].node_type == 'R');
+    REQUIRE(locs[0].node_index == 0);
+    REQUIRE(locs[0].offset == 0);
+
+    locs = graph.get_locations_of_an_actual_position(6002);
+    REQUIRE(locs.size() == 1);
+    REQUIRE(locs[0].node_type == 'R');
+    REQUIRE(locs[0].node_index == 1);
+    REQUIRE(locs[0].offset == 0);
+  }
+
+  SECTION("A position at the start of the variant is on both alleles")
+  {
+    std::vector<gyper::Location> locs = graph.get_locations_of_an_actual_position(1);
+    REQUIRE(locs.size() == 2);
+    REQUIRE(locs[0].node_type == 'V');
+    REQUIRE(locs[0].node_index == 0);
+    REQUIRE(locs[1].node_type == 'V');
+    REQUIRE(locs[1].node_index == 1);
+  }
+
+  SECTION("A position far into the long allele is found")
+  {
+    std::vector<gyper::Location> locs = graph.get_locations_of_an_actual_position(5500);
+    REQUIRE(locs.size() == 1);
+    REQUIRE(locs[0].node_type == 'V');
+    REQUIRE(locs[0].node_index == 0);
+    REQUIRE(locs[0].offset == 5499);
+  }
+}
+
+
+TEST_CASE("A position before the first reference node has no locations")
+{
+  using namespace gyper;
+  std::vector<char> reference_sequence = gyper::to_vec("CCGGTAAAT");
+  std::vector<gyper::VarRecord> records;
+
+  {
+    gyper::VarRecord record;
+    record.pos = 3;
+    record.ref = {'G', 'G'};
+    record.alts = {{'G', 'T'}};
+
+    records.push_back(record);
+  }
+
+  graph = gyper::Graph(false /*use_absolute_positions*/);
+  graph.add_genomic_region(std::move(reference_sequence), std::move(records), gyper::GenomicRegion("chr1:2"));
+  REQUIRE(graph.ref_nodes[0].get_label().order == 1);
+
+  REQUIRE(graph.get_locations_of_an_actual_position(0).size() == 0);
+  REQUIRE(graph.get_locations_of_an_actual_position(0, Path(), true /*is_special*/).size() == 0);
+
+  std::vector<gyper::Location> locs = graph.get_locations_of_an_actual_position(1);
+  REQUIRE(locs.size() == 1);
+  REQUIRE(locs[0].node_type == 'R');
+  REQUIRE(locs[0].node_index == 0);
+  REQUIRE(locs[0].offset == 0);
+}
+
+
+TEST_CASE("Variant regions are padded and merged")
+{
+  using namespace gyper;
+  std::vector<char> reference_sequence = gyper::to_vec("CCGGTAAAT");
+  std::vector<gyper::VarRecord> records;
+
+  {
+    gyper::VarRecord record;
+    record.pos = 3;
+    record.ref = {'G', 'G'};
+    record.alts = {{'G', 'T'}};
+
+    records.push_back(record);
+
+    record.pos = 6;
+    record.ref = {'A'};
+    record.alts = {{'A', 'T'}, {'G'}};
+
+    records.push_back(record);
+  }
+
+  graph = gyper::Graph(false /*use_absolute_positions*/);
+  graph.add_genomic_region(std::move(reference_sequence), std::move(records), gyper::GenomicRegion("chr1:2"));
+  graph.contigs.resize(1);
+  graph.contigs[0].name = "chr1";
+  graph.contigs[0].length = 1000;
+  absolute_pos.calculate_offsets();
+
+  REQUIRE(graph.get_variant_regions(0) == std::vector<std::string>({"chr1:3-4", "chr1:6-6"}));
+  REQUIRE(graph.get_variant_regions(1) == std::vector<std::string>({"chr1:2-7"}));
+  REQUIRE(graph.get_variant_regions(10) == std::vector<std::string>({"chr1:1-16"}));
+}
@@ -0,0 +1,911 @@
+#include <catch.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <graphtyper/graph/graph.hpp>
+#include <graphtyper/graph/graph_utils.hpp>
+#include <graphtyper/graph/label.hpp>
+#include <graphtyper/graph/location.hpp>
+#include <graphtyper/graph/var_record.hpp>
+#include <graphtyper/index/kmer_label.hpp>
+
+
+namespace
+{
+
+std::vector<char>
+get_random_dna(std::mt19937 & gen, std::size_t const size)
+{
+  // Mostly matching bases, with some N and a few of the '<' and '>' markers of graph DNA
+  char const bases[] = {'A', 'C', 'G', 'T', 'A', 'C', 'G', 'T', 'A', 'C', 'G', 'T', 'N', '<', '>'};
+  std::vector<char> dna(size);
+
+  for (auto & base : dna)
+    base = bases[gen() % (gen() % 20 == 0 ? sizeof(bases) : 4)];
+
+  return dna;
+}
+
+
+/** Splits 'dna' into consecutive node labels of random lengths, like the labels on a path of the graph. */
+std::vector<std::size_t>
+get_random_node_ends(std::mt19937 & gen, std::size_t const size)
+{
+  std::vector<std::size_t> ends;
+  std::size_t end = 0;
+
+  while (end < size)
+  {
+    end = std::min(size, end + gen() % 12); // Nodes can be empty, like deletion alleles
+    ends.push_back(end);
+  }
+
+  return ends;
+}
+
+
+/**
+ * \brief The previous Graph::get_labels_forward(), which recounted the mismatches of every sequence each time a node
+ *        was added to it. Kept as it was, to check the labels of the current implementation against.
+ */
+std::vector<gyper::KmerLabel>
+get_labels_forward_previous(gyper::Graph const & g,
+                            gyper::Location const & s,
+                            std::vector<char> const & read,
+                            uint32_t & max_mismatches)
+{
+  using namespace gyper;
+
+  std::vector<KmerLabel> labels;
+
+  std::vector<std::vector<char> > var_and_refs(1);
+  std::vector<std::vector<uint32_t> > var_ids(1);
+  std::vector<uint32_t> end_pos(1, 0u);
+  std::vector<TNodeIndex> vars;
+
+  if (s.node_type == 'V')
+  {
+    assert(s.node_index < g.var_nodes.size());
+    VarNode const & var = g.var_nodes[s.node_index];
+    var_ids[0].push_back(s.node_index);
+    var_and_refs[0] = std::vector<char>(var.get_label().dna.begin() + s.offset,
+                                        var.get_label().dna.end()
+      );
+
+    // Check if variant is enough
+    if (var_and_refs[0].size() >= read.size())
+    {
+      // variant is enough
+      end_pos[0] =
+        static_cast<uint32_t>(var.get_label().reach() - (var_and_refs[0].size() - read.size()));
+
+      uint32_t const ref_reach =
+        g.var_nodes[g.ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
+
+      if (end_pos[0] > ref_reach)
+        end_pos[0] = g.get_special_pos(end_pos[0], ref_reach);
+    }
+    else
+    {
+      // We also need to add a reference
+      RefNode const & ref = g.ref_nodes[var.get_out_ref_index()];
+      vars = ref.get_vars();
+
+      var_and_refs[0].insert(var_and_refs[0].end(),
+                             ref.get_label().dna.begin(),
+                             ref.get_label().dna.end()
+        );
+
+      end_pos[0] =
+        static_cast<uint32_t>(ref.get_label().reach() - (var_and_refs[0].size() - read.size()));
+    }
+  }
+  else
+  {
+    assert(s.node_type == 'R');
+    assert(s.node_index < g.ref_nodes.size());
+    RefNode const & ref = g.ref_nodes[s.node_index];
+    vars = ref.get_vars();
+
+    var_and_refs[0] = std::vector<char>(ref.get_label().dna.begin() + s.offset,
+                                        ref.get_label().dna.end()
+      );
+
+    end_pos[0] =
+      static_cast<uint32_t>(ref.get_label().reach() - (var_and_refs[0].size() - read.size()));
+  }
+
+  // We are starting on a variant node
+  if (vars.size() > 0 && var_and_refs[0].size() < read.size())
+  {
+    // We are the the end of the graph, and the sequence is not long enough, we need to bail
+    std::vector<uint32_t> mismatch_scores(vars.size(), 0);
+    uint32_t r = g.var_nodes[vars[0]].get_out_ref_index();
+    bool all_sequences_long_enough = false;
+    std::size_t const MAX_VAR_AND_REFS = 128;
+
+    while (not all_sequences_long_enough && var_and_refs.size() < MAX_VAR_AND_REFS && vars.size() > 0)
+    {
+      all_sequences_long_enough = true;
+      assert(r < g.ref_nodes.size());
+      RefNode const & ref = g.ref_nodes[r];
+      std::size_t original_size = var_and_refs.size();
+
+      for (unsigned j = 0; j < original_size; ++j)
+      {
+        assert(j < var_and_refs.size());    // Should always be less than the current size
+
+        if (var_and_refs[j].size() >= read.size())
+          continue;   // Sequence is already large enough
+
+        for (unsigned i = 0; i < vars.size() - 1; ++i)
+        {
+          assert(j < var_and_refs.size());
+          assert(vars[i] < g.var_nodes.size());
+          VarNode const & var = g.var_nodes[vars[i]];
+          std::vector<char> new_seq(var_and_refs[j].begin(), var_and_refs[j].end());
+          new_seq.insert(new_seq.end(), var.get_label().dna.begin(), var.get_label().dna.end());
+
+          bool const variant_is_enough = new_seq.size() >= read.size();
+
+          if (not variant_is_enough)
+            new_seq.insert(new_seq.end(), ref.get_label().dna.begin(), ref.get_label().dna.end());
+
+          // Only add it if it has less or equal than 'max_mismatches' mismatches
+          if (count_mismatches(read, 0, new_seq, 0, max_mismatches) <= max_mismatches)
+          {
+            std::vector<uint32_t> new_var_id(var_ids[j]);
+            new_var_id.push_back(vars[i]);
+            var_ids.push_back(std::move(new_var_id));
+
+            // Check if we need to continue further
+            if (new_seq.size() < read.size())
+              all_sequences_long_enough = false;
+
+            // Update end positions
+            if (variant_is_enough)
+            {
+              end_pos.push_back(var.get_label().reach() - (new_seq.size() - read.size()));
+
+              // Check if the end position is further than the reference reach
+              uint32_t const ref_reach = g.var_nodes[g.ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
+
+              if (end_pos.back() > ref_reach)
+                end_pos.back() = g.get_special_pos(end_pos.back(), ref_reach);
+            }
+            else
+            {
+              end_pos.push_back(ref.get_label().reach() - (new_seq.size() - read.size()));
+            }
+
+            assert(g.var_nodes[var_ids.back().back()].get_label().order <= end_pos.back());
+            var_and_refs.push_back(std::move(new_seq));
+          }
+        }
+
+        // The last variant replaces the old seq
+        VarNode const & var = g.var_nodes[vars[vars.size() - 1]];
+        var_and_refs[j].insert(var_and_refs[j].end(), var.get_label().dna.begin(), var.get_label().dna.end());
+
+        bool const variant_is_enough = var_and_refs[j].size() >= read.size();
+
+        if (!variant_is_enough)
+        {
+          var_and_refs[j].insert(var_and_refs[j].end(), ref.get_label().dna.begin(), ref.get_label().dna.end());
+        }
+
+        if (count_mismatches(read, 0, var_and_refs[j], 0, max_mismatches) <= max_mismatches)
+        {
+          var_ids[j].push_back(vars[vars.size() - 1]);
+
+          if (all_sequences_long_enough and var_and_refs[j].size() < read.size())
+            all_sequences_long_enough = false;
+
+          // Update end positions
+          if (variant_is_enough)
+          {
+            end_pos[j] = var.get_label().reach() - (var_and_refs[j].size() - read.size());
+
+            // Check if the end position is further than the reference reach
+            uint32_t const ref_reach = g.var_nodes[g.ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
+            if (end_pos[j] > ref_reach)
+              end_pos[j] = g.get_special_pos(end_pos[j], ref_reach);
+          }
+          else
+          {
+            end_pos[j] = ref.get_label().reach() - (var_and_refs[j].size() - read.size());
+          }
+
+          assert(g.var_nodes[var_ids[j].back()].get_label().order <= end_pos[j]);
+          assert(var_ids.size() == end_pos.size());
+        }
+        else
+        {
+          // Delete the jth element
+          var_and_refs.erase(var_and_refs.begin() + j);
+          var_ids.erase(var_ids.begin() + j);
+          end_pos.erase(end_pos.begin() + j);
+
+          --original_size;
+          --j;
+        }
+      }
+
+      if (not all_sequences_long_enough)
+      {
+        // Get new reference node and variant nodes
+        assert(r < g.ref_nodes.size());
+        vars = g.ref_nodes[r].get_vars();
+        ++r;
+      }
+      else
+      {
+        break;
+      }
+    }
+  }
+
+  std::vector<std::vector<uint32_t> > best_var_ids;
+  std::vector<uint32_t> best_end_pos;
+
+  // Iterate all possible sequences
+  for (unsigned j = 0; j < var_and_refs.size(); ++j)
+  {
+    if (var_and_refs[j].size() < read.size())
+      continue;
+
+    uint32_t mismatches = count_mismatches(read, 0, var_and_refs[j], 0, max_mismatches);
+
+    if (mismatches > max_mismatches)
+    {
+      continue;
+    }
+    else if (mismatches < max_mismatches)
+    {
+      max_mismatches = mismatches; // Found alignment with fewer mismatches
+      best_var_ids.clear();
+      best_var_ids.push_back(var_ids[j]);
+      best_end_pos.clear();
+      best_end_pos.push_back(end_pos[j]);
+    }
+    else
+    {
+      best_var_ids.push_back(var_ids[j]);
+      best_end_pos.push_back(end_pos[j]);
+    }
+  }
+
+  if (best_var_ids.size() == 0)
+    return labels;
+
+  assert(best_var_ids.size() == best_end_pos.size());
+
+  if (best_var_ids.size() > 0)
+  {
+    for (unsigned j = 0; j < best_var_ids.size(); ++j)
+    {
+      uint32_t start_pos = s.node_order + s.offset;
+
+      // Check if we need to use a special positions for the end position
+      if (s.node_type == 'V')
+      {
+        uint32_t const ref_reach = g.var_nodes[g.ref_nodes[g.var_nodes[s.node_index].get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
+        if (start_pos > ref_reach)
+          start_pos = g.get_special_pos(start_pos, ref_reach);
+      }
+
+      // Check if we are overlapping any variant node
+      if (best_var_ids[j].size() == 0)
+      {
+        labels.push_back(KmerLabel(start_pos, best_end_pos[j]));
+      }
+      else
+      {
+        for (auto const & good_var : best_var_ids[j])
+        {
+          assert(g.var_nodes[good_var].get_label().order <= best_end_pos[j]);
+
+          labels.push_back(KmerLabel(start_pos,
+                                     best_end_pos[j],
+                                     good_var,
+                                     g.get_variant_num(good_var),
+                                     g.var_nodes[good_var].get_label().order
+                                     )
+                           );
+        }
+      }
+    }
+  }
+
+  return labels;
+}
+
+
+/** \brief The previous Graph::get_labels_backward(), kept as the oracle of the current implementation. */
+std::vector<gyper::KmerLabel>
+get_labels_backward_previous(gyper::Graph const & g,
+                             gyper::Location const & e,
+                             std::vector<char> const & read,
+                             uint32_t & max_mismatches)
+{
+  using namespace gyper;
+
+  std::vector<KmerLabel> labels;
+
+  std::vector<std::vector<char> > var_and_refs(1);
+  std::vector<std::vector<uint32_t> > var_ids(1);
+  std::vector<uint32_t> start_pos(1, 0u);
+  std::vector<TNodeIndex> vars;
+
+  if (e.node_type == 'V')
+  {
+    assert(e.node_index < g.var_nodes.size());
+    VarNode const & var = g.var_nodes[e.node_index];
+    var_ids[0].push_back(e.node_index);
+    var_and_refs[0] = std::vector<char>(var.get_label().dna.begin(), var.get_label().dna.begin() + e.offset + 1);
+
+    // Check if adding the variant was enough
+    if (var_and_refs[0].size() >= read.size())
+    {
+      start_pos[0] = var.get_label().order + (var_and_refs[0].size() - read.size());
+
+      // Check if we need to use a special positions
+      uint32_t const ref_reach = g.var_nodes[g.ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
+      if (start_pos[0] > ref_reach)
+        start_pos[0] = g.get_special_pos(start_pos[0], ref_reach);
+    }
+    else
+    {
+      uint32_t const r = var.get_out_ref_index() - 1;
+      RefNode const & ref = g.ref_nodes[r];
+      var_and_refs[0].insert(var_and_refs[0].begin(), ref.get_label().dna.begin(), ref.get_label().dna.end());
+      start_pos[0] = ref.get_label().order + (var_and_refs[0].size() - read.size());
+
+      if (r != 0)
+        vars = g.ref_nodes[r - 1].get_vars();
+    }
+  }
+  else
+  {
+    assert(e.node_type == 'R');
+    assert(e.node_index < g.ref_nodes.size());
+    RefNode const & ref = g.ref_nodes[e.node_index];
+
+    if (e.node_index != 0)
+      vars = g.ref_nodes[e.node_index - 1].get_vars(); // Only if we are not on the first reference node, we can get the vars
+
+    var_and_refs[0] = std::vector<char>(ref.get_label().dna.begin(), ref.get_label().dna.begin() + e.offset + 1);
+    start_pos[0] = ref.get_label().order + (var_and_refs[0].size() - read.size());
+  }
+
+  // We are starting on a variant node
+  if (vars.size() > 0 && var_and_refs[0].size() < read.size())
+  {
+    std::vector<uint32_t> mismatch_scores(vars.size(), 0);
+    uint32_t r = g.var_nodes[vars[0]].get_out_ref_index() - 1;
+    bool all_sequences_long_enough = false;
+    std::size_t const MAX_VAR_AND_REFS = 128;
+
+    while (not all_sequences_long_enough and var_and_refs.size() < MAX_VAR_AND_REFS && vars.size() > 0)
+    {
+      all_sequences_long_enough = true;
+      assert(r < g.ref_nodes.size());
+      RefNode const & ref = g.ref_nodes[r];
+      std::size_t original_size = var_and_refs.size();
+
+      for (unsigned j = 0; j < original_size; ++j)
+      {
+        assert(j < var_and_refs.size());  // Should always be less than the current size
+
+        if (var_and_refs[j].size() >= read.size())
+          continue; // Sequence is already large enough
+
+        for (unsigned i = 0; i < vars.size() - 1; ++i)
+        {
+          assert(j < var_and_refs.size());
+
+          if (var_and_refs[j].size() < read.size())
+          {
+            assert(i < vars.size());
+            assert(vars[i] < g.var_nodes.size());
+            VarNode const & var = g.var_nodes[vars[i]];
+            std::vector<char> new_seq(var.get_label().dna.begin(), var.get_label().dna.end());
+            new_seq.insert(new_seq.end(), var_and_refs[j].begin(), var_and_refs[j].end());
+
+            bool const variant_is_enough = new_seq.size() >= read.size();
+
+            if (not variant_is_enough)
+            {
+              new_seq.insert(new_seq.begin(), ref.get_label().dna.begin(), ref.get_label().dna.end());
+            }
+
+            // Only add it if it has less or equal than 'max_mismatches' mismatches
+            if (count_mismatches_backward(read, 0, new_seq, 0, max_mismatches) <= max_mismatches)
+            {
+              std::vector<uint32_t> new_var_id(var_ids[j]);
+              new_var_id.push_back(vars[i]);
+              var_ids.push_back(std::move(new_var_id));
+
+              // Check if we need to continue further
+              if (new_seq.size() < read.size())
+              {
+                all_sequences_long_enough = false;
+              }
+
+              // Update end positions
+              if (variant_is_enough)
+              {
+                start_pos.push_back(var.get_label().order + (new_seq.size() - read.size()));
+
+                // Check if we need to use a special positions
+                uint32_t const ref_reach = g.var_nodes[g.ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
+                if (start_pos.back() > ref_reach)
+                  start_pos.back() = g.get_special_pos(start_pos.back(), ref_reach);
+              }
+              else
+              {
+                start_pos.push_back(ref.get_label().order + (new_seq.size() - read.size()));
+              }
+
+              var_and_refs.push_back(std::move(new_seq));
+            }
+          }
+        }
+
+        // The last variant replaces the old seq
+        VarNode const & var = g.var_nodes[vars[vars.size() - 1]];
+        var_and_refs[j].insert(var_and_refs[j].begin(), var.get_label().dna.begin(), var.get_label().dna.end());
+
+        bool const variant_is_enough = var_and_refs[j].size() >= read.size();
+
+        if (!variant_is_enough)
+        {
+          var_and_refs[j].insert(var_and_refs[j].begin(), ref.get_label().dna.begin(), ref.get_label().dna.end());
+        }
+
+        if (count_mismatches_backward(read, 0, var_and_refs[j], 0, max_mismatches) <= max_mismatches)
+        {
+          var_ids[j].push_back(vars[vars.size() - 1]);
+
+          if (var_and_refs[j].size() < read.size())
+            all_sequences_long_enough = false;
+
+          // Update end positions
+          if (variant_is_enough)
+          {
+            start_pos[j] = var.get_label().order + (var_and_refs[j].size() - read.size());
+
+            // Check if we need to use a special positions
+            uint32_t const ref_reach = g.var_nodes[g.ref_nodes[var.get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
+            if (start_pos[j] > ref_reach)
+              start_pos[j] = g.get_special_pos(start_pos[j], ref_reach);
+          }
+          else
+          {
+            start_pos[j] = ref.get_label().order + (var_and_refs[j].size() - read.size());
+          }
+
+          assert(var_ids.size() == start_pos.size());
+        }
+        else
+        {
+          // Delete the jth element
+          var_and_refs.erase(var_and_refs.begin() + j);
+          var_ids.erase(var_ids.begin() + j);
+          start_pos.erase(start_pos.begin() + j);
+
+          --original_size;
+          --j;
+        }
+      }
+
+      if (not all_sequences_long_enough)
+      {
+        // // Get new reference node and variant nodes
+        // r = g.var_nodes[vars[0]].get_out_ref_index() - 1;
+        // assert(r < g.ref_nodes.size());
+
+        if (r != 0)
+        {
+          --r;
+          assert(g.ref_nodes[r].get_vars()[0] != vars[0]);
+          vars = g.ref_nodes[r].get_vars();
+        }
+        else
+        {
+          vars.clear();
+          break;
+        }
+      }
+      else
+      {
+        break;
+      }
+    }
+  }
+
+  std::vector<std::vector<uint32_t> > best_var_ids;
+  std::vector<uint32_t> best_start_pos;
+
+  // Iterate all possible sequences
+  for (unsigned j = 0; j < var_and_refs.size(); ++j)
+  {
+    if (var_and_refs[j].size() < read.size())
+      continue;
+
+    uint32_t const mismatches = count_mismatches_backward(read, 0, var_and_refs[j], 0, max_mismatches);
+
+    if (mismatches < max_mismatches)
+    {
+      max_mismatches = mismatches;
+      best_var_ids.clear();
+      best_var_ids.push_back(var_ids[j]);
+      best_start_pos.clear();
+      best_start_pos.push_back(start_pos[j]);
+    }
+    else if (mismatches == max_mismatches)
+    {
+      best_var_ids.push_back(var_ids[j]);
+      best_start_pos.push_back(start_pos[j]);
+    }
+  }
+
+  if (best_var_ids.size() == 0)
+    return labels;
+
+  assert(best_var_ids.size() == best_start_pos.size());
+
+  for (unsigned j = 0; j < best_var_ids.size(); ++j)
+  {
+    uint32_t end_pos = e.node_order + e.offset;
+
+    // Check if we need to use a special positions for the end position
+    if (e.node_type == 'V')
+    {
+      uint32_t const ref_reach = g.var_nodes[g.ref_nodes[g.var_nodes[e.node_index].get_out_ref_index() - 1].get_vars()[0]].get_label().reach();
+      if (end_pos > ref_reach)
+        end_pos = g.get_special_pos(end_pos, ref_reach);
+    }
+
+    // Check if we are overlapping any variant node
+    if (best_var_ids[j].size() == 0)
+    {
+      labels.push_back(KmerLabel(best_start_pos[j], end_pos));
+    }
+    else
+    {
+      for (auto const & good_var : best_var_ids[j])
+      {
+        labels.push_back(KmerLabel(best_start_pos[j],
+                                   end_pos,
+                                   good_var,
+                                   g.get_variant_num(good_var),
+                                   g.var_nodes[good_var].get_label().order
+                                   )
+                         );
+      }
+    }
+  }
+
+  return labels;
+}
+
+
+/** Creates a graph with SNPs, multi-allelic sites, insertions and deletions at random positions. */
+gyper::Graph
+create_random_graph(std::mt19937 & gen)
+{
+  char const bases[] = {'A', 'C', 'G', 'T'};
+  std::vector<char> reference_sequence(300);
+
+  for (auto & base : reference_sequence)
+    base = bases[gen() % 4];
+
+  std::vector<gyper::VarRecord> records;
+  std::size_t pos = 1 + gen() % 6;
+
+  while (pos + 8 < reference_sequence.size())
+  {
+    gyper::VarRecord record;
+    record.pos = static_cast<uint32_t>(pos);
+    record.ref = {reference_sequence[pos]};
+
+    switch (gen() % 4)
+    {
+    case 0: // SNP or multi-allelic SNP
+    {
+      std::size_t const ref = std::find(bases, bases + 4, record.ref[0]) - bases;
+      std::size_t const num_alts = 1 + gen() % 3;
+
+      for (std::size_t a = 1; a <= num_alts; ++a)
+        record.alts.push_back({bases[(ref + a) % 4]});
+
+      break;
+    }
+
+    case 1: // Deletion
+      record.ref.insert(record.ref.end(),
+                        reference_sequence.begin() + pos + 1,
+                        reference_sequence.begin() + pos + 2 + gen() % 5);
+      record.alts.push_back({record.ref[0]});
+      break;
+
+    case 2: // Insertion, which can be longer than a read
+    {
+      std::vector<char> alt(record.ref);
+
+      for (std::size_t i = 1 + gen() % (gen() % 4 == 0 ? 70 : 8); i > 0; --i)
+        alt.push_back(bases[gen() % 4]);
+
+      record.alts.push_back(std::move(alt));
+      break;
+    }
+
+    default: // A deletion and an insertion at the same site
+    {
+      record.ref.push_back(reference_sequence[pos + 1]);
+      record.alts.push_back({record.ref[0]});
+      record.alts.push_back({record.ref[0], record.ref[1], bases[gen() % 4], bases[gen() % 4]});
+      break;
+    }
+    }
+
+    pos += record.ref.size() + 1 + gen() % 6;
+    records.push_back(std::move(record));
+  }
+
+  gyper::Graph g(false /*use_absolute_positions*/);
+  g.add_genomic_region(std::move(reference_sequence), std::move(records), gyper::GenomicRegion());
+  g.create_special_positions();
+  return g;
+}
+
+
+/** Picks a random location on a node with DNA. Nodes of deletion alleles have none. */
+gyper::Location
+get_random_location(std::mt19937 & gen, gyper::Graph const & g)
+{
+  while (true)
+  {
+    if (gen() % 2 == 0)
+    {
+      std::size_t const r = gen() % g.ref_nodes.size();
+      gyper::Label const & label = g.ref_nodes[r].get_label();
+
+      if (label.dna.size() > 0)
+        return gyper::Location('R', static_cast<uint32_t>(r), label.order, static_cast<uint32_t>(gen() % label.dna.size()));
+    }
+    else
+    {
+      std::size_t const v = gen() % g.var_nodes.size();
+      gyper::Label const & label = g.var_nodes[v].get_label();
+
+      if (label.dna.size() > 0)
+        return gyper::Location('V', static_cast<uint32_t>(v), label.order, static_cast<uint32_t>(gen() % label.dna.size()));
+    }
+  }
+}
+
+
+/** Reads 'length' bases of a random path through the graph, starting at 's'. */
+std::vector<char>
+walk_forward(std::mt19937 & gen, gyper::Graph const & g, gyper::Location const & s, std::size_t const length)
+{
+  std::size_t r;
+  std::vector<char> dna;
+
+  if (s.node_type == 'V')
+  {
+    std::vector<char> const & var_dna = g.var_nodes[s.node_index].get_label().dna;
+    dna.insert(dna.end(), var_dna.begin() + s.offset, var_dna.end());
+    r = g.var_nodes[s.node_index].get_out_ref_index();
+    dna.insert(dna.end(), g.ref_nodes[r].get_label().dna.begin(), g.ref_nodes[r].get_label().dna.end());
+  }
+  else
+  {
+    r = s.node_index;
+    std::vector<char> const & ref_dna = g.ref_nodes[r].get_label().dna;
+    dna.insert(dna.end(), ref_dna.begin() + s.offset, ref_dna.end());
+  }
+
+  while (dna.size() < length && g.ref_nodes[r].get_vars().size() > 0)
+  {
+    std::vector<gyper::TNodeIndex> const & vars = g.ref_nodes[r].get_vars();
+    gyper::TNodeIndex const v = vars[gen() % vars.size()];
+    std::vector<char> const & var_dna = g.var_nodes[v].get_label().dna;
+    dna.insert(dna.end(), var_dna.begin(), var_dna.end());
+    r = g.var_nodes[v].get_out_ref_index();
+    dna.insert(dna.end(), g.ref_nodes[r].get_label().dna.begin(), g.ref_nodes[r].get_label().dna.end());
+  }
+
+  dna.resize(length, 'A'); // Reads going past the end of the graph have no labels
+  return dna;
+}
+
+
+/** Reads 'length' bases of a random path through the graph, ending at 'e'. */
+std::vector<char>
+walk_backward(std::mt19937 & gen, gyper::Graph const & g, gyper::Location const & e, std::size_t const length)
+{
+  std::size_t r;
+  std::vector<char> dna;
+
+  if (e.node_type == 'V')
+  {
+    std::vector<char> const & var_dna = g.var_nodes[e.node_index].get_label().dna;
+    dna.insert(dna.end(), var_dna.begin(), var_dna.begin() + e.offset + 1);
+    r = g.var_nodes[e.node_index].get_out_ref_index() - 1;
+    dna.insert(dna.begin(), g.ref_nodes[r].get_label().dna.begin(), g.ref_nodes[r].get_label().dna.end());
+  }
+  else
+  {
+    r = e.node_index;
+    std::vector<char> const & ref_dna = g.ref_nodes[r].get_label().dna;
+    dna.insert(dna.end(), ref_dna.begin(), ref_dna.begin() + e.offset + 1);
+  }
+
+  while (dna.size() < length && r > 0)
+  {
+    std::vector<gyper::TNodeIndex> const & vars = g.ref_nodes[r - 1].get_vars();
+    gyper::TNodeIndex const v = vars[gen() % vars.size()];
+    std::vector<char> const & var_dna = g.var_nodes[v].get_label().dna;
+    dna.insert(dna.begin(), var_dna.begin(), var_dna.end());
+    --r;
+    dna.insert(dna.begin(), g.ref_nodes[r].get_label().dna.begin(), g.ref_nodes[r].get_label().dna.end());
+  }
+
+  if (dna.size() >= length)
+    dna.erase(dna.begin(), dna.end() - length);
+  else
+    dna.insert(dna.begin(), length - dna.size(), 'A');
+
+  return dna;
+}
+
+
+/** Changes a few bases of a read, so it aligns with mismatches or not at all. */
+void
+add_read_errors(std::mt19937 & gen, std::vector<char> & read)
+{
+  char const bases[] = {'A', 'C', 'G', 'T', 'N'};
+
+  for (std::size_t i = gen() % 4; i > 0; --i)
+    read[gen() % read.size()] = bases[gen() % 5];
+}
+
+
+} // anon namespace
+
+
+TEST_CASE("Counting mismatches node by node is the same as recounting the whole path", "[graph_utils]")
+{
+  std::mt19937 gen(20);
+
+  for (int t = 0; t < 20000; ++t)
+  {
+    uint32_t const max_mismatches = gen() % 5;
+    std::vector<char> read = get_random_dna(gen, 1 + gen() % 100);
+
+    // Reads do not have the markers, but can have N
+    for (auto & base : read)
+    {
+      if (base == '<' || base == '>')
+        base = 'A';
+    }
+
+    std::vector<char> const dna = get_random_dna(gen, gen() % 120);
+    std::vector<std::size_t> const node_ends = get_random_node_ends(gen, dna.size());
+
+    // Forward, like get_labels_forward() extending a path to the right of the read start
+    {
+      uint32_t const expected = count_mismatches(read, 0, dna, 0, max_mismatches);
+      uint32_t mismatches = 0;
+      std::size_t length = 0;
+      bool is_aligned = true;
+
+      for (std::size_t i = 0; is_aligned && i < node_ends.size(); ++i)
+      {
+        std::size_t const begin = i == 0 ? 0 : node_ends[i - 1];
+
+        if (length < read.size())
+        {
+          is_aligned = add_mismatches(read.begin() + length,
+                                      read.end(),
+                                      dna.begin() + begin,
+                                      dna.begin() + node_ends[i],
+                                      mismatches,
+                                      max_mismatches);
+        }
+
+        length += node_ends[i] - begin;
+      }
+
+      REQUIRE(is_aligned == (expected <= max_mismatches));
+
+      if (is_aligned)
+        REQUIRE(mismatches == expected);
+    }
+
+    // Backward, like get_labels_backward() extending a path to the left of the read end
+    {
+      uint32_t const expected = count_mismatches_backward(read, 0, dna, 0, max_mismatches);
+      uint32_t mismatches = 0;
+      std::size_t length = 0;
+      bool is_aligned = true;
+
+      for (long i = static_cast<long>(node_ends.size()) - 1; is_aligned && i >= 0; --i)
+      {
+        std::size_t const begin = i == 0 ? 0 : node_ends[i - 1];
+
+        if (length < read.size())
+        {
+          is_aligned = add_mismatches(read.rbegin() + length,
+                                      read.rend(),
+                                      std::vector<char>::const_reverse_iterator(dna.begin() + node_ends[i]),
+                                      std::vector<char>::const_reverse_iterator(dna.begin() + begin),
+                                      mismatches,
+                                      max_mismatches);
+        }
+
+        length += node_ends[i] - begin;
+      }
+
+      REQUIRE(is_aligned == (expected <= max_mismatches));
+
+      if (is_aligned)
+        REQUIRE(mismatches == expected);
+    }
+  }
+}
+
+
+TEST_CASE("The labels of reads in random graphs are the same as the labels of the previous implementation", "[graph_utils]")
+{
+  using namespace gyper;
+
+  std::mt19937 gen(21);
+
+  for (int i = 0; i < 40; ++i)
+  {
+    Graph const g = create_random_graph(gen);
+    REQUIRE(g.var_nodes.size() > 0);
+
+    for (int t = 0; t < 500; ++t)
+    {
+      Location const loc = get_random_location(gen, g);
+      std::size_t const length = 1 + gen() % 80;
+      uint32_t const max_mismatches = gen() % 5;
+
+      {
+        std::vector<char> read = walk_forward(gen, g, loc, length);
+        add_read_errors(gen, read);
+
+        uint32_t expected_mismatches = max_mismatches;
+        uint32_t mismatches = max_mismatches;
+        std::vector<KmerLabel> const expected = get_labels_forward_previous(g, loc, read, expected_mismatches);
+        std::vector<KmerLabel> const labels = g.get_labels_forward(loc, read, mismatches);
+
+        REQUIRE(labels == expected);
+        REQUIRE(mismatches == expected_mismatches);
+      }
+
+      {
+        std::vector<char> read = walk_backward(gen, g, loc, length);
+        add_read_errors(gen, read);
+
+        uint32_t expected_mismatches = max_mismatches;
+        uint32_t mismatches = max_mismatches;
+        std::vector<KmerLabel> const expected = get_labels_backward_previous(g, loc, read, expected_mismatches);
+        std::vector<KmerLabel> const labels = g.get_labels_backward(loc, read, mismatches);
+
+        REQUIRE(labels == expected);
+        REQUIRE(mismatches == expected_mismatches);
+      }
+    }
+  }
+}
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <random>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <graphtyper/graph/graph.hpp>
@@ -38,3 +41,119 @@ TEST_CASE("Haplotype with one genotype")
   REQUIRE(haps.size() == 1);
   REQUIRE(haps[0].get_genotype_num() == 3);
 }
+
+
+namespace
+{
+
+void
+add_read_to_log_scores_scalar(std::vector<uint16_t> & log_score,
+                              std::vector<uint16_t> const & haplotype_errors,
+                              uint16_t const epsilon_exponent)
+{
+  std::size_t i = 0;
+
+  for (std::size_t y = 0; y < haplotype_errors.size(); ++y)
+  {
+    for (std::size_t x = 0; x <= y; ++x, ++i)
+    {
+      if (haplotype_errors[x] == 0 && haplotype_errors[y] == 0)
+        log_score[i] += epsilon_exponent;
+      else if (haplotype_errors[x] == 0 || haplotype_errors[y] == 0)
+        log_score[i] += epsilon_exponent - 1;
+      else if (haplotype_errors[x] == 1 && haplotype_errors[y] == 1)
+        log_score[i] += 4;
+      else if (haplotype_errors[x] == 1 || haplotype_errors[y] == 1)
+        log_score[i] += 3;
+      else if (haplotype_errors[x] == 2 && haplotype_errors[y] == 2)
+        log_score[i] += 2;
+      else if (haplotype_errors[x] == 2 || haplotype_errors[y] == 2)
+        log_score[i] += 1;
+    }
+  }
+}
+
+
+} // anon namespace
+
+
+TEST_CASE("Vectorized log score updates are identical to scalar updates")
+{
+  using namespace gyper;
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<uint16_t> error_dist(0, 5);
+  std::uniform_int_distribution<uint16_t> eps_dist(9, 20);
+
+  for (std::size_t cnum : {1ul, 2ul, 7ul, 8ul, 9ul, 15ul, 16ul, 17ul, 31ul, 33ul, 100ul, 257ul})
+  {
+    std::vector<uint16_t> expected(cnum * (cnum + 1) / 2, 0);
+    std::vector<uint16_t> log_score(expected);
+
+    for (int read = 0; read < 20; ++read)
+    {
+      std::vector<uint16_t> haplotype_errors(cnum);
+
+      for (auto & errors : haplotype_errors)
+        errors = error_dist(gen);
+
+      uint16_t const epsilon_exponent = eps_dist(gen);
+      add_read_to_log_scores_scalar(expected, haplotype_errors, epsilon_exponent);
+      add_read_to_log_scores(log_score, haplotype_errors, epsilon_exponent);
+    }
+
+    REQUIRE(log_score == expected);
+  }
+}
+
+
+TEST_CASE("Each vectorized log score kernel gives the same row as the scalar kernel")
+{
+  using namespace gyper;
+  std::mt19937 gen(8);
+  std::uniform_int_distribution<uint16_t> class_dist(0, 3);
+  std::uniform_int_distribution<uint16_t> score_dist(0, 20);
+
+  typedef std::size_t (* TKernel)(uint16_t *, uint16_t const *, uint16_t const *, std::size_t, std::size_t);
+  std::vector<std::pair<TKernel, std::size_t> > kernels; // Kernels compiled in and their number of lanes
+
+#ifdef __AVX2__
+  kernels.push_back({add_class_scores_avx2, 16});
+#endif // __AVX2__
+
+#ifdef __SSE2__
+  kernels.push_back({add_class_scores_sse2, 8});
+#endif // __SSE2__
+
+  for (auto const & kernel : kernels)
+  {
+    // Rows which are shorter than the vectors, a multiple of them, or have a remainder
+    for (std::size_t row_size = 0; row_size <= 70; ++row_size)
+    {
+      for (std::size_t begin = 0; begin <= std::min(row_size, static_cast<std::size_t>(3)); ++begin)
+      {
+        std::vector<uint16_t> classes(row_size);
+        std::vector<uint16_t> expected(row_size);
+        uint16_t const row_scores[4] = {score_dist(gen), score_dist(gen), score_dist(gen), score_dist(gen)};
+
+        for (std::size_t x = 0; x < row_size; ++x)
+        {
+          classes[x] = class_dist(gen);
+          expected[x] = score_dist(gen);
+        }
+
+        std::vector<uint16_t> row(expected);
+        add_class_scores_scalar(expected.data(), classes.data(), row_scores, begin, row_size);
+
+        std::size_t const end = kernel.first(row.data(), classes.data(), row_scores, begin, row_size);
+        REQUIRE(end == begin + (row_size - begin) / kernel.second * kernel.second);
+
+        // The kernel leaves the rest of the row untouched
+        for (std::size_t x = end; x < row_size; ++x)
+          REQUIRE(row[x] == expected[x] - row_scores[classes[x]]);
+
+        add_class_scores_scalar(row.data(), classes.data(), row_scores, end, row_size);
+        REQUIRE(row == expected);
+      }
+    }
+  }
+}
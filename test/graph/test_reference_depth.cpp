@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <graphtyper/graph/reference_depth.hpp>
+#include <graphtyper/typer/variant_candidate.hpp>
+
+#include <catch.hpp>
+
+
+namespace
+{
+
+/** The depth of each reference index, counted base by base as the depth was computed before it used intervals. */
+class PerBaseDepth
+{
+public:
+  explicit PerBaseDepth(std::size_t const depth_size)
+    : depth(depth_size, 0u)
+  {}
+
+  void
+  add_read(gyper::ReferenceDepth const & ref_depth, std::vector<std::pair<uint32_t, uint32_t> > const & read)
+  {
+    std::vector<std::size_t> local_depth;
+
+    for (auto const & interval : read)
+    {
+      std::size_t const start_index = ref_depth.start_pos_to_index(interval.first);
+      std::size_t const end_index = std::min(ref_depth.end_pos_to_index(interval.second), depth.size());
+
+      for (std::size_t i = start_index; i < end_index; ++i)
+        local_depth.push_back(i);
+    }
+
+    std::sort(local_depth.begin(), local_depth.end());
+    auto last = std::unique(local_depth.begin(), local_depth.end());
+
+    for (auto it = local_depth.begin(); it != last; ++it)
+    {
+      if (depth[*it] < 0xFFFFul)
+        ++depth[*it];
+    }
+  }
+
+  std::vector<uint16_t> depth;
+};
+
+
+} // anon namespace
+
+
+TEST_CASE("Reference depth from intervals is the same as the per-base depth")
+{
+  using namespace gyper;
+
+  std::size_t const DEPTH_SIZE = 1000;
+  ReferenceDepth ref_depth;
+  ref_depth.resize_depth(DEPTH_SIZE);
+  uint32_t const offset = ref_depth.reference_offset;
+  PerBaseDepth expected(DEPTH_SIZE);
+  std::mt19937 gen(42);
+
+  auto check_depth = [&]()
+  {
+    REQUIRE(ref_depth.get_depth() == expected.depth);
+
+    for (int v = 0; v < 100; ++v)
+    {
+      VariantCandidate var;
+      var.abs_pos = offset + gen() % (DEPTH_SIZE - 20);
+      var.seqs.push_back(std::vector<char>(1 + gen() % 10, 'A'));
+      var.seqs.push_back(std::vector<char>(1, 'C'));
+
+      uint32_t const start_index = var.seqs[0].size() > 1 ? var.abs_pos + 1 - offset : var.abs_pos - offset;
+      uint32_t const end_index = var.abs_pos + static_cast<uint32_t>(var.seqs[0].size()) - offset;
+      uint16_t const max_depth = *std::max_element(expected.depth.begin() + start_index,
+                                                   expected.depth.begin() + end_index);
+      REQUIRE(ref_depth.get_read_depth(var) == max_depth);
+    }
+  };
+
+  // Enough reads for the intervals to be folded into the depth window a few times
+  for (int r = 0; r < 200000; ++r)
+  {
+    std::vector<std::pair<uint32_t, uint32_t> > read;
+    int const num_intervals = 1 + gen() % 3;
+
+    // Overlapping intervals of a read are only counted once
+    for (int i = 0; i < num_intervals; ++i)
+    {
+      uint32_t const start_pos = offset + gen() % (DEPTH_SIZE + 20);
+      uint32_t const end_pos = start_pos + gen() % 100;
+      read.push_back({start_pos, end_pos});
+      ref_depth.increase_local_depth_by_one(start_pos, end_pos);
+    }
+
+    ref_depth.commit_local_depth();
+    expected.add_read(ref_depth, read);
+
+    if (r == 100 || r == 50000 || r == 150000)
+      check_depth();
+  }
+
+  REQUIRE(ref_depth.folded_depth.size() > 0);
+  check_depth();
+
+  std::size_t window_begin;
+  std::vector<uint16_t> const window = ref_depth.get_depth_window(window_begin);
+  REQUIRE(window_begin + window.size() <= DEPTH_SIZE);
+  REQUIRE(std::vector<uint16_t>(expected.depth.begin() + window_begin,
+                                expected.depth.begin() + window_begin + window.size()) == window);
+}
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <graphtyper/constants.hpp>
+#include <graphtyper/index/hamming1_index.hpp>
+#include <graphtyper/utilities/arena.hpp>
+#include <graphtyper/utilities/type_conversions.hpp>
+
+#include <catch.hpp>
+
+
+namespace
+{
+
+/** Returns the keys in hamming distance 1 to 'key' by looking up all 96 candidates. */
+std::vector<uint64_t>
+brute_force_hamming1(std::vector<uint64_t> const & sorted_keys, uint64_t const key)
+{
+  std::vector<uint64_t> neighbours;
+  std::array<uint64_t, 96> candidates = gyper::to_uint64_vec_hamming_distance_1(key);
+
+  for (auto const candidate : candidates)
+  {
+    if (std::binary_search(sorted_keys.begin(), sorted_keys.end(), candidate))
+      neighbours.push_back(candidate);
+  }
+
+  return neighbours;
+}
+
+
+/** Removes candidates which are not in the index, they may be returned for frequent k-mer halves. */
+std::vector<uint64_t>
+keep_existing(std::vector<uint64_t> const & sorted_keys, std::vector<uint64_t> const & candidates)
+{
+  std::vector<uint64_t> existing;
+
+  for (auto const candidate : candidates)
+  {
+    if (std::binary_search(sorted_keys.begin(), sorted_keys.end(), candidate))
+      existing.push_back(candidate);
+  }
+
+  return existing;
+}
+
+
+} // anon namespace
+
+
+TEST_CASE("Hamming distance 1 index finds the same k-mers as looking up all 96 candidates")
+{
+  std::mt19937_64 rng(42);
+  std::vector<uint64_t> keys;
+
+  // Random k-mers and some of their neighbours
+  for (int i = 0; i < 2000; ++i)
+  {
+    uint64_t const key = rng();
+    keys.push_back(key);
+    keys.push_back(key ^ (static_cast<uint64_t>(1 + rng() % 3) << (2 * (rng() % 32))));
+  }
+
+  // Many k-mers with the same high half
+  for (uint64_t i = 0; i < 100; ++i)
+    keys.push_back(0x0123456700000000ull | (i << 8));
+
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  gyper::Hamming1Index hamming1_index;
+  hamming1_index.build(std::vector<uint64_t>(keys));
+  REQUIRE(hamming1_index.size() == keys.size());
+
+  // The k-mers can also be appended to a buffer which is reused between queries
+  gyper::Arena arena;
+  gyper::ArenaVector<uint64_t> neighbours{gyper::ArenaAllocator<uint64_t>(arena)};
+
+  for (std::size_t i = 0; i < keys.size(); ++i)
+  {
+    std::vector<uint64_t> const found = hamming1_index.find(keys[i]);
+    REQUIRE(keep_existing(keys, found) == brute_force_hamming1(keys, keys[i]));
+
+    neighbours.assign(1, keys[i]);
+    hamming1_index.find(keys[i], neighbours);
+    REQUIRE(neighbours.size() == found.size() + 1);
+    REQUIRE(std::equal(found.begin(), found.end(), neighbours.begin() + 1));
+
+    uint64_t const missing_key = rng();
+    REQUIRE(keep_existing(keys, hamming1_index.find(missing_key)) == brute_force_hamming1(keys, missing_key));
+  }
+}
+
+
+TEST_CASE("Empty hamming distance 1 index")
+{
+  gyper::Hamming1Index hamming1_index;
+  REQUIRE(hamming1_index.empty());
+  REQUIRE(hamming1_index.find(0x0123456789ABCDEFull).size() == 0);
+}
+
+
+TEST_CASE("Hamming distance 1 index can be written to a file and memory-mapped")
+{
+  std::mt19937_64 rng(7);
+  std::vector<uint64_t> keys;
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    uint64_t const key = rng();
+    keys.push_back(key);
+    keys.push_back(key ^ (static_cast<uint64_t>(1 + rng() % 3) << (2 * (rng() % 32))));
+  }
+
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  gyper::Hamming1Index built_index;
+  built_index.build(std::vector<uint64_t>(keys));
+
+  std::string const path = std::string(gyper_BINARY_DIRECTORY) + "/hamming1_index_test.gtm";
+  built_index.write(path);
+
+  gyper::Hamming1Index mapped_index;
+  REQUIRE(mapped_index.open(path));
+  REQUIRE(mapped_index.size() == built_index.size());
+
+  // A moved index keeps its mapping
+  gyper::Hamming1Index moved_index(std::move(mapped_index));
+  REQUIRE(mapped_index.empty());
+  REQUIRE(moved_index.size() == keys.size());
+
+  for (auto const key : keys)
+    REQUIRE(moved_index.find(key) == built_index.find(key));
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    uint64_t const missing_key = rng();
+    REQUIRE(moved_index.find(missing_key) == built_index.find(missing_key));
+  }
+
+  gyper::Hamming1Index invalid_index;
+  REQUIRE(!invalid_index.open(std::string(gyper_SOURCE_DIRECTORY) + "/test/data/reference/index_test.fa"));
+  REQUIRE(invalid_index.empty());
+}
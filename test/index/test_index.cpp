@@ -1,19 +1,47 @@
 #include <catch.hpp>
 
 #include <stdio.h>
+#include <algorithm>
 #include <climits>
 #include <cstdio>
 #include <string>
+#include <vector>
 #include <iostream>
 #include <fstream>
+#include <iterator>
 
 #include <graphtyper/graph/graph_serialization.hpp>
 #include <graphtyper/graph/constructor.hpp>
+#include <graphtyper/index/hamming1_index.hpp>
 #include <graphtyper/index/indexer.hpp>
+#include <graphtyper/index/mem_index.hpp>
+#include <graphtyper/index/mmap_index.hpp>
 #include <graphtyper/index/rocksdb.hpp>
+#include <graphtyper/utilities/options.hpp>
 #include <graphtyper/utilities/type_conversions.hpp>
 
 
+namespace
+{
+
+void
+require_same_labels(std::vector<gyper::KmerLabel> const & labels, std::vector<gyper::KmerLabel> const & expected)
+{
+  REQUIRE(labels.size() == expected.size());
+
+  for (std::size_t i = 0; i < labels.size(); ++i)
+  {
+    REQUIRE(labels[i].start_index == expected[i].start_index);
+    REQUIRE(labels[i].end_index == expected[i].end_index);
+    REQUIRE(labels[i].variant_id == expected[i].variant_id);
+    REQUIRE(labels[i].variant_num == expected[i].variant_num);
+  }
+}
+
+
+} // anon namespace
+
+
 TEST_CASE("Test index chr1")
 {
   using namespace gyper;
@@ -160,6 +188,36 @@ TEST_CASE("Test index chr2")
     REQUIRE(gyper::index.get(gyper::to_uint64("CCCCAGGTTTCCCCAGGTTTCCCCAGGTTTGG", 0))[0].variant_id == gyper::INVALID_ID);
     REQUIRE(gyper::index.get(gyper::to_uint64("CCCCAGGTTTCCCCAGGTTTCCCCAGGTTTGG", 0))[0].variant_num == gyper::INVALID_NUM);
   }
+
+  // The memory-mapped index has the same labels, in the same order, as the RocksDB index
+  {
+    MmapIndex mmap_index;
+    REQUIRE(mmap_index.open(get_mmap_index_path(my_index.str())));
+    REQUIRE(mmap_index.table.size() > 0);
+
+    std::vector<std::string> const kmers = {
+      "CCCCAGGTTTCCCCAGGTTTCCCCAGGTTTCC",
+      "CCCCAGGTTTCCCCAGGTTTCCCCAGGTTTGG",
+      "CACCAGGTTTCCCCAGGTTTCCCCAGGTTTCC",
+      "CAACAGGTTTCCCCAGGTTTCCCCAGGTTTCC",
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA" // Not in the index
+    };
+
+    for (auto const & kmer : kmers)
+    {
+      std::vector<KmerLabel> const expected = index.get(to_uint64(kmer, 0));
+      std::vector<KmerLabel> const labels = mmap_index.table.get(std::vector<uint64_t>(1, to_uint64(kmer, 0)));
+      REQUIRE(labels.size() == expected.size());
+
+      for (std::size_t i = 0; i < labels.size(); ++i)
+      {
+        REQUIRE(labels[i].start_index == expected[i].start_index);
+        REQUIRE(labels[i].end_index == expected[i].end_index);
+        REQUIRE(labels[i].variant_id == expected[i].variant_id);
+        REQUIRE(labels[i].variant_num == expected[i].variant_num);
+      }
+    }
+  }
 }
 
 
@@ -223,6 +281,119 @@ TEST_CASE("Test index chr3")
   }
 }
 
+
+TEST_CASE("Multi-threaded indexing gives the same index as serial indexing")
+{
+  using namespace gyper;
+
+  std::stringstream my_graph;
+  my_graph << gyper_SOURCE_DIRECTORY << "/test/data/graphs/index_test_chr2.grf";
+  std::stringstream my_index;
+  my_index << gyper_SOURCE_DIRECTORY << "/test/data/graphs/index_test_chr2_threads";
+
+  auto read_file = [](std::string const & path)
+  {
+    std::ifstream f(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+  };
+
+  gyper::load_graph(my_graph.str().c_str());
+  REQUIRE(graph.size() > 0);
+
+  // Use chunks of a single reference node, so with two threads the graph is indexed in several chunks and waves
+  std::size_t const index_chunk_size = Options::instance()->index_chunk_size;
+  Options::instance()->index_chunk_size = 1;
+  REQUIRE(graph.ref_nodes.size() > 2);
+
+  Options::instance()->threads = 1;
+  gyper::index_graph(my_graph.str(), my_index.str());
+  std::string const serial_index = read_file(get_mmap_index_path(my_index.str()));
+  std::string const serial_hamming1 = read_file(get_hamming1_index_path(my_index.str()));
+
+  Options::instance()->threads = 2;
+  gyper::index_graph(my_graph.str(), my_index.str());
+  std::string const parallel_index = read_file(get_mmap_index_path(my_index.str()));
+  std::string const parallel_hamming1 = read_file(get_hamming1_index_path(my_index.str()));
+  Options::instance()->threads = 1;
+  Options::instance()->index_chunk_size = index_chunk_size;
+
+  REQUIRE(serial_index.size() > 0);
+  REQUIRE(serial_index == parallel_index);
+  REQUIRE(serial_hamming1.size() > 0);
+  REQUIRE(serial_hamming1 == parallel_hamming1);
+}
+
+
+TEST_CASE("The in-memory k-mer table has the same labels as the RocksDB index")
+{
+  using namespace gyper;
+
+  for (std::string const chr : {"chr1", "chr2", "chr3"})
+  {
+    std::string const graph_path = std::string(gyper_SOURCE_DIRECTORY) + "/test/data/graphs/index_test_" + chr + ".grf";
+    std::string const index_path = std::string(gyper_BINARY_DIRECTORY) + "/test_index_mem_index_" + chr;
+
+    gyper::load_graph(graph_path.c_str());
+    REQUIRE(graph.size() > 0);
+    gyper::index_graph(graph_path, index_path);
+    gyper::load_index(index_path);
+    REQUIRE(gyper::index.check());
+
+    MemIndex mem;
+    mem.load();
+
+    // All keys of the RocksDB index
+    std::vector<uint64_t> keys;
+
+    {
+      rocksdb::Iterator * it = gyper::index.hamming0.db->NewIterator(rocksdb::ReadOptions());
+      REQUIRE(it);
+
+      for (it->SeekToFirst(); it->Valid(); it->Next())
+        keys.push_back(key_to_uint64_t(it->key().ToString()));
+
+      delete it;
+    }
+
+    REQUIRE(keys.size() > 0);
+    REQUIRE(mem.hamming0.size() == keys.size());
+
+    {
+      std::vector<uint64_t> table_keys = mem.hamming0.get_keys();
+      std::sort(table_keys.begin(), table_keys.end());
+      std::vector<uint64_t> sorted_keys = keys;
+      std::sort(sorted_keys.begin(), sorted_keys.end());
+      REQUIRE(table_keys == sorted_keys);
+    }
+
+    // Keys which are not in the index. The all-A k-mer has the same key as the empty slots of the table
+    keys.push_back(to_uint64("AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA", 0));
+    keys.push_back(to_uint64("ACGTACGTACGTACGTACGTACGTACGTACGT", 0));
+
+    // Each key on its own
+    for (auto const key : keys)
+      require_same_labels(mem.get(std::vector<uint64_t>(1, key)), gyper::index.get(key));
+
+    // Read k-mers with one or several keys in a single query
+    std::vector<std::vector<uint64_t> > multi_keys;
+
+    for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+      if (i % 3 == 0)
+        multi_keys.push_back(std::vector<uint64_t>(1, keys[i]));
+      else
+        multi_keys.back().push_back(keys[i]);
+    }
+
+    std::vector<std::vector<KmerLabel> > const expected = gyper::index.multi_get(multi_keys);
+    std::vector<std::vector<KmerLabel> > const labels = mem.multi_get(multi_keys);
+    REQUIRE(labels.size() == expected.size());
+
+    for (std::size_t i = 0; i < labels.size(); ++i)
+      require_same_labels(labels[i], expected[i]);
+  }
+}
+
 /*
 TEST_CASE("Test index chr5")
 {
@@ -0,0 +1,324 @@
+#include <catch.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <graphtyper/constants.hpp>
+#include <graphtyper/graph/graph_serialization.hpp>
+#include <graphtyper/index/mem_index.hpp>
+#include <graphtyper/index/mmap_index.hpp>
+#include <graphtyper/typer/alignment.hpp>
+#include <graphtyper/utilities/options.hpp>
+
+
+namespace
+{
+
+void
+load_chr1_graph_and_index()
+{
+  std::stringstream my_graph;
+  my_graph << gyper_SOURCE_DIRECTORY << "/test/data/graphs/index_test_chr1.grf";
+  std::stringstream my_index;
+  my_index << gyper_SOURCE_DIRECTORY << "/test/data/graphs/index_test_chr1";
+
+  gyper::load_graph(my_graph.str());
+  REQUIRE(gyper::graph.size() > 0);
+  REQUIRE(gyper::mem_index.load_mmap(gyper::get_mmap_index_path(my_index.str())));
+}
+
+
+gyper::SamRead
+make_read(std::string const & seq, uint16_t const flag = 0)
+{
+  gyper::SamRead read;
+  read.seq = seq.c_str();
+  read.qual = std::string(seq.size(), 'I').c_str();
+  read.flag = flag;
+  read.mapq = 60;
+  read.begin_pos = 0;
+  read.is_clipped = false;
+  return read;
+}
+
+
+std::string
+reverse_complement(std::string const & seq)
+{
+  std::string rc(seq.rbegin(), seq.rend());
+
+  for (auto & base : rc)
+  {
+    switch (base)
+    {
+    case 'A': base = 'T'; break;
+    case 'C': base = 'G'; break;
+    case 'G': base = 'C'; break;
+    case 'T': base = 'A'; break;
+    }
+  }
+
+  return rc;
+}
+
+
+/**
+ * \brief Finds the reference distance closest to 'OPTIMAL' like find_shortest_distance() did before, by calling
+ *        get_insert_size() for every pair of paths.
+ */
+int64_t
+find_shortest_distance_of_insert_sizes(gyper::GenotypePaths const & geno1,
+                                       gyper::GenotypePaths const & geno2,
+                                       uint32_t const OPTIMAL,
+                                       bool const REVERSE_COMPLEMENT)
+{
+  int64_t shortest_distance_diff = 0x00000000FFFFFFFFll;
+  int64_t shortest_distance = 0x00000000FFFFFFFFll;
+
+  for (auto it1 = geno1.paths.cbegin(); it1 != geno1.paths.cend(); ++it1)
+  {
+    for (auto it2 = geno2.paths.cbegin(); it2 != geno2.paths.cend(); ++it2)
+    {
+      long const distance = gyper::get_insert_size(it1, it2, OPTIMAL, REVERSE_COMPLEMENT);
+      long const distance_diff = std::llabs(distance - static_cast<long>(OPTIMAL));
+
+      if (distance_diff < shortest_distance_diff)
+      {
+        shortest_distance_diff = distance_diff;
+        shortest_distance = distance;
+      }
+    }
+  }
+
+  return shortest_distance;
+}
+
+
+/** \brief Creates a path from 'start' to 'end'. Paths through rs1 at position 37 can have one or both of its alleles. */
+gyper::Path
+make_path(uint32_t const start, uint32_t const end, uint32_t const rs1_alleles = 0)
+{
+  gyper::Path path;
+  path.start = start;
+  path.end = end;
+  path.mismatches = 0;
+
+  if (rs1_alleles != 0)
+  {
+    path.var_order.push_back(37);
+    path.nums.push_back(gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES>(rs1_alleles));
+  }
+
+  return path;
+}
+
+
+} // anon namespace
+
+
+TEST_CASE("Duplicate reads in a batch share the alignment of the first of them", "[alignment]")
+{
+  using namespace gyper;
+
+  load_chr1_graph_and_index();
+
+  // chr1 37 rs1 C G
+  std::string const ref = "AGGTTTCCCCAGGTTTCCCCAGGTTTCCCCAGGTTTCCCCAGGTTTCCCCAGGTTTCCCCTTTGGA";
+  std::string alt = ref;
+  alt[36] = 'G';
+
+  TReads reads;
+  reads.push_back({make_read(ref.substr(4, 60)), SamRead()});
+  reads.push_back({make_read(alt.substr(2, 60)), SamRead()});
+  reads.push_back({make_read(ref.substr(4, 60)), SamRead()}); // Duplicate of the first read
+
+  uint64_t num_aligned_before;
+  uint64_t num_cached_before;
+  get_read_cache_statistics(num_aligned_before, num_cached_before);
+
+  std::vector<GenotypePaths> genos;
+  align_unpaired_read_pairs(reads, genos);
+
+  uint64_t num_aligned;
+  uint64_t num_cached;
+  get_read_cache_statistics(num_aligned, num_cached);
+
+  // Each read is aligned in both orientations, the duplicate read is found in the cache in both
+  REQUIRE(num_aligned - num_aligned_before == 6);
+  REQUIRE(num_cached - num_cached_before == 2);
+
+  // Unaligned reads do not get genotype paths, so the duplicate reads are found by their sequence
+  std::string const dup = ref.substr(4, 60);
+  std::vector<GenotypePaths const *> dup_genos;
+
+  for (auto const & geno : genos)
+  {
+    if (std::string(geno.read.begin(), geno.read.end()) == dup)
+      dup_genos.push_back(&geno);
+  }
+
+  REQUIRE(dup_genos.size() == 2);
+  GenotypePaths const & geno1 = *dup_genos[0];
+  GenotypePaths const & geno2 = *dup_genos[1];
+  REQUIRE(geno1.paths.size() > 0);
+  REQUIRE(geno1.longest_path_length == geno2.longest_path_length);
+  REQUIRE(geno1.paths.size() == geno2.paths.size());
+
+  for (std::size_t p = 0; p < geno1.paths.size(); ++p)
+  {
+    REQUIRE(geno1.paths[p].start == geno2.paths[p].start);
+    REQUIRE(geno1.paths[p].end == geno2.paths[p].end);
+    REQUIRE(geno1.paths[p].var_order == geno2.paths[p].var_order);
+    REQUIRE(geno1.paths[p].nums == geno2.paths[p].nums);
+  }
+}
+
+
+TEST_CASE("Reads are aligned in the orientations given by their strand or their seeds", "[alignment]")
+{
+  using namespace gyper;
+
+  load_chr1_graph_and_index();
+
+  std::string const ref = "AGGTTTCCCCAGGTTTCCCCAGGTTTCCCCAGGTTTCCCCAGGTTTCCCCAGGTTTCCCCTTTGGA";
+  std::string const forward_seq = ref.substr(4, 60);
+  std::string const reverse_seq = reverse_complement(forward_seq);
+  std::string const unseeded_seq(60, 'A');
+
+  SamRead const forward = make_read(forward_seq);
+  SamRead const reverse = make_read(forward_seq, BAM_FREVERSE);
+  SamRead const unmapped_forward = make_read(forward_seq, BAM_FUNMAP);
+  SamRead const unmapped_reverse = make_read(reverse_seq, BAM_FUNMAP);
+  SamRead const unmapped_unseeded = make_read(unseeded_seq, BAM_FUNMAP);
+
+  bool const single_orientation_alignment = Options::instance()->single_orientation_alignment;
+
+  SECTION("Reads are aligned in both orientations by default")
+  {
+    Options::instance()->single_orientation_alignment = false;
+    REQUIRE(get_orientations_to_align(forward) == ALIGN_BOTH);
+    REQUIRE(get_orientations_to_align(reverse) == ALIGN_BOTH);
+    REQUIRE(get_orientations_to_align(forward, reverse) == ALIGN_BOTH);
+  }
+
+  SECTION("Mapped reads are aligned in the orientation of their strand")
+  {
+    Options::instance()->single_orientation_alignment = true;
+    REQUIRE(get_orientations_to_align(forward) == ALIGN_FORWARD);
+    REQUIRE(get_orientations_to_align(reverse) == ALIGN_REVERSE);
+
+    // The second read of a pair is reverse complemented to the strand of the first read
+    REQUIRE(get_orientations_to_align(forward, reverse) == ALIGN_FORWARD);
+    REQUIRE(get_orientations_to_align(reverse, forward) == ALIGN_REVERSE);
+    REQUIRE(get_orientations_to_align(forward, unmapped_unseeded) == ALIGN_FORWARD);
+    REQUIRE(get_orientations_to_align(unmapped_unseeded, forward) == ALIGN_REVERSE);
+  }
+
+  SECTION("Unmapped reads are aligned in the orientations their first or last k-mers are found in")
+  {
+    Options::instance()->single_orientation_alignment = true;
+    REQUIRE(get_orientations_to_align(unmapped_forward) == ALIGN_FORWARD);
+    REQUIRE(get_orientations_to_align(unmapped_reverse) == ALIGN_REVERSE);
+    REQUIRE(get_orientations_to_align(unmapped_unseeded) == ALIGN_BOTH);
+
+    REQUIRE(get_orientations_to_align(unmapped_forward, unmapped_unseeded) == ALIGN_FORWARD);
+    REQUIRE(get_orientations_to_align(unmapped_unseeded, unmapped_reverse) == ALIGN_REVERSE);
+    REQUIRE(get_orientations_to_align(unmapped_forward, unmapped_reverse) == ALIGN_BOTH);
+    REQUIRE(get_orientations_to_align(unmapped_unseeded, unmapped_unseeded) == ALIGN_BOTH);
+
+    // Reads of a pair which were mapped to the same strand are also seeded
+    REQUIRE(get_orientations_to_align(make_read(reverse_seq), make_read(reverse_seq)) == ALIGN_REVERSE);
+    REQUIRE(get_orientations_to_align(reverse, make_read(forward_seq, BAM_FREVERSE)) == ALIGN_FORWARD);
+  }
+
+  Options::instance()->single_orientation_alignment = single_orientation_alignment;
+}
+
+
+TEST_CASE("The shortest distance between paths of a read pair is the same as of the insert sizes", "[alignment]")
+{
+  using namespace gyper;
+
+  load_chr1_graph_and_index();
+
+  SECTION("Randomized paths")
+  {
+    std::mt19937 gen(8);
+
+    for (int t = 0; t < 2000; ++t)
+    {
+      uint32_t const OPTIMAL = gen() % 70;
+      GenotypePaths geno1;
+      GenotypePaths geno2;
+
+      for (auto * geno : {&geno1, &geno2})
+      {
+        std::size_t const num_paths = 1 + gen() % 4;
+
+        for (std::size_t p = 0; p < num_paths; ++p)
+        {
+          // Some positions are outside of the graph and some are on the alleles of rs1
+          uint32_t const start = gen() % 5 == 0 ? 37 : gen() % 70;
+          uint32_t const end = gen() % 5 == 0 ? 37 : gen() % 70;
+          geno->paths.push_back(make_path(start, end, gen() % 4));
+        }
+      }
+
+      for (bool const REVERSE_COMPLEMENT : {false, true})
+      {
+        int64_t const expected = find_shortest_distance_of_insert_sizes(geno1, geno2, OPTIMAL, REVERSE_COMPLEMENT);
+        int64_t const distance = find_shortest_distance(geno1, geno2, OPTIMAL, REVERSE_COMPLEMENT);
+
+        // Of equally close distances, either could have been found first by the insert sizes
+        REQUIRE(std::llabs(distance - OPTIMAL) == std::llabs(expected - OPTIMAL));
+      }
+    }
+  }
+
+  SECTION("A distance which is the optimal insert size is returned right away")
+  {
+    GenotypePaths geno1;
+    geno1.paths.push_back(make_path(10, 20));
+    GenotypePaths geno2;
+    geno2.paths.push_back(make_path(30, 40));
+    geno2.paths.push_back(make_path(45, 55));
+    geno2.paths.push_back(make_path(50, 60));
+
+    REQUIRE(find_shortest_distance(geno1, geno2, 45, false) == 45);
+    REQUIRE(find_shortest_distance_of_insert_sizes(geno1, geno2, 45, false) == 45);
+    REQUIRE(find_shortest_distance(geno2, geno1, 20, true) == 20);
+    REQUIRE(find_shortest_distance_of_insert_sizes(geno2, geno1, 20, true) == 20);
+  }
+
+  SECTION("Of equally close distances, the one of the first pair of paths is kept")
+  {
+    GenotypePaths geno1;
+    geno1.paths.push_back(make_path(10, 20));
+    GenotypePaths geno2;
+    geno2.paths.push_back(make_path(30, 40)); // Distance 30
+    geno2.paths.push_back(make_path(40, 50)); // Distance 40
+
+    REQUIRE(find_shortest_distance(geno1, geno2, 35, false) == 30);
+    REQUIRE(find_shortest_distance_of_insert_sizes(geno1, geno2, 35, false) == 30);
+
+    std::swap(geno2.paths[0], geno2.paths[1]);
+    REQUIRE(find_shortest_distance(geno1, geno2, 35, false) == 40);
+    REQUIRE(find_shortest_distance_of_insert_sizes(geno1, geno2, 35, false) == 40);
+  }
+
+  SECTION("Paths without locations have no distance")
+  {
+    GenotypePaths geno1;
+    geno1.paths.push_back(make_path(37, 50)); // Has no allele of rs1
+    GenotypePaths geno2;
+    geno2.paths.push_back(make_path(40, 57));
+
+    REQUIRE(find_shortest_distance(geno1, geno2, 20, false) == 0x00000000FFFFFFFFll);
+    REQUIRE(find_shortest_distance_of_insert_sizes(geno1, geno2, 20, false) == 0x00000000FFFFFFFFll);
+  }
+}
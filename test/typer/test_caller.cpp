@@ -0,0 +1,191 @@
+#include <catch.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "bgzf.h"
+#include "kstring.h"
+
+#include <graphtyper/constants.hpp>
+#include <graphtyper/graph/reference_depth.hpp>
+#include <graphtyper/typer/caller.hpp>
+#include <graphtyper/typer/variant_map.hpp>
+#include <graphtyper/utilities/options.hpp>
+
+
+namespace
+{
+
+// chr3 31 rs4 A G,GA
+std::string const CHR3 = "AAAACAAAATAAAACAAAATAAAAGAAAACAAAATAAAACAAAATAAAAGAAAACATTATAAAACA";
+
+
+/** Reads with the alternative allele have G at rs4 and, to be discovered, a new variant G at position 41. */
+std::string
+get_read(std::size_t const begin, bool const is_alt)
+{
+  std::string seq = CHR3.substr(begin, 60);
+
+  if (is_alt)
+  {
+    seq[30 - begin] = 'G';
+    seq[40 - begin] = 'G';
+  }
+
+  return seq;
+}
+
+
+void
+write_sam(std::string const & path,
+          std::string const & sample,
+          std::size_t const num_ref,
+          std::size_t const num_alt,
+          bool const is_paired)
+{
+  std::ofstream sam(path);
+  REQUIRE(sam.is_open());
+  sam << "@HD\tVN:1.6\tSO:unsorted\n"
+      << "@SQ\tSN:chr3\tLN:66\n"
+      << "@RG\tID:" << sample << "\tSM:" << sample << "\n";
+
+  for (std::size_t i = 0; i < num_ref + num_alt; ++i)
+  {
+    std::size_t const begin = i % 7;
+    std::string const seq = get_read(begin, i >= num_ref);
+    std::string const qual(seq.size(), 'I');
+
+    if (is_paired)
+    {
+      // The first mate is forward and the second mate reverse, both of the same fragment
+      sam << sample << "_read" << i << "\t99\tchr3\t" << (begin + 1) << "\t60\t60M\t=\t" << (begin + 1) << "\t60\t"
+          << seq << "\t" << qual << "\tRG:Z:" << sample << "\n";
+      sam << sample << "_read" << i << "\t147\tchr3\t" << (begin + 1) << "\t60\t60M\t=\t" << (begin + 1) << "\t-60\t"
+          << seq << "\t" << qual << "\tRG:Z:" << sample << "\n";
+    }
+    else
+    {
+      sam << sample << "_read" << i << "\t0\tchr3\t" << (begin + 1) << "\t60\t60M\t*\t0\t0\t"
+          << seq << "\t" << qual << "\tRG:Z:" << sample << "\n";
+    }
+  }
+}
+
+
+/** Decompresses a BGZF file, without the header line with the date. */
+std::string
+read_bgzf_text(std::string const & path)
+{
+  BGZF * fp = bgzf_open(path.c_str(), "r");
+  REQUIRE(fp != nullptr);
+  kstring_t line = {0, 0, nullptr};
+  std::string text;
+
+  while (bgzf_getline(fp, '\n', &line) >= 0)
+  {
+    if (std::string(line.s, line.l).compare(0, 11, "##fileDate=") != 0)
+    {
+      text.append(line.s, line.l);
+      text.push_back('\n');
+    }
+  }
+
+  free(line.s);
+  bgzf_close(fp);
+  return text;
+}
+
+
+/** \brief Calls the samples with 'threads' threads and returns the calls and, when discovering, the new variants. */
+std::pair<std::string, std::string>
+call_with_threads(std::vector<std::string> const & sams, std::string const & output_dir, unsigned const threads)
+{
+  std::stringstream graph_path;
+  graph_path << gyper_SOURCE_DIRECTORY << "/test/data/graphs/index_test_chr3.grf";
+  std::stringstream index_path;
+  index_path << gyper_SOURCE_DIRECTORY << "/test/data/graphs/index_test_chr3";
+
+  // Each call starts with no discovered variants and no reference depth, as in a new process
+  gyper::global_varmap = gyper::VariantMap();
+  gyper::global_reference_depth = gyper::GlobalReferenceDepth();
+
+  mkdir(output_dir.c_str(), 0755);
+  gyper::Options::instance()->threads = threads;
+  gyper::call(sams, graph_path.str(), index_path.str(), {"."}, {}, output_dir);
+  gyper::Options::instance()->threads = 1;
+
+  std::pair<std::string, std::string> calls;
+  calls.first = read_bgzf_text(output_dir + "/sample0_calls.vcf.gz");
+
+  if (!gyper::Options::instance()->no_new_variants)
+    calls.second = read_bgzf_text(output_dir + "/sample0_variants.vcf.gz");
+
+  return calls;
+}
+
+
+/** Writes the SAMs of homozygous reference, heterozygous and homozygous alternative samples in 'data_dir'. */
+std::vector<std::string>
+write_sams(std::string const & data_dir, bool const is_paired)
+{
+  std::vector<std::string> sams;
+  std::size_t const num_alt[] = {0, 6, 12, 6};
+  mkdir(data_dir.c_str(), 0755);
+
+  for (std::size_t s = 0; s < 4; ++s)
+  {
+    std::string const sample = "sample" + std::to_string(s);
+    sams.push_back(data_dir + "/" + sample + ".sam");
+    write_sam(sams.back(), sample, 12 - num_alt[s], num_alt[s], is_paired);
+  }
+
+  return sams;
+}
+
+
+} // anon namespace
+
+
+TEST_CASE("Calling with several reader threads gives the same calls as with a single thread")
+{
+  using namespace gyper;
+
+  // The output is written in the build directory, not among the test data
+  std::string const data_dir = std::string(gyper_BINARY_DIRECTORY) + "/test_caller_threads";
+  mkdir(data_dir.c_str(), 0755);
+  bool const no_new_variants = Options::instance()->no_new_variants;
+
+  for (bool const is_paired : {false, true})
+  {
+    for (bool const is_discovering : {false, true})
+    {
+      std::string const dir = data_dir + (is_paired ? "/paired" : "/unpaired") +
+                              (is_discovering ? "_discovery" : "_no_discovery");
+      std::vector<std::string> const sams = write_sams(dir, is_paired);
+      Options::instance()->no_new_variants = !is_discovering;
+
+      auto const serial_calls = call_with_threads(sams, dir + "/serial", 1);
+      auto const parallel_calls = call_with_threads(sams, dir + "/parallel", 4);
+      auto const many_parallel_calls = call_with_threads(sams, dir + "/many_parallel", 16);
+
+      Options::instance()->no_new_variants = no_new_variants;
+
+      REQUIRE(serial_calls.first.find("\nchr3\t") != std::string::npos);
+      REQUIRE(serial_calls.first == parallel_calls.first);
+      REQUIRE(serial_calls.first == many_parallel_calls.first);
+
+      if (is_discovering)
+        REQUIRE(serial_calls.second.find("\nchr3\t") != std::string::npos);
+
+      REQUIRE(serial_calls.second == parallel_calls.second);
+      REQUIRE(serial_calls.second == many_parallel_calls.second);
+    }
+  }
+}
@@ -43,7 +43,7 @@ TEST_CASE("Path with one label")
     REQUIRE(new_path.var_order.size() == 1);
     REQUIRE(new_path.nums.size() == 1);
     REQUIRE(new_path.var_order[0] == 20);
-    REQUIRE(new_path.nums[0] == std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES>(1 << 2));
+    REQUIRE(new_path.nums[0] == gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES>(1 << 2));
   }
 }
 
@@ -84,7 +84,7 @@ TEST_CASE("Sucessful merging of two paths")
     REQUIRE(merged_path.var_order.size() == 1);
     REQUIRE(merged_path.nums.size() == 1);
     REQUIRE(merged_path.var_order[0] == 20);
-    REQUIRE(merged_path.nums[0] == std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES>(1 << 2));
+    REQUIRE(merged_path.nums[0] == gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES>(1 << 2));
   }
 
   SECTION("Two paths with the different variant id can merge")
@@ -108,9 +108,9 @@ TEST_CASE("Sucessful merging of two paths")
     REQUIRE(merged_path.var_order.size() == 2);
     REQUIRE(merged_path.nums.size() == 2);
     REQUIRE(merged_path.var_order[0] == 34);
-    REQUIRE(merged_path.nums[0] == std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES>(1 << 3));
+    REQUIRE(merged_path.nums[0] == gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES>(1 << 3));
     REQUIRE(merged_path.var_order[1] == 20);
-    REQUIRE(merged_path.nums[1] == std::bitset<gyper::MAX_NUMBER_OF_HAPLOTYPES>(1 << 2));
+    REQUIRE(merged_path.nums[1] == gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES>(1 << 2));
   }
 }
 
@@ -0,0 +1,128 @@
+#include <catch.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <graphtyper/typer/read_pipeline.hpp>
+
+
+namespace
+{
+
+/** Counts how many times each batch passes through the stages of a pipeline. */
+struct StageCounts
+{
+  explicit StageCounts(std::size_t const num_batches)
+    : aligned(num_batches)
+    , scored(num_batches)
+  {
+    for (std::size_t i = 0; i < num_batches; ++i)
+    {
+      aligned[i] = 0;
+      scored[i] = 0;
+    }
+  }
+
+  std::vector<std::atomic<int> > aligned;
+  std::vector<std::atomic<int> > scored;
+};
+
+
+gyper::ReadPipeline::TAlignStage
+get_align_stage(StageCounts & counts)
+{
+  return [&counts](gyper::ReadBatch && batch)
+         {
+           ++counts.aligned[batch.pn_index];
+           gyper::AlignedBatch aligned;
+           aligned.pn_index = batch.pn_index;
+           return aligned;
+         };
+}
+
+
+gyper::ReadPipeline::TScoreStage
+get_score_stage(StageCounts & counts)
+{
+  return [&counts](gyper::AlignedBatch & aligned)
+         {
+           ++counts.scored[aligned.pn_index];
+         };
+}
+
+
+} // anon namespace
+
+
+TEST_CASE("Every batch added to the read pipeline is aligned and scored exactly once", "[read_pipeline]")
+{
+  using namespace gyper;
+
+  std::size_t const NUM_BATCHES = 2000;
+
+  for (std::size_t const num_threads : {1, 2, 8})
+  {
+    StageCounts counts(NUM_BATCHES);
+
+    {
+      ReadPipeline pipeline(get_align_stage(counts), get_score_stage(counts), num_threads, 2 /*queue size*/);
+
+      // Add the batches from two threads, like readers of different files
+      auto add_batches = [&pipeline, NUM_BATCHES](std::size_t const first)
+                         {
+                           for (std::size_t i = first; i < NUM_BATCHES; i += 2)
+                           {
+                             ReadBatch batch;
+                             batch.pn_index = i;
+                             pipeline.add(std::move(batch));
+                           }
+                         };
+
+      std::thread reader(add_batches, 1);
+      add_batches(0);
+      reader.join();
+      pipeline.join();
+    }
+
+    for (std::size_t i = 0; i < NUM_BATCHES; ++i)
+    {
+      REQUIRE(counts.aligned[i] == 1);
+      REQUIRE(counts.scored[i] == 1);
+    }
+  }
+}
+
+
+TEST_CASE("An exception in a stage of the read pipeline is rethrown by join", "[read_pipeline]")
+{
+  using namespace gyper;
+
+  std::size_t const NUM_BATCHES = 100;
+  StageCounts counts(NUM_BATCHES);
+  ReadPipeline::TScoreStage score_stage = get_score_stage(counts);
+
+  ReadPipeline pipeline(get_align_stage(counts),
+                        [&score_stage](AlignedBatch & aligned)
+                        {
+                          if (aligned.pn_index == 10)
+                            throw std::runtime_error("Scoring failed");
+
+                          score_stage(aligned);
+                        },
+                        4 /*threads*/,
+                        2 /*queue size*/);
+
+  // Adding batches must not block after the pipeline has stopped
+  for (std::size_t i = 0; i < NUM_BATCHES; ++i)
+  {
+    ReadBatch batch;
+    batch.pn_index = i;
+    pipeline.add(std::move(batch));
+  }
+
+  REQUIRE_THROWS_AS(pipeline.join(), std::runtime_error);
+  REQUIRE(counts.scored[10] == 0);
+}
@@ -0,0 +1,179 @@
+#include <catch.hpp>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <graphtyper/graph/reference_depth.hpp>
+#include <graphtyper/typer/variant_candidate.hpp>
+#include <graphtyper/typer/variant_map.hpp>
+#include <graphtyper/typer/variant_support.hpp>
+
+
+namespace
+{
+
+std::size_t const NUM_SAMPLES = 2;
+uint32_t const REGION_SIZE = 1000;
+
+
+/** Creates SNP candidates at a few positions, so each variant is supported by many reads. */
+std::vector<gyper::VariantCandidate>
+create_candidates(std::mt19937 & gen, std::size_t const num_candidates)
+{
+  char const bases[] = {'A', 'C', 'G', 'T'};
+  std::vector<gyper::VariantCandidate> vars(num_candidates);
+
+  for (auto & var : vars)
+  {
+    std::size_t const ref = gen() % 4;
+    var.abs_pos = 1 + gen() % 50;
+    var.seqs = {{bases[ref]}, {bases[(ref + 1 + gen() % 3) % 4]}};
+    var.is_low_qual = gen() % 4 == 0;
+    var.is_in_proper_pair = gen() % 4 != 0;
+    var.is_mapq0 = gen() % 8 == 0;
+    var.is_unaligned = gen() % 8 == 0;
+    var.is_clipped = gen() % 8 == 0;
+    var.is_first_in_pair = gen() % 2 == 0;
+    var.is_seq_reversed = gen() % 2 == 0;
+    var.original_pos = var.abs_pos + gen() % 100;
+  }
+
+  return vars;
+}
+
+
+/** Adds the support of variants to a single map, as variant maps were built before they were sharded. */
+void
+add_variants_unsharded(gyper::VarMap & varmap, std::vector<gyper::VariantCandidate> const & vars)
+{
+  for (auto const & var : vars)
+  {
+    gyper::VariantSupport & support = varmap[var];
+
+    if (var.is_low_qual)
+      ++support.lq_support;
+    else
+      ++support.hq_support;
+
+    ++support.depth;
+    support.proper_pairs += var.is_in_proper_pair;
+    support.mapq0 += var.is_mapq0;
+    support.unaligned += var.is_unaligned;
+    support.clipped += var.is_clipped;
+    support.first_in_pairs += var.is_first_in_pair;
+    support.sequence_reversed += var.is_seq_reversed;
+    support.add_unique_position(var.original_pos);
+  }
+}
+
+
+void
+require_same_support(gyper::VariantSupport const & a, gyper::VariantSupport const & b)
+{
+  REQUIRE(a.hq_support == b.hq_support);
+  REQUIRE(a.lq_support == b.lq_support);
+  REQUIRE(a.proper_pairs == b.proper_pairs);
+  REQUIRE(a.depth == b.depth);
+  REQUIRE(a.mapq0 == b.mapq0);
+  REQUIRE(a.unaligned == b.unaligned);
+  REQUIRE(a.clipped == b.clipped);
+  REQUIRE(a.first_in_pairs == b.first_in_pairs);
+  REQUIRE(a.sequence_reversed == b.sequence_reversed);
+  REQUIRE(a.unique_positions == b.unique_positions);
+  REQUIRE(a.pn_index == b.pn_index);
+}
+
+
+} // anon namespace
+
+
+TEST_CASE("Variant maps added to from many threads are the same as variant maps which are not sharded")
+{
+  using namespace gyper;
+
+  std::mt19937 gen(12);
+  std::vector<std::string> const samples = {"sample1", "sample2"};
+
+  // Batches of variant candidates of each sample, like the batches of reads scored on different threads
+  std::vector<std::vector<std::vector<VariantCandidate> > > batches(NUM_SAMPLES);
+
+  for (auto & sample_batches : batches)
+  {
+    for (int b = 0; b < 16; ++b)
+      sample_batches.push_back(create_candidates(gen, 1000));
+  }
+
+  VariantMap sharded;
+  sharded.set_samples(samples);
+  VariantMap unsharded;
+  unsharded.set_samples(samples);
+
+  {
+    std::vector<std::thread> threads;
+
+    for (std::size_t pn_index = 0; pn_index < NUM_SAMPLES; ++pn_index)
+    {
+      for (auto & batch : batches[pn_index])
+      {
+        add_variants_unsharded(unsharded.varmaps[pn_index], batch);
+        threads.emplace_back([&sharded, &batch, pn_index](){sharded.add_variants(std::move(batch), pn_index);});
+      }
+    }
+
+    for (auto & thread : threads)
+      thread.join();
+  }
+
+  // The unsharded maps have no shards to merge, so they are used as they are
+  sharded.merge_varmap_shards();
+  unsharded.merge_varmap_shards();
+
+  for (std::size_t pn_index = 0; pn_index < NUM_SAMPLES; ++pn_index)
+  {
+    REQUIRE(sharded.varmaps[pn_index].size() == unsharded.varmaps[pn_index].size());
+
+    for (auto const & item : unsharded.varmaps[pn_index])
+    {
+      REQUIRE(sharded.varmaps[pn_index].count(item.first) == 1);
+      require_same_support(sharded.varmaps[pn_index].at(item.first), item.second);
+    }
+  }
+
+  // Both give the same pool of variants above the cutoffs
+  uint32_t const reference_offset = global_reference_depth.reference_offset;
+  std::vector<std::vector<uint16_t> > const depths = global_reference_depth.depths;
+  global_reference_depth.set_pn_count(NUM_SAMPLES);
+  global_reference_depth.reference_offset = 0;
+
+  for (auto & depth : global_reference_depth.depths)
+  {
+    depth.resize(REGION_SIZE);
+
+    for (auto & d : depth)
+      d = static_cast<uint16_t>(gen() % 40);
+  }
+
+  sharded.create_varmap_for_all();
+  unsharded.create_varmap_for_all();
+
+  global_reference_depth.set_pn_count(depths.size());
+  global_reference_depth.reference_offset = reference_offset;
+  global_reference_depth.depths = depths;
+
+  REQUIRE(unsharded.pool_varmap.size() > 0);
+  REQUIRE(sharded.pool_varmap.size() == unsharded.pool_varmap.size());
+
+  for (auto const & item : unsharded.pool_varmap)
+  {
+    REQUIRE(sharded.pool_varmap.count(item.first) == 1);
+    auto const & sharded_supports = sharded.pool_varmap.at(item.first);
+    REQUIRE(sharded_supports.size() == item.second.size());
+
+    for (std::size_t s = 0; s < item.second.size(); ++s)
+      require_same_support(sharded_supports[s], item.second[s]);
+  }
+}
@@ -7,9 +7,177 @@
 #include <iostream>
 #include <fstream>
 
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "bgzf.h"
+#include "kstring.h"
+
+#include <graphtyper/graph/absolute_position.hpp> // gyper::absolute_pos
 #include <graphtyper/graph/graph_serialization.hpp> // load_graph()
 #include <graphtyper/index/indexer.hpp> // load_index()
 #include <graphtyper/typer/vcf.hpp>
+#include <graphtyper/utilities/options.hpp>
+
+
+namespace
+{
+
+/** Decompresses a BGZF file, without the header line with the date. */
+std::string
+read_vcf_text(std::string const & path)
+{
+  BGZF * fp = bgzf_open(path.c_str(), "r");
+  REQUIRE(fp != nullptr);
+  kstring_t line = {0, 0, nullptr};
+  std::string text;
+
+  while (bgzf_getline(fp, '\n', &line) >= 0)
+  {
+    if (std::string(line.s, line.l).compare(0, 11, "##fileDate=") != 0)
+    {
+      text.append(line.s, line.l);
+      text.push_back('\n');
+    }
+  }
+
+  free(line.s);
+  bgzf_close(fp);
+  return text;
+}
+
+
+/** Creates variants at the first 60 positions of chr1, so many of them are at the same position. */
+std::vector<gyper::Variant>
+get_random_variants(std::mt19937 & gen, std::size_t const num_variants, std::size_t const max_alleles = 2)
+{
+  std::vector<gyper::Variant> variants;
+  char const bases[] = {'A', 'C', 'G', 'T'};
+
+  for (std::size_t i = 0; i < num_variants; ++i)
+  {
+    gyper::Variant var;
+    var.abs_pos = gyper::absolute_pos.get_absolute_position("chr1", 1 + gen() % 60);
+    var.seqs.resize(2 + gen() % (max_alleles - 1));
+
+    for (auto & seq : var.seqs)
+    {
+      std::size_t const size = 1 + gen() % 3;
+
+      for (std::size_t j = 0; j < size; ++j)
+        seq.push_back(bases[gen() % 4]);
+    }
+
+    variants.push_back(var);
+  }
+
+  return variants;
+}
+
+
+/** Gets the CHROM, POS, ID, REF and ALT fields of the records of a VCF. */
+std::vector<std::string>
+get_record_ids(std::string const & text)
+{
+  std::vector<std::string> ids;
+  std::istringstream lines(text);
+  std::string line;
+
+  while (std::getline(lines, line))
+  {
+    if (line.size() == 0 || line[0] == '#')
+      continue;
+
+    std::size_t end = 0;
+
+    for (int f = 0; f < 5; ++f)
+      end = line.find('\t', end + 1);
+
+    ids.push_back(line.substr(0, end));
+  }
+
+  return ids;
+}
+
+
+/**
+ * Gets the expected CHROM, POS, ID, REF and ALT fields of the variants when they are sorted by position, type and
+ * alleles, as Vcf::write_records sorted them before it sorted keys.
+ */
+std::vector<std::string>
+get_expected_record_ids(std::vector<gyper::Variant> variants)
+{
+  using gyper::Variant;
+
+  std::stable_sort(variants.begin(), variants.end(), [](Variant const & a, Variant const & b) -> bool
+    {
+      return a.abs_pos < b.abs_pos ||
+             (a.abs_pos == b.abs_pos &&
+              a.determine_variant_type() < b.determine_variant_type()
+             ) ||
+             (a.abs_pos == b.abs_pos &&
+              a.determine_variant_type() == b.determine_variant_type() &&
+              a.seqs < b.seqs
+             );
+    });
+
+  std::vector<std::string> ids;
+  long dup = -1;
+
+  for (std::size_t i = 0; i < variants.size(); ++i)
+  {
+    Variant const & var = variants[i];
+
+    if (i > 0 &&
+        var.abs_pos == variants[i - 1].abs_pos &&
+        var.determine_variant_type() == variants[i - 1].determine_variant_type())
+    {
+      ++dup;
+    }
+    else
+    {
+      dup = -1;
+    }
+
+    auto const contig_pos = gyper::absolute_pos.get_contig_position(var.abs_pos);
+    std::ostringstream id;
+    id << contig_pos.first << '\t' << contig_pos.second << '\t'
+       << contig_pos.first << ':' << contig_pos.second << ':' << var.determine_variant_type();
+
+    if (dup != -1)
+      id << '.' << dup;
+
+    id << '\t' << std::string(var.seqs[0].begin(), var.seqs[0].end()) << '\t';
+
+    for (std::size_t a = 1; a < var.seqs.size(); ++a)
+      id << (a > 1 ? "," : "") << std::string(var.seqs[a].begin(), var.seqs[a].end());
+
+    ids.push_back(id.str());
+  }
+
+  return ids;
+}
+
+
+/** Writes the variants to a BGZF compressed VCF on 'threads' threads and reads the text of it. */
+std::string
+write_vcf_text(std::vector<gyper::Variant> const & variants, unsigned const threads, std::string const & filename)
+{
+  std::stringstream path;
+  path << gyper_SOURCE_DIRECTORY << "/test/data/" << filename;
+
+  gyper::Options::instance()->threads = threads;
+  gyper::Vcf vcf(gyper::WRITE_BGZF_MODE, path.str());
+  vcf.variants = variants;
+  vcf.write();
+  gyper::Options::instance()->threads = 1;
+  return read_vcf_text(path.str());
+}
+
+
+} // anon namespace
 
 
 TEST_CASE("Create a VCF and add samples")
@@ -89,3 +257,55 @@ TEST_CASE("Create a VCF and add variants")
     REQUIRE(vcf.variants[1].seqs[1] == gyper::to_vec("CA"));
   }
 }
+
+
+TEST_CASE("Writing a VCF on many threads gives the same text as on a single thread")
+{
+  using namespace gyper;
+
+  std::stringstream my_graph;
+  my_graph << gyper_SOURCE_DIRECTORY << "/test/data/graphs/index_test_chr1.grf";
+  gyper::load_graph(my_graph.str());
+
+  // Enough records for several formatting blocks per thread, with many variants at the same position
+  std::mt19937 gen(7);
+  std::vector<Variant> const variants = get_random_variants(gen, 40000);
+
+  std::string const serial_text = write_vcf_text(variants, 1, "parallel_write_serial.vcf.gz");
+  std::string const parallel_text = write_vcf_text(variants, 4, "parallel_write_threads.vcf.gz");
+  REQUIRE(std::count(serial_text.begin(), serial_text.end(), '\n') > 40000);
+  REQUIRE(serial_text == parallel_text);
+}
+
+
+TEST_CASE("Records are written in the order of their position, type and alleles")
+{
+  using namespace gyper;
+
+  std::stringstream my_graph;
+  my_graph << gyper_SOURCE_DIRECTORY << "/test/data/graphs/index_test_chr1.grf";
+  gyper::load_graph(my_graph.str());
+
+  std::mt19937 gen(22);
+
+  SECTION("Fewer variants than threads")
+  {
+    std::vector<Variant> const variants = get_random_variants(gen, 3, 3);
+    std::vector<std::string> const expected = get_expected_record_ids(variants);
+    REQUIRE(get_record_ids(write_vcf_text(variants, 8, "sorted_few.vcf.gz")) == expected);
+  }
+
+  SECTION("Variants which are sorted in parallel chunks, with many ties")
+  {
+    std::vector<Variant> variants = get_random_variants(gen, 30000, 3);
+
+    // Identical variants are tied on all of position, type and alleles
+    for (std::size_t i = 0; i < 1000; ++i)
+      variants.push_back(variants[gen() % variants.size()]);
+
+    std::vector<std::string> const expected = get_expected_record_ids(variants);
+    REQUIRE(get_record_ids(write_vcf_text(variants, 1, "sorted_serial.vcf.gz")) == expected);
+    REQUIRE(get_record_ids(write_vcf_text(variants, 3, "sorted_threads3.vcf.gz")) == expected);
+    REQUIRE(get_record_ids(write_vcf_text(variants, 8, "sorted_threads8.vcf.gz")) == expected);
+  }
+}
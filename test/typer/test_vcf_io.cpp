@@ -2,10 +2,13 @@
 
 #include <stdio.h>
 #include <climits>
+#include <cstdint>
 #include <cstdio>
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <vector>
 
 #include <graphtyper/constants.hpp>
 #include <graphtyper/typer/vcf.hpp>
@@ -42,4 +45,179 @@ TEST_CASE("Read the index test VCF file")
   {
     REQUIRE(vcf.sample_names.size() == 0);
   }
+
+  SECTION("The read buffer only grows for lines which do not fit")
+  {
+    REQUIRE(vcf.read_buffer.size() > 0);
+    REQUIRE(vcf.read_buffer.size() <= 65536);
+  }
+}
+
+
+namespace
+{
+
+std::string
+get_index_test_vcf_text()
+{
+  std::stringstream vcf_ss;
+  vcf_ss << gyper_SOURCE_DIRECTORY << "/test/data/reference/index_test.vcf";
+  std::ifstream f(vcf_ss.str());
+  REQUIRE(f.is_open());
+  std::stringstream text;
+  text << f.rdbuf();
+  return text.str();
+}
+
+
+std::vector<gyper::Variant>
+read_vcf_text(std::string const & text, std::string const & filename)
+{
+  // The VCF is written in the build directory, not among the test data
+  std::stringstream vcf_ss;
+  vcf_ss << gyper_BINARY_DIRECTORY << "/" << filename;
+
+  {
+    std::ofstream f(vcf_ss.str());
+    REQUIRE(f.is_open());
+    f << text;
+  }
+
+  gyper::Vcf vcf(gyper::READ_UNCOMPRESSED_MODE, vcf_ss.str());
+  vcf.read();
+  return vcf.variants;
+}
+
+
+void
+require_same_variants(std::vector<gyper::Variant> const & a, std::vector<gyper::Variant> const & b)
+{
+  REQUIRE(a.size() == b.size());
+
+  for (std::size_t i = 0; i < a.size(); ++i)
+  {
+    REQUIRE(a[i].abs_pos == b[i].abs_pos);
+    REQUIRE(a[i].seqs == b[i].seqs);
+    REQUIRE(a[i].infos == b[i].infos);
+  }
+}
+
+
+} // anon namespace
+
+
+TEST_CASE("Read a VCF file which does not end with a newline")
+{
+  std::string const text = get_index_test_vcf_text();
+  REQUIRE(text.back() == '\n');
+
+  auto const expected = read_vcf_text(text, "index_test_newline.vcf");
+  auto const vars = read_vcf_text(text.substr(0, text.size() - 1), "index_test_no_final_newline.vcf");
+  REQUIRE(expected.size() == 12);
+  require_same_variants(expected, vars);
+}
+
+
+TEST_CASE("Read a VCF file with a line longer than the read buffer")
+{
+  std::string const text = get_index_test_vcf_text();
+
+  // Insert a record with a long INFO field before the last records, which must still be read after it
+  std::size_t const pos = text.find("chr8\t");
+  REQUIRE(pos != std::string::npos);
+  std::string const seq(3000000, 'A');
+  std::string const long_text = text.substr(0, pos) +
+                                "chr7\t80\t.\tA\tC\t0\t.\tSVTYPE=INS;SEQ=" + seq + ";SVSIZE=3000000\n" +
+                                text.substr(pos);
+
+  auto const expected = read_vcf_text(text, "index_test_newline.vcf");
+  auto vars = read_vcf_text(long_text, "index_test_long_line.vcf");
+  REQUIRE(vars.size() == expected.size() + 1);
+
+  std::size_t const long_index = 9; // After the chr1 to chr7 records
+  REQUIRE(vars[long_index].seqs.size() == 2);
+  REQUIRE(vars[long_index].infos.at("SEQ") == seq);
+  REQUIRE(vars[long_index].infos.at("SVTYPE") == "INS");
+  REQUIRE(vars[long_index].infos.at("SVSIZE") == "3000000");
+
+  vars.erase(vars.begin() + long_index);
+  require_same_variants(expected, vars);
+}
+
+
+TEST_CASE("Read the calls of samples from a VCF file")
+{
+  std::string const text =
+    "##fileformat=VCFv4.2\n"
+    "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\ts1\ts2\ts3\ts4\n"
+    "chr1\t37\t.\tC\tG,T\t50\tPASS\tCR=1\tGT:FT:AD:MD:DP:RA:PP:GQ:PL"
+    "\t0|1:PASS:10,12,0:2:24:11,13:9:99:255,0,255,255,255,255"
+    "\t2|1:FAIL3:0,7,8:0:15:1,16:14:40:255,255,255,40,0,255"
+    "\t.|.:FAIL1:0,0,0:0:0:0,0:0:0:0,0,0,0,0,0"
+    "\t2|2:PASS:0,1,300:255:556:2,301:200:99:255,255,255,255,255,0\n"
+    "chr1\t40\t.\tA\tC\t50\tPASS\tCR=0\tGT:FT:AD:MD:DP:RA:PP:GQ:PL"
+    "\t0/1:PASS:5,6:1:12:5,6:3:80:200,0,180"
+    "\t./.:FAIL2:0,0:0:0:0,0:0:0:0,0,0"
+    "\t1/1:PASS:0,9:0:9:0,9:9:27:255,27,0"
+    "\t0/0:PASS:8,0:0:8:8,0:0:24:0,24,255\n";
+
+  std::stringstream vcf_ss;
+  vcf_ss << gyper_BINARY_DIRECTORY << "/samples_test.vcf";
+
+  {
+    std::ofstream f(vcf_ss.str());
+    REQUIRE(f.is_open());
+    f << text;
+  }
+
+  gyper::Vcf vcf(gyper::READ_UNCOMPRESSED_MODE, vcf_ss.str());
+  vcf.read();
+  REQUIRE(vcf.sample_names == std::vector<std::string>({"s1", "s2", "s3", "s4"}));
+  REQUIRE(vcf.variants.size() == 2);
+
+  auto require_call = [](gyper::SampleCall const & call,
+                         std::vector<uint16_t> const & coverage,
+                         uint8_t const ambiguous_depth,
+                         uint16_t const ref_total_depth,
+                         uint16_t const alt_total_depth,
+                         uint8_t const alt_proper_pair_depth,
+                         int8_t const filter,
+                         std::vector<uint8_t> const & phred)
+  {
+    REQUIRE(call.coverage == coverage);
+    REQUIRE(call.ambiguous_depth == ambiguous_depth);
+    REQUIRE(call.ref_total_depth == ref_total_depth);
+    REQUIRE(call.alt_total_depth == alt_total_depth);
+    REQUIRE(call.alt_proper_pair_depth == alt_proper_pair_depth);
+    REQUIRE(call.filter == filter);
+    REQUIRE(call.phred == phred);
+  };
+
+  SECTION("Phased multi-allelic calls")
+  {
+    gyper::Variant const & var = vcf.variants[0];
+    REQUIRE(var.seqs.size() == 3);
+    REQUIRE(var.calls.size() == 4);
+
+    // The phase is 1 if the first haplotype has the higher allele, a missing genotype has phase 0
+    REQUIRE(var.phase == std::vector<uint8_t>({0, 1, 0, 0}));
+
+    require_call(var.calls[0], {10, 12, 0}, 2, 11, 13, 9, 0, {255, 0, 255, 255, 255, 255});
+    require_call(var.calls[1], {0, 7, 8}, 0, 1, 16, 14, 3, {255, 255, 255, 40, 0, 255});
+    require_call(var.calls[2], {0, 0, 0}, 0, 0, 0, 0, 1, {0, 0, 0, 0, 0, 0});
+    require_call(var.calls[3], {0, 1, 300}, 255, 2, 301, 200, 0, {255, 255, 255, 255, 255, 0});
+  }
+
+  SECTION("Unphased biallelic calls")
+  {
+    gyper::Variant const & var = vcf.variants[1];
+    REQUIRE(var.seqs.size() == 2);
+    REQUIRE(var.calls.size() == 4);
+    REQUIRE(var.phase.size() == 0);
+
+    require_call(var.calls[0], {5, 6}, 1, 5, 6, 3, 0, {200, 0, 180});
+    require_call(var.calls[1], {0, 0}, 0, 0, 0, 0, 2, {0, 0, 0});
+    require_call(var.calls[2], {0, 9}, 0, 0, 9, 9, 0, {255, 27, 0});
+    require_call(var.calls[3], {8, 0}, 0, 8, 0, 0, 0, {0, 24, 255});
+  }
 }
@@ -0,0 +1,461 @@
+#include <catch.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bgzf.h"
+#include "kstring.h"
+
+#include <graphtyper/constants.hpp>
+#include <graphtyper/graph/graph_serialization.hpp>
+#include <graphtyper/typer/var_stats.hpp>
+#include <graphtyper/typer/vcf.hpp>
+#include <graphtyper/typer/vcf_operations.hpp>
+#include <graphtyper/utilities/options.hpp>
+
+
+namespace
+{
+
+/** The empty BGZF block which marks the end of a BGZF file. */
+char const BGZF_EOF_MARKER[28] = {
+  '\037', '\213', '\010', '\4', '\0', '\0', '\0', '\0', '\0', '\377', '\6', '\0', '\102', '\103',
+  '\2', '\0', '\033', '\0', '\3', '\0', '\0', '\0', '\0', '\0', '\0', '\0', '\0', '\0'
+};
+
+
+std::string
+read_bgzf_text(std::string const & path)
+{
+  BGZF * fp = bgzf_open(path.c_str(), "r");
+  REQUIRE(fp != nullptr);
+  kstring_t line = {0, 0, nullptr};
+  std::string text;
+
+  while (bgzf_getline(fp, '\n', &line) >= 0)
+  {
+    text.append(line.s, line.l);
+    text.push_back('\n');
+  }
+
+  free(line.s);
+  bgzf_close(fp);
+  return text;
+}
+
+
+std::size_t
+count_eof_markers(std::string const & path)
+{
+  std::ifstream f(path, std::ios::binary);
+  std::string const data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  std::string const marker(BGZF_EOF_MARKER, sizeof(BGZF_EOF_MARKER));
+  std::size_t count = 0;
+
+  for (std::size_t pos = data.find(marker); pos != std::string::npos; pos = data.find(marker, pos + 1))
+    ++count;
+
+  REQUIRE(data.size() >= marker.size());
+  REQUIRE(data.compare(data.size() - marker.size(), marker.size(), marker) == 0);
+  return count;
+}
+
+
+/** The header of the VCFs written by write_bgzf_vcf. */
+std::string const BGZF_VCF_HEADER =
+  "##fileformat=VCFv4.2\n"
+  "##contig=<ID=chr1,length=248956422>\n"
+  "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\ts1\n";
+
+
+/**
+ * \brief Writes a BGZF compressed VCF with records of random INFO, which compress poorly. Without 'has_eof' the
+ *        end-of-file marker is cut off the file. Returns the text of the records.
+ */
+std::string
+write_bgzf_vcf(std::mt19937 & gen,
+               std::string const & path,
+               std::size_t const num_records,
+               std::size_t const info_length,
+               bool const has_eof = true)
+{
+  char const alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789._";
+  std::string records;
+
+  for (std::size_t r = 0; r < num_records; ++r)
+  {
+    records += "chr1\t" + std::to_string(r + 1) + "\t.\tA\tC\t50\tPASS\tX=";
+
+    for (std::size_t i = 0; i < info_length; ++i)
+      records.push_back(alphabet[gen() % 64]);
+
+    records += "\tGT\t0/1\n";
+  }
+
+  std::string const text = BGZF_VCF_HEADER + records;
+  BGZF * fp = bgzf_open(path.c_str(), "w");
+  REQUIRE(fp != nullptr);
+  REQUIRE(bgzf_write(fp, text.data(), text.size()) == static_cast<ssize_t>(text.size()));
+  REQUIRE(bgzf_close(fp) == 0);
+
+  if (!has_eof)
+  {
+    struct stat st;
+    REQUIRE(stat(path.c_str(), &st) == 0);
+    REQUIRE(count_eof_markers(path) == 1);
+    REQUIRE(truncate(path.c_str(), st.st_size - sizeof(BGZF_EOF_MARKER)) == 0);
+  }
+
+  return records;
+}
+
+
+std::size_t
+get_file_size(std::string const & path)
+{
+  struct stat st;
+  REQUIRE(stat(path.c_str(), &st) == 0);
+  return static_cast<std::size_t>(st.st_size);
+}
+
+
+/** The INFO and the calls of a record of one of the VCFs which are merged. */
+struct MergeRecord
+{
+  uint32_t pos;
+  char alt;
+  uint32_t cr;
+  uint32_t mq;
+  uint32_t mq0;
+  std::vector<uint32_t> sbf;
+  std::vector<uint32_t> sbr;
+  std::vector<uint32_t> ra_count;
+  std::vector<gyper::SampleCall> calls;
+};
+
+
+/**
+ * \brief Writes a VCF with 'num_samples' samples and random INFO and calls for each record. There are three SNPs at
+ *        each position, so all but the first of them get a suffix to their ID when merged.
+ */
+std::vector<MergeRecord>
+write_merge_vcf(std::mt19937 & gen,
+                std::string const & path,
+                std::string const & sample_prefix,
+                std::size_t const num_samples,
+                std::size_t const num_records)
+{
+  char const alts[] = {'C', 'G', 'T'};
+  std::vector<MergeRecord> records(num_records);
+  std::ofstream vcf(path);
+  REQUIRE(vcf.is_open());
+  vcf << "##fileformat=VCFv4.2\n"
+      << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT";
+
+  for (std::size_t s = 0; s < num_samples; ++s)
+    vcf << "\t" << sample_prefix << s;
+
+  vcf << "\n";
+
+  for (std::size_t r = 0; r < num_records; ++r)
+  {
+    MergeRecord & record = records[r];
+    record.pos = static_cast<uint32_t>(1 + r / 3);
+    record.alt = alts[r % 3];
+    record.cr = gen() % 10;
+    record.mq = 20 + gen() % 41;
+    record.mq0 = gen() % 5;
+    record.sbf = {static_cast<uint32_t>(gen() % 20), static_cast<uint32_t>(gen() % 20)};
+    record.sbr = {static_cast<uint32_t>(gen() % 20), static_cast<uint32_t>(gen() % 20)};
+    record.ra_count = {static_cast<uint32_t>(gen() % 3), static_cast<uint32_t>(gen() % 3)};
+
+    vcf << "chr1\t" << record.pos << "\t.\tA\t" << record.alt << "\t50\tPASS\t"
+        << "CR=" << record.cr << ";MQ=" << record.mq << ";MQ0=" << record.mq0
+        << ";RACount=" << gyper::join_strand_bias(record.ra_count)
+        << ";SBF=" << gyper::join_strand_bias(record.sbf)
+        << ";SBR=" << gyper::join_strand_bias(record.sbr)
+        << "\tGT:AD:MD:RA:PP:PL";
+
+    for (std::size_t s = 0; s < num_samples; ++s)
+    {
+      gyper::SampleCall call;
+      call.coverage = {static_cast<uint16_t>(gen() % 30), static_cast<uint16_t>(gen() % 30)};
+      call.ambiguous_depth = static_cast<uint8_t>(gen() % 4);
+      call.ref_total_depth = static_cast<uint16_t>(call.coverage[0] + gen() % 3);
+      call.alt_total_depth = static_cast<uint16_t>(call.coverage[1] + gen() % 3);
+      call.alt_proper_pair_depth = static_cast<uint8_t>(gen() % (call.coverage[1] + 1));
+      call.phred = {static_cast<uint8_t>(gen() % 100), 0, static_cast<uint8_t>(gen() % 100)};
+
+      vcf << "\t0/1:" << call.coverage[0] << "," << call.coverage[1]
+          << ":" << static_cast<uint32_t>(call.ambiguous_depth)
+          << ":" << call.ref_total_depth << "," << call.alt_total_depth
+          << ":" << static_cast<uint32_t>(call.alt_proper_pair_depth)
+          << ":" << static_cast<uint32_t>(call.phred[0]) << ",0," << static_cast<uint32_t>(call.phred[2]);
+
+      record.calls.push_back(call);
+    }
+
+    vcf << "\n";
+  }
+
+  return records;
+}
+
+
+/** Gets the IDs of the records of a VCF. */
+std::vector<std::string>
+get_record_ids(std::string const & text)
+{
+  std::vector<std::string> ids;
+  std::istringstream ss(text);
+
+  for (std::string line; std::getline(ss, line);)
+  {
+    if (line.size() == 0 || line[0] == '#')
+      continue;
+
+    std::size_t const id_begin = line.find('\t', line.find('\t') + 1) + 1;
+    ids.push_back(line.substr(id_begin, line.find('\t', id_begin) - id_begin));
+  }
+
+  return ids;
+}
+
+
+/** Merges the VCFs in a child process and returns its exit status, so a merge which exits can be tested. */
+int
+get_exit_status_of_merge(std::vector<std::string> vcfs, std::string const & output)
+{
+  pid_t const pid = fork();
+  REQUIRE(pid >= 0);
+
+  if (pid == 0)
+  {
+    gyper::vcf_merge(vcfs, output);
+    _exit(0);
+  }
+
+  int status = 0;
+  REQUIRE(waitpid(pid, &status, 0) == pid);
+  REQUIRE(WIFEXITED(status));
+  return WEXITSTATUS(status);
+}
+
+
+} // anon namespace
+
+
+TEST_CASE("Concatenating the BGZF blocks of VCFs gives the same VCF as recompressing them")
+{
+  using namespace gyper;
+
+  std::stringstream my_graph;
+  my_graph << gyper_SOURCE_DIRECTORY << "/test/data/graphs/index_test_chr1.grf";
+  gyper::load_graph(my_graph.str());
+
+  std::stringstream dir;
+  dir << gyper_BINARY_DIRECTORY << "/test_vcf_concat";
+  mkdir(dir.str().c_str(), 0755);
+
+  std::stringstream vcf_path;
+  vcf_path << gyper_SOURCE_DIRECTORY << "/test/data/reference/index_test.vcf";
+
+  // Write two small BGZF compressed VCFs, so in each of them the records are in the same block as the header
+  std::vector<std::string> vcfs = {dir.str() + "/part1.vcf.gz", dir.str() + "/part2.vcf.gz"};
+
+  for (auto const & vcf : vcfs)
+    vcf_concatenate({vcf_path.str()}, vcf, true /*SKIP_SORT*/, false /*SITES_ONLY*/, ".");
+
+  REQUIRE(read_bgzf_text(vcfs[0]).find("\nchr1\t37\t") != std::string::npos);
+
+  std::string const recompressed = dir.str() + "/recompressed.vcf.gz";
+  std::string const copied = dir.str() + "/copied.vcf.gz";
+  vcf_concatenate(vcfs, recompressed, true /*SKIP_SORT*/, false /*SITES_ONLY*/, ".", false /*COPY_BLOCKS*/);
+  REQUIRE(vcf_concatenate_bgzf_blocks(vcfs, copied));
+
+  REQUIRE(read_bgzf_text(copied) == read_bgzf_text(recompressed));
+  REQUIRE(count_eof_markers(copied) == 1);
+}
+
+
+TEST_CASE("Merging VCFs in record batches adds up the records of all VCFs")
+{
+  using namespace gyper;
+
+  std::stringstream my_graph;
+  my_graph << gyper_SOURCE_DIRECTORY << "/test/data/graphs/index_test_chr1.grf";
+  gyper::load_graph(my_graph.str());
+
+  std::string const dir = std::string(gyper_BINARY_DIRECTORY) + "/test_vcf_merge";
+  mkdir(dir.c_str(), 0755);
+
+  // More records than are read in a batch, and not a multiple of the batch size
+  std::size_t const NUM_RECORDS = 150;
+  std::size_t const NUM_VCFS = 3;
+  std::size_t const NUM_SAMPLES = 2;
+  std::mt19937 gen(23);
+  std::vector<std::string> vcfs;
+  std::vector<std::vector<MergeRecord> > records;
+
+  for (std::size_t v = 0; v < NUM_VCFS; ++v)
+  {
+    vcfs.push_back(dir + "/part" + std::to_string(v) + ".vcf");
+    records.push_back(write_merge_vcf(gen, vcfs.back(), "sample" + std::to_string(v) + "_", NUM_SAMPLES, NUM_RECORDS));
+  }
+
+  unsigned const threads = Options::instance()->threads;
+  std::vector<std::string> merged_texts;
+
+  for (unsigned const num_threads : {1u, 2u, 8u})
+  {
+    std::string const output = dir + "/merged" + std::to_string(num_threads) + ".vcf.gz";
+    Options::instance()->threads = num_threads;
+    vcf_merge(vcfs, output);
+    Options::instance()->threads = threads;
+    merged_texts.push_back(read_bgzf_text(output));
+
+    Vcf merged(READ_MODE, output);
+    merged.read();
+    REQUIRE(merged.sample_names.size() == NUM_VCFS * NUM_SAMPLES);
+    REQUIRE(merged.sample_names[NUM_SAMPLES] == "sample1_0");
+    REQUIRE(merged.variants.size() == NUM_RECORDS);
+
+    for (std::size_t r = 0; r < NUM_RECORDS; ++r)
+    {
+      Variant const & var = merged.variants[r];
+      REQUIRE(var.abs_pos == records[0][r].pos);
+      REQUIRE(var.seqs.size() == 2);
+      REQUIRE(var.seqs[1] == std::vector<char>(1, records[0][r].alt));
+      REQUIRE(var.calls.size() == NUM_VCFS * NUM_SAMPLES);
+
+      uint32_t cr = 0;
+      uint32_t mq0 = 0;
+      uint64_t mapq_root = 0;
+      uint64_t seq_depth = 0;
+      std::vector<uint32_t> sbf(2, 0);
+      std::vector<uint32_t> sbr(2, 0);
+      std::vector<uint32_t> ra_count(2, 0);
+
+      for (std::size_t v = 0; v < NUM_VCFS; ++v)
+      {
+        MergeRecord const & record = records[v][r];
+        uint64_t record_depth = 0;
+
+        for (std::size_t s = 0; s < NUM_SAMPLES; ++s)
+        {
+          SampleCall const & expected = record.calls[s];
+          SampleCall const & call = var.calls[v * NUM_SAMPLES + s];
+          REQUIRE(call.coverage == expected.coverage);
+          REQUIRE(call.ambiguous_depth == expected.ambiguous_depth);
+          REQUIRE(call.ref_total_depth == expected.ref_total_depth);
+          REQUIRE(call.alt_total_depth == expected.alt_total_depth);
+          REQUIRE(call.alt_proper_pair_depth == expected.alt_proper_pair_depth);
+          REQUIRE(call.phred == expected.phred);
+          record_depth += expected.coverage[0] + expected.coverage[1] + expected.ambiguous_depth;
+        }
+
+        cr += record.cr;
+        mq0 += record.mq0;
+        mapq_root += static_cast<uint64_t>(record.mq) * record.mq * record_depth;
+        seq_depth += record_depth;
+
+        for (std::size_t a = 0; a < 2; ++a)
+        {
+          sbf[a] += record.sbf[a];
+          sbr[a] += record.sbr[a];
+          ra_count[a] += record.ra_count[a];
+        }
+      }
+
+      REQUIRE(var.infos.at("CR") == std::to_string(cr));
+      REQUIRE(var.infos.at("MQ0") == std::to_string(mq0));
+      REQUIRE(var.infos.at("SBF") == join_strand_bias(sbf));
+      REQUIRE(var.infos.at("SBR") == join_strand_bias(sbr));
+      REQUIRE(var.infos.at("RACount") == join_strand_bias(ra_count));
+
+      uint16_t const mq = seq_depth > 0 ?
+                          static_cast<uint16_t>(sqrt(static_cast<double>(mapq_root) / static_cast<double>(seq_depth))) :
+                          255;
+
+      REQUIRE(var.infos.at("MQ") == std::to_string(mq));
+    }
+
+    // Records of the same position and type get a suffix to their ID
+    std::vector<std::string> const ids = get_record_ids(merged_texts.back());
+    REQUIRE(ids.size() == NUM_RECORDS);
+
+    for (std::size_t r = 0; r < NUM_RECORDS; r += 3)
+    {
+      REQUIRE(ids[r].compare(0, 5, "chr1:") == 0);
+      REQUIRE(ids[r + 1] == ids[r] + ".0");
+      REQUIRE(ids[r + 2] == ids[r] + ".1");
+    }
+  }
+
+  REQUIRE(merged_texts[0] == merged_texts[1]);
+  REQUIRE(merged_texts[0] == merged_texts[2]);
+
+  // A VCF with fewer records than the first cannot be merged
+  std::mt19937 short_gen(24);
+  std::string const short_vcf = dir + "/short.vcf";
+  write_merge_vcf(short_gen, short_vcf, "short_", NUM_SAMPLES, NUM_RECORDS - 10);
+
+  for (unsigned const num_threads : {1u, 8u})
+  {
+    Options::instance()->threads = num_threads;
+    REQUIRE(get_exit_status_of_merge({vcfs[0], short_vcf, vcfs[2]}, dir + "/short_merged.vcf.gz") == 1);
+    Options::instance()->threads = threads;
+  }
+}
+
+
+TEST_CASE("Concatenating the BGZF blocks of large VCFs copies all of their records")
+{
+  using namespace gyper;
+
+  std::string const dir = std::string(gyper_BINARY_DIRECTORY) + "/test_vcf_concat";
+  mkdir(dir.c_str(), 0755);
+  std::mt19937 gen(24);
+
+  // A VCF of a single block, one of several blocks, one without an end-of-file marker and one which is larger than
+  // the buffer the blocks are copied with
+  std::vector<std::string> const vcfs = {dir + "/small.vcf.gz",
+                                         dir + "/several_blocks.vcf.gz",
+                                         dir + "/no_eof.vcf.gz",
+                                         dir + "/large.vcf.gz"};
+
+  std::string expected = BGZF_VCF_HEADER;
+  expected += write_bgzf_vcf(gen, vcfs[0], 10, 20);
+  expected += write_bgzf_vcf(gen, vcfs[1], 300, 1000);
+  expected += write_bgzf_vcf(gen, vcfs[2], 300, 1000, false /*has_eof*/);
+  expected += write_bgzf_vcf(gen, vcfs[3], 2000, 1000);
+
+  REQUIRE(get_file_size(vcfs[1]) > 3 * 65536);
+  REQUIRE(get_file_size(vcfs[3]) > 1048576 + 65536);
+
+  std::string const copied = dir + "/copied_large.vcf.gz";
+  REQUIRE(vcf_concatenate_bgzf_blocks(vcfs, copied));
+  REQUIRE(read_bgzf_text(copied) == expected);
+  REQUIRE(count_eof_markers(copied) == 1);
+
+  // The end-of-file marker is also held back when a VCF without one is last
+  std::vector<std::string> const no_eof_last = {vcfs[3], vcfs[2]};
+  std::string const copied_no_eof_last = dir + "/copied_no_eof_last.vcf.gz";
+  REQUIRE(vcf_concatenate_bgzf_blocks(no_eof_last, copied_no_eof_last));
+  REQUIRE(read_bgzf_text(copied_no_eof_last) == read_bgzf_text(vcfs[3]) +
+                                                 read_bgzf_text(vcfs[2]).substr(BGZF_VCF_HEADER.size()));
+  REQUIRE(count_eof_markers(copied_no_eof_last) == 1);
+}
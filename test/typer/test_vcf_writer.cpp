@@ -0,0 +1,174 @@
+#include <catch.hpp>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <graphtyper/graph/absolute_position.hpp>
+#include <graphtyper/graph/graph.hpp>
+#include <graphtyper/graph/var_record.hpp>
+#include <graphtyper/typer/genotype_paths.hpp>
+#include <graphtyper/typer/vcf_writer.hpp>
+#include <graphtyper/utilities/compact_bitset.hpp>
+
+
+namespace
+{
+
+std::size_t const NUM_VARIANTS = 150;
+uint32_t const VARIANT_SPACING = 100;
+
+
+/** Creates a graph with SNPs far enough apart for each of them to be in its own haplotype. */
+void
+create_graph_with_many_haplotypes()
+{
+  std::mt19937 gen(10);
+  char const bases[] = {'A', 'C', 'G', 'T'};
+  std::vector<char> reference_sequence(NUM_VARIANTS * VARIANT_SPACING + 1);
+
+  for (auto & base : reference_sequence)
+    base = bases[gen() % 4];
+
+  std::vector<gyper::VarRecord> records;
+
+  for (std::size_t v = 0; v < NUM_VARIANTS; ++v)
+  {
+    gyper::VarRecord record;
+    record.pos = static_cast<uint32_t>(v * VARIANT_SPACING + VARIANT_SPACING / 2);
+    record.ref = {reference_sequence[record.pos]};
+    record.alts = {{record.ref[0] == 'A' ? 'C' : 'A'}};
+    records.push_back(record);
+  }
+
+  uint32_t const length = static_cast<uint32_t>(reference_sequence.size());
+  gyper::graph = gyper::Graph(false /*use_absolute_positions*/);
+  gyper::graph.add_genomic_region(std::move(reference_sequence), std::move(records), gyper::GenomicRegion());
+  gyper::graph.create_special_positions();
+
+  gyper::Contig contig;
+  contig.name = "chr1";
+  contig.length = length;
+  gyper::graph.contigs.push_back(contig);
+  gyper::absolute_pos.calculate_offsets();
+}
+
+
+/**
+ * \brief Creates reads which explain alleles of one or two haplotypes. Haplotypes 'h' and 'h + 64' are guarded by
+ *        the same lock, so both reads of the same and of different lock stripes are created.
+ */
+std::vector<gyper::GenotypePaths>
+create_reads(std::vector<gyper::Haplotype> const & haplotypes, std::size_t const num_reads)
+{
+  std::mt19937 gen(11);
+  std::vector<gyper::GenotypePaths> genos(num_reads);
+
+  for (auto & geno : genos)
+  {
+    std::size_t const hap1 = gen() % haplotypes.size();
+    std::size_t hap2 = hap1;
+
+    if (gen() % 2 == 0)
+      hap2 = (hap1 + 64) % haplotypes.size(); // Same stripe
+    else if (gen() % 2 == 0)
+      hap2 = (hap1 + 1) % haplotypes.size(); // Different stripe
+
+    geno.read.resize(100, 'A');
+    geno.qual.resize(100, 'I');
+    geno.mapq = static_cast<uint8_t>(gen() % 61);
+    geno.forward_strand = gen() % 2 == 0;
+    geno.is_first_in_pair = gen() % 2 == 0;
+    geno.original_pos = gen() % 1000;
+
+    std::size_t const num_paths = 1 + gen() % 2;
+
+    for (std::size_t p = 0; p < num_paths; ++p)
+    {
+      gyper::Path path;
+      path.start = haplotypes[hap1].gts[0].id - 40;
+      path.end = path.start + 99;
+      path.read_start_index = 0;
+      path.read_end_index = 99;
+      path.mismatches = static_cast<uint16_t>(gen() % 2);
+
+      for (std::size_t const hap : {hap1, hap2})
+      {
+        if (path.var_order.size() > 0 && path.var_order.back() == haplotypes[hap].gts[0].id)
+          continue;
+
+        path.var_order.push_back(haplotypes[hap].gts[0].id);
+        path.nums.push_back(gyper::CompactBitset<gyper::MAX_NUMBER_OF_HAPLOTYPES>(1 + gen() % 3));
+      }
+
+      geno.paths.push_back(std::move(path));
+    }
+  }
+
+  return genos;
+}
+
+
+} // anon namespace
+
+
+TEST_CASE("Scoring reads on many threads gives the same haplotype scores as scoring them on one thread")
+{
+  using namespace gyper;
+
+  create_graph_with_many_haplotypes();
+  std::vector<std::string> const samples = {"sample1"};
+  std::size_t const NUM_READS = 20000;
+  std::size_t const NUM_THREADS = 8;
+
+  VcfWriter serial_writer(samples);
+  REQUIRE(serial_writer.haplotypes.size() == NUM_VARIANTS);
+
+  {
+    std::vector<GenotypePaths> genos = create_reads(serial_writer.haplotypes, NUM_READS);
+    serial_writer.update_haplotype_scores_from_paths(genos, 0);
+  }
+
+  VcfWriter parallel_writer(samples);
+
+  {
+    std::vector<GenotypePaths> genos = create_reads(parallel_writer.haplotypes, NUM_READS);
+    std::vector<std::vector<GenotypePaths> > batches(NUM_THREADS);
+
+    for (std::size_t i = 0; i < genos.size(); ++i)
+      batches[i % NUM_THREADS].push_back(std::move(genos[i]));
+
+    std::vector<std::thread> threads;
+
+    for (auto & batch : batches)
+      threads.emplace_back([&parallel_writer, &batch](){parallel_writer.update_haplotype_scores_from_paths(batch, 0);});
+
+    for (auto & thread : threads)
+      thread.join();
+  }
+
+  for (std::size_t h = 0; h < NUM_VARIANTS; ++h)
+  {
+    Haplotype const & serial = serial_writer.haplotypes[h];
+    Haplotype const & parallel = parallel_writer.haplotypes[h];
+
+    REQUIRE(serial.hap_samples[0].log_score == parallel.hap_samples[0].log_score);
+    REQUIRE(serial.hap_samples[0].gt_coverage == parallel.hap_samples[0].gt_coverage);
+    REQUIRE(serial.hap_samples[0].max_log_score == parallel.hap_samples[0].max_log_score);
+    REQUIRE(serial.hap_samples[0].get_ambiguous_depth() == parallel.hap_samples[0].get_ambiguous_depth());
+    REQUIRE(serial.hap_samples[0].get_ambiguous_depth_alt() == parallel.hap_samples[0].get_ambiguous_depth_alt());
+    REQUIRE(serial.var_stats.size() == parallel.var_stats.size());
+
+    for (std::size_t v = 0; v < serial.var_stats.size(); ++v)
+    {
+      REQUIRE(serial.var_stats[v].mapq_root_total == parallel.var_stats[v].mapq_root_total);
+      REQUIRE(serial.var_stats[v].mapq_allele_counts == parallel.var_stats[v].mapq_allele_counts);
+      REQUIRE(serial.var_stats[v].clipped_reads == parallel.var_stats[v].clipped_reads);
+      REQUIRE(serial.var_stats[v].realignment_count == parallel.var_stats[v].realignment_count);
+      REQUIRE(serial.var_stats[v].r1_strand_forward == parallel.var_stats[v].r1_strand_forward);
+      REQUIRE(serial.var_stats[v].r2_strand_reverse == parallel.var_stats[v].r2_strand_reverse);
+    }
+  }
+}
@@ -6,6 +6,9 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
 
 #include <seqan/basic.h>
 #include <seqan/stream.h>
@@ -14,11 +17,33 @@
 
 #include <graphtyper/graph/graph_serialization.hpp>
 #include <graphtyper/constants.hpp>
+#include <graphtyper/index/indexer.hpp>
 #include <graphtyper/index/kmer_label.hpp>
+#include <graphtyper/index/mem_index.hpp>
+#include <graphtyper/utilities/arena.hpp>
+#include <graphtyper/utilities/options.hpp>
 #include <graphtyper/utilities/type_conversions.hpp>
 #include <graphtyper/utilities/kmer_help_functions.hpp>
 
 
+namespace
+{
+
+void
+require_same_labels_as_query_index(std::vector<seqan::IupacString> const & reads)
+{
+  gyper::Arena arena;
+  std::vector<gyper::TKmerLabels> const batch_labels = gyper::query_index_batch(reads, arena);
+  REQUIRE(batch_labels.size() == reads.size());
+
+  for (std::size_t r = 0; r < reads.size(); ++r)
+    REQUIRE(batch_labels[r] == gyper::query_index(reads[r]));
+}
+
+
+} // anon namespace
+
+
 TEST_CASE("Get the number of kmers in a dna string")
 {
   using namespace gyper;
@@ -112,3 +137,60 @@ TEST_CASE("Get multiple uint64_t with Iupac reads")
     REQUIRE(keys.size() == 0);
   }
 }
+
+
+TEST_CASE("Querying the k-mers of reads in a batch gives the same labels as querying each read")
+{
+  using namespace gyper;
+
+  std::stringstream my_graph;
+  my_graph << gyper_SOURCE_DIRECTORY << "/test/data/graphs/index_test_chr1.grf";
+  std::stringstream my_index;
+  my_index << gyper_BINARY_DIRECTORY << "/test_kmer_help_functions_chr1";
+
+  gyper::load_graph(my_graph.str());
+  gyper::index_graph(my_graph.str(), my_index.str());
+  gyper::load_index(my_index.str());
+  gyper::mem_index.load();
+  REQUIRE(gyper::mem_index.hamming0.size() > 0);
+
+  // The k-mer of the repeat has 3 labels, and the k-mer with an S gets the labels of both alleles of the variant
+  std::vector<seqan::IupacString> reads;
+  reads.push_back("AGGTTTCCCCAGGTTTCCCCAGGTTTCCCCAG");
+  reads.push_back("GGTTTCCCCAGGTTTCCCCAGGTTTSCCCAGG");
+
+  // Reads of random lengths from the reference and the variant haplotype, with some ambiguous bases
+  std::vector<std::vector<char> > const haplotypes = {graph.get_all_ref(), graph.get_first_var()};
+  char const bases[] = {'A', 'C', 'G', 'T', 'N', 'R', 'Y', 'S', 'W', 'K', 'M', 'B', 'D', 'H', 'V'};
+  std::mt19937 gen(4);
+
+  for (int i = 0; i < 2000; ++i)
+  {
+    std::vector<char> const & hap = haplotypes[gen() % haplotypes.size()];
+    std::size_t const length = K + gen() % (hap.size() - K + 1);
+    std::size_t const begin = gen() % (hap.size() - length + 1);
+    std::string read(hap.begin() + begin, hap.begin() + begin + length);
+
+    for (std::size_t e = gen() % 4; e > 0; --e)
+      read[gen() % read.size()] = bases[gen() % sizeof(bases)];
+
+    reads.push_back(seqan::IupacString(read.c_str()));
+  }
+
+  SECTION("All labels are kept")
+  {
+    REQUIRE(query_index(reads[0])[0].size() == 3);
+    REQUIRE(query_index(reads[1])[0].size() > 1);
+    require_same_labels_as_query_index(reads);
+  }
+
+  SECTION("Read k-mers with more than max_index_labels labels get no labels")
+  {
+    uint64_t const max_index_labels = Options::instance()->max_index_labels;
+    Options::instance()->max_index_labels = 2;
+    REQUIRE(query_index(reads[0])[0].size() == 0);
+    REQUIRE(query_index(reads[1])[0].size() == 0);
+    require_same_labels_as_query_index(reads);
+    Options::instance()->max_index_labels = max_index_labels;
+  }
+}
@@ -0,0 +1,436 @@
+#include <catch.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sam.h"
+
+#include <seqan/basic.h>
+#include <seqan/bam_io.h>
+#include <seqan/sequence.h>
+
+#include <graphtyper/constants.hpp>
+#include <graphtyper/utilities/sam_reader.hpp>
+
+
+namespace
+{
+
+seqan::BamAlignmentRecord
+make_record(std::vector<std::pair<char, unsigned> > const & cigar, int32_t const begin_pos = 99)
+{
+  seqan::BamAlignmentRecord record;
+  record.qName = "read1";
+  record.beginPos = begin_pos;
+  record.flag = BAM_FPAIRED | BAM_FREVERSE;
+  record.mapQ = 42;
+  record.seq = "ACGTACGTAC";
+  record.qual = "IIIIIIIIII";
+
+  for (auto const & op : cigar)
+    seqan::appendValue(record.cigar, seqan::CigarElement<>(op.first, op.second));
+
+  return record;
+}
+
+
+gyper::SamRead
+make_read(std::vector<std::pair<char, unsigned> > const & cigar, int32_t const begin_pos = 99)
+{
+  seqan::BamAlignmentRecord record = make_record(cigar, begin_pos);
+  return gyper::make_sam_read(record);
+}
+
+
+std::string
+get_random_seq(std::mt19937 & gen, std::size_t const length = 80)
+{
+  char const bases[] = {'A', 'C', 'G', 'T'};
+  std::string seq(length, 'A');
+
+  for (auto & base : seq)
+    base = bases[gen() % 4];
+
+  return seq;
+}
+
+
+std::string
+get_reverse_complement(std::string const & seq)
+{
+  std::string rc(seq.rbegin(), seq.rend());
+
+  for (auto & base : rc)
+  {
+    switch (base)
+    {
+    case 'A': base = 'T'; break;
+    case 'C': base = 'G'; break;
+    case 'G': base = 'C'; break;
+    case 'T': base = 'A'; break;
+    default: break;
+    }
+  }
+
+  return rc;
+}
+
+
+/**
+ * \brief Gets a SAM line of a read which is fully aligned unless a CIGAR string is given. 'pos' and 'mate_pos' are
+ *        1-based and the mate is on the same contig.
+ */
+std::string
+get_sam_line(std::string const & name,
+             uint16_t const flag,
+             std::string const & chr,
+             int32_t const pos,
+             int32_t const mate_pos,
+             std::string const & seq,
+             std::string const & cigar = std::string(),
+             int const mapq = 60)
+{
+  std::ostringstream ss;
+  ss << name << "\t" << flag << "\t" << chr << "\t" << pos << "\t" << mapq << "\t"
+     << (cigar.size() > 0 ? cigar : std::to_string(seq.size()) + "M") << "\t"
+     << (mate_pos > 0 ? "=" : "*") << "\t" << mate_pos << "\t0\t"
+     << seq << "\t" << std::string(seq.size(), 'I') << "\n";
+  return ss.str();
+}
+
+
+/** Converts SAM text to a BAM file with an index, so regions of it can be read. */
+void
+write_indexed_bam(std::string const & path, std::string const & sam_text)
+{
+  std::string const sam_path = path + ".sam";
+
+  {
+    std::ofstream sam(sam_path);
+    REQUIRE(sam.is_open());
+    sam << sam_text;
+  }
+
+  samFile * sam_fp = sam_open(sam_path.c_str(), "r");
+  REQUIRE(sam_fp != nullptr);
+  bam_hdr_t * hdr = sam_hdr_read(sam_fp);
+  REQUIRE(hdr != nullptr);
+  samFile * bam_fp = sam_open(path.c_str(), "wb");
+  REQUIRE(bam_fp != nullptr);
+  REQUIRE(sam_hdr_write(bam_fp, hdr) == 0);
+  bam1_t * record = bam_init1();
+
+  while (sam_read1(sam_fp, hdr, record) >= 0)
+    REQUIRE(sam_write1(bam_fp, hdr, record) >= 0);
+
+  bam_destroy1(record);
+  bam_hdr_destroy(hdr);
+  sam_close(bam_fp);
+  sam_close(sam_fp);
+  REQUIRE(sam_index_build(path.c_str(), 0) == 0);
+}
+
+
+/** Reads batches of at most 'N' reads until the reader is done, as the caller does. */
+gyper::TReads
+read_all_reads(gyper::SamReader & reader, std::size_t const N)
+{
+  gyper::TReads all_reads;
+
+  while (true)
+  {
+    gyper::TReads reads = reader.read_N_reads(N);
+
+    if (reads.size() == 0)
+      break;
+
+    std::move(reads.begin(), reads.end(), std::back_inserter(all_reads));
+  }
+
+  return all_reads;
+}
+
+
+/** Gets the 0-based positions of all reads and mates which were read. */
+std::vector<int32_t>
+get_begin_positions(gyper::TReads const & reads)
+{
+  std::vector<int32_t> positions;
+
+  for (auto const & read_pair : reads)
+  {
+    positions.push_back(read_pair.first.begin_pos);
+
+    if (read_pair.second.begin_pos >= 0)
+      positions.push_back(read_pair.second.begin_pos);
+  }
+
+  std::sort(positions.begin(), positions.end());
+  return positions;
+}
+
+
+/** Sorts read pairs by the position of their first read. */
+void
+sort_by_begin_pos(gyper::TReads & reads)
+{
+  std::sort(reads.begin(), reads.end(), [](gyper::TReadPair const & a, gyper::TReadPair const & b){
+    return a.first.begin_pos < b.first.begin_pos;
+  });
+}
+
+
+} // anon namespace
+
+
+TEST_CASE("The BAM record fields used in alignment are moved to the read")
+{
+  seqan::BamAlignmentRecord record = make_record({{'M', 10}});
+  gyper::SamRead const read = gyper::make_sam_read(record);
+
+  REQUIRE(read.seq == "ACGTACGTAC");
+  REQUIRE(read.qual == "IIIIIIIIII");
+  REQUIRE(read.begin_pos == 99);
+  REQUIRE(read.flag == (BAM_FPAIRED | BAM_FREVERSE));
+  REQUIRE(read.mapq == 42);
+  REQUIRE(read.is_paired());
+  REQUIRE(read.is_reverse());
+  REQUIRE(!read.is_unmapped());
+}
+
+
+TEST_CASE("The CIGAR string of a read is summarized by its clipping")
+{
+  SECTION("A fully aligned read is not clipped")
+  {
+    gyper::SamRead const read = make_read({{'M', 10}});
+    REQUIRE(!read.is_clipped);
+    REQUIRE(read.front_soft_clip == 0);
+  }
+
+  SECTION("Insertions and deletions are not clipping")
+  {
+    gyper::SamRead const read = make_read({{'M', 4}, {'I', 2}, {'M', 2}, {'D', 3}, {'M', 2}});
+    REQUIRE(!read.is_clipped);
+    REQUIRE(read.front_soft_clip == 0);
+  }
+
+  SECTION("Soft clipping at the start")
+  {
+    gyper::SamRead const read = make_read({{'S', 3}, {'M', 7}});
+    REQUIRE(read.is_clipped);
+    REQUIRE(read.front_soft_clip == 3);
+  }
+
+  SECTION("Soft clipping at the end")
+  {
+    gyper::SamRead const read = make_read({{'M', 7}, {'S', 3}});
+    REQUIRE(read.is_clipped);
+    REQUIRE(read.front_soft_clip == 0);
+  }
+
+  SECTION("Soft clipping at both ends")
+  {
+    gyper::SamRead const read = make_read({{'S', 2}, {'M', 6}, {'S', 2}});
+    REQUIRE(read.is_clipped);
+    REQUIRE(read.front_soft_clip == 2);
+  }
+
+  SECTION("Hard clipping at the start is clipping, but the bases are not in the read")
+  {
+    gyper::SamRead const read = make_read({{'H', 5}, {'M', 10}});
+    REQUIRE(read.is_clipped);
+    REQUIRE(read.front_soft_clip == 0);
+  }
+
+  SECTION("Hard clipping at the end")
+  {
+    gyper::SamRead const read = make_read({{'M', 10}, {'H', 5}});
+    REQUIRE(read.is_clipped);
+    REQUIRE(read.front_soft_clip == 0);
+  }
+
+  SECTION("Hard clipping outside of soft clipping")
+  {
+    // Only soft clipping at the very start of the CIGAR string is counted, as get_original_position() always did
+    gyper::SamRead const read = make_read({{'H', 5}, {'S', 3}, {'M', 7}});
+    REQUIRE(read.is_clipped);
+    REQUIRE(read.front_soft_clip == 0);
+  }
+
+  SECTION("A read without a CIGAR string is treated as clipped")
+  {
+    gyper::SamRead const read = make_read({});
+    REQUIRE(read.is_clipped);
+    REQUIRE(read.front_soft_clip == 0);
+  }
+}
+
+
+TEST_CASE("The original position of a read includes its soft-clipped bases")
+{
+  REQUIRE(make_read({{'M', 10}}).get_original_position() == 100);
+  REQUIRE(make_read({{'S', 3}, {'M', 7}}).get_original_position() == 97);
+  REQUIRE(make_read({{'M', 7}, {'S', 3}}).get_original_position() == 100);
+  REQUIRE(make_read({{'H', 5}, {'M', 10}}).get_original_position() == 100);
+  REQUIRE(make_read({{'S', 3}, {'M', 7}}, 0).get_original_position() == -2);
+
+  gyper::SamRead read = make_read({{'S', 3}, {'M', 7}});
+  read.clear_cigar();
+  REQUIRE(read.is_clipped);
+  REQUIRE(read.get_original_position() == 100);
+}
+
+
+TEST_CASE("Reads and mates overlapping adjacent windows are only read once")
+{
+  using namespace gyper;
+
+  std::mt19937 gen(16);
+  std::ostringstream sam;
+  sam << "@HD\tVN:1.6\tSO:coordinate\n"
+      << "@SQ\tSN:chr1\tLN:1000\n"
+      << "@SQ\tSN:chr2\tLN:1000\n";
+
+  // The windows are chr1:101-200, chr1:201-300 and chr2:1-100, and the reads are 80 bases
+  sam << get_sam_line("pair2", 99, "chr1", 101, 231, get_random_seq(gen)) // Only in the first window
+      << get_sam_line("read3", 0, "chr1", 121, 0, get_random_seq(gen))
+      << get_sam_line("read1", 0, "chr1", 151, 0, get_random_seq(gen)) // In both windows
+      << get_sam_line("pair1", 99, "chr1", 171, 191, get_random_seq(gen)) // Both mates are in both windows
+      << get_sam_line("pair1", 147, "chr1", 191, 171, get_random_seq(gen))
+      << get_sam_line("read2", 16, "chr1", 211, 0, get_random_seq(gen))
+      << get_sam_line("pair2", 147, "chr1", 231, 101, get_random_seq(gen)) // Only in the second window
+      // Reads on the next chromosome start before the end of the previous window, but have not been read
+      << get_sam_line("read4", 0, "chr2", 11, 0, get_random_seq(gen))
+      << get_sam_line("pair3", 99, "chr2", 21, 31, get_random_seq(gen))
+      << get_sam_line("pair3", 147, "chr2", 31, 21, get_random_seq(gen));
+
+  std::string const bam_path = std::string(gyper_BINARY_DIRECTORY) + "/test_sam_reader_windows.bam";
+  write_indexed_bam(bam_path, sam.str());
+  std::vector<std::string> const windows = {"chr1:101-200", "chr1:201-300", "chr2:1-100"};
+
+  // Both with a batch per read and with all reads in one batch
+  for (std::size_t const N : std::vector<std::size_t>({1, 1000}))
+  {
+    SamReader reader(bam_path, windows);
+    TReads const reads = read_all_reads(reader, N);
+    REQUIRE(get_begin_positions(reads) == std::vector<int32_t>({10, 20, 30, 100, 120, 150, 170, 190, 210, 230}));
+
+    std::vector<std::pair<int32_t, int32_t> > pairs;
+
+    for (auto const & read_pair : reads)
+    {
+      if (read_pair.second.begin_pos >= 0)
+        pairs.push_back({read_pair.first.begin_pos, read_pair.second.begin_pos});
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+    REQUIRE(pairs == std::vector<std::pair<int32_t, int32_t> >({{20, 30}, {100, 230}, {170, 190}}));
+  }
+}
+
+
+TEST_CASE("Mates are paired in the order of the template and unpaired reads are returned at the end")
+{
+  using namespace gyper;
+
+  std::mt19937 gen(13);
+  std::vector<std::string> seqs;
+
+  for (int i = 0; i < 11; ++i)
+    seqs.push_back(get_random_seq(gen));
+
+  std::string const n_seq = "N" + seqs[10].substr(1); // Has a CIGAR string until the N is trimmed
+  std::ostringstream sam;
+  sam << "@HD\tVN:1.6\tSO:coordinate\n"
+      << "@SQ\tSN:chr1\tLN:1000\n";
+
+  sam << get_sam_line("pair1", 99, "chr1", 101, 201, seqs[0]) // Read 1 forward, read 2 reverse
+      << get_sam_line("pair2", 163, "chr1", 111, 211, seqs[1]) // Read 2 forward comes before read 1 reverse
+      << get_sam_line("read1", 16, "chr1", 121, 0, seqs[2]) // Not paired and reverse
+      << get_sam_line("read2", 0, "chr1", 131, 0, seqs[3])
+      // The mate is mapped but not in the file, so the read is unpaired even though it is clipped at both ends
+      << get_sam_line("mateless1", 97, "chr1", 141, 901, seqs[4], "15S50M15S")
+      // The mate is unmapped and the read is good
+      << get_sam_line("mateless2", 73, "chr1", 151, 0, seqs[5])
+      // The mate is unmapped and the read is clipped at both ends
+      << get_sam_line("mateless3", 73, "chr1", 161, 0, seqs[6], "15S50M15S")
+      // The mate is unmapped and the read is not good once its N is trimmed and its CIGAR string cleared
+      << get_sam_line("mateless4", 73, "chr1", 171, 0, n_seq, "", 0)
+      // The same read is kept when its mate is found, even though it is unmapped
+      << get_sam_line("pair3", 73, "chr1", 181, 0, n_seq, "", 0)
+      << get_sam_line("pair3", 133, "chr1", 181, 0, seqs[7], "*")
+      << get_sam_line("pair1", 147, "chr1", 201, 101, seqs[9])
+      << get_sam_line("pair2", 83, "chr1", 211, 111, seqs[8])
+      << get_sam_line("duplicate", 1024, "chr1", 221, 0, seqs[0])
+      << get_sam_line("secondary", 256, "chr1", 231, 0, seqs[0]);
+
+  std::string const bam_path = std::string(gyper_BINARY_DIRECTORY) + "/test_sam_reader_pairs.bam";
+  write_indexed_bam(bam_path, sam.str());
+
+  for (std::size_t const N : std::vector<std::size_t>({1, 1000}))
+  {
+    SamReader reader(bam_path, {"."});
+    TReads pairs;
+    TReads unpaired;
+
+    while (true)
+    {
+      TReads reads = reader.read_N_reads(N);
+
+      if (reads.size() == 0)
+        break;
+
+      // Once an unpaired read is returned, all mates have been paired
+      REQUIRE(unpaired.size() == 0);
+
+      for (auto & read_pair : reads)
+      {
+        if (read_pair.second.begin_pos >= 0)
+          pairs.push_back(std::move(read_pair));
+        else
+          unpaired.push_back(std::move(read_pair));
+      }
+    }
+
+    sort_by_begin_pos(pairs);
+
+    REQUIRE(pairs.size() == 3);
+
+    // Read 1 is reverse complemented if it is reverse and read 2 if it is not reverse
+    REQUIRE(pairs[0].first.begin_pos == 100);
+    REQUIRE(pairs[0].first.is_first());
+    REQUIRE(pairs[0].first.seq == seqan::IupacString(seqs[0].c_str()));
+    REQUIRE(pairs[0].second.begin_pos == 200);
+    REQUIRE(pairs[0].second.seq == seqan::IupacString(seqs[9].c_str()));
+
+    REQUIRE(pairs[1].first.begin_pos == 180);
+    REQUIRE(pairs[1].first.seq == seqan::IupacString(n_seq.substr(1).c_str()));
+    REQUIRE(pairs[1].second.begin_pos == 180);
+    REQUIRE(pairs[1].second.is_unmapped());
+    REQUIRE(pairs[1].second.seq == seqan::IupacString(get_reverse_complement(seqs[7]).c_str()));
+
+    REQUIRE(pairs[2].first.begin_pos == 210);
+    REQUIRE(pairs[2].first.is_first());
+    REQUIRE(pairs[2].first.seq == seqan::IupacString(get_reverse_complement(seqs[8]).c_str()));
+    REQUIRE(pairs[2].second.begin_pos == 110);
+    REQUIRE(!pairs[2].second.is_first());
+    REQUIRE(pairs[2].second.seq == seqan::IupacString(get_reverse_complement(seqs[1]).c_str()));
+
+    sort_by_begin_pos(unpaired);
+
+    REQUIRE(get_begin_positions(unpaired) == std::vector<int32_t>({120, 130, 140, 150}));
+    REQUIRE(unpaired[0].first.seq == seqan::IupacString(get_reverse_complement(seqs[2]).c_str()));
+    REQUIRE(unpaired[1].first.seq == seqan::IupacString(seqs[3].c_str()));
+    REQUIRE(unpaired[2].first.is_clipped);
+    REQUIRE(unpaired[2].first.seq == seqan::IupacString(seqs[4].c_str()));
+    REQUIRE(unpaired[3].first.seq == seqan::IupacString(seqs[5].c_str()));
+  }
+}
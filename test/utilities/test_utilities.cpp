@@ -3,7 +3,10 @@
 #include <stdio.h>
 #include <climits>
 #include <cstdio>
+#include <limits>
+#include <sstream>
 #include <string>
+#include <vector>
 #include <iostream>
 #include <fstream>
 
@@ -11,12 +14,56 @@
 #include <graphtyper/constants.hpp>
 #include <graphtyper/utilities/type_conversions.hpp>
 #include <graphtyper/utilities/kmer_help_functions.hpp>
+#include <graphtyper/utilities/arena.hpp>
+#include <graphtyper/utilities/compact_bitset.hpp>
+#include <graphtyper/utilities/text_buffer.hpp>
 
 #include <seqan/basic.h>
 #include <seqan/sequence.h>
 #include <seqan/arg_parse.h>
 
 
+namespace
+{
+
+/** Checks that an integer is formatted by TextBuffer as by std::ostream. */
+template <typename T>
+void
+check_text_buffer_integers()
+{
+  std::vector<T> const values = {
+    std::numeric_limits<T>::min(),
+    static_cast<T>(std::numeric_limits<T>::min() + 1),
+    static_cast<T>(-100),
+    static_cast<T>(-10),
+    static_cast<T>(-9),
+    static_cast<T>(-1),
+    0,
+    1,
+    9,
+    10,
+    99,
+    100,
+    static_cast<T>(std::numeric_limits<T>::max() - 1),
+    std::numeric_limits<T>::max()
+  };
+
+  gyper::TextBuffer text;
+
+  for (T const value : values)
+  {
+    std::ostringstream ss;
+    ss << value;
+    text.clear();
+    text << value;
+    REQUIRE(text.str == ss.str());
+  }
+}
+
+
+} // anon namespace
+
+
 TEST_CASE("Converting reads", "[utils]")
 {
   using namespace gyper;
@@ -155,3 +202,91 @@ TEST_CASE("Hamming distance 1")
   }
 
 }
+
+
+TEST_CASE("Compact bitset only spills high bits to the heap", "[utils]")
+{
+  using namespace gyper;
+
+  CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> low;
+  low.set(2);
+  REQUIRE(low == CompactBitset<MAX_NUMBER_OF_HAPLOTYPES>(1 << 2));
+  REQUIRE(low.count() == 1);
+
+  CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> high;
+  high.set(1000);
+  REQUIRE(high.test(1000));
+  REQUIRE(!high.test(2));
+  REQUIRE((low & high).none());
+
+  low |= high;
+  REQUIRE(low.count() == 2);
+  REQUIRE(low.test(2));
+  REQUIRE(low.test(1000));
+
+  low &= CompactBitset<MAX_NUMBER_OF_HAPLOTYPES>(1 << 2);
+  REQUIRE(low == CompactBitset<MAX_NUMBER_OF_HAPLOTYPES>(1 << 2));
+
+  CompactBitset<MAX_NUMBER_OF_HAPLOTYPES> lowest;
+  lowest.set_lowest(130);
+  REQUIRE(lowest.count() == 130);
+  REQUIRE(lowest.test(129));
+  REQUIRE(!lowest.test(130));
+
+  lowest.set();
+  REQUIRE(lowest.count() == MAX_NUMBER_OF_HAPLOTYPES);
+  lowest.reset();
+  REQUIRE(lowest.none());
+}
+
+
+TEST_CASE("Arena reuses a single block after a reset", "[utils]")
+{
+  using namespace gyper;
+
+  Arena arena(1024);
+
+  {
+    ArenaVector<uint64_t> values{ArenaAllocator<uint64_t>(arena)};
+
+    for (uint64_t i = 0; i < 1000; ++i)
+      values.push_back(i);
+
+    REQUIRE(values.size() == 1000);
+    REQUIRE(values[999] == 999);
+    REQUIRE(reinterpret_cast<uintptr_t>(values.data()) % alignof(uint64_t) == 0);
+  }
+
+  std::size_t const capacity = arena.capacity();
+  REQUIRE(capacity >= 1000 * sizeof(uint64_t));
+  arena.reset();
+  REQUIRE(arena.capacity() == capacity);
+
+  // Everything allocated before the reset fits in the merged block
+  ArenaVector<uint64_t> values(1000, 1, ArenaAllocator<uint64_t>(arena));
+  REQUIRE(arena.capacity() == capacity);
+}
+
+
+TEST_CASE("TextBuffer formats integers as std::ostream", "[utils]")
+{
+  check_text_buffer_integers<short>();
+  check_text_buffer_integers<unsigned short>();
+  check_text_buffer_integers<int>();
+  check_text_buffer_integers<unsigned int>();
+  check_text_buffer_integers<long>();
+  check_text_buffer_integers<unsigned long>();
+  check_text_buffer_integers<long long>();
+  check_text_buffer_integers<unsigned long long>();
+  check_text_buffer_integers<int16_t>();
+  check_text_buffer_integers<uint16_t>();
+  check_text_buffer_integers<int32_t>();
+  check_text_buffer_integers<uint32_t>();
+  check_text_buffer_integers<int64_t>();
+  check_text_buffer_integers<uint64_t>();
+
+  // Characters and booleans are not formatted as integers
+  gyper::TextBuffer text;
+  text << 'A' << static_cast<signed char>('B') << static_cast<unsigned char>('C') << true << false << -0 << "\t";
+  REQUIRE(text.str == "ABC100\t");
+}